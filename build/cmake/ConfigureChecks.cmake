@@ -52,6 +52,11 @@ check_include_file(poll.h HAVE_POLL_H)
 check_include_file(sys/poll.h HAVE_SYS_POLL_H)
 check_include_file(sys/select.h HAVE_SYS_SELECT_H)
 check_include_file(sched.h HAVE_SCHED_H)
+check_include_file(sys/eventfd.h HAVE_SYS_EVENTFD_H)
+
+# Compression libraries for THeaderTransport, see DefineOptions.cmake
+set(HAVE_LIBZSTD ${WITH_ZSTD})
+set(HAVE_LIBLZ4 ${WITH_LZ4})
 check_include_file(string.h HAVE_STRING_H)
 check_include_file(strings.h HAVE_STRINGS_H)
 
@@ -66,6 +71,16 @@ check_cxx_source_compiles(
   "
   HAVE_AF_UNIX_H)
 
+# TIoUringServer uses the io_uring interface of Linux 5.19 (multishot accept),
+# an older <linux/io_uring.h> counts as no io_uring support
+check_cxx_source_compiles(
+  "
+  #include <linux/io_uring.h>
+  int main(){return IORING_SETUP_CQSIZE | IORING_FEAT_SINGLE_MMAP | IORING_OP_SEND | IORING_ACCEPT_MULTISHOT;}
+  "
+  HAVE_IO_URING_MULTISHOT_ACCEPT)
+set(HAVE_LINUX_IO_URING_H ${HAVE_IO_URING_MULTISHOT_ACCEPT})
+
 
 check_function_exists(gethostbyname HAVE_GETHOSTBYNAME)
 check_function_exists(gethostbyname_r HAVE_GETHOSTBYNAME_R)
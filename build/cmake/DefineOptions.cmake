@@ -67,12 +67,24 @@ if(WITH_CPP)
     find_package(ZLIB QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_ZLIB "Build with ZLIB support" ON
                            "ZLIB_FOUND" OFF)
+    # Additional compression transforms of THeaderTransport
+    find_path(ZSTD_INCLUDE_DIR zstd.h)
+    find_library(ZSTD_LIBRARY zstd)
+    CMAKE_DEPENDENT_OPTION(WITH_ZSTD "Build with zstd support" ON
+                           "WITH_ZLIB;ZSTD_INCLUDE_DIR;ZSTD_LIBRARY" OFF)
+    find_path(LZ4_INCLUDE_DIR lz4.h)
+    find_library(LZ4_LIBRARY lz4)
+    CMAKE_DEPENDENT_OPTION(WITH_LZ4 "Build with lz4 support" ON
+                           "WITH_ZLIB;LZ4_INCLUDE_DIR;LZ4_LIBRARY" OFF)
     find_package(Libevent QUIET)
     CMAKE_DEPENDENT_OPTION(WITH_LIBEVENT "Build with libevent support" ON
                            "Libevent_FOUND" OFF)
     find_package(Qt5 QUIET COMPONENTS Core Network)
     CMAKE_DEPENDENT_OPTION(WITH_QT5 "Build with Qt5 support" ON
                            "Qt5_FOUND" OFF)
+    find_package(benchmark QUIET)
+    CMAKE_DEPENDENT_OPTION(WITH_BENCHMARK "Build the serialization benchmarks (requires Google Benchmark)" ON
+                           "benchmark_FOUND" OFF)
 endif()
 CMAKE_DEPENDENT_OPTION(BUILD_CPP "Build C++ library" ON
                        "BUILD_LIBRARIES;WITH_CPP" OFF)
@@ -185,6 +197,9 @@ if (BUILD_CPP)
     message(STATUS "    Build with libevent support:              ${WITH_LIBEVENT}")
     message(STATUS "    Build with Qt5 support:                   ${WITH_QT5}")
     message(STATUS "    Build with ZLIB support:                  ${WITH_ZLIB}")
+    message(STATUS "    Build with zstd support:                  ${WITH_ZSTD}")
+    message(STATUS "    Build with lz4 support:                   ${WITH_LZ4}")
+    message(STATUS "    Build serialization benchmarks:           ${WITH_BENCHMARK}")
 endif ()
 message(STATUS)
 message(STATUS "  Build C (GLib) library:                     ${BUILD_C_GLIB}")
@@ -27,6 +27,8 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -61,6 +63,7 @@ public:
     gen_pure_enums_ = false;
     use_include_prefix_ = false;
     gen_cob_style_ = false;
+    gen_future_style_ = false;
     gen_no_client_completion_ = false;
     gen_no_default_operators_ = false;
     gen_templates_ = false;
@@ -68,6 +71,8 @@ public:
     gen_moveable_ = false;
     gen_no_ostream_operators_ = false;
     gen_no_skeleton_ = false;
+    gen_string_view_fields_ = false;
+    gen_arena_ = false;
     has_members_ = false;
 
     for( iter = parsed_options.begin(); iter != parsed_options.end(); ++iter) {
@@ -77,6 +82,10 @@ public:
         use_include_prefix_ = true;
       } else if( iter->first.compare("cob_style") == 0) {
         gen_cob_style_ = true;
+      } else if( iter->first.compare("future_style") == 0) {
+        // future clients are built on top of the cob clients
+        gen_cob_style_ = true;
+        gen_future_style_ = true;
       } else if( iter->first.compare("no_client_completion") == 0) {
         gen_no_client_completion_ = true;
       } else if( iter->first.compare("no_default_operators") == 0) {
@@ -90,6 +99,10 @@ public:
         gen_no_ostream_operators_ = true;
       } else if ( iter->first.compare("no_skeleton") == 0) {
         gen_no_skeleton_ = true;
+      } else if ( iter->first.compare("string_view_fields") == 0) {
+        gen_string_view_fields_ = true;
+      } else if ( iter->first.compare("arena") == 0) {
+        gen_arena_ = true;
       } else {
         throw "unknown option cpp:" + iter->first;
       }
@@ -117,6 +130,8 @@ public:
   void generate_enum_ostream_operator(std::ostream& out, t_enum* tenum);
   void generate_enum_to_string_helper_function_decl(std::ostream& out, t_enum* tenum);
   void generate_enum_to_string_helper_function(std::ostream& out, t_enum* tenum);
+  void generate_enum_append_function_decl(std::ostream& out, t_enum* tenum);
+  void generate_enum_append_function(std::ostream& out, t_enum* tenum);
   void generate_forward_declaration(t_struct* tstruct) override;
   void generate_struct(t_struct* tstruct) override { generate_cpp_struct(tstruct, false); }
   void generate_xception(t_struct* txception) override { generate_cpp_struct(txception, true); }
@@ -157,6 +172,7 @@ public:
   void generate_struct_result_writer(std::ostream& out, t_struct* tstruct, bool pointers = false);
   void generate_struct_swap(std::ostream& out, t_struct* tstruct);
   void generate_struct_print_method(std::ostream& out, t_struct* tstruct);
+  void generate_struct_append_method(std::ostream& out, t_struct* tstruct);
   void generate_exception_what_method(std::ostream& out, t_struct* tstruct);
 
   /**
@@ -169,6 +185,7 @@ public:
   void generate_service_multiface(t_service* tservice);
   void generate_service_helpers(t_service* tservice);
   void generate_service_client(t_service* tservice, string style);
+  void generate_service_future_client(t_service* tservice);
   void generate_service_processor(t_service* tservice, string style);
   void generate_service_skeleton(t_service* tservice);
   void generate_process_function(t_service* tservice,
@@ -260,12 +277,49 @@ public:
   void generate_struct_ostream_operator_decl(std::ostream& f, t_struct* tstruct);
   void generate_struct_ostream_operator(std::ostream& f, t_struct* tstruct);
   void generate_struct_print_method_decl(std::ostream& f, t_struct* tstruct);
+  void generate_struct_append_method_decl(std::ostream& f, t_struct* tstruct);
+  void generate_struct_append_function(std::ostream& f, t_struct* tstruct);
   void generate_exception_what_method_decl(std::ostream& f,
                                            t_struct* tstruct,
                                            bool external = false);
 
   bool is_reference(t_field* tfield) { return tfield->get_reference(); }
 
+  bool is_string_view_field(t_field* tfield) const {
+    return string_view_fields_.find(tfield) != string_view_fields_.end();
+  }
+
+  bool is_arena_string(t_type* ttype) {
+    ttype = get_true_type(ttype);
+    return gen_arena_ && ttype->is_string()
+           && ttype->annotations_.find("cpp.type") == ttype->annotations_.end();
+  }
+
+  /**
+   * Returns the name of the protocol's bulk array functions for a list, e.g.
+   * "I32" for readI32Array(), or an empty string if the list is read and
+   * written element by element.
+   */
+  std::string list_array_name(t_type* ttype) {
+    if (!ttype->is_list() || ((t_container*)ttype)->has_cpp_name()) {
+      return "";
+    }
+    t_type* elem = get_true_type(((t_list*)ttype)->get_elem_type());
+    if (!elem->is_base_type() || elem->annotations_.find("cpp.type") != elem->annotations_.end()) {
+      return "";
+    }
+    switch (((t_base_type*)elem)->get_base()) {
+    case t_base_type::TYPE_I32:
+      return "I32";
+    case t_base_type::TYPE_I64:
+      return "I64";
+    case t_base_type::TYPE_DOUBLE:
+      return "Double";
+    default:
+      return "";
+    }
+  }
+
   bool is_complex_type(t_type* ttype) {
     ttype = get_true_type(ttype);
 
@@ -350,6 +404,11 @@ private:
    */
   bool gen_cob_style_;
 
+  /**
+   * True if we should generate future returning clients as well.
+   */
+  bool gen_future_style_;
+
   /**
    * True if we should omit calls to completion__() in CobClient class.
    */
@@ -365,6 +424,21 @@ private:
    */
   bool gen_no_skeleton_;
 
+  /**
+   * True if string and binary fields of structs should be TStringViews.
+   */
+  bool gen_string_view_fields_;
+
+  /**
+   * Struct members declared as TStringView instead of std::string
+   */
+  std::set<t_field*> string_view_fields_;
+
+  /**
+   * True if strings and containers should use apache::thrift::TArenaAllocator
+   */
+  bool gen_arena_;
+
   /**
    * True if thrift has member(s)
    */
@@ -439,6 +513,7 @@ void t_cpp_generator::init_generator() {
            << "#include <thrift/Thrift.h>" << endl
            << "#include <thrift/TApplicationException.h>" << endl
            << "#include <thrift/TBase.h>" << endl
+           << "#include <thrift/TToString.h>" << endl
            << "#include <thrift/protocol/TProtocol.h>" << endl
            << "#include <thrift/transport/TTransport.h>" << endl
            << endl;
@@ -620,6 +695,9 @@ void t_cpp_generator::generate_enum(t_enum* tenum) {
 
   generate_enum_to_string_helper_function_decl(f_types_, tenum);
   generate_enum_to_string_helper_function(f_types_impl_, tenum);
+
+  generate_enum_append_function_decl(f_types_, tenum);
+  generate_enum_append_function(f_types_impl_, tenum);
 }
 
 void t_cpp_generator::generate_enum_ostream_operator_decl(std::ostream& out, t_enum* tenum) {
@@ -706,6 +784,49 @@ void t_cpp_generator::generate_enum_to_string_helper_function(std::ostream& out,
   }
 }
 
+void t_cpp_generator::generate_enum_append_function_decl(std::ostream& out, t_enum* tenum) {
+  // enums with a custom ostream operator are printed with it
+  if (!has_custom_ostream(tenum)) {
+    out << "void appendTo(std::string& out, const ";
+    if (gen_pure_enums_) {
+      out << tenum->get_name();
+    } else {
+      out << tenum->get_name() << "::type&";
+    }
+    out << " val, const ::apache::thrift::TToStringLimit& limit = "
+           "::apache::thrift::TToStringLimit());" << endl;
+    out << endl;
+  }
+}
+
+void t_cpp_generator::generate_enum_append_function(std::ostream& out, t_enum* tenum) {
+  if (!has_custom_ostream(tenum)) {
+    out << "void appendTo(std::string& out, const ";
+    if (gen_pure_enums_) {
+      out << tenum->get_name();
+    } else {
+      out << tenum->get_name() << "::type&";
+    }
+    out << " val, const ::apache::thrift::TToStringLimit& limit) ";
+    scope_up(out);
+
+    out << indent() << "std::map<int, const char*>::const_iterator it = _"
+             << tenum->get_name() << "_VALUES_TO_NAMES.find(val);" << endl;
+    out << indent() << "if (it != _" << tenum->get_name() << "_VALUES_TO_NAMES.end()) {" << endl;
+    indent_up();
+    out << indent() << "out.append(it->second);" << endl;
+    indent_down();
+    out << indent() << "} else {" << endl;
+    indent_up();
+    out << indent() << "::apache::thrift::appendTo(out, static_cast<int>(val), limit);" << endl;
+    indent_down();
+    out << indent() << "}" << endl;
+
+    scope_down(out);
+    out << endl;
+  }
+}
+
 /**
  * Generates a class that holds all the constants.
  */
@@ -902,6 +1023,20 @@ void t_cpp_generator::generate_forward_declaration(t_struct* tstruct) {
  * @param tstruct The struct definition
  */
 void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception) {
+  if (gen_string_view_fields_) {
+    // Only fields of user defined structs; service arguments and results
+    // have to match the std::string parameters of the handler interface.
+    const vector<t_field*>& members = tstruct->get_members();
+    for (vector<t_field*>::const_iterator m_iter = members.begin(); m_iter != members.end();
+         ++m_iter) {
+      t_type* type = get_true_type((*m_iter)->get_type());
+      if (type->is_string() && !is_reference(*m_iter)
+          && type->annotations_.find("cpp.type") == type->annotations_.end()) {
+        string_view_fields_.insert(*m_iter);
+      }
+    }
+  }
+
   generate_struct_declaration(f_types_, tstruct, is_exception, false, true, true, true, true);
   generate_struct_definition(f_types_impl_, f_types_impl_, tstruct, true, true);
 
@@ -920,6 +1055,7 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
 
   if (!has_custom_ostream(tstruct)) {
     generate_struct_print_method(f_types_impl_, tstruct);
+    generate_struct_append_method(f_types_impl_, tstruct);
   }
 
   if (is_exception) {
@@ -1239,6 +1375,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
       out << endl << indent() << "void __set_" << (*m_iter)->get_name() << "(::std::shared_ptr<"
           << type_name((*m_iter)->get_type(), false, false) << ">";
       out << " val);" << endl;
+    } else if (is_string_view_field(*m_iter)) {
+      out << endl << indent() << "void __set_" << (*m_iter)->get_name()
+          << "(const ::apache::thrift::TStringView& val);" << endl;
     } else {
       out << endl << indent() << "void __set_" << (*m_iter)->get_name() << "("
           << type_name((*m_iter)->get_type(), false, true);
@@ -1294,6 +1433,15 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
         out << " override";
       out << ';' << endl;
     }
+    if (gen_arena_ && !pointers) {
+      if (gen_templates_) {
+        out << indent() << "template <class Protocol_>" << endl << indent()
+            << "uint32_t read(Protocol_* iprot, ::apache::thrift::TArena& arena);" << endl;
+      } else {
+        out << indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot, "
+            << "::apache::thrift::TArena& arena);" << endl;
+      }
+    }
   }
   if (write) {
     if (gen_templates_) {
@@ -1313,6 +1461,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
     out << indent() << "virtual ";
     generate_struct_print_method_decl(out, nullptr);
     out << ";" << endl;
+    out << indent();
+    generate_struct_append_method_decl(out, nullptr);
+    out << ";" << endl;
   }
 
   // std::exception::what()
@@ -1339,6 +1490,9 @@ void t_cpp_generator::generate_struct_declaration(ostream& out,
 
   if (is_user_struct) {
     generate_struct_ostream_operator_decl(out, tstruct);
+    if (!has_custom_ostream(tstruct)) {
+      generate_struct_append_function(out, tstruct);
+    }
   }
 }
 
@@ -1369,6 +1523,9 @@ void t_cpp_generator::generate_struct_definition(ostream& out,
             << (*m_iter)->get_name() << "(::std::shared_ptr<"
             << type_name((*m_iter)->get_type(), false, false) << ">";
         out << " val) {" << endl;
+      } else if (is_string_view_field(*m_iter)) {
+        out << endl << indent() << "void " << tstruct->get_name() << "::__set_"
+            << (*m_iter)->get_name() << "(const ::apache::thrift::TStringView& val) {" << endl;
       } else {
         out << endl << indent() << "void " << tstruct->get_name() << "::__set_"
             << (*m_iter)->get_name() << "(" << type_name((*m_iter)->get_type(), false, true);
@@ -1425,6 +1582,26 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
       << indent() << "using ::apache::thrift::protocol::TProtocolException;" << endl
       << endl;
 
+  // Members created before an arena became current are moved into it
+  if (gen_arena_ && !pointers) {
+    bool rebound = false;
+    for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+      t_type* type = get_true_type((*f_iter)->get_type());
+      if (is_reference(*f_iter) || is_string_view_field(*f_iter)) {
+        continue;
+      }
+      if ((type->is_container() && !((t_container*)type)->has_cpp_name())
+          || is_arena_string(type)) {
+        indent(out) << "::apache::thrift::rebindToCurrentArena(this->" << (*f_iter)->get_name()
+                    << ");" << endl;
+        rebound = true;
+      }
+    }
+    if (rebound) {
+      out << endl;
+    }
+  }
+
   // Required variables aren't in __isset, so we need tmp vars to check them.
   for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
     if ((*f_iter)->get_req() == t_field::T_REQUIRED)
@@ -1514,6 +1691,23 @@ void t_cpp_generator::generate_struct_reader(ostream& out, t_struct* tstruct, bo
 
   indent_down();
   indent(out) << "}" << endl << endl;
+
+  if (gen_arena_ && !pointers) {
+    if (gen_templates_) {
+      out << indent() << "template <class Protocol_>" << endl << indent() << "uint32_t "
+          << tstruct->get_name() << "::read(Protocol_* iprot, ::apache::thrift::TArena& arena) {"
+          << endl;
+    } else {
+      indent(out) << "uint32_t " << tstruct->get_name()
+                  << "::read(::apache::thrift::protocol::TProtocol* iprot, "
+                  << "::apache::thrift::TArena& arena) {" << endl;
+    }
+    indent_up();
+    indent(out) << "::apache::thrift::TArena::Scope scope(arena);" << endl;
+    indent(out) << "return read(iprot);" << endl;
+    indent_down();
+    indent(out) << "}" << endl << endl;
+  }
 }
 
 /**
@@ -1736,6 +1930,31 @@ void t_cpp_generator::generate_struct_print_method_decl(std::ostream& out, t_str
   out << "printTo(std::ostream& out) const";
 }
 
+void t_cpp_generator::generate_struct_append_method_decl(std::ostream& out, t_struct* tstruct) {
+  out << "void ";
+  if (tstruct) {
+    out << tstruct->get_name() << "::appendTo(std::string& out, "
+        << "const ::apache::thrift::TToStringLimit& limit) const";
+  } else {
+    out << "appendTo(std::string& out, const ::apache::thrift::TToStringLimit& limit = "
+        << "::apache::thrift::TToStringLimit()) const";
+  }
+}
+
+/**
+ * Generates the appendTo() overload that lets ::apache::thrift::appendTo()
+ * print the struct in containers and other structs
+ */
+void t_cpp_generator::generate_struct_append_function(std::ostream& out, t_struct* tstruct) {
+  out << "inline void appendTo(std::string& out, const " << tstruct->get_name() << "& obj," << endl
+      << "                     const ::apache::thrift::TToStringLimit& limit = "
+      << "::apache::thrift::TToStringLimit())" << endl;
+  scope_up(out);
+  out << indent() << "obj.appendTo(out, limit);" << endl;
+  scope_down(out);
+  out << endl;
+}
+
 void t_cpp_generator::generate_exception_what_method_decl(std::ostream& out,
                                                           t_struct* tstruct,
                                                           bool external) {
@@ -1748,31 +1967,21 @@ void t_cpp_generator::generate_exception_what_method_decl(std::ostream& out,
     out << " override";
 }
 
-namespace struct_ostream_operator_generator {
-void generate_required_field_value(std::ostream& out, const t_field* field) {
-  out << " << to_string(" << field->get_name() << ")";
-}
-
-void generate_optional_field_value(std::ostream& out, const t_field* field) {
-  out << "; (__isset." << field->get_name() << " ? (out";
-  generate_required_field_value(out, field);
-  out << ") : (out << \"<null>\"))";
-}
-
-void generate_field_value(std::ostream& out, const t_field* field) {
-  if (field->get_req() == t_field::T_OPTIONAL)
-    generate_optional_field_value(out, field);
-  else
-    generate_required_field_value(out, field);
-}
-
-void generate_field_name(std::ostream& out, const t_field* field) {
-  out << "\"" << field->get_name() << "=\"";
-}
-
-void generate_field(std::ostream& out, const t_field* field) {
-  generate_field_name(out, field);
-  generate_field_value(out, field);
+namespace struct_append_method_generator {
+void generate_field(std::ostream& out, const t_field* field, bool first, const std::string& indent) {
+  out << indent << "if (!limit.appendField(out, \"" << field->get_name() << "=\", "
+      << (first ? "true" : "false") << ")) {" << endl
+      << indent << "  return;" << endl
+      << indent << "}" << endl;
+  if (field->get_req() == t_field::T_OPTIONAL) {
+    out << indent << "if (__isset." << field->get_name() << ") {" << endl
+        << indent << "  appendTo(out, this->" << field->get_name() << ", limit);" << endl
+        << indent << "} else {" << endl
+        << indent << "  out.append(\"<null>\");" << endl
+        << indent << "}" << endl;
+  } else {
+    out << indent << "appendTo(out, this->" << field->get_name() << ", limit);" << endl;
+  }
 }
 
 void generate_fields(std::ostream& out,
@@ -1782,20 +1991,13 @@ void generate_fields(std::ostream& out,
   const vector<t_field*>::const_iterator end = fields.end();
 
   for (vector<t_field*>::const_iterator it = beg; it != end; ++it) {
-    out << indent << "out << ";
-
-    if (it != beg) {
-      out << "\", \" << ";
-    }
-
-    generate_field(out, *it);
-    out << ";" << endl;
+    generate_field(out, *it, it == beg, indent);
   }
 }
 }
 
 /**
- * Generates operator<<
+ * Generates printTo(), which prints what appendTo() appends
  */
 void t_cpp_generator::generate_struct_print_method(std::ostream& out, t_struct* tstruct) {
   out << indent();
@@ -1804,10 +2006,35 @@ void t_cpp_generator::generate_struct_print_method(std::ostream& out, t_struct*
 
   indent_up();
 
-  out << indent() << "using ::apache::thrift::to_string;" << endl;
-  out << indent() << "out << \"" << tstruct->get_name() << "(\";" << endl;
-  struct_ostream_operator_generator::generate_fields(out, tstruct->get_members(), indent());
-  out << indent() << "out << \")\";" << endl;
+  out << indent() << "std::string buffer;" << endl;
+  out << indent() << "appendTo(buffer);" << endl;
+  out << indent() << "out << buffer;" << endl;
+
+  indent_down();
+  out << "}" << endl << endl;
+}
+
+/**
+ * Generates appendTo()
+ */
+void t_cpp_generator::generate_struct_append_method(std::ostream& out, t_struct* tstruct) {
+  out << indent();
+  generate_struct_append_method_decl(out, tstruct);
+  out << " {" << endl;
+
+  indent_up();
+
+  const vector<t_field*>& fields = tstruct->get_members();
+  if (fields.empty()) {
+    out << indent() << "(void) limit;" << endl;
+  } else {
+    // a using-declaration, unlike the member, does not hide the overloads
+    // that argument-dependent lookup finds for the fields
+    out << indent() << "using ::apache::thrift::appendTo;" << endl;
+  }
+  out << indent() << "out.append(\"" << tstruct->get_name() << "(\");" << endl;
+  struct_append_method_generator::generate_fields(out, fields, indent());
+  out << indent() << "out.push_back(')');" << endl;
 
   indent_down();
   out << "}" << endl << endl;
@@ -1873,6 +2100,9 @@ void t_cpp_generator::generate_service(t_service* tservice) {
   if (gen_cob_style_) {
     f_header_ << "#include <thrift/async/TAsyncDispatchProcessor.h>" << endl;
   }
+  if (gen_future_style_) {
+    f_header_ << "#include <future>" << endl;
+  }
   f_header_ << "#include <thrift/async/TConcurrentClientSyncInfo.h>" << endl;
   f_header_ << "#include <memory>" << endl;
   f_header_ << "#include \"" << get_include_prefix(*get_program()) << program_name_ << "_types.h\""
@@ -1950,6 +2180,10 @@ void t_cpp_generator::generate_service(t_service* tservice) {
 
   }
 
+  if (gen_future_style_) {
+    generate_service_future_client(tservice);
+  }
+
   f_header_ << "#ifdef _MSC_VER\n"
                "  #pragma warning( pop )\n"
                "#endif\n\n";
@@ -3010,6 +3244,143 @@ void t_cpp_generator::generate_service_client(t_service* tservice, string style)
   }
 }
 
+/**
+ * Generates a client whose methods return futures, implemented on top of
+ * the cob-style client.
+ *
+ * @param tservice The service to generate a client for.
+ */
+void t_cpp_generator::generate_service_future_client(t_service* tservice) {
+  std::ostream& out = (gen_templates_ ? f_service_tcc_ : f_service_);
+  string template_header, template_suffix, short_suffix;
+  if (gen_templates_) {
+    template_header = "template <class Protocol_>\n";
+    short_suffix = "T";
+    template_suffix = "T<Protocol_>";
+  }
+  string class_name = service_name_ + "FutureClient" + short_suffix;
+  string cob_client = service_name_ + "CobClient" + template_suffix;
+  string cob_client_ptr = "std::shared_ptr< " + cob_client + " >";
+  string channel_ptr = "std::shared_ptr< ::apache::thrift::async::TAsyncChannel>";
+
+  string extends;
+  if (tservice->get_extends() != nullptr) {
+    extends = type_name(tservice->get_extends()) + "FutureClient" + template_suffix;
+  }
+
+  // Generate the header portion
+  f_header_ << "// The \'future\' client keeps any number of calls in flight on one channel.\n"
+               "// Like the cob client it wraps, it must only be used on the thread that\n"
+               "// runs the event loop of the channel; the futures can be waited on anywhere.\n";
+  f_header_ << template_header << "class " << class_name;
+  if (!extends.empty()) {
+    f_header_ << " : public " << extends;
+  }
+  f_header_ << " {" << endl << " public:" << endl;
+  indent_up();
+
+  f_header_ << indent() << class_name << "(" << channel_ptr
+            << " channel, ::apache::thrift::protocol::TProtocolFactory* protocolFactory) :" << endl
+            << indent() << "  " << class_name << "(std::make_shared< " << cob_client
+            << " >(channel, protocolFactory)) {}" << endl;
+  f_header_ << indent() << "explicit " << class_name << "(" << cob_client_ptr << " client) :"
+            << endl << indent() << "  ";
+  if (!extends.empty()) {
+    f_header_ << extends << "(client), ";
+  }
+  f_header_ << "client_(client) {}" << endl;
+  f_header_ << indent() << cob_client_ptr << " getCobClient() {" << endl << indent()
+            << "  return client_;" << endl << indent() << "}" << endl;
+
+  vector<t_function*> functions = tservice->get_functions();
+  vector<t_function*>::const_iterator f_iter;
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    generate_java_doc(f_header_, *f_iter);
+    indent(f_header_) << "std::future<" << type_name((*f_iter)->get_returntype()) << "> "
+                      << (*f_iter)->get_name() << "("
+                      << argument_list((*f_iter)->get_arglist()) << ");" << endl;
+  }
+  indent_down();
+
+  f_header_ << " private:" << endl;
+  indent_up();
+  f_header_ << indent() << cob_client_ptr << " client_;" << endl;
+  indent_down();
+  f_header_ << "};" << endl << endl;
+
+  if (gen_templates_) {
+    f_header_ << "typedef " << service_name_
+              << "FutureClientT< ::apache::thrift::protocol::TProtocol> " << service_name_
+              << "FutureClient;" << endl << endl;
+  }
+
+  // Generate the method implementations
+  string scope = service_name_ + "FutureClient" + template_suffix + "::";
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    t_type* return_type = (*f_iter)->get_returntype();
+    string result_type = type_name(return_type);
+    string funname = (*f_iter)->get_name();
+
+    if (gen_templates_) {
+      indent(out) << template_header;
+    }
+    indent(out) << "std::future<" << result_type << "> " << scope << funname << "("
+                << argument_list((*f_iter)->get_arglist()) << ")" << endl;
+    scope_up(out);
+    out << indent() << "std::shared_ptr<std::promise<" << result_type
+        << "> > _promise = std::make_shared<std::promise<" << result_type << "> >();" << endl
+        << indent() << "std::future<" << result_type << "> _future = _promise->get_future();"
+        << endl
+        << indent() << "try {" << endl;
+    indent_up();
+    out << indent() << "client_->" << funname << "([_promise](" << cob_client << "* _client) {"
+        << endl;
+    indent_up();
+    if ((*f_iter)->is_oneway()) {
+      out << indent() << "if (_client->getChannel()->error()) {" << endl
+          << indent() << "  _promise->set_exception(std::make_exception_ptr("
+          << "::apache::thrift::transport::TTransportException("
+          << "::apache::thrift::transport::TTransportException::NOT_OPEN, \"channel failed\")));"
+          << endl
+          << indent() << "} else {" << endl
+          << indent() << "  _promise->set_value();" << endl
+          << indent() << "}" << endl;
+    } else {
+      out << indent() << "try {" << endl;
+      indent_up();
+      if (return_type->is_void()) {
+        out << indent() << "_client->recv_" << funname << "();" << endl << indent()
+            << "_promise->set_value();" << endl;
+      } else if (is_complex_type(return_type)) {
+        t_field returnfield(return_type, "_return");
+        out << indent() << declare_field(&returnfield) << endl << indent() << "_client->recv_"
+            << funname << "(_return);" << endl << indent()
+            << "_promise->set_value(std::move(_return));" << endl;
+      } else {
+        out << indent() << "_promise->set_value(_client->recv_" << funname << "());" << endl;
+      }
+      indent_down();
+      out << indent() << "} catch (...) {" << endl << indent()
+          << "  _promise->set_exception(std::current_exception());" << endl << indent() << "}"
+          << endl;
+    }
+    indent_down();
+    out << indent() << "}";
+    const vector<t_field*>& fields = (*f_iter)->get_arglist()->get_members();
+    for (vector<t_field*>::const_iterator fld_iter = fields.begin(); fld_iter != fields.end();
+         ++fld_iter) {
+      out << ", " << (*fld_iter)->get_name();
+    }
+    out << ");" << endl;
+    indent_down();
+    out << indent() << "} catch (...) {" << endl << indent()
+        << "  _promise->set_exception(std::current_exception());" << endl << indent() << "}"
+        << endl << indent() << "return _future;" << endl;
+    scope_down(out);
+    out << endl;
+  }
+}
+
 class ProcessorGenerator {
 public:
   ProcessorGenerator(t_cpp_generator* generator, t_service* service, const string& style);
@@ -3031,6 +3402,8 @@ public:
 
   void generate_class_definition();
   void generate_dispatch_call(bool template_protocol);
+  void generate_dispatch_match(t_function* tfunction);
+  size_t distinguishing_position(const vector<t_function*>& group);
   void generate_process_functions();
   void generate_factory();
 
@@ -3162,30 +3535,6 @@ void ProcessorGenerator::generate_class_definition() {
   f_header_ << " private:" << endl;
   indent_up();
 
-  // Declare processMap_
-  f_header_ << indent() << "typedef  void (" << class_name_ << "::*"
-            << "ProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-            << "::apache::thrift::protocol::TProtocol*, "
-            << "::apache::thrift::protocol::TProtocol*" << call_context_decl_ << ");" << endl;
-  if (generator_->gen_templates_) {
-    f_header_ << indent() << "typedef void (" << class_name_ << "::*"
-              << "SpecializedProcessFunction)(" << finish_cob_decl_ << "int32_t, "
-              << "Protocol_*, Protocol_*" << call_context_decl_ << ");" << endl << indent()
-              << "struct ProcessFunctions {" << endl << indent() << "  ProcessFunction generic;"
-              << endl << indent() << "  SpecializedProcessFunction specialized;" << endl << indent()
-              << "  ProcessFunctions(ProcessFunction g, "
-              << "SpecializedProcessFunction s) :" << endl << indent() << "    generic(g)," << endl
-              << indent() << "    specialized(s) {}" << endl << indent()
-              << "  ProcessFunctions() : generic(nullptr), specialized(nullptr) "
-              << "{}" << endl << indent() << "};" << endl << indent()
-              << "typedef std::map<std::string, ProcessFunctions> "
-              << "ProcessMap;" << endl;
-  } else {
-    f_header_ << indent() << "typedef std::map<std::string, ProcessFunction> "
-              << "ProcessMap;" << endl;
-  }
-  f_header_ << indent() << "ProcessMap processMap_;" << endl;
-
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
     indent(f_header_) << "void process_" << (*f_iter)->get_name() << "(" << finish_cob_
                       << "int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, "
@@ -3229,29 +3578,8 @@ void ProcessorGenerator::generate_class_definition() {
   if (!extends_.empty()) {
     f_header_ << indent() << "  " << extends_ << "(iface)," << endl;
   }
-  f_header_ << indent() << "  iface_(iface) {" << endl;
-  indent_up();
-
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    f_header_ << indent() << "processMap_[\"" << (*f_iter)->get_name() << "\"] = ";
-    if (generator_->gen_templates_) {
-      f_header_ << "ProcessFunctions(" << endl;
-      if (generator_->gen_templates_only_) {
-        indent(f_header_) << "  nullptr," << endl;
-      } else {
-        indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ","
-                          << endl;
-      }
-      indent(f_header_) << "  &" << class_name_ << "::process_" << (*f_iter)->get_name() << ")";
-    } else {
-      f_header_ << "&" << class_name_ << "::process_" << (*f_iter)->get_name();
-    }
-    f_header_ << ";" << endl;
-  }
-
-  indent_down();
-  f_header_ << indent() << "}" << endl << endl << indent() << "virtual ~" << class_name_ << "() {}"
-            << endl;
+  f_header_ << indent() << "  iface_(iface) {}" << endl << endl << indent() << "virtual ~"
+            << class_name_ << "() {}" << endl;
   indent_down();
   f_header_ << "};" << endl << endl;
 
@@ -3291,55 +3619,105 @@ void ProcessorGenerator::generate_dispatch_call(bool template_protocol) {
          << "const std::string& fname, int32_t seqid" << call_context_ << ") {" << endl;
   indent_up();
 
-  // HOT: member function pointer map
-  f_out_ << indent() << typename_str_ << "ProcessMap::iterator pfn;" << endl << indent()
-         << "pfn = processMap_.find(fname);" << endl << indent()
-         << "if (pfn == processMap_.end()) {" << endl;
+  // HOT: switch on the name length, then on the most distinguishing character,
+  // so a lookup costs at most one string comparison and never allocates
+  std::map<size_t, vector<t_function*> > by_length;
+  vector<t_function*> functions = service_->get_functions();
+  vector<t_function*>::iterator f_iter;
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    by_length[(*f_iter)->get_name().size()].push_back(*f_iter);
+  }
+
+  if (!by_length.empty()) {
+    f_out_ << indent() << "switch (fname.size()) {" << endl;
+    std::map<size_t, vector<t_function*> >::iterator l_iter;
+    for (l_iter = by_length.begin(); l_iter != by_length.end(); ++l_iter) {
+      f_out_ << indent() << "case " << l_iter->first << ":" << endl;
+      indent_up();
+      vector<t_function*>& group = l_iter->second;
+      if (group.size() == 1) {
+        generate_dispatch_match(group.front());
+      } else {
+        size_t pos = distinguishing_position(group);
+        std::map<char, vector<t_function*> > by_char;
+        for (f_iter = group.begin(); f_iter != group.end(); ++f_iter) {
+          by_char[(*f_iter)->get_name()[pos]].push_back(*f_iter);
+        }
+        f_out_ << indent() << "switch (fname[" << pos << "]) {" << endl;
+        std::map<char, vector<t_function*> >::iterator c_iter;
+        for (c_iter = by_char.begin(); c_iter != by_char.end(); ++c_iter) {
+          f_out_ << indent() << "case '" << c_iter->first << "':" << endl;
+          indent_up();
+          for (f_iter = c_iter->second.begin(); f_iter != c_iter->second.end(); ++f_iter) {
+            generate_dispatch_match(*f_iter);
+          }
+          f_out_ << indent() << "break;" << endl;
+          indent_down();
+        }
+        f_out_ << indent() << "}" << endl;
+      }
+      f_out_ << indent() << "break;" << endl;
+      indent_down();
+    }
+    f_out_ << indent() << "}" << endl << endl;
+  }
+
   if (extends_.empty()) {
-    f_out_ << indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl << indent()
-           << "  iprot->readMessageEnd();" << endl << indent()
-           << "  iprot->getTransport()->readEnd();" << endl << indent()
-           << "  ::apache::thrift::TApplicationException "
+    f_out_ << indent() << "iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl << indent()
+           << "iprot->readMessageEnd();" << endl << indent()
+           << "iprot->getTransport()->readEnd();" << endl << indent()
+           << "::apache::thrift::TApplicationException "
               "x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: "
               "'\"+fname+\"'\");" << endl << indent()
-           << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
-           << endl << indent() << "  x.write(oprot);" << endl << indent()
-           << "  oprot->writeMessageEnd();" << endl << indent()
-           << "  oprot->getTransport()->writeEnd();" << endl << indent()
-           << "  oprot->getTransport()->flush();" << endl << indent()
-           << (style_ == "Cob" ? "  return cob(true);" : "  return true;") << endl;
+           << "oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);"
+           << endl << indent() << "x.write(oprot);" << endl << indent()
+           << "oprot->writeMessageEnd();" << endl << indent()
+           << "oprot->getTransport()->writeEnd();" << endl << indent()
+           << "oprot->getTransport()->flush();" << endl << indent()
+           << (style_ == "Cob" ? "return cob(true);" : "return true;") << endl;
   } else {
-    f_out_ << indent() << "  return " << extends_ << "::dispatchCall("
+    f_out_ << indent() << "return " << extends_ << "::dispatchCall("
            << (style_ == "Cob" ? "cob, " : "") << "iprot, oprot, fname, seqid" << call_context_arg_
            << ");" << endl;
   }
-  f_out_ << indent() << "}" << endl;
-  if (template_protocol) {
-    f_out_ << indent() << "(this->*(pfn->second.specialized))";
-  } else {
-    if (generator_->gen_templates_only_) {
-      // TODO: This is a null pointer, so nothing good will come from calling
-      // it.  Throw an exception instead.
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else if (generator_->gen_templates_) {
-      f_out_ << indent() << "(this->*(pfn->second.generic))";
-    } else {
-      f_out_ << indent() << "(this->*(pfn->second))";
-    }
-  }
-  f_out_ << "(" << cob_arg_ << "seqid, iprot, oprot" << call_context_arg_ << ");" << endl;
-
-  // TODO(dreiss): return pfn ret?
-  if (style_ == "Cob") {
-    f_out_ << indent() << "return;" << endl;
-  } else {
-    f_out_ << indent() << "return true;" << endl;
-  }
 
   indent_down();
   f_out_ << "}" << endl << endl;
 }
 
+void ProcessorGenerator::generate_dispatch_match(t_function* tfunction) {
+  f_out_ << indent() << "if (fname == \"" << tfunction->get_name() << "\") {" << endl;
+  indent_up();
+  f_out_ << indent() << "process_" << tfunction->get_name() << "(" << cob_arg_
+         << "seqid, iprot, oprot" << call_context_arg_ << ");" << endl << indent()
+         << (style_ == "Cob" ? "return;" : "return true;") << endl;
+  indent_down();
+  f_out_ << indent() << "}" << endl;
+}
+
+/**
+ * Returns the character position that splits a group of equally long method
+ * names into the most buckets, so the generated switch needs as few string
+ * comparisons as possible.
+ */
+size_t ProcessorGenerator::distinguishing_position(const vector<t_function*>& group) {
+  size_t length = group.front()->get_name().size();
+  size_t best_pos = 0;
+  size_t best_count = 0;
+  for (size_t pos = 0; pos < length; ++pos) {
+    std::set<char> seen;
+    vector<t_function*>::const_iterator f_iter;
+    for (f_iter = group.begin(); f_iter != group.end(); ++f_iter) {
+      seen.insert((*f_iter)->get_name()[pos]);
+    }
+    if (seen.size() > best_count) {
+      best_count = seen.size();
+      best_pos = pos;
+    }
+  }
+  return best_pos;
+}
+
 void ProcessorGenerator::generate_process_functions() {
   vector<t_function*> functions = service_->get_functions();
   vector<t_function*>::iterator f_iter;
@@ -3508,8 +3886,15 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
         << "this->eventHandler_.get(), ctx, " << service_func_name << ");" << endl << endl
         << indent() << "if (this->eventHandler_.get() != nullptr) {" << endl << indent()
         << "  this->eventHandler_->preRead(ctx, " << service_func_name << ");" << endl << indent()
-        << "}" << endl << endl << indent() << argsname << " args;" << endl << indent()
-        << "args.read(iprot);" << endl << indent() << "iprot->readMessageEnd();" << endl << indent()
+        << "}" << endl << endl;
+    if (gen_arena_) {
+      // Strings and containers of the arguments live until the arena is destroyed
+      out << indent() << "::apache::thrift::TArena arena;" << endl << indent() << argsname
+          << " args;" << endl << indent() << "args.read(iprot, arena);" << endl;
+    } else {
+      out << indent() << argsname << " args;" << endl << indent() << "args.read(iprot);" << endl;
+    }
+    out << indent() << "iprot->readMessageEnd();" << endl << indent()
         << "uint32_t bytes = iprot->getTransport()->readEnd();" << endl << endl << indent()
         << "if (this->eventHandler_.get() != nullptr) {" << endl << indent()
         << "  this->eventHandler_->postRead(ctx, " << service_func_name << ", bytes);" << endl
@@ -3969,7 +4354,11 @@ void t_cpp_generator::generate_deserialize_field(ostream& out,
       throw "compiler error: cannot serialize void field in a struct: " + name;
       break;
     case t_base_type::TYPE_STRING:
-      if (type->is_binary()) {
+      if (is_string_view_field(tfield)) {
+        out << (type->is_binary() ? "readBinaryView(" : "readStringView(") << name << ");";
+      } else if (is_arena_string(type)) {
+        out << (type->is_binary() ? "readArenaBinary(" : "readArenaString(") << name << ");";
+      } else if (type->is_binary()) {
         out << "readBinary(" << name << ");";
       } else {
         out << "readString(" << name << ");";
@@ -4066,6 +4455,18 @@ void t_cpp_generator::generate_deserialize_container(ostream& out, t_type* ttype
     if (!use_push) {
       indent(out) << prefix << ".resize(" << size << ");" << endl;
     }
+
+    string array_name = list_array_name(ttype);
+    if (!array_name.empty()) {
+      indent(out) << "if (" << size << " > 0)" << endl;
+      indent_up();
+      indent(out) << "xfer += iprot->read" << array_name << "Array(" << prefix << ".data(), "
+                  << size << ");" << endl;
+      indent_down();
+      indent(out) << "xfer += iprot->readListEnd();" << endl;
+      scope_down(out);
+      return;
+    }
   }
 
   // For loop iterates over elements
@@ -4177,7 +4578,11 @@ void t_cpp_generator::generate_serialize_field(ostream& out,
         throw "compiler error: cannot serialize void field in a struct: " + name;
         break;
       case t_base_type::TYPE_STRING:
-        if (type->is_binary()) {
+        if (is_string_view_field(tfield)) {
+          out << (type->is_binary() ? "writeBinaryView(" : "writeStringView(") << name << ");";
+        } else if (is_arena_string(type)) {
+          out << (type->is_binary() ? "writeArenaBinary(" : "writeArenaString(") << name << ");";
+        } else if (type->is_binary()) {
           out << "writeBinary(" << name << ");";
         } else {
           out << "writeString(" << name << ");";
@@ -4254,6 +4659,15 @@ void t_cpp_generator::generate_serialize_container(ostream& out, t_type* ttype,
     indent(out) << "xfer += oprot->writeListBegin("
                 << type_to_enum(((t_list*)ttype)->get_elem_type()) << ", "
                 << "static_cast<uint32_t>(" << prefix << ".size()));" << endl;
+
+    string array_name = list_array_name(ttype);
+    if (!array_name.empty()) {
+      indent(out) << "xfer += oprot->write" << array_name << "Array(" << prefix << ".data(), "
+                  << "static_cast<uint32_t>(" << prefix << ".size()));" << endl;
+      indent(out) << "xfer += oprot->writeListEnd();" << endl;
+      scope_down(out);
+      return;
+    }
   }
 
   string iter = tmp("_iter");
@@ -4420,14 +4834,17 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
       cname = tcontainer->get_cpp_name();
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*)ttype;
-      cname = "std::map<" + type_name(tmap->get_key_type(), in_typedef) + ", "
+      cname = (gen_arena_ ? "::apache::thrift::TArenaMap<" : "std::map<")
+              + type_name(tmap->get_key_type(), in_typedef) + ", "
               + type_name(tmap->get_val_type(), in_typedef) + "> ";
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*)ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      cname = (gen_arena_ ? "::apache::thrift::TArenaSet<" : "std::set<")
+              + type_name(tset->get_elem_type(), in_typedef) + "> ";
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*)ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      cname = (gen_arena_ ? "::apache::thrift::TArenaVector<" : "std::vector<")
+              + type_name(tlist->get_elem_type(), in_typedef) + "> ";
     }
 
     if (arg) {
@@ -4477,7 +4894,7 @@ string t_cpp_generator::base_type_name(t_base_type::t_base tbase) {
   case t_base_type::TYPE_VOID:
     return "void";
   case t_base_type::TYPE_STRING:
-    return "std::string";
+    return gen_arena_ ? "::apache::thrift::TArenaString" : "std::string";
   case t_base_type::TYPE_BOOL:
     return "bool";
   case t_base_type::TYPE_I8:
@@ -4511,7 +4928,11 @@ string t_cpp_generator::declare_field(t_field* tfield,
   if (constant) {
     result += "const ";
   }
-  result += type_name(tfield->get_type());
+  if (is_string_view_field(tfield)) {
+    result += "::apache::thrift::TStringView";
+  } else {
+    result += type_name(tfield->get_type());
+  }
   if (is_reference(tfield)) {
     result = "::std::shared_ptr<" + result + ">";
   }
@@ -4750,6 +5171,8 @@ THRIFT_REGISTER_GENERATOR(
     cpp,
     "C++",
     "    cob_style:       Generate \"Continuation OBject\"-style classes.\n"
+    "    future_style:    Generate clients whose methods return std::futures, on top of the\n"
+    "                     cob-style clients.  Implies cob_style.\n"
     "    no_client_completion:\n"
     "                     Omit calls to completion__() in CobClient class.\n"
     "    no_default_operators:\n"
@@ -4760,4 +5183,9 @@ THRIFT_REGISTER_GENERATOR(
     "    moveable_types:  Generate move constructors and assignment operators.\n"
     "    no_ostream_operators:\n"
     "                     Omit generation of ostream definitions.\n"
-    "    no_skeleton:     Omits generation of skeleton.\n")
+    "    no_skeleton:     Omits generation of skeleton.\n"
+    "    string_view_fields:\n"
+    "                     Use apache::thrift::TStringView for string and binary fields of structs,\n"
+    "                     which can refer to the received frame instead of copying.\n"
+    "    arena:           Use apache::thrift::TArenaAllocator for strings and containers and\n"
+    "                     add read(iprot, arena) to decode a struct into a TArena.\n")
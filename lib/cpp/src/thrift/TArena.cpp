@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/TArena.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace apache {
+namespace thrift {
+
+namespace {
+thread_local TArena* currentArena = nullptr;
+
+// Offset of the usable memory from the start of a block
+const size_t kHeaderSize = (sizeof(void*) + sizeof(size_t) + alignof(std::max_align_t) - 1)
+                           & ~(alignof(std::max_align_t) - 1);
+}
+
+const size_t TArena::DEFAULT_BLOCK_SIZE;
+const size_t TArena::MAX_BLOCK_SIZE;
+
+TArena::~TArena() {
+  while (blocks_ != nullptr) {
+    Block* next = blocks_->next;
+    std::free(blocks_);
+    blocks_ = next;
+  }
+}
+
+void* TArena::allocateSlow(size_t size, size_t alignment) {
+  // Room for the request even if the block start is only aligned to max_align_t
+  size_t needed = size + (alignment > alignof(std::max_align_t) ? alignment : 0);
+  if (needed < size || needed > static_cast<size_t>(-1) - kHeaderSize) {
+    throw std::bad_alloc();
+  }
+
+  size_t blockSize = (std::max)(nextBlockSize_, needed);
+  auto* block = static_cast<Block*>(std::malloc(kHeaderSize + blockSize));
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  block->size = blockSize;
+  block->next = blocks_;
+  blocks_ = block;
+  ptr_ = reinterpret_cast<char*>(block) + kHeaderSize;
+  end_ = ptr_ + blockSize;
+  nextBlockSize_ = (std::min)(nextBlockSize_ * 2, (std::max)(initialBlockSize_, MAX_BLOCK_SIZE));
+  return allocate(size, alignment);
+}
+
+void TArena::reset() {
+  if (blocks_ == nullptr) {
+    return;
+  }
+
+  Block* next = blocks_->next;
+  while (next != nullptr) {
+    Block* following = next->next;
+    std::free(next);
+    next = following;
+  }
+  blocks_->next = nullptr;
+  ptr_ = reinterpret_cast<char*>(blocks_) + kHeaderSize;
+  end_ = ptr_ + blocks_->size;
+  bytesAllocated_ = 0;
+}
+
+TArena* TArena::current() noexcept {
+  return currentArena;
+}
+
+void TArena::setCurrent(TArena* arena) noexcept {
+  currentArena = arena;
+}
+}
+} // apache::thrift
@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TARENA_H_
+#define _THRIFT_TARENA_H_ 1
+
+#include <thrift/TNonCopyable.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <new>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+
+/**
+ * A monotonic memory arena.
+ *
+ * Memory is handed out from large blocks by bumping a pointer and is only
+ * returned all at once, when the arena is reset or destroyed.  Structs
+ * generated with the cpp:arena option can be read into an arena (see
+ * TArenaAllocator), which replaces the many small allocations made for their
+ * strings and containers with a few block allocations.
+ *
+ * An arena is not thread safe.
+ */
+class TArena : private TNonCopyable {
+public:
+  /// Default size of the first block
+  static const size_t DEFAULT_BLOCK_SIZE = 4096;
+
+  /// Blocks grow by doubling up to this size
+  static const size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+  explicit TArena(size_t blockSize = DEFAULT_BLOCK_SIZE)
+    : blocks_(nullptr),
+      ptr_(nullptr),
+      end_(nullptr),
+      initialBlockSize_(blockSize),
+      nextBlockSize_(blockSize),
+      bytesAllocated_(0) {}
+
+  ~TArena();
+
+  /**
+   * Returns size bytes aligned to alignment, which must be a power of two.
+   *
+   * @throws std::bad_alloc if no memory is available
+   */
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(ptr_) + alignment - 1) & ~(alignment - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(end_);
+    if (ptr_ == nullptr || aligned > end || size > end - aligned) {
+      return allocateSlow(size, alignment);
+    }
+    ptr_ = reinterpret_cast<char*>(aligned + size);
+    bytesAllocated_ += size;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  /**
+   * Releases all memory handed out so far.  The most recent block is kept
+   * for reuse.
+   */
+  void reset();
+
+  /** Returns the number of bytes handed out since construction or reset(). */
+  size_t getBytesAllocated() const { return bytesAllocated_; }
+
+  /**
+   * Returns the arena that default constructed TArenaAllocators of the
+   * calling thread allocate from, or nullptr if there is none.
+   */
+  static TArena* current() noexcept;
+
+  /**
+   * Makes an arena the current one of the calling thread for the lifetime
+   * of the scope.
+   */
+  class Scope : private TNonCopyable {
+  public:
+    explicit Scope(TArena& arena) noexcept : previous_(current()) { setCurrent(&arena); }
+    ~Scope() { setCurrent(previous_); }
+
+  private:
+    TArena* previous_;
+  };
+
+private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  void* allocateSlow(size_t size, size_t alignment);
+  static void setCurrent(TArena* arena) noexcept;
+
+  Block* blocks_;
+  char* ptr_;
+  char* end_;
+  size_t initialBlockSize_;
+  size_t nextBlockSize_;
+  size_t bytesAllocated_;
+};
+
+/**
+ * A standard allocator that allocates from a TArena, or from the heap if it
+ * has none.
+ *
+ * A default constructed allocator uses the calling thread's current arena
+ * (see TArena::Scope), so containers and strings created while an arena is
+ * current - including the elements a container creates for itself - are
+ * placed into it without passing the allocator around explicitly.  Memory
+ * taken from an arena is never returned individually.
+ *
+ * The allocator moves and swaps along with the contents of a container, but
+ * copies are made with a default constructed allocator, so copying a value
+ * out of an arena after its scope has ended leaves the arena behind.
+ */
+template <typename T>
+class TArenaAllocator {
+public:
+  typedef T value_type;
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  TArenaAllocator() noexcept : arena_(TArena::current()) {}
+
+  explicit TArenaAllocator(TArena* arena) noexcept : arena_(arena) {}
+
+  template <typename U>
+  TArenaAllocator(const TArenaAllocator<U>& other) noexcept : arena_(other.getArena()) {}
+
+  T* allocate(size_t n) {
+    if (n > static_cast<size_t>(-1) / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    if (arena_ != nullptr) {
+      return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept {
+    if (arena_ == nullptr) {
+      ::operator delete(p);
+    }
+  }
+
+  TArenaAllocator select_on_container_copy_construction() const { return TArenaAllocator(); }
+
+  TArena* getArena() const noexcept { return arena_; }
+
+private:
+  TArena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b) noexcept {
+  return a.getArena() == b.getArena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b) noexcept {
+  return a.getArena() != b.getArena();
+}
+
+typedef std::basic_string<char, std::char_traits<char>, TArenaAllocator<char> > TArenaString;
+
+template <typename T>
+using TArenaVector = std::vector<T, TArenaAllocator<T> >;
+
+template <typename T>
+using TArenaSet = std::set<T, std::less<T>, TArenaAllocator<T> >;
+
+template <typename K, typename V>
+using TArenaMap = std::map<K, V, std::less<K>, TArenaAllocator<std::pair<const K, V> > >;
+
+/**
+ * Moves a string or container that was created outside of the current arena
+ * into it, keeping its value.  Generated readers call this for their members
+ * before reading into them.
+ */
+template <typename T>
+void rebindToCurrentArena(T& value) {
+  typename T::allocator_type allocator;
+  if (value.get_allocator() != allocator) {
+    T rebound(value, allocator);
+    value = std::move(rebound);
+  }
+}
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TARENA_H_
@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TSTRINGVIEW_H_
+#define _THRIFT_TSTRINGVIEW_H_ 1
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace apache {
+namespace thrift {
+
+/**
+ * An immutable string or binary value that shares ownership of the memory
+ * it refers to.
+ *
+ * Structs generated with the cpp:string_view_fields option hold their string
+ * and binary fields as TStringView.  When such a struct is read by a protocol
+ * from a transport that can lend out its buffer with shared ownership (see
+ * TTransport::borrowShared()), the fields point straight into the received
+ * frame instead of being copied into a std::string each, and keep that frame
+ * alive for as long as they are referenced.  Copying a TStringView only
+ * copies the reference.
+ *
+ * Values built by the application are copied into storage of their own.
+ */
+class TStringView {
+public:
+  typedef char value_type;
+  typedef size_t size_type;
+  typedef const char* const_iterator;
+  typedef const char* iterator;
+
+  TStringView() noexcept : size_(0) {}
+
+  TStringView(const char* str) : TStringView(std::string(str)) {}
+
+  TStringView(const char* data, size_t size) : TStringView(std::string(data, size)) {}
+
+  TStringView(std::string str) : size_(str.size()) {
+    if (size_ > 0) {
+      auto owner = std::make_shared<std::string>(std::move(str));
+      data_ = std::shared_ptr<const char>(owner, owner->data());
+    }
+  }
+
+  /**
+   * Refers to size bytes at data, which owner keeps alive.
+   */
+  template <typename Owner>
+  TStringView(const std::shared_ptr<Owner>& owner, const void* data, size_t size) noexcept
+    : data_(owner, static_cast<const char*>(data)),
+      size_(size) {}
+
+  const char* data() const noexcept { return data_ ? data_.get() : ""; }
+  size_t size() const noexcept { return size_; }
+  size_t length() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const_iterator begin() const noexcept { return data(); }
+  const_iterator end() const noexcept { return data() + size_; }
+
+  char operator[](size_t pos) const { return data()[pos]; }
+
+  void clear() noexcept {
+    data_.reset();
+    size_ = 0;
+  }
+
+  void swap(TStringView& other) noexcept {
+    data_.swap(other.data_);
+    std::swap(size_, other.size_);
+  }
+
+  /** Returns a copy of the value. */
+  std::string str() const { return std::string(data(), size_); }
+
+  explicit operator std::string() const { return str(); }
+
+#if __cplusplus >= 201703L
+  operator std::string_view() const noexcept { return std::string_view(data(), size_); }
+#endif
+
+  int compare(const char* data, size_t size) const noexcept {
+    int result = std::memcmp(this->data(), data, size_ < size ? size_ : size);
+    if (result != 0) {
+      return result;
+    }
+    return size_ < size ? -1 : (size_ > size ? 1 : 0);
+  }
+
+  int compare(const TStringView& other) const noexcept {
+    return compare(other.data(), other.size_);
+  }
+
+private:
+  std::shared_ptr<const char> data_;
+  size_t size_;
+};
+
+inline void swap(TStringView& a, TStringView& b) noexcept {
+  a.swap(b);
+}
+
+inline bool operator==(const TStringView& a, const TStringView& b) noexcept {
+  return a.size() == b.size() && a.compare(b) == 0;
+}
+
+inline bool operator==(const TStringView& a, const std::string& b) noexcept {
+  return a.size() == b.size() && a.compare(b.data(), b.size()) == 0;
+}
+
+inline bool operator==(const std::string& a, const TStringView& b) noexcept {
+  return b == a;
+}
+
+inline bool operator==(const TStringView& a, const char* b) noexcept {
+  return a.compare(b, std::strlen(b)) == 0;
+}
+
+inline bool operator==(const char* a, const TStringView& b) noexcept {
+  return b == a;
+}
+
+template <typename T>
+inline bool operator!=(const TStringView& a, const T& b) noexcept {
+  return !(a == b);
+}
+
+inline bool operator!=(const std::string& a, const TStringView& b) noexcept {
+  return !(b == a);
+}
+
+inline bool operator!=(const char* a, const TStringView& b) noexcept {
+  return !(b == a);
+}
+
+inline bool operator<(const TStringView& a, const TStringView& b) noexcept {
+  return a.compare(b) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const TStringView& str) {
+  return out.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+}
+} // apache::thrift
+
+#endif // #ifndef _THRIFT_TSTRINGVIEW_H_
@@ -21,6 +21,8 @@
 #define _THRIFT_TOSTRING_H_ 1
 
 #include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <limits>
 #include <locale>
 #include <map>
@@ -29,6 +31,10 @@
 #include <string>
 #include <vector>
 
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
 namespace apache {
 namespace thrift {
 
@@ -66,14 +72,14 @@ inline std::string to_string(const long double& t) {
   return o.str();
 }
 
-template <typename K, typename V>
-std::string to_string(const std::map<K, V>& m);
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const std::map<K, V, C, A>& m);
 
-template <typename T>
-std::string to_string(const std::set<T>& s);
+template <typename T, typename C, typename A>
+std::string to_string(const std::set<T, C, A>& s);
 
-template <typename T>
-std::string to_string(const std::vector<T>& t);
+template <typename T, typename A>
+std::string to_string(const std::vector<T, A>& t);
 
 template <typename K, typename V>
 std::string to_string(const typename std::pair<K, V>& v) {
@@ -93,26 +99,271 @@ std::string to_string(const T& beg, const T& end) {
   return o.str();
 }
 
-template <typename T>
-std::string to_string(const std::vector<T>& t) {
+template <typename T, typename A>
+std::string to_string(const std::vector<T, A>& t) {
   std::ostringstream o;
   o << "[" << to_string(t.begin(), t.end()) << "]";
   return o.str();
 }
 
-template <typename K, typename V>
-std::string to_string(const std::map<K, V>& m) {
+template <typename K, typename V, typename C, typename A>
+std::string to_string(const std::map<K, V, C, A>& m) {
   std::ostringstream o;
   o << "{" << to_string(m.begin(), m.end()) << "}";
   return o.str();
 }
 
-template <typename T>
-std::string to_string(const std::set<T>& s) {
+template <typename T, typename C, typename A>
+std::string to_string(const std::set<T, C, A>& s) {
   std::ostringstream o;
   o << "{" << to_string(s.begin(), s.end()) << "}";
   return o.str();
 }
+
+/**
+ * Limits what appendTo() prints, so that log lines don't grow with the data:
+ * once the output is maxSize bytes long, strings, containers and structs are
+ * cut short with "...", and containers print at most maxElements elements.
+ * The output may end up a few bytes longer than maxSize, for the "..." and
+ * the closing brackets.
+ */
+class TToStringLimit {
+public:
+  TToStringLimit(size_t maxSize = std::string::npos, size_t maxElements = std::string::npos)
+    : maxSize_(maxSize), maxElements_(maxElements) {}
+
+  size_t getMaxSize() const { return maxSize_; }
+
+  size_t getMaxElements() const { return maxElements_; }
+
+  bool isFull(const std::string& out) const { return out.size() >= maxSize_; }
+
+  /**
+   * Appends as much of a string as fits, followed by "..." if it did not fit.
+   */
+  void appendString(std::string& out, const char* data, size_t size) const {
+    size_t room = maxSize_ > out.size() ? maxSize_ - out.size() : 0;
+    if (size <= room) {
+      out.append(data, size);
+    } else {
+      out.append(data, room);
+      out.append("...", 3);
+    }
+  }
+
+  /**
+   * Starts a field of a generated struct, or ends the struct with "...)" if
+   * the output is full.  Returns whether the field should be printed.
+   */
+  bool appendField(std::string& out, const char* name, bool first) const {
+    if (!first) {
+      out.append(", ", 2);
+    }
+    if (isFull(out)) {
+      out.append("...)", 4);
+      return false;
+    }
+    out.append(name);
+    return true;
+  }
+
+private:
+  size_t maxSize_;
+  size_t maxElements_;
+};
+
+/**
+ * appendTo() prints like to_string(), but appends to a string that can be
+ * reused for many calls, and does not need an ostringstream for numbers,
+ * strings and containers.  Generated structs and enums have their own
+ * overloads; other types are printed with to_string().
+ */
+inline void appendTo(std::string& out, unsigned long long value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  char buf[std::numeric_limits<unsigned long long>::digits10 + 1];
+#if __cplusplus >= 201703L
+  out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+#else
+  char* begin = buf + sizeof(buf);
+  do {
+    *--begin = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  out.append(begin, buf + sizeof(buf));
+#endif
+}
+
+inline void appendTo(std::string& out, long long value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  if (value < 0) {
+    out.push_back('-');
+    // negating the unsigned value also works for the smallest long long
+    appendTo(out, 0 - static_cast<unsigned long long>(value), limit);
+  } else {
+    appendTo(out, static_cast<unsigned long long>(value), limit);
+  }
+}
+
+inline void appendTo(std::string& out, unsigned long value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<unsigned long long>(value), limit);
+}
+
+inline void appendTo(std::string& out, long value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<long long>(value), limit);
+}
+
+inline void appendTo(std::string& out, unsigned int value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<unsigned long long>(value), limit);
+}
+
+inline void appendTo(std::string& out, int value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<long long>(value), limit);
+}
+
+inline void appendTo(std::string& out, unsigned short value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<unsigned long long>(value), limit);
+}
+
+inline void appendTo(std::string& out, short value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<long long>(value), limit);
+}
+
+// characters, including the int8_t of byte fields, are printed as characters
+// like an ostream does
+inline void appendTo(std::string& out, char value, const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  out.push_back(value);
+}
+
+inline void appendTo(std::string& out, signed char value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<char>(value), limit);
+}
+
+inline void appendTo(std::string& out, unsigned char value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, static_cast<char>(value), limit);
+}
+
+inline void appendTo(std::string& out, bool value, const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  out.push_back(value ? '1' : '0');
+}
+
+#if __cplusplus >= 201703L && defined(__cpp_lib_to_chars)
+// the same digits as to_string(), which prints with max_digits10 precision
+template <typename T>
+void appendFloatingPoint(std::string& out, T value) {
+  char buf[64];
+  std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value,
+                                              std::chars_format::general,
+                                              std::numeric_limits<T>::max_digits10);
+  out.append(buf, result.ptr);
+}
+#else
+template <typename T>
+void appendFloatingPoint(std::string& out, T value) {
+  out.append(to_string(value));
+}
+#endif
+
+inline void appendTo(std::string& out, float value, const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  appendFloatingPoint(out, value);
+}
+
+inline void appendTo(std::string& out, double value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  appendFloatingPoint(out, value);
+}
+
+inline void appendTo(std::string& out, long double value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  (void)limit;
+  appendFloatingPoint(out, value);
+}
+
+inline void appendTo(std::string& out, const std::string& value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  limit.appendString(out, value.data(), value.size());
+}
+
+inline void appendTo(std::string& out, const char* value,
+                     const TToStringLimit& limit = TToStringLimit()) {
+  limit.appendString(out, value, strlen(value));
+}
+
+template <typename T>
+void appendTo(std::string& out, const T& t, const TToStringLimit& limit = TToStringLimit()) {
+  appendTo(out, to_string(t), limit);
+}
+
+template <typename K, typename V>
+void appendTo(std::string& out, const std::pair<K, V>& v,
+              const TToStringLimit& limit = TToStringLimit());
+
+template <typename T, typename A>
+void appendTo(std::string& out, const std::vector<T, A>& t,
+              const TToStringLimit& limit = TToStringLimit());
+
+template <typename K, typename V, typename C, typename A>
+void appendTo(std::string& out, const std::map<K, V, C, A>& m,
+              const TToStringLimit& limit = TToStringLimit());
+
+template <typename T, typename C, typename A>
+void appendTo(std::string& out, const std::set<T, C, A>& s,
+              const TToStringLimit& limit = TToStringLimit());
+
+template <typename K, typename V>
+void appendTo(std::string& out, const std::pair<K, V>& v, const TToStringLimit& limit) {
+  appendTo(out, v.first, limit);
+  out.append(": ", 2);
+  appendTo(out, v.second, limit);
+}
+
+template <typename T>
+void appendTo(std::string& out, const T& beg, const T& end, const TToStringLimit& limit) {
+  size_t count = 0;
+  for (T it = beg; it != end; ++it, ++count) {
+    if (it != beg) {
+      out.append(", ", 2);
+    }
+    if (count == limit.getMaxElements() || limit.isFull(out)) {
+      out.append("...", 3);
+      return;
+    }
+    appendTo(out, *it, limit);
+  }
+}
+
+template <typename T, typename A>
+void appendTo(std::string& out, const std::vector<T, A>& t, const TToStringLimit& limit) {
+  out.push_back('[');
+  appendTo(out, t.begin(), t.end(), limit);
+  out.push_back(']');
+}
+
+template <typename K, typename V, typename C, typename A>
+void appendTo(std::string& out, const std::map<K, V, C, A>& m, const TToStringLimit& limit) {
+  out.push_back('{');
+  appendTo(out, m.begin(), m.end(), limit);
+  out.push_back('}');
+}
+
+template <typename T, typename C, typename A>
+void appendTo(std::string& out, const std::set<T, C, A>& s, const TToStringLimit& limit) {
+  out.push_back('{');
+  appendTo(out, s.begin(), s.end(), limit);
+  out.push_back('}');
+}
 }
 } // apache::thrift
 
@@ -27,22 +27,31 @@ namespace apache { namespace thrift { namespace async {
 
 using namespace ::apache::thrift::concurrency;
 
-TConcurrentClientSyncInfo::TConcurrentClientSyncInfo() :
+const uint32_t TConcurrentClientSyncInfo::DEFAULT_MAX_PENDING;
+
+TConcurrentClientSyncInfo::TConcurrentClientSyncInfo(uint32_t maxPending) :
   stop_(false),
-  seqidMutex_(),
   // test rollover all the time
   nextseqid_((std::numeric_limits<int32_t>::max)()-10),
-  seqidToMonitorMap_(),
-  freeMonitors_(),
+  slots_(),
+  slotMask_(0),
   writeMutex_(),
   readMutex_(),
   recvPending_(false),
   wakeupSomeone_(false),
   seqidPending_(0),
   fnamePending_(),
-  mtypePending_(::apache::thrift::protocol::T_CALL)
+  mtypePending_(::apache::thrift::protocol::T_CALL),
+  waitersHead_(nullptr),
+  waitersTail_(nullptr)
 {
-  freeMonitors_.reserve(MONITOR_CACHE_SIZE);
+  uint32_t slotCount = 1;
+  while(slotCount < maxPending && slotCount < (1u << 30))
+    slotCount <<= 1;
+  slotMask_ = slotCount - 1;
+  slots_.reserve(slotCount);
+  for(uint32_t i = 0; i < slotCount; ++i)
+    slots_.emplace_back(new Slot(&readMutex_));
 }
 
 bool TConcurrentClientSyncInfo::getPending(
@@ -73,24 +82,16 @@ void TConcurrentClientSyncInfo::updatePending(
   seqidPending_ = rseqid;
   fnamePending_ = fname;
   mtypePending_ = mtype;
-  MonitorPtr monitor;
-  {
-    Guard seqidGuard(seqidMutex_);
-    auto i = seqidToMonitorMap_.find(rseqid);
-    if(i == seqidToMonitorMap_.end())
-      throwBadSeqId_();
-    monitor = i->second;
-  }
-  monitor->notify();
+  Slot& slot = slotFor_(rseqid);
+  if(!slot.busy.load() || slot.seqid.load() != rseqid)
+    throwBadSeqId_();
+  slot.monitor.notify();
 }
 
 void TConcurrentClientSyncInfo::waitForWork(int32_t seqid)
 {
-  MonitorPtr m;
-  {
-    Guard seqidGuard(seqidMutex_);
-    m = seqidToMonitorMap_[seqid];
-  }
+  Slot& slot = slotFor_(seqid);
+  pushWaiter_(slot);
   while(true)
   {
     // be very careful about setting state in this loop that affects waking up.  You may exit
@@ -98,12 +99,16 @@ void TConcurrentClientSyncInfo::waitForWork(int32_t seqid)
     // left) the read mutex, and that will put you right back in this loop, with the mangled
     // state you left behind.
     if(stop_)
+    {
+      removeWaiter_(slot);
       throwDeadConnection_();
-    if(wakeupSomeone_)
-      return;
-    if(recvPending_ && seqidPending_ == seqid)
+    }
+    if(wakeupSomeone_ || (recvPending_ && seqidPending_ == seqid))
+    {
+      removeWaiter_(slot);
       return;
-    m->waitForever();
+    }
+    slot.monitor.waitForever();
   }
 }
 
@@ -121,76 +126,83 @@ void TConcurrentClientSyncInfo::throwDeadConnection_()
     "this client died on another thread, and is now in an unusable state");
 }
 
-void TConcurrentClientSyncInfo::wakeupAnyone_(const Guard &)
+void TConcurrentClientSyncInfo::pushWaiter_(Slot &slot)
+{
+  slot.prevWaiter = waitersTail_;
+  slot.nextWaiter = nullptr;
+  if(waitersTail_)
+    waitersTail_->nextWaiter = &slot;
+  else
+    waitersHead_ = &slot;
+  waitersTail_ = &slot;
+}
+
+void TConcurrentClientSyncInfo::removeWaiter_(Slot &slot)
+{
+  if(slot.prevWaiter)
+    slot.prevWaiter->nextWaiter = slot.nextWaiter;
+  else
+    waitersHead_ = slot.nextWaiter;
+  if(slot.nextWaiter)
+    slot.nextWaiter->prevWaiter = slot.prevWaiter;
+  else
+    waitersTail_ = slot.prevWaiter;
+  slot.prevWaiter = nullptr;
+  slot.nextWaiter = nullptr;
+}
+
+void TConcurrentClientSyncInfo::wakeupAnyone_()
 {
   wakeupSomeone_ = true;
-  if(!seqidToMonitorMap_.empty())
+  if(waitersTail_)
   {
-    // The monitor map maps integers to monitors.  Larger integers are more recent
-    // messages.  Since this is ordered, it means that the last element is the most recent.
+    // The waiter list is ordered by the time the threads started waiting, so the
+    // tail is the most recent call.
     // We are trying to guess which thread will have its message complete next, so we are picking
     // the most recent. The oldest message is likely to be some polling, long lived message.
     // If we guess right, the thread we wake up will handle the message that comes in.
     // If we guess wrong, the thread we wake up will hand off the work to the correct thread,
     // costing us an extra context switch.
-    seqidToMonitorMap_.rbegin()->second->notify();
+    waitersTail_->monitor.notify();
   }
 }
 
-void TConcurrentClientSyncInfo::markBad_(const Guard &)
+void TConcurrentClientSyncInfo::markBad_()
 {
   wakeupSomeone_ = true;
   stop_ = true;
-  for(auto & i : seqidToMonitorMap_)
-    i.second->notify();
+  for(auto & slot : slots_)
+    if(slot->busy.load())
+      slot->monitor.notify();
 }
 
-TConcurrentClientSyncInfo::MonitorPtr
-TConcurrentClientSyncInfo::newMonitor_(const Guard &)
+void TConcurrentClientSyncInfo::releaseSlot_(int32_t seqid)
 {
-  if(freeMonitors_.empty())
-    return std::make_shared<Monitor>(&readMutex_);
-  MonitorPtr retval;
-  //swapping to avoid an atomic operation
-  retval.swap(freeMonitors_.back());
-  freeMonitors_.pop_back();
-  return retval;
-}
-
-void TConcurrentClientSyncInfo::deleteMonitor_(
-  const Guard &,
-  TConcurrentClientSyncInfo::MonitorPtr &m) /*noexcept*/
-{
-  if(freeMonitors_.size() > MONITOR_CACHE_SIZE)
-  {
-    m.reset();
-    return;
-  }
-  //freeMonitors_ was reserved up to MONITOR_CACHE_SIZE in the ctor,
-  //so this shouldn't throw
-  freeMonitors_.push_back(TConcurrentClientSyncInfo::MonitorPtr());
-  //swapping to avoid an atomic operation
-  m.swap(freeMonitors_.back());
+  slotFor_(seqid).busy.store(false);
 }
 
 int32_t TConcurrentClientSyncInfo::generateSeqId()
 {
-  Guard seqidGuard(seqidMutex_);
   if(stop_)
     throwDeadConnection_();
 
-  if(!seqidToMonitorMap_.empty())
-    if(nextseqid_ == seqidToMonitorMap_.begin()->first)
-      throw apache::thrift::TApplicationException(
-        TApplicationException::BAD_SEQUENCE_ID,
-        "about to repeat a seqid");
-  int32_t newSeqId = nextseqid_;
-  if (nextseqid_ == (std::numeric_limits<int32_t>::max)())
-    nextseqid_ = (std::numeric_limits<int32_t>::min)();
-  else
-    ++nextseqid_;
-  seqidToMonitorMap_[newSeqId] = newMonitor_(seqidGuard);
-  return newSeqId;
+  // Seqids whose slot is still taken by a long running call are skipped, so
+  // only give up once every slot has been tried.
+  for(size_t attempt = 0; attempt < slots_.size(); ++attempt)
+  {
+    // atomic arithmetic wraps around from max to min
+    int32_t newSeqId = nextseqid_.fetch_add(1);
+    Slot& slot = slotFor_(newSeqId);
+    bool expected = false;
+    if(slot.busy.compare_exchange_strong(expected, true))
+    {
+      slot.seqid.store(newSeqId);
+      return newSeqId;
+    }
+  }
+  throw apache::thrift::TApplicationException(
+    TApplicationException::BAD_SEQUENCE_ID,
+    "too many outstanding calls");
 }
 
 TConcurrentRecvSentry::TConcurrentRecvSentry(TConcurrentClientSyncInfo *sync, int32_t seqid) :
@@ -203,16 +215,11 @@ TConcurrentRecvSentry::TConcurrentRecvSentry(TConcurrentClientSyncInfo *sync, in
 
 TConcurrentRecvSentry::~TConcurrentRecvSentry()
 {
-  {
-    Guard seqidGuard(sync_.seqidMutex_);
-    sync_.deleteMonitor_(seqidGuard, sync_.seqidToMonitorMap_[seqid_]);
-
-    sync_.seqidToMonitorMap_.erase(seqid_);
-    if(committed_)
-      sync_.wakeupAnyone_(seqidGuard);
-    else
-      sync_.markBad_(seqidGuard);
-  }
+  sync_.releaseSlot_(seqid_);
+  if(committed_)
+    sync_.wakeupAnyone_();
+  else
+    sync_.markBad_();
   sync_.getReadMutex().unlock();
 }
 
@@ -231,10 +238,7 @@ TConcurrentSendSentry::TConcurrentSendSentry(TConcurrentClientSyncInfo *sync) :
 TConcurrentSendSentry::~TConcurrentSendSentry()
 {
   if(!committed_)
-  {
-    Guard seqidGuard(sync_.seqidMutex_);
-    sync_.markBad_(seqidGuard);
-  }
+    sync_.markBad_();
   sync_.getWriteMutex().unlock();
 }
 
@@ -22,10 +22,10 @@
 #include <thrift/protocol/TProtocol.h>
 #include <thrift/concurrency/Mutex.h>
 #include <thrift/concurrency/Monitor.h>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
-#include <map>
 
 namespace apache {
 namespace thrift {
@@ -58,13 +58,28 @@ private:
   bool committed_;
 };
 
+/**
+ * Coordinates the threads that share the connection of a concurrent client.
+ *
+ * Every outstanding call owns one slot of a fixed ring, indexed by its seqid,
+ * which holds the monitor the call waits on.  The slots are allocated once,
+ * so issuing a call takes no lock and allocates nothing; the ring size
+ * bounds the number of calls that can be outstanding at once.
+ *
+ * Responses are read by whichever waiting thread holds the read mutex.  A
+ * response for another call is parked and the owner of its slot is woken up
+ * to deserialize it.
+ */
 class TConcurrentClientSyncInfo {
-private: // typedefs
-  typedef std::shared_ptr< ::apache::thrift::concurrency::Monitor> MonitorPtr;
-  typedef std::map<int32_t, MonitorPtr> MonitorMap;
-
 public:
-  TConcurrentClientSyncInfo();
+  /// Default number of calls that can be outstanding at once
+  static const uint32_t DEFAULT_MAX_PENDING = 256;
+
+  /**
+   * @param maxPending number of calls that can be outstanding at once,
+   *                   rounded up to a power of two
+   */
+  explicit TConcurrentClientSyncInfo(uint32_t maxPending = DEFAULT_MAX_PENDING);
 
   int32_t generateSeqId();
 
@@ -81,29 +96,36 @@ public:
   ::apache::thrift::concurrency::Mutex& getReadMutex() { return readMutex_; }
   ::apache::thrift::concurrency::Mutex& getWriteMutex() { return writeMutex_; }
 
-private: // constants
-  enum { MONITOR_CACHE_SIZE = 10 };
+private: // types
+  struct Slot {
+    explicit Slot(::apache::thrift::concurrency::Mutex* readMutex)
+      : busy(false), seqid(0), monitor(readMutex), prevWaiter(nullptr), nextWaiter(nullptr) {}
+
+    std::atomic<bool> busy;
+    std::atomic<int32_t> seqid;
+    ::apache::thrift::concurrency::Monitor monitor;
+    // begin readMutex_ protected members
+    Slot* prevWaiter;
+    Slot* nextWaiter;
+    // end readMutex_ protected members
+  };
 
 private: // functions
-  MonitorPtr newMonitor_(
-      const ::apache::thrift::concurrency::Guard& seqidGuard); /* requires seqidMutex_ */
-  void deleteMonitor_(const ::apache::thrift::concurrency::Guard& seqidGuard, MonitorPtr& m);
-      /*noexcept*/ /* requires seqidMutex_ */
-  void wakeupAnyone_(
-      const ::apache::thrift::concurrency::Guard& seqidGuard);           /* requires seqidMutex_ */
-  void markBad_(const ::apache::thrift::concurrency::Guard& seqidGuard); /* requires seqidMutex_ */
+  Slot& slotFor_(int32_t seqid) { return *slots_[static_cast<uint32_t>(seqid) & slotMask_]; }
+  void releaseSlot_(int32_t seqid);
+  void pushWaiter_(Slot& slot);   /* requires readMutex_ */
+  void removeWaiter_(Slot& slot); /* requires readMutex_ */
+  void wakeupAnyone_();           /* requires readMutex_ */
+  void markBad_();
   void throwBadSeqId_();
   void throwDeadConnection_();
 
 private: // data members
-  volatile bool stop_;
+  std::atomic<bool> stop_;
 
-  ::apache::thrift::concurrency::Mutex seqidMutex_;
-  // begin seqidMutex_ protected members
-  int32_t nextseqid_;
-  MonitorMap seqidToMonitorMap_;
-  std::vector<MonitorPtr> freeMonitors_;
-  // end seqidMutex_ protected members
+  std::atomic<int32_t> nextseqid_;
+  std::vector<std::unique_ptr<Slot> > slots_;
+  uint32_t slotMask_;
 
   ::apache::thrift::concurrency::Mutex writeMutex_;
 
@@ -114,6 +136,8 @@ private: // data members
   int32_t seqidPending_;
   std::string fnamePending_;
   ::apache::thrift::protocol::TMessageType mtypePending_;
+  Slot* waitersHead_;
+  Slot* waitersTail_;
   // end readMutex_ protected members
 
   friend class TConcurrentSendSentry;
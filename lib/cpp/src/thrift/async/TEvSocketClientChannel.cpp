@@ -0,0 +1,209 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/async/TEvSocketClientChannel.h>
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TTransportException.h>
+
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <exception>
+
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+
+namespace apache {
+namespace thrift {
+namespace async {
+
+const uint32_t TEvSocketClientChannel::DEFAULT_MAX_FRAME_SIZE;
+
+TEvSocketClientChannel::TEvSocketClientChannel(const std::string& host,
+                                               int port,
+                                               struct event_base* eb,
+                                               struct evdns_base* dnsbase)
+  : bev_(nullptr), maxFrameSize_(DEFAULT_MAX_FRAME_SIZE), error_(false) {
+  bev_ = bufferevent_socket_new(eb, -1, BEV_OPT_CLOSE_ON_FREE);
+  if (bev_ == nullptr) {
+    throw TException("bufferevent_socket_new failed");
+  }
+  bufferevent_setcb(bev_, readCallback, writeCallback, eventCallback, this);
+  if (bufferevent_enable(bev_, EV_READ | EV_WRITE) != 0
+      || bufferevent_socket_connect_hostname(bev_, dnsbase, AF_UNSPEC, host.c_str(), port) != 0) {
+    bufferevent_free(bev_);
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "could not connect to " + host + ":" + std::to_string(port));
+  }
+}
+
+TEvSocketClientChannel::~TEvSocketClientChannel() {
+  bufferevent_free(bev_);
+}
+
+void TEvSocketClientChannel::sendAndRecvMessage(const VoidCallback& cob,
+                                                TMemoryBuffer* sendBuf,
+                                                TMemoryBuffer* recvBuf) {
+  writeFrame(sendBuf);
+  recvQueue_.push_back(Completion(cob, recvBuf));
+}
+
+void TEvSocketClientChannel::sendMessage(const VoidCallback& cob, TMemoryBuffer* message) {
+  writeFrame(message);
+  sendQueue_.push_back(cob);
+}
+
+void TEvSocketClientChannel::recvMessage(const VoidCallback& cob, TMemoryBuffer* message) {
+  if (error_) {
+    throw TTransportException(TTransportException::NOT_OPEN, "channel failed");
+  }
+  recvQueue_.push_back(Completion(cob, message));
+}
+
+void TEvSocketClientChannel::writeFrame(TMemoryBuffer* message) {
+  if (error_) {
+    throw TTransportException(TTransportException::NOT_OPEN, "channel failed");
+  }
+
+  uint8_t* buf;
+  uint32_t size;
+  message->getBuffer(&buf, &size);
+  uint32_t frameSize = htonl(size);
+  struct evbuffer* output = bufferevent_get_output(bev_);
+  if (evbuffer_add(output, &frameSize, sizeof(frameSize)) != 0
+      || evbuffer_add(output, buf, size) != 0) {
+    throw TException("evbuffer_add failed");
+  }
+}
+
+void TEvSocketClientChannel::readFrames() {
+  struct evbuffer* input = bufferevent_get_input(bev_);
+  while (!error_) {
+    size_t available = evbuffer_get_length(input);
+    uint32_t frameSize;
+    if (available < sizeof(frameSize)) {
+      return;
+    }
+    evbuffer_copyout(input, &frameSize, sizeof(frameSize));
+    frameSize = ntohl(frameSize);
+    if (frameSize > maxFrameSize_) {
+      fail("response frame too large");
+      return;
+    }
+    if (available - sizeof(frameSize) < frameSize) {
+      return;
+    }
+    if (recvQueue_.empty()) {
+      fail("unexpected response");
+      return;
+    }
+
+    evbuffer_drain(input, sizeof(frameSize));
+    // Let the receiver read the frame from the input buffer, and drop it afterwards
+    Completion completion = recvQueue_.front();
+    recvQueue_.pop_front();
+    unsigned char* frame = evbuffer_pullup(input, frameSize);
+    completion.second->resetBuffer(frame, frameSize);
+    try {
+      completion.first();
+    } catch (const std::exception& e) {
+      // don't propagate a C++ exception in C code (e.g. libevent)
+      GlobalOutput.printf("TEvSocketClientChannel: callback threw (ignored): %s", e.what());
+    }
+    completion.second->resetBuffer();
+    evbuffer_drain(input, frameSize);
+  }
+}
+
+void TEvSocketClientChannel::messagesSent() {
+  std::deque<VoidCallback> sent;
+  sent.swap(sendQueue_);
+  for (auto& cob : sent) {
+    try {
+      cob();
+    } catch (const std::exception& e) {
+      GlobalOutput.printf("TEvSocketClientChannel: callback threw (ignored): %s", e.what());
+    }
+  }
+}
+
+void TEvSocketClientChannel::fail(const char* why) {
+  if (error_) {
+    return;
+  }
+  GlobalOutput.printf("TEvSocketClientChannel: %s", why);
+  error_ = true;
+  bufferevent_disable(bev_, EV_READ | EV_WRITE);
+
+  // The callbacks find out about the failure from error(), or when they try
+  // to read their empty response.
+  messagesSent();
+  std::deque<Completion> failed;
+  failed.swap(recvQueue_);
+  for (auto& completion : failed) {
+    completion.second->resetBuffer();
+    try {
+      completion.first();
+    } catch (const std::exception& e) {
+      GlobalOutput.printf("TEvSocketClientChannel: callback threw (ignored): %s", e.what());
+    }
+  }
+}
+
+/* static */ void TEvSocketClientChannel::readCallback(struct bufferevent* bev, void* arg) {
+  (void)bev;
+  static_cast<TEvSocketClientChannel*>(arg)->readFrames();
+}
+
+/* static */ void TEvSocketClientChannel::writeCallback(struct bufferevent* bev, void* arg) {
+  (void)bev;
+  static_cast<TEvSocketClientChannel*>(arg)->messagesSent();
+}
+
+/* static */ void TEvSocketClientChannel::eventCallback(struct bufferevent* bev,
+                                                        short what,
+                                                        void* arg) {
+  auto* self = static_cast<TEvSocketClientChannel*>(arg);
+  if (what & BEV_EVENT_CONNECTED) {
+    // requests are small and latency matters more than packet count
+    int one = 1;
+    setsockopt(bufferevent_getfd(bev),
+               IPPROTO_TCP,
+               TCP_NODELAY,
+               reinterpret_cast<const char*>(&one),
+               sizeof(one));
+    return;
+  }
+  if (what & BEV_EVENT_EOF) {
+    self->fail("connection closed");
+  } else if (what & (BEV_EVENT_ERROR | BEV_EVENT_TIMEOUT)) {
+    self->fail("connection failed");
+  }
+}
+}
+}
+} // apache::thrift::async
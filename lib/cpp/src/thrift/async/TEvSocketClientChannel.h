@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TEV_SOCKET_CLIENT_CHANNEL_H_
+#define _THRIFT_TEV_SOCKET_CLIENT_CHANNEL_H_ 1
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <thrift/async/TAsyncChannel.h>
+
+struct bufferevent;
+struct event_base;
+struct evdns_base;
+
+namespace apache {
+namespace thrift {
+namespace async {
+
+/**
+ * A non-blocking channel that exchanges framed messages over a TCP
+ * connection, as a TFramedTransport does, driven by a libevent event base.
+ *
+ * Requests are written as soon as they are sent, without waiting for the
+ * responses to the previous ones, so any number of calls can be in flight on
+ * one connection.  Responses are handed to the callbacks in the order the
+ * requests were sent, which is the order in which Thrift servers answer the
+ * calls of a connection.
+ *
+ * All methods, and the event loop of the event base, must be run on the
+ * same thread.
+ */
+class TEvSocketClientChannel : public TAsyncChannel {
+public:
+  using TAsyncChannel::VoidCallback;
+
+  /// Default limit on the size of a response, the same as TFramedTransport's
+  static const uint32_t DEFAULT_MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+  TEvSocketClientChannel(const std::string& host,
+                         int port,
+                         struct event_base* eb,
+                         struct evdns_base* dnsbase = nullptr);
+  ~TEvSocketClientChannel() override;
+
+  void sendAndRecvMessage(const VoidCallback& cob,
+                          apache::thrift::transport::TMemoryBuffer* sendBuf,
+                          apache::thrift::transport::TMemoryBuffer* recvBuf) override;
+
+  /**
+   * Sends a message.  The callback runs once the message was written to the
+   * socket.
+   */
+  void sendMessage(const VoidCallback& cob,
+                   apache::thrift::transport::TMemoryBuffer* message) override;
+
+  /**
+   * Receives a message.  Like the receives of sendAndRecvMessage(), it is
+   * queued behind the ones requested before it, and gets the first frame
+   * that arrives after they got theirs.
+   */
+  void recvMessage(const VoidCallback& cob,
+                   apache::thrift::transport::TMemoryBuffer* message) override;
+
+  bool good() const override { return !error_; }
+  bool error() const override { return error_; }
+  bool timedOut() const override { return false; }
+
+  /**
+   * Returns the number of messages that are still to be received.
+   */
+  size_t getPendingCount() const { return recvQueue_.size(); }
+
+  void setMaxFrameSize(uint32_t maxFrameSize) { maxFrameSize_ = maxFrameSize; }
+  uint32_t getMaxFrameSize() const { return maxFrameSize_; }
+
+private:
+  typedef std::pair<VoidCallback, apache::thrift::transport::TMemoryBuffer*> Completion;
+
+  static void readCallback(struct bufferevent* bev, void* arg);
+  static void writeCallback(struct bufferevent* bev, void* arg);
+  static void eventCallback(struct bufferevent* bev, short what, void* arg);
+
+  void writeFrame(apache::thrift::transport::TMemoryBuffer* message);
+  void readFrames();
+  void messagesSent();
+  void fail(const char* why);
+
+  struct bufferevent* bev_;
+  std::deque<Completion> recvQueue_;
+  std::deque<VoidCallback> sendQueue_;
+  uint32_t maxFrameSize_;
+  bool error_;
+};
+}
+}
+} // apache::thrift::async
+
+#endif // #ifndef _THRIFT_TEV_SOCKET_CLIENT_CHANNEL_H_
@@ -200,6 +200,15 @@ public:
   static std::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count = 4,
                                                                  size_t pendingTaskCountMax = 0);
 
+  /**
+   * Creates a thread manager with the same contract as newSimpleThreadManager,
+   * but which spreads pending tasks over one queue per initial worker and lets
+   * idle workers steal from the other queues.  Prefer it when many threads add
+   * tasks concurrently and the single task queue lock becomes contended.
+   */
+  static std::shared_ptr<ThreadManager> newWorkStealingThreadManager(size_t count = 4,
+                                                                       size_t pendingTaskCountMax = 0);
+
   class Task;
 
   class Worker;
@@ -0,0 +1,468 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/concurrency/TimingWheelTimerManager.h>
+#include <thrift/concurrency/Exception.h>
+
+#include <assert.h>
+#include <limits>
+#include <memory>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+using std::shared_ptr;
+using std::weak_ptr;
+
+/**
+ * A timer in the wheel.  While it is linked into a slot the task owns itself
+ * through self_, so the wheel itself only needs intrusive raw links and a
+ * timer costs a single allocation.
+ */
+class TimingWheelTimerManager::Task : public Runnable {
+
+public:
+  enum STATE { WAITING, EXECUTING, CANCELLED, COMPLETE };
+
+  Task(shared_ptr<Runnable> runnable, uint64_t tick)
+    : runnable_(runnable),
+      tick_(tick),
+      state_(WAITING),
+      slot_(nullptr),
+      prev_(nullptr),
+      next_(nullptr) {}
+
+  ~Task() override = default;
+
+  void run() override {
+    if (state_ == EXECUTING) {
+      runnable_->run();
+      state_ = COMPLETE;
+    }
+  }
+
+  bool operator==(const shared_ptr<Runnable>& runnable) const { return runnable_ == runnable; }
+
+private:
+  shared_ptr<Runnable> runnable_;
+  uint64_t tick_;
+  STATE state_;
+  Slot* slot_;
+  Task* prev_;
+  Task* next_;
+  shared_ptr<Task> self_;
+  friend class TimingWheelTimerManager;
+  friend class TimingWheelTimerManager::Dispatcher;
+};
+
+class TimingWheelTimerManager::Dispatcher : public Runnable {
+
+public:
+  Dispatcher(TimingWheelTimerManager* manager) : manager_(manager) {}
+
+  ~Dispatcher() override = default;
+
+  /**
+   * Dispatcher entry point
+   *
+   * Sleeps until the next non-empty slot or the next cascade point of the
+   * wheel, then turns the wheel up to the current time and runs every task
+   * that fell due on the way outside the lock.
+   */
+  void run() override {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimingWheelTimerManager::STARTING) {
+        manager_->state_ = TimingWheelTimerManager::STARTED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+
+    do {
+      std::vector<shared_ptr<TimingWheelTimerManager::Task> > expiredTasks;
+      {
+        Synchronized s(manager_->monitor_);
+        manager_->expire(expiredTasks);
+        while (manager_->state_ == TimingWheelTimerManager::STARTED && expiredTasks.empty()) {
+          manager_->wakeTick_ = manager_->nextWakeTick();
+          if (manager_->wakeTick_ == (std::numeric_limits<uint64_t>::max)()) {
+            manager_->monitor_.waitForever();
+          } else {
+            manager_->monitor_.waitForTime(manager_->toTime(manager_->wakeTick_));
+          }
+          // while awake the dispatcher looks at the wheel again anyway, so
+          // add() does not need to notify it
+          manager_->wakeTick_ = 0;
+          manager_->expire(expiredTasks);
+        }
+      }
+
+      for (const auto& expiredTask : expiredTasks) {
+        expiredTask->run();
+      }
+
+    } while (manager_->state_ == TimingWheelTimerManager::STARTED);
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimingWheelTimerManager::STOPPING) {
+        manager_->state_ = TimingWheelTimerManager::STOPPED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+    return;
+  }
+
+private:
+  TimingWheelTimerManager* manager_;
+  friend class TimingWheelTimerManager;
+};
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4355) // 'this' used in base member initializer list
+#endif
+
+TimingWheelTimerManager::TimingWheelTimerManager(const std::chrono::milliseconds& tick)
+  : tick_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(tick)),
+    epoch_(std::chrono::steady_clock::now()),
+    currentTick_(0),
+    wakeTick_(0),
+    slots_(LEVELS << SLOT_BITS),
+    taskCount_(0),
+    state_(TimingWheelTimerManager::UNINITIALIZED),
+    dispatcher_(std::make_shared<Dispatcher>(this)) {
+  if (tick_.count() <= 0) {
+    throw InvalidArgumentException();
+  }
+}
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+TimingWheelTimerManager::~TimingWheelTimerManager() {
+
+  // If we haven't been explicitly stopped, do so now.  We don't need to grab
+  // the monitor here, since stop already takes care of reentrancy.
+
+  if (state_ != STOPPED) {
+    try {
+      stop();
+    } catch (...) {
+      // We're really hosed.
+    }
+  }
+
+  // Break the self references of timers that never fell due.
+  clear();
+}
+
+void TimingWheelTimerManager::start() {
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    if (state_ == TimingWheelTimerManager::UNINITIALIZED) {
+      state_ = TimingWheelTimerManager::STARTING;
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    dispatcherThread_ = threadFactory_->newThread(dispatcher_);
+    dispatcherThread_->start();
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (state_ == TimingWheelTimerManager::STARTING) {
+      monitor_.wait();
+    }
+    assert(state_ != TimingWheelTimerManager::STARTING);
+  }
+}
+
+void TimingWheelTimerManager::stop() {
+  bool doStop = false;
+  {
+    Synchronized s(monitor_);
+    if (state_ == TimingWheelTimerManager::UNINITIALIZED) {
+      state_ = TimingWheelTimerManager::STOPPED;
+    } else if (state_ != STOPPING && state_ != STOPPED) {
+      doStop = true;
+      state_ = STOPPING;
+      monitor_.notifyAll();
+    }
+    while (state_ != STOPPED) {
+      monitor_.wait();
+    }
+  }
+
+  if (doStop) {
+    // Clean up any outstanding tasks
+    clear();
+
+    // Remove dispatcher's reference to us.
+    dispatcher_->manager_ = nullptr;
+  }
+}
+
+shared_ptr<const ThreadFactory> TimingWheelTimerManager::threadFactory() const {
+  Synchronized s(monitor_);
+  return threadFactory_;
+}
+
+void TimingWheelTimerManager::threadFactory(shared_ptr<const ThreadFactory> value) {
+  Synchronized s(monitor_);
+  threadFactory_ = value;
+}
+
+size_t TimingWheelTimerManager::taskCount() const {
+  return taskCount_;
+}
+
+TimingWheelTimerManager::Timer TimingWheelTimerManager::add(shared_ptr<Runnable> task,
+                                                            const std::chrono::milliseconds& timeout) {
+  return add(task, std::chrono::steady_clock::now() + timeout);
+}
+
+TimingWheelTimerManager::Timer TimingWheelTimerManager::add(shared_ptr<Runnable> task,
+                                                            const time_point& abstime) {
+  auto now = std::chrono::steady_clock::now();
+
+  if (abstime < now) {
+    throw InvalidArgumentException();
+  }
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  shared_ptr<Task> timer = std::make_shared<Task>(task, toTick(abstime, true));
+  timer->self_ = timer;
+  link(timer.get(), currentTick_ + 1);
+  taskCount_++;
+
+  // Only kick the dispatcher if it is asleep and would wake up too late.
+  if (timer->tick_ < wakeTick_) {
+    monitor_.notify();
+  }
+
+  return timer;
+}
+
+void TimingWheelTimerManager::remove(shared_ptr<Runnable> task) {
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+  bool found = false;
+  for (auto& slot : slots_) {
+    for (Task* ix = slot.head; ix != nullptr;) {
+      Task* next = ix->next_;
+      if (*ix == task) {
+        found = true;
+        unlink(ix);
+        taskCount_--;
+        ix->state_ = Task::CANCELLED;
+        shared_ptr<Task> release;
+        release.swap(ix->self_);
+      }
+      ix = next;
+    }
+  }
+  if (!found) {
+    throw NoSuchTaskException();
+  }
+}
+
+void TimingWheelTimerManager::remove(Timer handle) {
+  Synchronized s(monitor_);
+  if (state_ != TimingWheelTimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  shared_ptr<Task> task = handle.lock();
+  if (!task) {
+    throw NoSuchTaskException();
+  }
+
+  if (task->slot_ == nullptr) {
+    // Task is being executed
+    throw UncancellableTaskException();
+  }
+
+  unlink(task.get());
+  taskCount_--;
+  task->state_ = Task::CANCELLED;
+  task->self_.reset();
+}
+
+TimingWheelTimerManager::STATE TimingWheelTimerManager::state() const {
+  return state_;
+}
+
+uint64_t TimingWheelTimerManager::toTick(const time_point& abstime, bool roundUp) const {
+  if (abstime <= epoch_) {
+    return 0;
+  }
+  auto elapsed = abstime - epoch_;
+  uint64_t tick = static_cast<uint64_t>(elapsed / tick_);
+  if (roundUp && elapsed % tick_ != std::chrono::steady_clock::duration::zero()) {
+    tick++;
+  }
+  return tick;
+}
+
+TimingWheelTimerManager::time_point TimingWheelTimerManager::toTime(uint64_t tick) const {
+  return epoch_ + tick_ * static_cast<std::chrono::steady_clock::rep>(tick);
+}
+
+/**
+ * Links a task into the slot for its tick, using the lowest level whose
+ * range still covers the distance from the current tick.  A task further out
+ * than the whole wheel is parked in the top level and re-placed when that
+ * slot is cascaded.
+ */
+void TimingWheelTimerManager::link(Task* task, uint64_t earliest) {
+  uint64_t tick = task->tick_ < earliest ? earliest : task->tick_;
+  uint64_t delta = tick - currentTick_;
+
+  unsigned level = 0;
+  while (level + 1 < LEVELS && delta >> (SLOT_BITS * (level + 1)) != 0) {
+    level++;
+  }
+  if (delta >> (SLOT_BITS * (level + 1)) != 0) {
+    tick = currentTick_ + (static_cast<uint64_t>(1) << (SLOT_BITS * LEVELS)) - 1;
+  }
+
+  Slot& slot = slots_[(level << SLOT_BITS) + ((tick >> (SLOT_BITS * level)) & SLOT_MASK)];
+  task->slot_ = &slot;
+  task->prev_ = nullptr;
+  task->next_ = slot.head;
+  if (slot.head != nullptr) {
+    slot.head->prev_ = task;
+  }
+  slot.head = task;
+}
+
+void TimingWheelTimerManager::unlink(Task* task) {
+  if (task->prev_ != nullptr) {
+    task->prev_->next_ = task->next_;
+  } else {
+    task->slot_->head = task->next_;
+  }
+  if (task->next_ != nullptr) {
+    task->next_->prev_ = task->prev_;
+  }
+  task->slot_ = nullptr;
+  task->prev_ = nullptr;
+  task->next_ = nullptr;
+}
+
+/**
+ * Moves the tasks of the slot at the current position of the given level
+ * down to the lower levels.  Called when all lower levels have wrapped.
+ */
+void TimingWheelTimerManager::cascade(unsigned level) {
+  uint64_t index = (currentTick_ >> (SLOT_BITS * level)) & SLOT_MASK;
+  if (index == 0 && level + 1 < LEVELS) {
+    cascade(level + 1);
+  }
+
+  Slot& slot = slots_[(level << SLOT_BITS) + index];
+  Task* task = slot.head;
+  slot.head = nullptr;
+  while (task != nullptr) {
+    Task* next = task->next_;
+    link(task, currentTick_);
+    task = next;
+  }
+}
+
+/**
+ * Turns the wheel up to the current time, handing every task that fell due
+ * over to the caller.  Must be called with the monitor held.
+ */
+void TimingWheelTimerManager::expire(std::vector<shared_ptr<Task> >& expired) {
+  uint64_t target = toTick(std::chrono::steady_clock::now(), false);
+
+  if (taskCount_ == 0) {
+    // nothing to cascade or expire on the way
+    if (currentTick_ < target) {
+      currentTick_ = target;
+    }
+    return;
+  }
+
+  while (currentTick_ < target) {
+    ++currentTick_;
+    if ((currentTick_ & SLOT_MASK) == 0) {
+      cascade(1);
+    }
+
+    Slot& slot = slots_[currentTick_ & SLOT_MASK];
+    while (slot.head != nullptr) {
+      Task* task = slot.head;
+      unlink(task);
+      if (task->state_ == Task::WAITING) {
+        task->state_ = Task::EXECUTING;
+      }
+      expired.push_back(std::move(task->self_));
+      taskCount_--;
+    }
+  }
+}
+
+/**
+ * Returns the next tick worth waking up for: the next non-empty slot of the
+ * lowest level, or the next cascade point if there is none before it.
+ */
+uint64_t TimingWheelTimerManager::nextWakeTick() const {
+  if (taskCount_ == 0) {
+    return (std::numeric_limits<uint64_t>::max)();
+  }
+
+  uint64_t boundary = (currentTick_ | SLOT_MASK) + 1;
+  for (uint64_t tick = currentTick_ + 1; tick < boundary; ++tick) {
+    if (slots_[tick & SLOT_MASK].head != nullptr) {
+      return tick;
+    }
+  }
+  return boundary;
+}
+
+void TimingWheelTimerManager::clear() {
+  for (auto& slot : slots_) {
+    while (slot.head != nullptr) {
+      Task* task = slot.head;
+      unlink(task);
+      shared_ptr<Task> release;
+      release.swap(task->self_);
+    }
+  }
+  taskCount_ = 0;
+}
+}
+}
+} // apache::thrift::concurrency
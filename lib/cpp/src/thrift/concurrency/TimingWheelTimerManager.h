@@ -0,0 +1,169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_
+#define _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_ 1
+
+#include <thrift/concurrency/Monitor.h>
+#include <thrift/concurrency/ThreadFactory.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+/**
+ * Timing Wheel Timer Manager
+ *
+ * Drop-in alternative to TimerManager for workloads with very many short
+ * lived timers, such as per-request deadlines that are almost always
+ * cancelled.  Timers are kept in a hierarchical timing wheel: adding and
+ * removing a timer through its handle are O(1), and all timers falling due in
+ * the same tick are collected in one batch.  The price is that expiration
+ * times are rounded up to the tick resolution.
+ *
+ * The public interface and the exceptions thrown mirror TimerManager.
+ */
+class TimingWheelTimerManager {
+
+public:
+  class Task;
+  typedef std::weak_ptr<Task> Timer;
+
+  /**
+   * @param tick Resolution of the wheel; timers never fire early but may fire
+   *             up to one tick late.
+   */
+  TimingWheelTimerManager(const std::chrono::milliseconds& tick = std::chrono::milliseconds(1));
+
+  virtual ~TimingWheelTimerManager();
+
+  virtual std::shared_ptr<const ThreadFactory> threadFactory() const;
+
+  virtual void threadFactory(std::shared_ptr<const ThreadFactory> value);
+
+  /**
+   * Starts the timer manager service
+   *
+   * @throws IllegalArgumentException Missing thread factory attribute
+   */
+  virtual void start();
+
+  /**
+   * Stops the timer manager service
+   */
+  virtual void stop();
+
+  virtual size_t taskCount() const;
+
+  /**
+   * Adds a task to be executed at some time in the future by the dispatcher thread.
+   *
+   * @param task The task to execute
+   * @param timeout Time in milliseconds to delay before executing task
+   * @return Handle of the timer, which can be used to remove the timer.
+   */
+  virtual Timer add(std::shared_ptr<Runnable> task, const std::chrono::milliseconds& timeout);
+  Timer add(std::shared_ptr<Runnable> task, uint64_t timeout) { return add(task, std::chrono::milliseconds(timeout)); }
+
+  /**
+   * Adds a task to be executed at some time in the future by the dispatcher thread.
+   *
+   * @param task The task to execute
+   * @param abstime Absolute time in the future to execute task.
+   * @return Handle of the timer, which can be used to remove the timer.
+   */
+  virtual Timer add(std::shared_ptr<Runnable> task, const std::chrono::time_point<std::chrono::steady_clock>& abstime);
+
+  /**
+   * Removes a pending task.  Unlike removing a single timer this has to visit
+   * every pending timer.
+   *
+   * @param task The task to remove. All timers which execute this task will
+   * be removed.
+   * @throws NoSuchTaskException Specified task doesn't exist. It was either
+   *                             processed already or this call was made for a
+   *                             task that was never added to this timer
+   */
+  virtual void remove(std::shared_ptr<Runnable> task);
+
+  /**
+   * Removes a single pending task in constant time
+   *
+   * @param timer The timer to remove. The timer is returned when calling the
+   * add() method.
+   * @throws NoSuchTaskException Specified task doesn't exist. It was either
+   *                             processed already or this call was made for a
+   *                             task that was never added to this timer
+   *
+   * @throws UncancellableTaskException Specified task is already being
+   *                                    executed or has completed execution.
+   */
+  virtual void remove(Timer timer);
+
+  enum STATE { UNINITIALIZED, STARTING, STARTED, STOPPING, STOPPED };
+
+  virtual STATE state() const;
+
+private:
+  // 4 levels of 256 slots cover 2^32 ticks, about 49 days at 1ms resolution.
+  static const unsigned SLOT_BITS = 8;
+  static const uint64_t SLOT_MASK = (1 << SLOT_BITS) - 1;
+  static const unsigned LEVELS = 4;
+
+  struct Slot {
+    Slot() : head(nullptr) {}
+    Task* head;
+  };
+
+  typedef std::chrono::time_point<std::chrono::steady_clock> time_point;
+
+  uint64_t toTick(const time_point& abstime, bool roundUp) const;
+  time_point toTime(uint64_t tick) const;
+
+  void link(Task* task, uint64_t earliest);
+  void unlink(Task* task);
+  void cascade(unsigned level);
+  void expire(std::vector<std::shared_ptr<Task> >& expired);
+  uint64_t nextWakeTick() const;
+  void clear();
+
+  std::shared_ptr<const ThreadFactory> threadFactory_;
+  friend class Task;
+  const std::chrono::steady_clock::duration tick_;
+  time_point epoch_;
+  uint64_t currentTick_;
+  uint64_t wakeTick_;
+  std::vector<Slot> slots_;
+  size_t taskCount_;
+  Monitor monitor_;
+  STATE state_;
+  class Dispatcher;
+  friend class Dispatcher;
+  std::shared_ptr<Dispatcher> dispatcher_;
+  std::shared_ptr<Thread> dispatcherThread_;
+};
+}
+}
+} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_TIMINGWHEELTIMERMANAGER_H_
@@ -0,0 +1,643 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/concurrency/Exception.h>
+#include <thrift/concurrency/Monitor.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace concurrency {
+
+using std::shared_ptr;
+
+/**
+ * Work stealing thread manager
+ *
+ * Tasks are spread over a fixed number of shards, each with its own lock and
+ * queue.  A worker drains its home shard first and then steals from the
+ * others, so add() and task dispatch only contend on one shard lock instead
+ * of a single manager-wide mutex.  Tasks added from a worker thread go to that
+ * worker's shard.
+ *
+ * The manager-wide mutex_ is only taken when a worker runs out of work and
+ * goes idle, when an idle worker has to be woken up, and when the worker pool
+ * changes size, so a busy pool runs without touching it.
+ *
+ * Pending task limits, expiration and the expire callback behave exactly as
+ * they do for the default implementation.
+ */
+class WorkStealingThreadManager : public ThreadManager {
+
+public:
+  WorkStealingThreadManager(size_t workerCount, size_t pendingTaskCountMax)
+    : initialWorkerCount_(workerCount),
+      pendingTaskCountMax_(pendingTaskCountMax),
+      shards_(workerCount > 0 ? workerCount : 1),
+      nextShard_(0),
+      nextWorkerShard_(0),
+      nextSequence_(0),
+      workerCount_(0),
+      workerMaxCount_(0),
+      idleCount_(0),
+      pendingCount_(0),
+      expiredCount_(0),
+      blockedAdders_(0),
+      state_(ThreadManager::UNINITIALIZED),
+      monitor_(&mutex_),
+      workerMonitor_(&mutex_),
+      maxMonitor_(&maxMutex_) {
+    for (auto& shard : shards_) {
+      shard.reset(new Shard());
+    }
+  }
+
+  ~WorkStealingThreadManager() override { stop(); }
+
+  void start() override;
+  void stop() override;
+
+  ThreadManager::STATE state() const override { return state_; }
+
+  shared_ptr<ThreadFactory> threadFactory() const override {
+    Guard g(mutex_);
+    return threadFactory_;
+  }
+
+  void threadFactory(shared_ptr<ThreadFactory> value) override {
+    Guard g(mutex_);
+    if (threadFactory_ && threadFactory_->isDetached() != value->isDetached()) {
+      throw InvalidArgumentException();
+    }
+    threadFactory_ = value;
+  }
+
+  void addWorker(size_t value) override;
+
+  void removeWorker(size_t value) override;
+
+  size_t idleWorkerCount() const override { return idleCount_; }
+
+  size_t workerCount() const override { return workerCount_; }
+
+  size_t pendingTaskCount() const override { return pendingCount_; }
+
+  size_t totalTaskCount() const override {
+    Guard g(mutex_);
+    return pendingCount_ + workerCount_ - idleCount_;
+  }
+
+  size_t pendingTaskCountMax() const override { return pendingTaskCountMax_; }
+
+  size_t expiredTaskCount() const override { return expiredCount_; }
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration) override;
+
+  void remove(shared_ptr<Runnable> task) override;
+
+  shared_ptr<Runnable> removeNextPending() override;
+
+  void removeExpiredTasks() override { removeExpired(false); }
+
+  void setExpireCallback(ExpireCallback expireCallback) override;
+
+private:
+  class Worker;
+  friend class Worker;
+
+  typedef std::chrono::steady_clock::time_point time_point;
+
+  /**
+   * A queued task.  Held by value so that add() does not allocate beyond the
+   * queue's own storage; the sequence number keeps removeNextPending() FIFO
+   * across shards.
+   */
+  struct Entry {
+    Entry(shared_ptr<Runnable> r, uint64_t s, int64_t expiration)
+      : runnable(std::move(r)), sequence(s), expires(expiration != 0LL) {
+      if (expires) {
+        expireTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(expiration);
+      }
+    }
+
+    bool expired(const time_point& now) const { return expires && expireTime < now; }
+
+    shared_ptr<Runnable> runnable;
+    uint64_t sequence;
+    bool expires;
+    time_point expireTime;
+  };
+
+  struct Shard {
+    Mutex mutex;
+    std::deque<Entry> tasks;
+  };
+
+  /**
+   * Takes the next task for a worker, starting with its home shard.
+   * \returns false if every shard was empty
+   */
+  bool pop(size_t home, Entry& out);
+
+  /**
+   * Accounts for a task leaving the queues and wakes up a blocked add() if the
+   * pending task limit was reached.
+   */
+  void released(size_t count);
+
+  /**
+   * Reserves room for one more pending task, blocking or throwing according to
+   * the add() contract when pendingTaskCountMax() is reached.
+   */
+  void reserve(int64_t timeout);
+
+  /**
+   * Remove one or more expired tasks.
+   * \param[in]  justOne  if true, try to remove just one task and return
+   */
+  void removeExpired(bool justOne);
+
+  /**
+   * \returns whether it is acceptable to block, depending on the current thread id
+   */
+  bool canSleep() const;
+
+  /**
+   * \returns the shard a task added from the calling thread should go to
+   */
+  size_t shardForAdd() const;
+
+  /**
+   * Checked with mutex_ held.  A worker stays active while the pool is not
+   * being shrunk, or while stop() is draining the remaining tasks.
+   */
+  bool isActive() const {
+    return (workerCount_ <= workerMaxCount_)
+           || (state_ == JOINING && pendingCount_ > 0);
+  }
+
+  /**
+   * Lowers the maximum worker count and blocks until enough worker threads complete
+   * to get to the new maximum worker limit.  The caller is responsible for acquiring
+   * a lock on the class mutex_.
+   */
+  void removeWorkersUnderLock(size_t value);
+
+  const size_t initialWorkerCount_;
+  const size_t pendingTaskCountMax_;
+
+  std::vector<std::unique_ptr<Shard> > shards_;
+  mutable std::atomic<size_t> nextShard_;
+  size_t nextWorkerShard_;
+  std::atomic<uint64_t> nextSequence_;
+
+  std::atomic<size_t> workerCount_;
+  std::atomic<size_t> workerMaxCount_;
+  std::atomic<size_t> idleCount_;
+  std::atomic<size_t> pendingCount_;
+  std::atomic<size_t> expiredCount_;
+  std::atomic<size_t> blockedAdders_;
+  std::atomic<ThreadManager::STATE> state_;
+
+  ExpireCallback expireCallback_;
+  shared_ptr<ThreadFactory> threadFactory_;
+
+  Mutex mutex_;
+  Monitor monitor_;             // idle workers wait here for tasks
+  Monitor workerMonitor_;       // used to synchronize changes in worker count
+  Mutex maxMutex_;
+  Monitor maxMonitor_;          // add() waits here while pendingTaskCountMax() is reached
+
+  std::set<shared_ptr<Thread> > workers_;
+  std::set<shared_ptr<Thread> > deadWorkers_;
+  std::map<const Thread::id_t, shared_ptr<Thread> > idMap_;
+};
+
+namespace {
+// The manager and shard owned by the worker running on this thread, if any.
+thread_local const WorkStealingThreadManager* currentManager = nullptr;
+thread_local size_t currentShard = 0;
+}
+
+class WorkStealingThreadManager::Worker : public Runnable {
+
+public:
+  Worker(WorkStealingThreadManager* manager) : manager_(manager), shard_(0) {}
+
+  ~Worker() override = default;
+
+  /**
+   * Worker entry point
+   *
+   * Runs tasks without holding the manager lock for as long as any shard has
+   * work, and only falls back to waiting on the manager monitor once all of
+   * them are empty.
+   */
+  void run() override {
+    Guard g(manager_->mutex_);
+
+    bool active = manager_->workerCount_ < manager_->workerMaxCount_;
+    if (active) {
+      shard_ = manager_->nextWorkerShard_++ % manager_->shards_.size();
+      currentManager = manager_;
+      currentShard = shard_;
+      if (++manager_->workerCount_ == manager_->workerMaxCount_) {
+        manager_->workerMonitor_.notify();
+      }
+    }
+
+    while (active) {
+      // Holding the manager lock: wait until there is work or we must leave.
+      bool haveTask = false;
+      Entry entry(shared_ptr<Runnable>(), 0, 0LL);
+      manager_->idleCount_++;
+      while ((active = manager_->isActive()) && !(haveTask = manager_->pop(shard_, entry))) {
+        manager_->monitor_.wait();
+      }
+      manager_->idleCount_--;
+
+      if (!haveTask) {
+        break;
+      }
+
+      manager_->mutex_.unlock();
+      do {
+        execute(entry);
+        entry.runnable.reset();
+      } while (!shrinking() && popWithoutLock(entry));
+      manager_->mutex_.lock();
+    }
+
+    currentManager = nullptr;
+
+    /**
+     * Final accounting for the worker thread that is done working
+     */
+    manager_->deadWorkers_.insert(this->thread());
+    if (--manager_->workerCount_ == manager_->workerMaxCount_) {
+      manager_->workerMonitor_.notify();
+    }
+    // Idle workers that wait for the tasks stop() drains, or for the pool
+    // to shrink, have to look at isActive() again.
+    if (manager_->state_ == JOINING || shrinking()) {
+      manager_->monitor_.notifyAll();
+    }
+  }
+
+private:
+  /**
+   * Cheap check, without the manager lock, whether the pool is being shrunk
+   * and this worker should go back and re-evaluate isActive() under the lock.
+   */
+  bool shrinking() const { return manager_->workerCount_ > manager_->workerMaxCount_; }
+
+  /**
+   * Takes the next task without the manager lock.  Idle workers that only
+   * stay for the tasks stop() drains are woken up when this takes the last
+   * one, since they won't find another.
+   */
+  bool popWithoutLock(Entry& entry) {
+    if (!manager_->pop(shard_, entry)) {
+      return false;
+    }
+    if (manager_->pendingCount_ == 0 && manager_->state_ == JOINING) {
+      Guard g(manager_->mutex_);
+      manager_->monitor_.notifyAll();
+    }
+    return true;
+  }
+
+  void execute(Entry& entry) {
+    if (!entry.expired(std::chrono::steady_clock::now())) {
+      try {
+        entry.runnable->run();
+      } catch (const std::exception& e) {
+        GlobalOutput.printf("[ERROR] task->run() raised an exception: %s", e.what());
+      } catch (...) {
+        GlobalOutput.printf("[ERROR] task->run() raised an unknown exception");
+      }
+    } else {
+      ExpireCallback expireCallback;
+      {
+        Guard g(manager_->mutex_);
+        expireCallback = manager_->expireCallback_;
+      }
+      if (expireCallback) {
+        expireCallback(entry.runnable);
+        manager_->expiredCount_++;
+      }
+    }
+  }
+
+  WorkStealingThreadManager* manager_;
+  size_t shard_;
+};
+
+bool WorkStealingThreadManager::pop(size_t home, Entry& out) {
+  const size_t count = shards_.size();
+  for (size_t ix = 0; ix < count; ++ix) {
+    Shard& shard = *shards_[(home + ix) % count];
+    Guard g(shard.mutex);
+    if (!shard.tasks.empty()) {
+      out = std::move(shard.tasks.front());
+      shard.tasks.pop_front();
+      released(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadManager::released(size_t count) {
+  pendingCount_ -= count;
+  if (blockedAdders_ > 0) {
+    Guard g(maxMutex_);
+    maxMonitor_.notifyAll();
+  }
+}
+
+void WorkStealingThreadManager::addWorker(size_t value) {
+  std::set<shared_ptr<Thread> > newThreads;
+  for (size_t ix = 0; ix < value; ix++) {
+    shared_ptr<Worker> worker = std::make_shared<Worker>(this);
+    newThreads.insert(threadFactory_->newThread(worker));
+  }
+
+  Guard g(mutex_);
+  workerMaxCount_ += value;
+  workers_.insert(newThreads.begin(), newThreads.end());
+
+  for (const auto& newThread : newThreads) {
+    newThread->start();
+    idMap_.insert(std::pair<const Thread::id_t, shared_ptr<Thread> >(newThread->getId(), newThread));
+  }
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+}
+
+void WorkStealingThreadManager::start() {
+  {
+    Guard g(mutex_);
+    if (state_ != ThreadManager::UNINITIALIZED) {
+      return;
+    }
+
+    if (!threadFactory_) {
+      throw InvalidArgumentException();
+    }
+    state_ = ThreadManager::STARTED;
+  }
+
+  // like SimpleThreadManager, bring up the initial workers on start
+  addWorker(initialWorkerCount_);
+}
+
+void WorkStealingThreadManager::stop() {
+  Guard g(mutex_);
+  bool doStop = false;
+
+  if (state_ != ThreadManager::STOPPING && state_ != ThreadManager::JOINING
+      && state_ != ThreadManager::STOPPED) {
+    doStop = true;
+    state_ = ThreadManager::JOINING;
+  }
+
+  if (doStop) {
+    removeWorkersUnderLock(workerCount_);
+  }
+
+  state_ = ThreadManager::STOPPED;
+}
+
+void WorkStealingThreadManager::removeWorker(size_t value) {
+  Guard g(mutex_);
+  removeWorkersUnderLock(value);
+}
+
+void WorkStealingThreadManager::removeWorkersUnderLock(size_t value) {
+  if (value > workerMaxCount_) {
+    throw InvalidArgumentException();
+  }
+
+  workerMaxCount_ -= value;
+
+  // Busy workers notice the lower limit through shrinking(); idle ones need
+  // to be woken up to notice it.
+  monitor_.notifyAll();
+
+  while (workerCount_ != workerMaxCount_) {
+    workerMonitor_.wait();
+  }
+
+  for (const auto& deadWorker : deadWorkers_) {
+
+    // when used with a joinable thread factory, we join the threads as we remove them
+    if (!threadFactory_->isDetached()) {
+      deadWorker->join();
+    }
+
+    idMap_.erase(deadWorker->getId());
+    workers_.erase(deadWorker);
+  }
+
+  deadWorkers_.clear();
+}
+
+bool WorkStealingThreadManager::canSleep() const {
+  return currentManager != this;
+}
+
+size_t WorkStealingThreadManager::shardForAdd() const {
+  if (currentManager == this) {
+    return currentShard;
+  }
+  return nextShard_++ % shards_.size();
+}
+
+void WorkStealingThreadManager::reserve(int64_t timeout) {
+  if (pendingTaskCountMax_ == 0) {
+    pendingCount_++;
+    return;
+  }
+
+  // if we're at a limit, remove an expired task to see if the limit clears
+  if (pendingCount_ >= pendingTaskCountMax_) {
+    removeExpired(true);
+  }
+
+  size_t pending = pendingCount_;
+  for (;;) {
+    while (pending < pendingTaskCountMax_) {
+      if (pendingCount_.compare_exchange_weak(pending, pending + 1)) {
+        return;
+      }
+    }
+
+    if (!canSleep() || timeout < 0) {
+      throw TooManyPendingTasksException();
+    }
+
+    Guard g(maxMutex_);
+    blockedAdders_++;
+    try {
+      while (pendingCount_ >= pendingTaskCountMax_) {
+        maxMonitor_.wait(timeout);
+      }
+    } catch (...) {
+      blockedAdders_--;
+      throw;
+    }
+    blockedAdders_--;
+    pending = pendingCount_;
+  }
+}
+
+void WorkStealingThreadManager::add(shared_ptr<Runnable> value,
+                                    int64_t timeout,
+                                    int64_t expiration) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::add ThreadManager "
+        "not started");
+  }
+
+  reserve(timeout);
+
+  {
+    Shard& shard = *shards_[shardForAdd()];
+    Guard g(shard.mutex);
+    shard.tasks.emplace_back(std::move(value), nextSequence_++, expiration);
+  }
+
+  // If a worker is idle, wake one up; otherwise all workers are busy and
+  // will find this task when they next look at the shards.
+  if (idleCount_ > 0) {
+    Guard g(mutex_);
+    monitor_.notify();
+  }
+}
+
+void WorkStealingThreadManager::remove(shared_ptr<Runnable> task) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::remove ThreadManager not "
+        "started");
+  }
+
+  for (auto& shard : shards_) {
+    Guard g(shard->mutex);
+    for (auto it = shard->tasks.begin(); it != shard->tasks.end(); ++it) {
+      if (it->runnable == task) {
+        shard->tasks.erase(it);
+        released(1);
+        return;
+      }
+    }
+  }
+}
+
+shared_ptr<Runnable> WorkStealingThreadManager::removeNextPending() {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException(
+        "WorkStealingThreadManager::removeNextPending "
+        "ThreadManager not started");
+  }
+
+  // Lock every shard so the oldest task can be found and taken atomically.
+  std::vector<std::unique_ptr<Guard> > guards;
+  guards.reserve(shards_.size());
+  Shard* oldest = nullptr;
+  for (auto& shard : shards_) {
+    guards.emplace_back(new Guard(shard->mutex));
+    if (!shard->tasks.empty()
+        && (!oldest || shard->tasks.front().sequence < oldest->tasks.front().sequence)) {
+      oldest = shard.get();
+    }
+  }
+
+  if (!oldest) {
+    return shared_ptr<Runnable>();
+  }
+
+  shared_ptr<Runnable> task = oldest->tasks.front().runnable;
+  oldest->tasks.pop_front();
+  released(1);
+  return task;
+}
+
+void WorkStealingThreadManager::removeExpired(bool justOne) {
+  ExpireCallback expireCallback;
+  {
+    Guard g(mutex_);
+    expireCallback = expireCallback_;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  std::vector<shared_ptr<Runnable> > expired;
+
+  for (auto& shard : shards_) {
+    Guard g(shard->mutex);
+    for (auto it = shard->tasks.begin(); it != shard->tasks.end();) {
+      if (it->expired(now)) {
+        expired.push_back(it->runnable);
+        it = shard->tasks.erase(it);
+        released(1);
+        ++expiredCount_;
+        if (justOne) {
+          break;
+        }
+      } else {
+        ++it;
+      }
+    }
+    if (justOne && !expired.empty()) {
+      break;
+    }
+  }
+
+  if (expireCallback) {
+    for (auto& runnable : expired) {
+      expireCallback(runnable);
+    }
+  }
+}
+
+void WorkStealingThreadManager::setExpireCallback(ExpireCallback expireCallback) {
+  Guard g(mutex_);
+  expireCallback_ = expireCallback;
+}
+
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(size_t count,
+                                                                      size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(new WorkStealingThreadManager(count, pendingTaskCountMax));
+}
+}
+}
+} // apache::thrift::concurrency
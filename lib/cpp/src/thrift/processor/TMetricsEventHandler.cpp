@@ -0,0 +1,402 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <thrift/processor/TMetricsEventHandler.h>
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Mutex;
+
+THistogram::THistogram() : count_(0), sum_(0) {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+THistogram::THistogram(const THistogram& other) : THistogram() {
+  merge(other);
+}
+
+THistogram& THistogram::operator=(const THistogram& other) {
+  if (this != &other) {
+    reset();
+    merge(other);
+  }
+  return *this;
+}
+
+uint32_t THistogram::bucketFor(uint64_t value) {
+  if (value < 2 * HALF_SUB_BUCKETS) {
+    return static_cast<uint32_t>(value);
+  }
+  if (value >> MAX_VALUE_BITS) {
+    return NUM_BUCKETS - 1;
+  }
+  uint32_t msb = 0;
+  while (value >> (msb + 1)) {
+    ++msb;
+  }
+  // the top SUB_BUCKET_BITS bits of the value pick the bucket
+  uint32_t shift = msb - (SUB_BUCKET_BITS - 1);
+  return shift * HALF_SUB_BUCKETS + static_cast<uint32_t>(value >> shift);
+}
+
+uint64_t THistogram::bucketEnd(uint32_t bucket) {
+  if (bucket < 2 * HALF_SUB_BUCKETS) {
+    return bucket;
+  }
+  uint32_t shift = bucket / HALF_SUB_BUCKETS - 1;
+  uint64_t subBucket = bucket % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+  return ((subBucket + 1) << shift) - 1;
+}
+
+void THistogram::record(uint64_t value) {
+  buckets_[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+void THistogram::merge(const THistogram& other) {
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+    uint64_t count = other.buckets_[i].load(std::memory_order_relaxed);
+    if (count != 0) {
+      buckets_[i].fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+  count_.fetch_add(other.getCount(), std::memory_order_relaxed);
+  sum_.fetch_add(other.getSum(), std::memory_order_relaxed);
+}
+
+void THistogram::reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+}
+
+double THistogram::getMean() const {
+  uint64_t count = getCount();
+  return count == 0 ? 0.0 : static_cast<double>(getSum()) / count;
+}
+
+uint64_t THistogram::getPercentile(double percentile) const {
+  // count the buckets rather than use count_, which may be behind them
+  uint64_t total = 0;
+  for (const auto& bucket : buckets_) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+  rank = rank < 1 ? 1 : (rank > total ? total : rank);
+  uint64_t seen = 0;
+  uint32_t last = 0;
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+    uint64_t count = buckets_[i].load(std::memory_order_relaxed);
+    if (count == 0) {
+      continue;
+    }
+    seen += count;
+    last = i;
+    if (seen >= rank) {
+      break;
+    }
+  }
+  return bucketEnd(last);
+}
+
+void TMethodMetrics::merge(const TMethodMetrics& other) {
+  calls += other.calls;
+  errors += other.errors;
+  readTime.merge(other.readTime);
+  handlerTime.merge(other.handlerTime);
+  writeTime.merge(other.writeTime);
+  requestBytes.merge(other.requestBytes);
+  responseBytes.merge(other.responseBytes);
+}
+
+struct TMetricsEventHandler::MethodStats {
+  MethodStats(const std::string& name) : name(name), calls(0), errors(0) {}
+
+  const std::string name;
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> errors;
+  THistogram readTime;
+  THistogram handlerTime;
+  THistogram writeTime;
+  THistogram requestBytes;
+  THistogram responseBytes;
+};
+
+struct TMetricsEventHandler::Context {
+  MethodStats* stats;
+  /// When the current phase of the call started
+  std::chrono::steady_clock::time_point start;
+  bool handled;
+};
+
+struct TMetricsEventHandler::ThreadStats {
+  /// Guards methods, which getMetrics() reads from other threads
+  Mutex mutex;
+  std::map<std::string, std::unique_ptr<MethodStats> > methods;
+
+  /// Only used by the owning thread: the method names we were called with
+  std::unordered_map<const char*, MethodStats*> methodsByName;
+
+  /// Only used by the owning thread: contexts to reuse
+  std::vector<std::unique_ptr<Context> > freeContexts;
+};
+
+namespace {
+
+std::atomic<uint64_t> nextHandlerId(1);
+
+/// Contexts a thread keeps for reuse
+const size_t MAX_FREE_CONTEXTS = 64;
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  return ns < 0 ? 0 : static_cast<uint64_t>(ns);
+}
+
+void exportHistogram(std::ostream& out,
+                     const std::string& method,
+                     const char* measure,
+                     const THistogram& histogram) {
+  out << method << ' ' << measure << " count=" << histogram.getCount()
+      << " mean=" << static_cast<uint64_t>(histogram.getMean() + 0.5)
+      << " p50=" << histogram.getPercentile(50.0) << " p90=" << histogram.getPercentile(90.0)
+      << " p99=" << histogram.getPercentile(99.0) << " p999=" << histogram.getPercentile(99.9)
+      << " max=" << histogram.getMax() << '\n';
+}
+}
+
+TMetricsEventHandler::TMetricsEventHandler() : id_(nextHandlerId++) {
+}
+
+TMetricsEventHandler::~TMetricsEventHandler() = default;
+
+TMetricsEventHandler::ThreadStats* TMetricsEventHandler::getThreadStats() {
+  // The statistics of this thread for every handler it called, by handler
+  // id: ids are never reused, so the entry of a destroyed handler is never
+  // found again.
+  static thread_local std::vector<std::pair<uint64_t, std::shared_ptr<ThreadStats> > > cache;
+
+  for (auto& entry : cache) {
+    if (entry.first == id_) {
+      return entry.second.get();
+    }
+  }
+
+  // drop the entries of destroyed handlers
+  for (size_t i = 0; i < cache.size();) {
+    if (cache[i].second.use_count() == 1) {
+      cache[i] = std::move(cache.back());
+      cache.pop_back();
+    } else {
+      ++i;
+    }
+  }
+
+  auto stats = std::make_shared<ThreadStats>();
+  {
+    Guard g(mutex_);
+    threads_.push_back(stats);
+  }
+  cache.emplace_back(id_, stats);
+  return stats.get();
+}
+
+TMetricsEventHandler::MethodStats* TMetricsEventHandler::getMethodStats(const char* fn_name) {
+  ThreadStats* thread = getThreadStats();
+
+  // fn_name is usually a literal of the generated code, so the pointer
+  // identifies the method; the name is compared in case it is not.
+  auto found = thread->methodsByName.find(fn_name);
+  if (found != thread->methodsByName.end() && found->second->name == fn_name) {
+    return found->second;
+  }
+
+  Guard g(thread->mutex);
+  std::unique_ptr<MethodStats>& stats = thread->methods[fn_name];
+  if (!stats) {
+    stats.reset(new MethodStats(fn_name));
+  }
+  thread->methodsByName[fn_name] = stats.get();
+  return stats.get();
+}
+
+void* TMetricsEventHandler::getContext(const char* fn_name, void* serverContext) {
+  (void)serverContext;
+  ThreadStats* thread = getThreadStats();
+  Context* context;
+  if (thread->freeContexts.empty()) {
+    context = new Context;
+  } else {
+    context = thread->freeContexts.back().release();
+    thread->freeContexts.pop_back();
+  }
+  context->stats = getMethodStats(fn_name);
+  context->start = std::chrono::steady_clock::now();
+  context->handled = false;
+  return context;
+}
+
+void TMetricsEventHandler::freeContext(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  if (ctx == nullptr) {
+    return;
+  }
+  // Contexts go to the free list of the thread that frees them, which is
+  // the one that got them unless the call completed asynchronously.
+  std::unique_ptr<Context> context(static_cast<Context*>(ctx));
+  ThreadStats* thread = getThreadStats();
+  if (thread->freeContexts.size() < MAX_FREE_CONTEXTS) {
+    thread->freeContexts.push_back(std::move(context));
+  }
+}
+
+void TMetricsEventHandler::preRead(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  context->start = std::chrono::steady_clock::now();
+}
+
+void TMetricsEventHandler::postRead(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  auto now = std::chrono::steady_clock::now();
+  MethodStats* stats = context->stats;
+  stats->calls.fetch_add(1, std::memory_order_relaxed);
+  stats->readTime.record(elapsedNs(context->start, now));
+  stats->requestBytes.record(bytes);
+  context->start = now;
+}
+
+void TMetricsEventHandler::preWrite(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  auto now = std::chrono::steady_clock::now();
+  if (!context->handled) {
+    context->stats->handlerTime.record(elapsedNs(context->start, now));
+    context->handled = true;
+  }
+  context->start = now;
+}
+
+void TMetricsEventHandler::postWrite(void* ctx, const char* fn_name, uint32_t bytes) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  auto now = std::chrono::steady_clock::now();
+  context->stats->writeTime.record(elapsedNs(context->start, now));
+  context->stats->responseBytes.record(bytes);
+}
+
+void TMetricsEventHandler::asyncComplete(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  if (!context->handled) {
+    context->stats->handlerTime.record(elapsedNs(context->start, std::chrono::steady_clock::now()));
+    context->handled = true;
+  }
+}
+
+void TMetricsEventHandler::handlerError(void* ctx, const char* fn_name) {
+  (void)fn_name;
+  auto* context = static_cast<Context*>(ctx);
+  context->stats->errors.fetch_add(1, std::memory_order_relaxed);
+  asyncComplete(ctx, fn_name);
+}
+
+std::map<std::string, TMethodMetrics> TMetricsEventHandler::getMetrics() const {
+  std::vector<std::shared_ptr<ThreadStats> > threads;
+  {
+    Guard g(mutex_);
+    threads = threads_;
+  }
+
+  std::map<std::string, TMethodMetrics> metrics;
+  for (const auto& thread : threads) {
+    Guard g(thread->mutex);
+    for (const auto& method : thread->methods) {
+      const MethodStats& stats = *method.second;
+      TMethodMetrics& result = metrics[method.first];
+      result.calls += stats.calls.load(std::memory_order_relaxed);
+      result.errors += stats.errors.load(std::memory_order_relaxed);
+      result.readTime.merge(stats.readTime);
+      result.handlerTime.merge(stats.handlerTime);
+      result.writeTime.merge(stats.writeTime);
+      result.requestBytes.merge(stats.requestBytes);
+      result.responseBytes.merge(stats.responseBytes);
+    }
+  }
+  return metrics;
+}
+
+void TMetricsEventHandler::reset() {
+  Guard g(mutex_);
+  for (const auto& thread : threads_) {
+    Guard tg(thread->mutex);
+    for (const auto& method : thread->methods) {
+      MethodStats& stats = *method.second;
+      stats.calls.store(0, std::memory_order_relaxed);
+      stats.errors.store(0, std::memory_order_relaxed);
+      stats.readTime.reset();
+      stats.handlerTime.reset();
+      stats.writeTime.reset();
+      stats.requestBytes.reset();
+      stats.responseBytes.reset();
+    }
+  }
+}
+
+std::string TMetricsEventHandler::exportText() const {
+  std::ostringstream out;
+  exportText(out);
+  return out.str();
+}
+
+void TMetricsEventHandler::exportText(std::ostream& out) const {
+  for (const auto& method : getMetrics()) {
+    const TMethodMetrics& metrics = method.second;
+    out << method.first << " calls=" << metrics.calls << " errors=" << metrics.errors << '\n';
+    exportHistogram(out, method.first, "read_ns", metrics.readTime);
+    exportHistogram(out, method.first, "handler_ns", metrics.handlerTime);
+    exportHistogram(out, method.first, "write_ns", metrics.writeTime);
+    exportHistogram(out, method.first, "request_bytes", metrics.requestBytes);
+    exportHistogram(out, method.first, "response_bytes", metrics.responseBytes);
+  }
+}
+}
+}
+} // apache::thrift::processor
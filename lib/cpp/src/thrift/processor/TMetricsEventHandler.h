@@ -0,0 +1,183 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_
+#define _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_ 1
+
+#include <thrift/TProcessor.h>
+#include <thrift/concurrency/Mutex.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace processor {
+
+/**
+ * A histogram of non-negative integers in buckets that are linear within
+ * each power of two, so that the value reported for a percentile is at
+ * most 1/32 (about 3%) above the true value, over the whole range.
+ * Values from 2^40 on are counted in the last bucket.
+ *
+ * Recording is lock-free and may happen from several threads at once.
+ */
+class THistogram {
+public:
+  THistogram();
+  THistogram(const THistogram& other);
+  THistogram& operator=(const THistogram& other);
+
+  /// Count a value.
+  void record(uint64_t value);
+
+  /// Add the counts of another histogram to this one.
+  void merge(const THistogram& other);
+
+  void reset();
+
+  uint64_t getCount() const { return count_.load(std::memory_order_relaxed); }
+
+  uint64_t getSum() const { return sum_.load(std::memory_order_relaxed); }
+
+  double getMean() const;
+
+  /**
+   * Return the value below or at which percentile percent of the values
+   * are, rounded up to the end of its bucket; 0 if nothing was recorded.
+   *
+   * @param percentile between 0 and 100.
+   */
+  uint64_t getPercentile(double percentile) const;
+
+  /// Return the largest value recorded, rounded up to the end of its bucket.
+  uint64_t getMax() const { return getPercentile(100.0); }
+
+private:
+  /// Values below 2^SUB_BUCKET_BITS are counted exactly
+  static const uint32_t SUB_BUCKET_BITS = 6;
+  static const uint32_t HALF_SUB_BUCKETS = 1 << (SUB_BUCKET_BITS - 1);
+  static const uint32_t MAX_VALUE_BITS = 40;
+  static const uint32_t NUM_BUCKETS
+      = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS;
+
+  static uint32_t bucketFor(uint64_t value);
+  static uint64_t bucketEnd(uint32_t bucket);
+
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+};
+
+/**
+ * What TMetricsEventHandler measured for a method.  Times are in
+ * nanoseconds.
+ */
+struct TMethodMetrics {
+  TMethodMetrics() : calls(0), errors(0) {}
+
+  /// Calls whose arguments were read
+  uint64_t calls;
+  /// Calls whose handler threw an undeclared exception
+  uint64_t errors;
+
+  /// From preRead() to postRead()
+  THistogram readTime;
+  /// From postRead() to preWrite(), or to asyncComplete() for oneway calls
+  THistogram handlerTime;
+  /// From preWrite() to postWrite()
+  THistogram writeTime;
+  THistogram requestBytes;
+  THistogram responseBytes;
+
+  void merge(const TMethodMetrics& other);
+};
+
+/**
+ * A processor event handler that keeps latency and size histograms for
+ * every method.  Every thread records into histograms of its own without
+ * locking; getMetrics() adds them up.
+ *
+ *   auto metrics = std::make_shared<TMetricsEventHandler>();
+ *   processor->setEventHandler(metrics);
+ *   ...
+ *   std::cout << metrics->exportText();
+ */
+class TMetricsEventHandler : public apache::thrift::TProcessorEventHandler {
+public:
+  TMetricsEventHandler();
+  ~TMetricsEventHandler() override;
+
+  void* getContext(const char* fn_name, void* serverContext) override;
+  void freeContext(void* ctx, const char* fn_name) override;
+  void preRead(void* ctx, const char* fn_name) override;
+  void postRead(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void preWrite(void* ctx, const char* fn_name) override;
+  void postWrite(void* ctx, const char* fn_name, uint32_t bytes) override;
+  void asyncComplete(void* ctx, const char* fn_name) override;
+  void handlerError(void* ctx, const char* fn_name) override;
+
+  /// Return the metrics of every method called so far, by method name.
+  std::map<std::string, TMethodMetrics> getMetrics() const;
+
+  /// Forget everything measured so far.
+  void reset();
+
+  /**
+   * Return the metrics as text, with a line for each method and measure:
+   *
+   *   Calculator.add calls=10 errors=0
+   *   Calculator.add read_ns count=10 mean=1480 p50=1376 p90=2048 p99=3968 p999=3968 max=3968
+   *   ...
+   */
+  std::string exportText() const;
+
+  /// Write the metrics as text, see exportText().
+  void exportText(std::ostream& out) const;
+
+private:
+  struct MethodStats;
+  struct ThreadStats;
+  struct Context;
+
+  /// The statistics of a method for the calling thread
+  MethodStats* getMethodStats(const char* fn_name);
+
+  /// The statistics of the calling thread, created on its first call
+  ThreadStats* getThreadStats();
+
+  /// Identifies this handler in the threads' caches of their statistics
+  const uint64_t id_;
+
+  /// Guards threads_
+  mutable apache::thrift::concurrency::Mutex mutex_;
+
+  /// The statistics of every thread that called this handler
+  std::vector<std::shared_ptr<ThreadStats> > threads_;
+};
+}
+}
+} // apache::thrift::processor
+
+#endif // #ifndef _THRIFT_PROCESSOR_TMETRICSEVENTHANDLER_H_
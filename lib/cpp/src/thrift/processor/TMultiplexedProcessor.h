@@ -23,7 +23,10 @@
 #include <thrift/protocol/TProtocolDecorator.h>
 #include <thrift/TApplicationException.h>
 #include <thrift/TProcessor.h>
-#include <boost/tokenizer.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
 
 namespace apache {
 namespace thrift {
@@ -51,6 +54,18 @@ public:
     return 0; // (Normal TProtocol read functions return number of bytes read)
   }
 
+  /**
+   * Make this return another message, or nothing when _protocol is empty.
+   * TMultiplexedProcessor reuses its StoredMessageProtocols this way.
+   */
+  void setMessage(std::shared_ptr<protocol::TProtocol> _protocol,
+                  const TMessageType _type,
+                  const int32_t _seqid) {
+    setProtocol(_protocol);
+    type = _type;
+    seqid = _seqid;
+  }
+
   std::string name;
   TMessageType type;
   int32_t seqid;
@@ -100,6 +115,7 @@ public:
     */
   void registerProcessor(const std::string& serviceName, std::shared_ptr<TProcessor> processor) {
     services[serviceName] = processor;
+    indexServices();
   }
 
   /**
@@ -150,7 +166,11 @@ public:
   bool process(std::shared_ptr<protocol::TProtocol> in,
                std::shared_ptr<protocol::TProtocol> out,
                void* connectionContext) override {
-    std::string name;
+    // The protocol the processor gets, which also holds the name while we
+    // look at it, so that it is read into a string that is reused.
+    std::shared_ptr<protocol::StoredMessageProtocol> stored = getStoredMessageProtocol(in);
+    StoredMessageGuard guard(stored);
+    std::string& name = stored->name;
     protocol::TMessageType type;
     int32_t seqid;
 
@@ -163,50 +183,35 @@ public:
       // Unexpected message type.
       throw protocol_error(in, out, name, seqid, "Unexpected message type");
     }
+    stored->setMessage(in, type, seqid);
 
-    // Extract the service name
-    boost::tokenizer<boost::char_separator<char> > tok(name, boost::char_separator<char>(":"));
-
-    std::vector<std::string> tokens;
-    std::copy(tok.begin(), tok.end(), std::back_inserter(tokens));
-
-    // A valid message should consist of two tokens: the service
-    // name and the name of the method to call.
-    if (tokens.size() == 2) {
+    // A multiplexed message name consists of the service name and the name
+    // of the method to call, separated by the first ':'.
+    std::string::size_type separator = name.find(':');
+    if (separator != std::string::npos) {
       // Search for a processor associated with this service name.
-      auto it = services.find(tokens[0]);
+      const std::shared_ptr<TProcessor>* processor = findService(name.data(), separator);
 
-      if (it != services.end()) {
-        std::shared_ptr<TProcessor> processor = it->second;
+      if (processor) {
+        name.erase(0, separator + 1);
         // Let the processor registered for this service name
         // process the message.
-        return processor
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[1], type, seqid)),
-                      out,
-                      connectionContext);
+        return (*processor)->process(stored, out, connectionContext);
       } else {
         // Unknown service.
-        throw protocol_error(in, out, name, seqid, 
-            "Unknown service: " + tokens[0] +
+        throw protocol_error(in, out, name, seqid,
+            "Unknown service: " + name.substr(0, separator) +
 				". Did you forget to call registerProcessor()?");
       }
-    } else if (tokens.size() == 1) {
+    } else {
 	  if (defaultProcessor) {
         // non-multiplexed client forwards to default processor
-        return defaultProcessor            
-            ->process(std::shared_ptr<protocol::TProtocol>(
-                          new protocol::StoredMessageProtocol(in, tokens[0], type, seqid)),
-                      out,
-                      connectionContext);
+        return defaultProcessor->process(stored, out, connectionContext);
 	  } else {
 		throw protocol_error(in, out, name, seqid,
 			"Non-multiplexed client request dropped. "
 			"Did you forget to call defaultProcessor()?");
 	  }
-    } else {
-		throw protocol_error(in, out, name, seqid,
-		    "Wrong number of tokens.");
     }
   }
 
@@ -217,6 +222,97 @@ private:
   //! If a non-multi client requests something, it goes to the
   //! default processor (if one is defined) for backwards compatibility.
   std::shared_ptr<TProcessor> defaultProcessor;
+
+  /** An entry of serviceIndex; an empty one has no name. */
+  struct ServiceSlot {
+    ServiceSlot() : hash(0), name(nullptr), processor(nullptr) {}
+
+    size_t hash;
+    const std::string* name;
+    const std::shared_ptr<TProcessor>* processor;
+  };
+
+  /**
+   * An open addressing hash table of the services, so that a service can be
+   * found without copying its name out of the message.  Its size is a power
+   * of two, and at least twice the number of services.
+   */
+  std::vector<ServiceSlot> serviceIndex;
+
+  static size_t hashServiceName(const char* name, size_t len) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+      hash = (hash ^ static_cast<uint8_t>(name[i])) * 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+  }
+
+  void indexServices() {
+    size_t size = 8;
+    while (size < 2 * services.size()) {
+      size *= 2;
+    }
+    std::vector<ServiceSlot> index(size);
+    for (const auto& service : services) {
+      size_t hash = hashServiceName(service.first.data(), service.first.size());
+      size_t i = hash & (size - 1);
+      while (index[i].name) {
+        i = (i + 1) & (size - 1);
+      }
+      index[i].hash = hash;
+      index[i].name = &service.first;
+      index[i].processor = &service.second;
+    }
+    serviceIndex.swap(index);
+  }
+
+  const std::shared_ptr<TProcessor>* findService(const char* name, size_t len) const {
+    if (serviceIndex.empty()) {
+      return nullptr;
+    }
+    size_t mask = serviceIndex.size() - 1;
+    size_t hash = hashServiceName(name, len);
+    for (size_t i = hash & mask; serviceIndex[i].name; i = (i + 1) & mask) {
+      const ServiceSlot& slot = serviceIndex[i];
+      if (slot.hash == hash && slot.name->compare(0, std::string::npos, name, len) == 0) {
+        return slot.processor;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * Return the StoredMessageProtocol of the calling thread, which process()
+   * reuses unless a processor kept a reference to it.
+   */
+  static std::shared_ptr<protocol::StoredMessageProtocol> getStoredMessageProtocol(
+      const std::shared_ptr<protocol::TProtocol>& in) {
+    static thread_local std::shared_ptr<protocol::StoredMessageProtocol> stored;
+    if (!stored || stored.use_count() > 1) {
+      stored = std::make_shared<protocol::StoredMessageProtocol>(in, "", protocol::T_CALL, 0);
+    }
+    return stored;
+  }
+
+  /**
+   * Lets go of the protocol a StoredMessageProtocol decorates, unless a
+   * processor kept a reference to it and may still use it.
+   */
+  class StoredMessageGuard {
+  public:
+    StoredMessageGuard(const std::shared_ptr<protocol::StoredMessageProtocol>& stored)
+      : stored_(stored) {}
+    ~StoredMessageGuard() {
+      // held by the calling thread and by process() only
+      if (stored_.use_count() <= 2) {
+        stored_->setMessage(std::shared_ptr<protocol::TProtocol>(), protocol::T_CALL, 0);
+      }
+    }
+
+  private:
+    const std::shared_ptr<protocol::StoredMessageProtocol>& stored_;
+  };
 };
 }
 }
@@ -119,6 +119,20 @@ public:
 
   inline uint32_t writeBinary(const std::string& str);
 
+  inline uint32_t writeStringView(const TStringView& str);
+
+  inline uint32_t writeBinaryView(const TStringView& str);
+
+  inline uint32_t writeArenaString(const TArenaString& str);
+
+  inline uint32_t writeArenaBinary(const TArenaString& str);
+
+  inline uint32_t writeI32Array(const int32_t* values, uint32_t count);
+
+  inline uint32_t writeI64Array(const int64_t* values, uint32_t count);
+
+  inline uint32_t writeDoubleArray(const double* values, uint32_t count);
+
   /**
    * Reading functions
    */
@@ -166,6 +180,27 @@ public:
 
   inline uint32_t readBinary(std::string& str);
 
+  inline uint32_t readStringView(TStringView& str);
+
+  inline uint32_t readBinaryView(TStringView& str);
+
+  inline uint32_t readArenaString(TArenaString& str);
+
+  inline uint32_t readArenaBinary(TArenaString& str);
+
+  inline uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  inline uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  inline uint32_t readDoubleArray(double* values, uint32_t count);
+
+  /**
+   * Skip a value without decoding it.  Fixed width values, containers of
+   * them and the bodies of strings are consumed from the transport as a
+   * whole.
+   */
+  uint32_t skip(TType type);
+
   int getMinSerializedSize(TType type);
 
   void checkReadBytesAvailable(TSet& set)
@@ -188,6 +223,19 @@ protected:
   template <typename StrType>
   uint32_t readStringBody(StrType& str, int32_t sz);
 
+  /// Number of array elements converted to wire format per write
+  static const uint32_t ARRAY_CHUNK_SIZE = 256;
+
+  /// Size of a value on the wire, or 0 if it varies
+  static uint32_t fixedSize(TType type);
+
+  static uint32_t arraySize(uint32_t count, uint32_t elementSize) {
+    if (count > (std::numeric_limits<uint32_t>::max)() / elementSize) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    return count * elementSize;
+  }
+
   Transport_* trans_;
 
   int32_t string_limit_;
@@ -23,6 +23,8 @@
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 namespace apache {
@@ -175,6 +177,58 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeDouble(const double dub)
   return 8;
 }
 
+template <class Transport_, class ByteOrder_>
+const uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::ARRAY_CHUNK_SIZE;
+
+/**
+ * The array functions convert whole lists between host and wire byte order
+ * in simple loops over contiguous memory that the compiler can vectorize.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI32Array(const int32_t* values,
+                                                                 uint32_t count) {
+  uint32_t size = arraySize(count, 4);
+  uint32_t chunk[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < count; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = (std::min)(count - i, ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      chunk[j] = ByteOrder_::toWire32(static_cast<uint32_t>(values[i + j]));
+    }
+    this->trans_->write(reinterpret_cast<uint8_t*>(chunk), n * 4);
+  }
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeI64Array(const int64_t* values,
+                                                                 uint32_t count) {
+  uint32_t size = arraySize(count, 8);
+  uint64_t chunk[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < count; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = (std::min)(count - i, ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      chunk[j] = ByteOrder_::toWire64(static_cast<uint64_t>(values[i + j]));
+    }
+    this->trans_->write(reinterpret_cast<uint8_t*>(chunk), n * 8);
+  }
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeDoubleArray(const double* values,
+                                                                    uint32_t count) {
+  uint32_t size = arraySize(count, 8);
+  uint64_t chunk[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < count; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = (std::min)(count - i, ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      chunk[j] = ByteOrder_::toWire64(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    this->trans_->write(reinterpret_cast<uint8_t*>(chunk), n * 8);
+  }
+  return size;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeString(const StrType& str) {
@@ -193,6 +247,26 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinary(const std::string
   return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeStringView(const TStringView& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeBinaryView(const TStringView& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeArenaString(const TArenaString& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::writeArenaBinary(const TArenaString& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::writeString(str);
+}
+
 /**
  * Reading functions
  */
@@ -414,6 +488,91 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readDouble(double& dub) {
   return 8;
 }
 
+/**
+ * If the transport has the whole array buffered, the values are converted
+ * straight out of its buffer, otherwise they are read first and converted in
+ * place.
+ */
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI32Array(int32_t* values, uint32_t count) {
+  uint32_t size = arraySize(count, 4);
+  if (size == 0) {
+    return 0;
+  }
+
+  uint32_t len = size;
+  const uint8_t* borrowed = this->trans_->borrow(nullptr, &len);
+  if (borrowed != nullptr) {
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t bits;
+      std::memcpy(&bits, borrowed + i * 4, 4);
+      values[i] = static_cast<int32_t>(ByteOrder_::fromWire32(bits));
+    }
+    this->trans_->consume(size);
+    return size;
+  }
+
+  this->trans_->readAll(reinterpret_cast<uint8_t*>(values), size);
+  auto* words = reinterpret_cast<uint32_t*>(values);
+  for (uint32_t i = 0; i < count; ++i) {
+    words[i] = ByteOrder_::fromWire32(words[i]);
+  }
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readI64Array(int64_t* values, uint32_t count) {
+  uint32_t size = arraySize(count, 8);
+  if (size == 0) {
+    return 0;
+  }
+
+  uint32_t len = size;
+  const uint8_t* borrowed = this->trans_->borrow(nullptr, &len);
+  if (borrowed != nullptr) {
+    for (uint32_t i = 0; i < count; ++i) {
+      uint64_t bits;
+      std::memcpy(&bits, borrowed + i * 8, 8);
+      values[i] = static_cast<int64_t>(ByteOrder_::fromWire64(bits));
+    }
+    this->trans_->consume(size);
+    return size;
+  }
+
+  this->trans_->readAll(reinterpret_cast<uint8_t*>(values), size);
+  auto* words = reinterpret_cast<uint64_t*>(values);
+  for (uint32_t i = 0; i < count; ++i) {
+    words[i] = ByteOrder_::fromWire64(words[i]);
+  }
+  return size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readDoubleArray(double* values, uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+
+  uint32_t size = arraySize(count, 8);
+  if (size == 0) {
+    return 0;
+  }
+
+  uint32_t len = size;
+  const uint8_t* borrowed = this->trans_->borrow(nullptr, &len);
+  if (borrowed == nullptr) {
+    this->trans_->readAll(reinterpret_cast<uint8_t*>(values), size);
+    borrowed = reinterpret_cast<const uint8_t*>(values);
+  } else {
+    this->trans_->consume(size);
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t bits;
+    std::memcpy(&bits, borrowed + i * 8, 8);
+    values[i] = bitwise_cast<double>(ByteOrder_::fromWire64(bits));
+  }
+  return size;
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readString(StrType& str) {
@@ -428,6 +587,55 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinary(std::string& str)
   return TBinaryProtocolT<Transport_, ByteOrder_>::readString(str);
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(TStringView& str) {
+  uint32_t result;
+  int32_t size;
+  result = readI32(size);
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (this->string_limit_ > 0 && size > this->string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Catch empty string case
+  if (size == 0) {
+    str.clear();
+    return result;
+  }
+
+  // Refer to the transport's buffer if it can be shared
+  std::shared_ptr<const uint8_t> borrowed = this->trans_->borrowShared(size);
+  if (borrowed) {
+    str = TStringView(borrowed, borrowed.get(), size);
+    this->trans_->consume(size);
+    return result + size;
+  }
+
+  std::shared_ptr<uint8_t> copy(new uint8_t[size], std::default_delete<uint8_t[]>());
+  this->trans_->readAll(copy.get(), size);
+  str = TStringView(copy, copy.get(), size);
+  return result + size;
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readBinaryView(TStringView& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readStringView(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readArenaString(TArenaString& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readString(str);
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readArenaBinary(TArenaString& str) {
+  return TBinaryProtocolT<Transport_, ByteOrder_>::readString(str);
+}
+
 template <class Transport_, class ByteOrder_>
 template <typename StrType>
 uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str, int32_t size) {
@@ -461,6 +669,100 @@ uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::readStringBody(StrType& str,
   return (uint32_t)size;
 }
 
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::fixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_I16:
+    return 2;
+  case T_I32:
+    return 4;
+  case T_I64:
+  case T_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_, class ByteOrder_>
+uint32_t TBinaryProtocolT<Transport_, ByteOrder_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+
+  uint32_t size = fixedSize(type);
+  if (size > 0) {
+    skipBytes(*this->trans_, size);
+    return size;
+  }
+
+  uint32_t result = 0;
+  switch (type) {
+  case T_STRING: {
+    int32_t len;
+    result += readI32(len);
+    if (len < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (this->string_limit_ > 0 && len > this->string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    this->trans_->checkReadBytesAvailable(len);
+    skipBytes(*this->trans_, static_cast<uint32_t>(len));
+    return result + len;
+  }
+  case T_STRUCT: {
+    while (true) {
+      int8_t fieldType;
+      result += readByte(fieldType);
+      if (fieldType == T_STOP) {
+        return result;
+      }
+      // the field id
+      skipBytes(*this->trans_, 2);
+      result += 2 + skip(static_cast<TType>(fieldType));
+    }
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    result += readMapBegin(keyType, valType, size);
+    uint32_t keySize = fixedSize(keyType);
+    uint32_t valSize = fixedSize(valType);
+    if (keySize > 0 && valSize > 0) {
+      uint32_t len = arraySize(size, keySize + valSize);
+      skipBytes(*this->trans_, len);
+      return result + len;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      result += skip(keyType);
+      result += skip(valType);
+    }
+    return result;
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    result += readListBegin(elemType, size);
+    uint32_t elemSize = fixedSize(elemType);
+    if (elemSize > 0) {
+      uint32_t len = arraySize(size, elemSize);
+      skipBytes(*this->trans_, len);
+      return result + len;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      result += skip(elemType);
+    }
+    return result;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
 // Return the minimum number of bytes a type will consume on the wire
 template <class Transport_, class ByteOrder_>
 int TBinaryProtocolT<Transport_, ByteOrder_>::getMinSerializedSize(TType type)
@@ -140,6 +140,20 @@ public:
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeStringView(const TStringView& str);
+
+  uint32_t writeBinaryView(const TStringView& str);
+
+  uint32_t writeArenaString(const TArenaString& str);
+
+  uint32_t writeArenaBinary(const TArenaString& str);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count);
+
   int getMinSerializedSize(TType type);
 
   void checkReadBytesAvailable(TSet& set)
@@ -174,8 +188,11 @@ protected:
                                   const int16_t fieldId,
                                   int8_t typeOverride);
   uint32_t writeCollectionBegin(const TType elemType, int32_t size);
+  uint32_t writeBinaryData(const char* data, size_t size);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
+  template <typename Int_>
+  uint32_t writeVarintArray(const Int_* values, uint32_t count);
   uint64_t i64ToZigzag(const int64_t l);
   uint32_t i32ToZigzag(const int32_t n);
   inline int8_t getCompactType(const TType ttype);
@@ -213,6 +230,27 @@ public:
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readStringView(TStringView& str);
+
+  uint32_t readBinaryView(TStringView& str);
+
+  uint32_t readArenaString(TArenaString& str);
+
+  uint32_t readArenaBinary(TArenaString& str);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
+  /**
+   * Skip a value without decoding it.  Runs of varints are skipped by
+   * looking for their last bytes, and doubles, bytes and the bodies of
+   * strings are consumed from the transport as a whole.
+   */
+  uint32_t skip(TType type);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -226,9 +264,18 @@ public:
 protected:
   uint32_t readVarint32(int32_t& i32);
   uint32_t readVarint64(int64_t& i64);
+  template <typename Int_>
+  uint32_t readVarintArray(Int_* values, uint32_t count);
+  uint32_t skipVarints(uint32_t count);
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
+  /// Size of a container element on the wire, or 0 if it varies
+  static uint32_t fixedSize(TType type);
+  static bool isVarint(TType type) { return type == T_I16 || type == T_I32 || type == T_I64; }
+
+  /// Number of array elements encoded per write
+  static const uint32_t ARRAY_CHUNK_SIZE = 256;
 
   // Buffer for reading strings, save for the lifetime of the protocol to
   // avoid memory churn allocating memory on every string read
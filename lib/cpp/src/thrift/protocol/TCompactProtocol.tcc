@@ -19,8 +19,10 @@
 #ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
 
+#include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <cstring>
 
 #include "thrift/config.h"
 
@@ -273,16 +275,41 @@ uint32_t TCompactProtocolT<Transport_>::writeString(const std::string& str) {
 
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
-  if(str.size() > (std::numeric_limits<uint32_t>::max)())
+  return writeBinaryData(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeStringView(const TStringView& str) {
+  return writeBinaryData(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryView(const TStringView& str) {
+  return writeBinaryData(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeArenaString(const TArenaString& str) {
+  return writeBinaryData(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeArenaBinary(const TArenaString& str) {
+  return writeBinaryData(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinaryData(const char* data, size_t size) {
+  if(size > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  auto ssize = static_cast<uint32_t>(str.size());
+  auto ssize = static_cast<uint32_t>(size);
   uint32_t wsize = writeVarint32(ssize) ;
   // checking ssize + wsize > uint_max, but we don't want to overflow while checking for overflows.
   // transforming the check to ssize > uint_max - wsize
   if(ssize > (std::numeric_limits<uint32_t>::max)() - wsize)
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   wsize += ssize;
-  trans_->write((uint8_t*)str.data(), ssize);
+  trans_->write((uint8_t*)data, ssize);
   return wsize;
 }
 
@@ -382,6 +409,68 @@ uint32_t TCompactProtocolT<Transport_>::writeVarint64(uint64_t n) {
   return wsize;
 }
 
+template <class Transport_>
+const uint32_t TCompactProtocolT<Transport_>::ARRAY_CHUNK_SIZE;
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32Array(const int32_t* values, uint32_t count) {
+  return writeVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64Array(const int64_t* values, uint32_t count) {
+  return writeVarintArray(values, count);
+}
+
+/**
+ * Write a list of doubles as 8 bytes each, converted in chunks.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeDoubleArray(const double* values, uint32_t count) {
+  if (count > (std::numeric_limits<uint32_t>::max)() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  uint64_t chunk[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < count; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = (std::min)(count - i, ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      chunk[j] = THRIFT_htolell(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    trans_->write(reinterpret_cast<uint8_t*>(chunk), n * 8);
+  }
+  return count * 8;
+}
+
+/**
+ * Write a list of integers as zigzag varints.  The varints are encoded into
+ * a local buffer, so the transport is called once per chunk rather than once
+ * per element.
+ */
+template <class Transport_>
+template <typename Int_>
+uint32_t TCompactProtocolT<Transport_>::writeVarintArray(const Int_* values, uint32_t count) {
+  uint8_t buf[10 * ARRAY_CHUNK_SIZE];
+  uint32_t wsize = 0;
+
+  for (uint32_t i = 0; i < count; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = (std::min)(count - i, ARRAY_CHUNK_SIZE);
+    uint32_t pos = 0;
+    for (uint32_t j = 0; j < n; ++j) {
+      uint64_t v = sizeof(Int_) == 4 ? i32ToZigzag(static_cast<int32_t>(values[i + j]))
+                                     : i64ToZigzag(static_cast<int64_t>(values[i + j]));
+      while ((v & ~0x7FULL) != 0) {
+        buf[pos++] = static_cast<uint8_t>((v & 0x7F) | 0x80);
+        v >>= 7;
+      }
+      buf[pos++] = static_cast<uint8_t>(v);
+    }
+    trans_->write(buf, pos);
+    wsize += pos;
+  }
+  return wsize;
+}
+
 /**
  * Convert l into a zigzag long. This allows negative numbers to be
  * represented compactly as a varint.
@@ -673,6 +762,289 @@ uint32_t TCompactProtocolT<Transport_>::readDouble(double& dub) {
   return 8;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32Array(int32_t* values, uint32_t count) {
+  return readVarintArray(values, count);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64Array(int64_t* values, uint32_t count) {
+  return readVarintArray(values, count);
+}
+
+/**
+ * Read a list of doubles, straight out of the transport buffer if the whole
+ * list is available there.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readDoubleArray(double* values, uint32_t count) {
+  static_assert(sizeof(double) == sizeof(uint64_t), "sizeof(double) == sizeof(uint64_t)");
+  static_assert(std::numeric_limits<double>::is_iec559, "std::numeric_limits<double>::is_iec559");
+
+  if (count > (std::numeric_limits<uint32_t>::max)() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  uint32_t size = count * 8;
+  if (size == 0) {
+    return 0;
+  }
+
+  uint32_t len = size;
+  const uint8_t* borrowed = trans_->borrow(nullptr, &len);
+  if (borrowed == nullptr) {
+    trans_->readAll(reinterpret_cast<uint8_t*>(values), size);
+    borrowed = reinterpret_cast<const uint8_t*>(values);
+  } else {
+    trans_->consume(size);
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t bits;
+    std::memcpy(&bits, borrowed + i * 8, 8);
+    values[i] = bitwise_cast<double>(THRIFT_letohll(bits));
+  }
+  return size;
+}
+
+/**
+ * Read a list of zigzag varints.  Varints are decoded straight out of the
+ * transport buffer; eight bytes without a continuation bit between them are
+ * eight one-byte varints and are decoded together.  A varint that is split
+ * across the end of the buffer is read with readVarint64().
+ */
+template <class Transport_>
+template <typename Int_>
+uint32_t TCompactProtocolT<Transport_>::readVarintArray(Int_* values, uint32_t count) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    uint32_t avail = 1;
+    const uint8_t* borrowed = trans_->borrow(nullptr, &avail);
+    uint32_t pos = 0;
+
+    if (borrowed != nullptr) {
+      while (i < count) {
+        if (count - i >= 8 && avail - pos >= 8) {
+          uint64_t word;
+          std::memcpy(&word, borrowed + pos, 8);
+          if ((word & 0x8080808080808080ULL) == 0) {
+            for (uint32_t j = 0; j < 8; ++j) {
+              uint64_t v = borrowed[pos + j];
+              values[i + j] = sizeof(Int_) == 4 ? zigzagToI32(static_cast<uint32_t>(v))
+                                                : zigzagToI64(v);
+            }
+            i += 8;
+            pos += 8;
+            continue;
+          }
+        }
+
+        uint64_t val = 0;
+        int shift = 0;
+        uint32_t end = pos;
+        bool complete = false;
+        while (end < avail) {
+          uint8_t byte = borrowed[end++];
+          val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+          shift += 7;
+          if (!(byte & 0x80)) {
+            complete = true;
+            break;
+          }
+          // Have to check for invalid data so we don't crash.
+          if (UNLIKELY(end - pos == 10)) {
+            throw TProtocolException(TProtocolException::INVALID_DATA,
+                                     "Variable-length int over 10 bytes.");
+          }
+        }
+        if (!complete) {
+          break;
+        }
+        values[i++] = sizeof(Int_) == 4 ? zigzagToI32(static_cast<uint32_t>(val))
+                                        : zigzagToI64(val);
+        pos = end;
+      }
+
+      trans_->consume(pos);
+      rsize += pos;
+    }
+
+    if (pos == 0 && i < count) {
+      int64_t val;
+      rsize += readVarint64(val);
+      values[i++] = sizeof(Int_) == 4 ? zigzagToI32(static_cast<uint32_t>(val))
+                                      : zigzagToI64(static_cast<uint64_t>(val));
+    }
+  }
+  return rsize;
+}
+
+/**
+ * Skip count varints without decoding them: every byte without the
+ * continuation bit ends one, so eight bytes that all lack it are eight
+ * varints.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skipVarints(uint32_t count) {
+  uint32_t rsize = 0;
+  // bytes of the varint that is being skipped
+  uint32_t length = 0;
+
+  while (count > 0) {
+    uint32_t avail = 1;
+    const uint8_t* buf = trans_->borrow(nullptr, &avail);
+    uint8_t byte;
+    bool borrowed = buf != nullptr;
+    if (!borrowed) {
+      trans_->readAll(&byte, 1);
+      buf = &byte;
+      avail = 1;
+    }
+
+    uint32_t pos = 0;
+    while (pos < avail && count > 0) {
+      if (length == 0 && count >= 8 && avail - pos >= 8) {
+        uint64_t word;
+        std::memcpy(&word, buf + pos, 8);
+        if ((word & 0x8080808080808080ULL) == 0) {
+          count -= 8;
+          pos += 8;
+          continue;
+        }
+      }
+
+      if (buf[pos++] & 0x80) {
+        // Have to check for invalid data so we don't crash.
+        if (UNLIKELY(++length == 10)) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Variable-length int over 10 bytes.");
+        }
+      } else {
+        length = 0;
+        --count;
+      }
+    }
+
+    if (borrowed) {
+      trans_->consume(pos);
+    }
+    rsize += pos;
+  }
+  return rsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::fixedSize(TType type) {
+  switch (type) {
+  case T_BOOL:
+  case T_BYTE:
+    return 1;
+  case T_DOUBLE:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::skip(TType type) {
+  TInputRecursionTracker tracker(*this);
+  uint32_t rsize = 0;
+
+  switch (type) {
+  case T_BOOL: {
+    bool boolv;
+    return readBool(boolv);
+  }
+  case T_BYTE:
+    skipBytes(*trans_, 1);
+    return 1;
+  case T_DOUBLE:
+    skipBytes(*trans_, 8);
+    return 8;
+  case T_I16:
+  case T_I32:
+  case T_I64:
+    return skipVarints(1);
+  case T_STRING: {
+    int32_t size;
+    rsize += readVarint32(size);
+    if (size < 0) {
+      throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+    }
+    if (string_limit_ > 0 && size > string_limit_) {
+      throw TProtocolException(TProtocolException::SIZE_LIMIT);
+    }
+    trans_->checkReadBytesAvailable(rsize + (uint32_t)size);
+    skipBytes(*trans_, (uint32_t)size);
+    return rsize + (uint32_t)size;
+  }
+  case T_STRUCT: {
+    std::string name;
+    TType fieldType;
+    int16_t fieldId;
+    rsize += readStructBegin(name);
+    while (true) {
+      rsize += readFieldBegin(name, fieldType, fieldId);
+      if (fieldType == T_STOP) {
+        break;
+      }
+      rsize += skip(fieldType);
+    }
+    rsize += readStructEnd();
+    return rsize;
+  }
+  case T_MAP: {
+    TType keyType;
+    TType valType;
+    uint32_t size;
+    rsize += readMapBegin(keyType, valType, size);
+    if (fixedSize(keyType) > 0 && fixedSize(valType) > 0) {
+      uint64_t len = size * static_cast<uint64_t>(fixedSize(keyType) + fixedSize(valType));
+      if (len > (std::numeric_limits<uint32_t>::max)()) {
+        throw TProtocolException(TProtocolException::SIZE_LIMIT);
+      }
+      skipBytes(*trans_, static_cast<uint32_t>(len));
+      return rsize + static_cast<uint32_t>(len);
+    }
+    if (isVarint(keyType) && isVarint(valType)) {
+      return rsize + skipVarints(2 * size);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      rsize += skip(keyType);
+      rsize += skip(valType);
+    }
+    return rsize;
+  }
+  case T_SET:
+  case T_LIST: {
+    TType elemType;
+    uint32_t size;
+    rsize += readListBegin(elemType, size);
+    uint64_t elemSize = fixedSize(elemType);
+    if (elemSize > 0) {
+      uint64_t len = size * elemSize;
+      if (len > (std::numeric_limits<uint32_t>::max)()) {
+        throw TProtocolException(TProtocolException::SIZE_LIMIT);
+      }
+      skipBytes(*trans_, static_cast<uint32_t>(len));
+      return rsize + static_cast<uint32_t>(len);
+    }
+    if (isVarint(elemType)) {
+      return rsize + skipVarints(size);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      rsize += skip(elemType);
+    }
+    return rsize;
+  }
+  default:
+    break;
+  }
+
+  throw TProtocolException(TProtocolException::INVALID_DATA, "invalid TType");
+}
+
 template <class Transport_>
 uint32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
   return readBinary(str);
@@ -718,6 +1090,86 @@ uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
   return rsize + (uint32_t)size;
 }
 
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStringView(TStringView& str) {
+  return readBinaryView(str);
+}
+
+/**
+ * Read a byte[] from the wire into a view of the transport's buffer, or of
+ * a copy if the transport cannot share it.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinaryView(TStringView& str) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    str.clear();
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  std::shared_ptr<const uint8_t> borrowed = trans_->borrowShared(size);
+  if (borrowed) {
+    str = TStringView(borrowed, borrowed.get(), size);
+    trans_->consume(size);
+  } else {
+    std::shared_ptr<uint8_t> copy(new uint8_t[size], std::default_delete<uint8_t[]>());
+    trans_->readAll(copy.get(), size);
+    str = TStringView(copy, copy.get(), size);
+  }
+
+  trans_->checkReadBytesAvailable(rsize + (uint32_t)size);
+
+  return rsize + (uint32_t)size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readArenaString(TArenaString& str) {
+  return readArenaBinary(str);
+}
+
+/**
+ * Read a byte[] from the wire straight into an arena string.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readArenaBinary(TArenaString& str) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    str.clear();
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  trans_->checkReadBytesAvailable(rsize + (uint32_t)size);
+
+  str.resize(size);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
+
+  return rsize + (uint32_t)size;
+}
+
 /**
  * Read an i32 from the wire as a varint. The MSB of each byte is set
  * if there is another byte to follow. This can read up to 5 bytes.
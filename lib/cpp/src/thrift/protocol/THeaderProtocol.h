@@ -135,6 +135,20 @@ public:
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeStringView(const TStringView& str);
+
+  uint32_t writeBinaryView(const TStringView& str);
+
+  uint32_t writeArenaString(const TArenaString& str);
+
+  uint32_t writeArenaBinary(const TArenaString& str);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count);
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count);
+
   /**
    * Reading functions
    */
@@ -181,6 +195,22 @@ public:
 
   uint32_t readBinary(std::string& binary);
 
+  uint32_t readStringView(TStringView& str);
+
+  uint32_t readBinaryView(TStringView& binary);
+
+  uint32_t readArenaString(TArenaString& str);
+
+  uint32_t readArenaBinary(TArenaString& binary);
+
+  uint32_t readI32Array(int32_t* values, uint32_t count);
+
+  uint32_t readI64Array(int64_t* values, uint32_t count);
+
+  uint32_t readDoubleArray(double* values, uint32_t count);
+
+  uint32_t skip(TType type);
+
 protected:
   std::shared_ptr<THeaderTransport> trans_;
 
@@ -21,12 +21,24 @@
 
 #include <boost/locale.hpp>
 
+#include <clocale>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <locale>
 #include <sstream>
 #include <stdexcept>
 
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <thrift/protocol/TBase64Utils.h>
 #include <thrift/transport/TTransportException.h>
 #include <thrift/TToString.h>
@@ -294,6 +306,145 @@ static bool isLowSurrogate(uint16_t val) {
   return val >= 0xDC00 && val <= 0xDFFF;
 }
 
+// Return true if the character ch must be escaped in a JSON string
+static bool isJSONEscaped(uint8_t ch) {
+  return ch < 0x20 || ch == kJSONStringDelimiter || ch == kJSONBackslash;
+}
+
+// Return true if the character ch ends a run of plain characters in a JSON
+// string that is being read
+static bool isJSONStringSpecial(uint8_t ch) {
+  return ch == kJSONStringDelimiter || ch == kJSONBackslash;
+}
+
+#ifndef __SSE2__
+static const uint64_t kOnes = 0x0101010101010101ULL;
+static const uint64_t kHighBits = 0x8080808080808080ULL;
+
+// Return nonzero if one of the bytes of word is ch
+static uint64_t hasByte(uint64_t word, uint8_t ch) {
+  uint64_t x = word ^ (kOnes * ch);
+  return (x - kOnes) & ~x & kHighBits;
+}
+#endif
+
+// Return the number of characters at the start of str that can be written
+// to a JSON string as they are.
+static uint32_t countUnescaped(const uint8_t* str, uint32_t len) {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8(static_cast<char>(kJSONStringDelimiter));
+  const __m128i backslash = _mm_set1_epi8(static_cast<char>(kJSONBackslash));
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= len; i += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+    int mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return i + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+#else
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, str + i, sizeof(word));
+    // bytes below 0x20 are the ones that borrow when 0x20 is subtracted
+    uint64_t special = hasByte(word, kJSONStringDelimiter) | hasByte(word, kJSONBackslash)
+                       | ((word - kOnes * 0x20) & ~word & kHighBits);
+    if (special != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < len && !isJSONEscaped(str[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Return the number of characters at the start of str that are neither a
+// quote nor a backslash.
+static uint32_t countPlain(const uint8_t* str, uint32_t len) {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8(static_cast<char>(kJSONStringDelimiter));
+  const __m128i backslash = _mm_set1_epi8(static_cast<char>(kJSONBackslash));
+  for (; i + 16 <= len; i += 16) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)));
+    if (mask != 0) {
+      return i + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+  }
+#else
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, str + i, sizeof(word));
+    if ((hasByte(word, kJSONStringDelimiter) | hasByte(word, kJSONBackslash)) != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < len && !isJSONStringSpecial(str[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Write the decimal digits of num so that they end at end, and return
+// where they start.
+static char* formatInteger(int64_t num, char* end) {
+  // negate as unsigned, which works for the minimum too
+  uint64_t magnitude = num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+  char* p = end;
+  do {
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (num < 0) {
+    *--p = '-';
+  }
+  return p;
+}
+
+// Parse the whole of str as a decimal integer in [min, max] and return it
+// via num, in two's complement.  Return false if it is not one.
+static bool parseInteger(const std::string& str, int64_t min, uint64_t max, uint64_t& num) {
+  const char* p = str.c_str();
+  const char* end = p + str.length();
+  bool negative = false;
+  if (p != end && (*p == '-' || *p == '+')) {
+    negative = *p++ == '-';
+  }
+  if (p == end) {
+    return false;
+  }
+  uint64_t limit = negative ? 0 - static_cast<uint64_t>(min) : max;
+  uint64_t magnitude = 0;
+  for (; p != end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    auto digit = static_cast<uint64_t>(*p - '0');
+    if (magnitude > (limit - digit) / 10) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  num = negative ? 0 - magnitude : magnitude;
+  return true;
+}
+
+// Return true if the C library formats and parses numbers with a '.', so
+// that printf() and strtod() give what the classic locale would.
+static bool hasClassicDecimalPoint() {
+  const char* point = localeconv()->decimal_point;
+  return point[0] == '.' && point[1] == '\0';
+}
+
 /**
  * Class to serve as base JSON context and as base class for other context
  * implementations
@@ -416,12 +567,11 @@ void TJSONProtocol::popContext() {
 
 // Write the character ch as a JSON escape sequence ("\u00xx")
 uint32_t TJSONProtocol::writeJSONEscapeChar(uint8_t ch) {
-  trans_->write((const uint8_t*)kJSONEscapePrefix.c_str(),
-                static_cast<uint32_t>(kJSONEscapePrefix.length()));
-  uint8_t outCh = hexChar(ch >> 4);
-  trans_->write(&outCh, 1);
-  outCh = hexChar(ch);
-  trans_->write(&outCh, 1);
+  uint8_t escape[6];
+  memcpy(escape, kJSONEscapePrefix.c_str(), 4);
+  escape[4] = hexChar(ch >> 4);
+  escape[5] = hexChar(ch);
+  trans_->write(escape, 6);
   return 6;
 }
 
@@ -429,8 +579,8 @@ uint32_t TJSONProtocol::writeJSONEscapeChar(uint8_t ch) {
 uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
   if (ch >= 0x30) {
     if (ch == kJSONBackslash) { // Only special character >= 0x30 is '\'
-      trans_->write(&kJSONBackslash, 1);
-      trans_->write(&kJSONBackslash, 1);
+      const uint8_t escape[2] = {kJSONBackslash, kJSONBackslash};
+      trans_->write(escape, 2);
       return 2;
     } else {
       trans_->write(&ch, 1);
@@ -443,8 +593,8 @@ uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
       trans_->write(&ch, 1);
       return 1;
     } else if (outCh > 1) {
-      trans_->write(&kJSONBackslash, 1);
-      trans_->write(&outCh, 1);
+      const uint8_t escape[2] = {kJSONBackslash, outCh};
+      trans_->write(escape, 2);
       return 2;
     } else {
       return writeJSONEscapeChar(ch);
@@ -453,15 +603,28 @@ uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
 }
 
 // Write out the contents of the string str as a JSON string, escaping
-// characters as appropriate.
+// characters as appropriate.  Runs of characters that need no escaping are
+// written at once.
 uint32_t TJSONProtocol::writeJSONString(const std::string& str) {
   uint32_t result = context_->write(*trans_);
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
-  while (iter != end) {
-    result += writeJSONChar(*iter++);
+  if (str.length() > (std::numeric_limits<uint32_t>::max)())
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  const auto* chars = (const uint8_t*)str.data();
+  auto len = static_cast<uint32_t>(str.length());
+  while (len > 0) {
+    uint32_t unescaped = countUnescaped(chars, len);
+    if (unescaped > 0) {
+      trans_->write(chars, unescaped);
+      result += unescaped;
+      chars += unescaped;
+      len -= unescaped;
+    }
+    if (len > 0) {
+      result += writeJSONChar(*chars++);
+      --len;
+    }
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -478,13 +641,18 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
   if (str.length() > (std::numeric_limits<uint32_t>::max)())
     throw TProtocolException(TProtocolException::SIZE_LIMIT);
   auto len = static_cast<uint32_t>(str.length());
+  uint8_t encoded[1024];
   while (len >= 3) {
-    // Encode 3 bytes at a time
-    base64_encode(bytes, 3, b);
-    trans_->write(b, 4);
-    result += 4;
-    bytes += 3;
-    len -= 3;
+    // Encode 3 bytes at a time, and write as many as fit in encoded at once
+    uint32_t n = 0;
+    while (len >= 3 && n < sizeof(encoded)) {
+      base64_encode(bytes, 3, encoded + n);
+      n += 4;
+      bytes += 3;
+      len -= 3;
+    }
+    trans_->write(encoded, n);
+    result += n;
   }
   if (len) { // Handle remainder
     base64_encode(bytes, len, b);
@@ -500,24 +668,49 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string& str) {
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
   uint32_t result = context_->write(*trans_);
-  std::string val(to_string(num));
-  bool escapeNum = context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  if (val.length() > (std::numeric_limits<uint32_t>::max)())
-    throw TProtocolException(TProtocolException::SIZE_LIMIT);
-  trans_->write((const uint8_t*)val.c_str(), static_cast<uint32_t>(val.length()));
-  result += static_cast<uint32_t>(val.length());
+  // room for the digits of any 64 bit integer, its sign and quotes
+  char buf[24];
+  char* end = buf + sizeof(buf) - 1;
+  char* digits = formatInteger(static_cast<int64_t>(num), end);
+  return result + writeJSONNumber(digits, static_cast<uint32_t>(end - digits),
+                                  context_->escapeNum());
+}
+
+// Write the number, which must have room for a quote on either side, in
+// quotes if escapeNum is set.
+uint32_t TJSONProtocol::writeJSONNumber(char* digits, uint32_t len, bool escapeNum) {
   if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    char* quoted = digits - 1;
+    quoted[0] = kJSONStringDelimiter;
+    quoted[len + 1] = kJSONStringDelimiter;
+    trans_->write((const uint8_t*)quoted, len + 2);
+    return len + 2;
   }
-  return result;
+  trans_->write((const uint8_t*)digits, len);
+  return len;
 }
 
 namespace {
+// Format d as an ostream with the classic locale and a precision of 17
+// would, into buf of size bytes.  Return the length, or 0 if the C library
+// cannot do it.
+uint32_t formatDouble(double d, char* buf, uint32_t size) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  std::to_chars_result formatted = std::to_chars(buf, buf + size, d,
+                                                 std::chars_format::general, 17);
+  if (formatted.ec != std::errc()) {
+    return 0;
+  }
+  return static_cast<uint32_t>(formatted.ptr - buf);
+#else
+  if (!hasClassicDecimalPoint()) {
+    return 0;
+  }
+  int len = snprintf(buf, size, "%.17g", d);
+  return len > 0 && static_cast<uint32_t>(len) < size ? static_cast<uint32_t>(len) : 0;
+#endif
+}
+
 std::string doubleToString(double d) {
   std::ostringstream str;
   str.imbue(std::locale::classic());
@@ -548,10 +741,17 @@ uint32_t TJSONProtocol::writeJSONDouble(double num) {
     val = kThriftNan;
     special = true;
     break;
-  default:
+  default: {
+    // room for the longest number, "-d.dddddddddddddddde-ddd", and quotes
+    char buf[32];
+    uint32_t len = formatDouble(num, buf + 1, sizeof(buf) - 2);
+    if (len > 0) {
+      return result + writeJSONNumber(buf + 1, len, context_->escapeNum());
+    }
     val = doubleToString(num);
     break;
   }
+  }
 
   bool escapeNum = special || context_->escapeNum();
   if (escapeNum) {
@@ -742,6 +942,23 @@ uint32_t TJSONProtocol::readJSONString(std::string& str, bool skipContext) {
   uint8_t ch;
   str.clear();
   while (true) {
+    // Copy the plain characters the transport has buffered at once
+    uint32_t len;
+    const uint8_t* buf = reader_.borrow(&len);
+    if (buf) {
+      uint32_t plain = countPlain(buf, len);
+      if (plain > 0) {
+        if (!codeunits.empty()) {
+          throw TProtocolException(TProtocolException::INVALID_DATA,
+                                   "Missing UTF-16 low surrogate pair.");
+        }
+        reader_.readBorrowed(str, plain);
+        result += plain;
+        if (plain == len) {
+          continue;
+        }
+      }
+    }
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
@@ -828,6 +1045,20 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string& str) {
   uint32_t result = 0;
   str.clear();
   while (true) {
+    uint32_t len;
+    const uint8_t* buf = reader_.borrow(&len);
+    if (buf) {
+      uint32_t numeric = 0;
+      while (numeric < len && isJSONNumeric(buf[numeric])) {
+        ++numeric;
+      }
+      reader_.readBorrowed(str, numeric);
+      result += numeric;
+      if (numeric < len) {
+        break;
+      }
+      continue;
+    }
     uint8_t ch = reader_.peek();
     if (!isJSONNumeric(ch)) {
       break;
@@ -850,6 +1081,46 @@ T fromString(const std::string& s) {
     throw std::runtime_error(s);
   return t;
 }
+
+// Parse the whole of str as a double.  Return false if it is not one.
+bool parseDouble(const std::string& str, double& num) {
+  const char* begin = str.c_str();
+  const char* end = begin + str.length();
+  if (begin == end) {
+    return false;
+  }
+  for (const char* p = begin; p != end; ++p) {
+    if (!isJSONNumeric(static_cast<uint8_t>(*p))) {
+      return false;
+    }
+  }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  // from_chars() does not take a plus sign
+  const char* digits = begin;
+  if (*digits == '+' && ++digits != end && *digits == '-') {
+    return false;
+  }
+  std::from_chars_result parsed = std::from_chars(digits, end, num);
+  if (parsed.ec == std::errc()) {
+    return parsed.ptr == end;
+  }
+  if (parsed.ec != std::errc::result_out_of_range) {
+    return false;
+  }
+  // let strtod() round numbers out of range to infinity or zero
+#endif
+  if (hasClassicDecimalPoint()) {
+    char* parsedEnd;
+    num = strtod(begin, &parsedEnd);
+    return parsedEnd == end;
+  }
+  try {
+    num = fromString<double>(str);
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+  return true;
+}
 }
 
 // Reads a sequence of characters and assembles them into a number,
@@ -862,12 +1133,15 @@ uint32_t TJSONProtocol::readJSONInteger(NumberType& num) {
   }
   std::string str;
   result += readJSONNumericChars(str);
-  try {
-    num = fromString<NumberType>(str);
-  } catch (const std::runtime_error&) {
+  uint64_t value;
+  if (!parseInteger(str,
+                    static_cast<int64_t>((std::numeric_limits<NumberType>::min)()),
+                    static_cast<uint64_t>((std::numeric_limits<NumberType>::max)()),
+                    value)) {
     throw TProtocolException(TProtocolException::INVALID_DATA,
                              "Expected numeric value; got \"" + str + "\"");
   }
+  num = static_cast<NumberType>(value);
   if (context_->escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
@@ -893,9 +1167,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Numeric data unexpectedly quoted");
       }
-      try {
-        num = fromString<double>(str);
-      } catch (const std::runtime_error&) {
+      if (!parseDouble(str, num)) {
         throw TProtocolException(TProtocolException::INVALID_DATA,
                                      "Expected numeric value; got \"" + str + "\"");
       }
@@ -906,9 +1178,7 @@ uint32_t TJSONProtocol::readJSONDouble(double& num) {
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
     result += readJSONNumericChars(str);
-    try {
-      num = fromString<double>(str);
-    } catch (const std::runtime_error&) {
+    if (!parseDouble(str, num)) {
       throw TProtocolException(TProtocolException::INVALID_DATA,
                                    "Expected numeric value; got \"" + str + "\"");
     }
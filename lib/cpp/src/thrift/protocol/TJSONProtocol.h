@@ -86,12 +86,12 @@ class TJSONContext;
  * More discussion of the double handling is probably warranted. The aim of
  * the current implementation is to match as closely as possible the behavior
  * of Java's Double.toString(), which has no precision loss.  Implementors in
- * other languages should strive to achieve that where possible. I have not
- * yet verified whether std::istringstream::operator>>, which is doing that
- * work for me in C++, loses any precision, but I am leaving this as a future
- * improvement. I may try to provide a C component for this, so that other
- * languages could bind to the same underlying implementation for maximum
- * consistency.
+ * other languages should strive to achieve that where possible. Doubles are
+ * written with 17 significant digits, which is enough to read them back
+ * exactly, using std::to_chars() where the standard library has it and
+ * printf() otherwise; they are read with std::from_chars() or strtod().
+ * printf() and strtod() give way to iostreams if the C locale does not use
+ * '.' as the decimal point.
  *
  */
 class TJSONProtocol : public TVirtualProtocol<TJSONProtocol> {
@@ -118,6 +118,8 @@ private:
 
   uint32_t writeJSONDouble(double num);
 
+  uint32_t writeJSONNumber(char* digits, uint32_t len, bool escapeNum);
+
   uint32_t writeJSONObjectStart();
 
   uint32_t writeJSONObjectEnd();
@@ -285,6 +287,30 @@ public:
       return data_;
     }
 
+    /**
+     * Return the bytes the transport has buffered, see TTransport::borrow().
+     * Returns nullptr if a byte was peeked at, or if the transport has
+     * nothing buffered.
+     */
+    const uint8_t* borrow(uint32_t* len) {
+      if (hasData_) {
+        return nullptr;
+      }
+      *len = 1;
+      return trans_->borrow(nullptr, len);
+    }
+
+    /**
+     * Append len of the bytes returned by borrow() to str.  They are read
+     * like read() reads them rather than consumed, so that they count the
+     * same against the maximum message size.
+     */
+    void readBorrowed(std::string& str, uint32_t len) {
+      std::string::size_type size = str.size();
+      str.resize(size + len);
+      trans_->readAll(reinterpret_cast<uint8_t*>(&str[size]), len);
+    }
+
   private:
     TTransport* trans_;
     bool hasData_;
@@ -28,6 +28,98 @@ uint32_t TProtocol::skip_virt(TType type) {
   return ::apache::thrift::protocol::skip(*this, type);
 }
 
+uint32_t TProtocol::writeStringView_virt(const TStringView& str) {
+  return writeString_virt(str.str());
+}
+
+uint32_t TProtocol::writeBinaryView_virt(const TStringView& str) {
+  return writeBinary_virt(str.str());
+}
+
+uint32_t TProtocol::readStringView_virt(TStringView& str) {
+  std::string copy;
+  uint32_t result = readString_virt(copy);
+  str = TStringView(std::move(copy));
+  return result;
+}
+
+uint32_t TProtocol::readBinaryView_virt(TStringView& str) {
+  std::string copy;
+  uint32_t result = readBinary_virt(copy);
+  str = TStringView(std::move(copy));
+  return result;
+}
+
+uint32_t TProtocol::writeArenaString_virt(const TArenaString& str) {
+  return writeString_virt(std::string(str.data(), str.size()));
+}
+
+uint32_t TProtocol::writeArenaBinary_virt(const TArenaString& str) {
+  return writeBinary_virt(std::string(str.data(), str.size()));
+}
+
+uint32_t TProtocol::readArenaString_virt(TArenaString& str) {
+  std::string copy;
+  uint32_t result = readString_virt(copy);
+  str.assign(copy.data(), copy.size());
+  return result;
+}
+
+uint32_t TProtocol::readArenaBinary_virt(TArenaString& str) {
+  std::string copy;
+  uint32_t result = readBinary_virt(copy);
+  str.assign(copy.data(), copy.size());
+  return result;
+}
+
+uint32_t TProtocol::writeI32Array_virt(const int32_t* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += writeI32_virt(values[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::writeI64Array_virt(const int64_t* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += writeI64_virt(values[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::writeDoubleArray_virt(const double* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += writeDouble_virt(values[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::readI32Array_virt(int32_t* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += readI32_virt(values[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::readI64Array_virt(int64_t* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += readI64_virt(values[i]);
+  }
+  return result;
+}
+
+uint32_t TProtocol::readDoubleArray_virt(double* values, uint32_t count) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    result += readDouble_virt(values[i]);
+  }
+  return result;
+}
+
 TProtocolFactory::~TProtocolFactory() = default;
 
 }}} // apache::thrift::protocol
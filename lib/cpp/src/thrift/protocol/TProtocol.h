@@ -25,6 +25,8 @@
 #include <Winsock2.h>
 #endif
 
+#include <thrift/TArena.h>
+#include <thrift/TStringView.h>
 #include <thrift/transport/TTransport.h>
 #include <thrift/protocol/TProtocolException.h>
 #include <thrift/protocol/TEnum.h>
@@ -243,6 +245,20 @@ public:
 
   virtual uint32_t writeBinary_virt(const std::string& str) = 0;
 
+  virtual uint32_t writeStringView_virt(const TStringView& str);
+
+  virtual uint32_t writeBinaryView_virt(const TStringView& str);
+
+  virtual uint32_t writeArenaString_virt(const TArenaString& str);
+
+  virtual uint32_t writeArenaBinary_virt(const TArenaString& str);
+
+  virtual uint32_t writeI32Array_virt(const int32_t* values, uint32_t count);
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values, uint32_t count);
+
+  virtual uint32_t writeDoubleArray_virt(const double* values, uint32_t count);
+
   uint32_t writeMessageBegin(const std::string& name,
                              const TMessageType messageType,
                              const int32_t seqid) {
@@ -350,6 +366,53 @@ public:
     return writeBinary_virt(str);
   }
 
+  /**
+   * Write a string held in a TStringView.  Protocols that do not support
+   * views natively write a copy of it with writeString().
+   */
+  uint32_t writeStringView(const TStringView& str) {
+    T_VIRTUAL_CALL();
+    return writeStringView_virt(str);
+  }
+
+  uint32_t writeBinaryView(const TStringView& str) {
+    T_VIRTUAL_CALL();
+    return writeBinaryView_virt(str);
+  }
+
+  /**
+   * Write a string allocated by a TArenaAllocator.  Protocols that do not
+   * support arena strings natively write a copy of it with writeString().
+   */
+  uint32_t writeArenaString(const TArenaString& str) {
+    T_VIRTUAL_CALL();
+    return writeArenaString_virt(str);
+  }
+
+  uint32_t writeArenaBinary(const TArenaString& str) {
+    T_VIRTUAL_CALL();
+    return writeArenaBinary_virt(str);
+  }
+
+  /**
+   * Write the elements of a list of primitives in one call.  Protocols that
+   * have no bulk encoding write them one at a time.
+   */
+  uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return writeDoubleArray_virt(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -398,6 +461,20 @@ public:
 
   virtual uint32_t readBinary_virt(std::string& str) = 0;
 
+  virtual uint32_t readStringView_virt(TStringView& str);
+
+  virtual uint32_t readBinaryView_virt(TStringView& str);
+
+  virtual uint32_t readArenaString_virt(TArenaString& str);
+
+  virtual uint32_t readArenaBinary_virt(TArenaString& str);
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t count);
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t count);
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t count);
+
   uint32_t readMessageBegin(std::string& name, TMessageType& messageType, int32_t& seqid) {
     T_VIRTUAL_CALL();
     return readMessageBegin_virt(name, messageType, seqid);
@@ -498,6 +575,56 @@ public:
     return readBinary_virt(str);
   }
 
+  /**
+   * Read a string into a TStringView.  Protocols that support views refer to
+   * the transport's buffer if it can be borrowed with shared ownership (see
+   * TTransport::borrowShared()); otherwise the view holds a copy read with
+   * readString().
+   */
+  uint32_t readStringView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readStringView_virt(str);
+  }
+
+  uint32_t readBinaryView(TStringView& str) {
+    T_VIRTUAL_CALL();
+    return readBinaryView_virt(str);
+  }
+
+  /**
+   * Read a string into storage obtained from the string's TArenaAllocator.
+   * Protocols that do not support arena strings natively read it with
+   * readString() and copy it.
+   */
+  uint32_t readArenaString(TArenaString& str) {
+    T_VIRTUAL_CALL();
+    return readArenaString_virt(str);
+  }
+
+  uint32_t readArenaBinary(TArenaString& str) {
+    T_VIRTUAL_CALL();
+    return readArenaBinary_virt(str);
+  }
+
+  /**
+   * Read count elements of a list of primitives in one call.  Protocols
+   * that have no bulk decoding read them one at a time.
+   */
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    T_VIRTUAL_CALL();
+    return readDoubleArray_virt(values, count);
+  }
+
   /*
    * std::vector is specialized for bool, and its elements are individual bits
    * rather than bools.   We need to define a different version of readBool()
@@ -745,6 +872,27 @@ uint32_t skip(Protocol_& prot, TType type) {
                            "invalid TType");
 }
 
+/**
+ * Helper for protocol specific skip() implementations: discards len bytes
+ * of the transport, straight out of its buffer where it has one.
+ */
+template <class Transport_>
+void skipBytes(Transport_& trans, uint32_t len) {
+  while (len > 0) {
+    uint32_t avail = 1;
+    if (trans.borrow(nullptr, &avail) != nullptr) {
+      avail = avail < len ? avail : len;
+      trans.consume(avail);
+      len -= avail;
+    } else {
+      uint8_t buf[1024];
+      uint32_t size = len < sizeof(buf) ? len : static_cast<uint32_t>(sizeof(buf));
+      trans.readAll(buf, size);
+      len -= size;
+    }
+  }
+}
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_PROTOCOL_TPROTOCOL_H_ 1
@@ -92,6 +92,27 @@ public:
   uint32_t writeDouble_virt(const double dub) override { return protocol->writeDouble(dub); }
   uint32_t writeString_virt(const std::string& str) override { return protocol->writeString(str); }
   uint32_t writeBinary_virt(const std::string& str) override { return protocol->writeBinary(str); }
+  uint32_t writeStringView_virt(const TStringView& str) override {
+    return protocol->writeStringView(str);
+  }
+  uint32_t writeBinaryView_virt(const TStringView& str) override {
+    return protocol->writeBinaryView(str);
+  }
+  uint32_t writeArenaString_virt(const TArenaString& str) override {
+    return protocol->writeArenaString(str);
+  }
+  uint32_t writeArenaBinary_virt(const TArenaString& str) override {
+    return protocol->writeArenaBinary(str);
+  }
+  uint32_t writeI32Array_virt(const int32_t* values, uint32_t count) override {
+    return protocol->writeI32Array(values, count);
+  }
+  uint32_t writeI64Array_virt(const int64_t* values, uint32_t count) override {
+    return protocol->writeI64Array(values, count);
+  }
+  uint32_t writeDoubleArray_virt(const double* values, uint32_t count) override {
+    return protocol->writeDoubleArray(values, count);
+  }
 
   uint32_t readMessageBegin_virt(std::string& name,
                                          TMessageType& messageType,
@@ -140,6 +161,29 @@ public:
 
   uint32_t readString_virt(std::string& str) override { return protocol->readString(str); }
   uint32_t readBinary_virt(std::string& str) override { return protocol->readBinary(str); }
+  uint32_t readStringView_virt(TStringView& str) override { return protocol->readStringView(str); }
+  uint32_t readBinaryView_virt(TStringView& str) override { return protocol->readBinaryView(str); }
+  uint32_t readArenaString_virt(TArenaString& str) override { return protocol->readArenaString(str); }
+  uint32_t readArenaBinary_virt(TArenaString& str) override { return protocol->readArenaBinary(str); }
+  uint32_t readI32Array_virt(int32_t* values, uint32_t count) override {
+    return protocol->readI32Array(values, count);
+  }
+  uint32_t readI64Array_virt(int64_t* values, uint32_t count) override {
+    return protocol->readI64Array(values, count);
+  }
+  uint32_t readDoubleArray_virt(double* values, uint32_t count) override {
+    return protocol->readDoubleArray(values, count);
+  }
+
+protected:
+  /**
+   * Make this decorate another protocol, or none, so that a decorator can be
+   * reused.
+   */
+  void setProtocol(shared_ptr<TProtocol> proto) {
+    ptrans_ = proto ? proto->getTransport() : shared_ptr<TTransport>();
+    protocol = proto;
+  }
 
 private:
   shared_ptr<TProtocol> protocol;
@@ -300,6 +300,59 @@ public:
 
   uint32_t skip(TType type) { return ::apache::thrift::protocol::skip(*this, type); }
 
+  /*
+   * TProtocol provides copying implementations of the view and arena
+   * functions, and element-wise implementations of the array functions.
+   * Invoke them non-virtually.
+   */
+  uint32_t readStringView(TStringView& str) { return this->TProtocol::readStringView_virt(str); }
+
+  uint32_t readBinaryView(TStringView& str) { return this->TProtocol::readBinaryView_virt(str); }
+
+  uint32_t writeStringView(const TStringView& str) {
+    return this->TProtocol::writeStringView_virt(str);
+  }
+
+  uint32_t writeBinaryView(const TStringView& str) {
+    return this->TProtocol::writeBinaryView_virt(str);
+  }
+
+  uint32_t readArenaString(TArenaString& str) { return this->TProtocol::readArenaString_virt(str); }
+
+  uint32_t readArenaBinary(TArenaString& str) { return this->TProtocol::readArenaBinary_virt(str); }
+
+  uint32_t writeArenaString(const TArenaString& str) {
+    return this->TProtocol::writeArenaString_virt(str);
+  }
+
+  uint32_t writeArenaBinary(const TArenaString& str) {
+    return this->TProtocol::writeArenaBinary_virt(str);
+  }
+
+  uint32_t readI32Array(int32_t* values, uint32_t count) {
+    return this->TProtocol::readI32Array_virt(values, count);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t count) {
+    return this->TProtocol::readI64Array_virt(values, count);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t count) {
+    return this->TProtocol::readDoubleArray_virt(values, count);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t count) {
+    return this->TProtocol::writeI32Array_virt(values, count);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t count) {
+    return this->TProtocol::writeI64Array_virt(values, count);
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t count) {
+    return this->TProtocol::writeDoubleArray_virt(values, count);
+  }
+
 protected:
   TProtocolDefaults(std::shared_ptr<TTransport> ptrans) : TProtocol(ptrans) {}
 };
@@ -393,6 +446,34 @@ public:
     return static_cast<Protocol_*>(this)->writeBinary(str);
   }
 
+  uint32_t writeStringView_virt(const TStringView& str) override {
+    return static_cast<Protocol_*>(this)->writeStringView(str);
+  }
+
+  uint32_t writeBinaryView_virt(const TStringView& str) override {
+    return static_cast<Protocol_*>(this)->writeBinaryView(str);
+  }
+
+  uint32_t writeArenaString_virt(const TArenaString& str) override {
+    return static_cast<Protocol_*>(this)->writeArenaString(str);
+  }
+
+  uint32_t writeArenaBinary_virt(const TArenaString& str) override {
+    return static_cast<Protocol_*>(this)->writeArenaBinary(str);
+  }
+
+  uint32_t writeI32Array_virt(const int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI32Array(values, count);
+  }
+
+  uint32_t writeI64Array_virt(const int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeI64Array(values, count);
+  }
+
+  uint32_t writeDoubleArray_virt(const double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->writeDoubleArray(values, count);
+  }
+
   /**
    * Reading functions
    */
@@ -471,6 +552,34 @@ public:
     return static_cast<Protocol_*>(this)->readBinary(str);
   }
 
+  uint32_t readStringView_virt(TStringView& str) override {
+    return static_cast<Protocol_*>(this)->readStringView(str);
+  }
+
+  uint32_t readBinaryView_virt(TStringView& str) override {
+    return static_cast<Protocol_*>(this)->readBinaryView(str);
+  }
+
+  uint32_t readArenaString_virt(TArenaString& str) override {
+    return static_cast<Protocol_*>(this)->readArenaString(str);
+  }
+
+  uint32_t readArenaBinary_virt(TArenaString& str) override {
+    return static_cast<Protocol_*>(this)->readArenaBinary(str);
+  }
+
+  uint32_t readI32Array_virt(int32_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI32Array(values, count);
+  }
+
+  uint32_t readI64Array_virt(int64_t* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readI64Array(values, count);
+  }
+
+  uint32_t readDoubleArray_virt(double* values, uint32_t count) override {
+    return static_cast<Protocol_*>(this)->readDoubleArray(values, count);
+  }
+
   uint32_t skip_virt(TType type) override { return static_cast<Protocol_*>(this)->skip(type); }
 
   /*
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <thrift/server/TBufferPool.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::Guard;
+
+namespace {
+
+/// The smallest size class that holds size bytes
+uint32_t sizeClassFor(uint32_t size) {
+  uint32_t sizeClass = 0;
+  while ((uint64_t(1) << sizeClass) < size) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+/// The largest size class a buffer of capacity bytes can be used for
+uint32_t sizeClassOf(uint32_t capacity) {
+  uint32_t sizeClass = 0;
+  while ((uint64_t(2) << sizeClass) <= capacity) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+}
+
+TBufferPool::TBufferPool(size_t maxCachedBytes)
+  : cachedBytes_(0), maxCachedBytes_(maxCachedBytes), allocations_(0) {
+}
+
+TBufferPool::~TBufferPool() {
+  clear();
+}
+
+uint8_t* TBufferPool::acquire(uint32_t size, uint32_t* capacity) {
+  uint32_t sizeClass = sizeClassFor(size);
+  if (sizeClass < MIN_SIZE_CLASS) {
+    sizeClass = MIN_SIZE_CLASS;
+  }
+  uint64_t bytes = uint64_t(1) << sizeClass;
+  // the last size class only fits 2^32 - 1 bytes
+  *capacity = bytes > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(bytes);
+
+  {
+    Guard g(mutex_);
+    std::vector<uint8_t*>& buffers = buffers_[sizeClass];
+    if (!buffers.empty()) {
+      uint8_t* buffer = buffers.back();
+      buffers.pop_back();
+      cachedBytes_ -= static_cast<size_t>(bytes);
+      return buffer;
+    }
+    ++allocations_;
+  }
+
+  auto* buffer = static_cast<uint8_t*>(std::malloc(*capacity));
+  if (buffer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return buffer;
+}
+
+void TBufferPool::release(uint8_t* buffer, uint32_t capacity) {
+  if (buffer == nullptr) {
+    return;
+  }
+  uint32_t sizeClass = sizeClassOf(capacity);
+  size_t bytes = static_cast<size_t>(uint64_t(1) << sizeClass);
+  if (sizeClass >= MIN_SIZE_CLASS) {
+    Guard g(mutex_);
+    if (cachedBytes_ + bytes <= maxCachedBytes_) {
+      buffers_[sizeClass].push_back(buffer);
+      cachedBytes_ += bytes;
+      return;
+    }
+  }
+  std::free(buffer);
+}
+
+void TBufferPool::clear() {
+  Guard g(mutex_);
+  for (auto& buffers : buffers_) {
+    for (uint8_t* buffer : buffers) {
+      std::free(buffer);
+    }
+    buffers.clear();
+  }
+  cachedBytes_ = 0;
+}
+
+size_t TBufferPool::getMaxCachedBytes() const {
+  Guard g(mutex_);
+  return maxCachedBytes_;
+}
+
+void TBufferPool::setMaxCachedBytes(size_t maxCachedBytes) {
+  Guard g(mutex_);
+  maxCachedBytes_ = maxCachedBytes;
+  trim();
+}
+
+size_t TBufferPool::getCachedBytes() const {
+  Guard g(mutex_);
+  return cachedBytes_;
+}
+
+uint64_t TBufferPool::getAllocations() const {
+  Guard g(mutex_);
+  return allocations_;
+}
+
+void TBufferPool::trim() {
+  for (uint32_t sizeClass = NUM_SIZE_CLASSES; sizeClass-- > 0 && cachedBytes_ > maxCachedBytes_;) {
+    std::vector<uint8_t*>& buffers = buffers_[sizeClass];
+    while (!buffers.empty() && cachedBytes_ > maxCachedBytes_) {
+      std::free(buffers.back());
+      buffers.pop_back();
+      cachedBytes_ -= static_cast<size_t>(uint64_t(1) << sizeClass);
+    }
+  }
+}
+}
+}
+} // apache::thrift::server
@@ -0,0 +1,104 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _THRIFT_SERVER_TBUFFERPOOL_H_
+#define _THRIFT_SERVER_TBUFFERPOOL_H_ 1
+
+#include <thrift/concurrency/Mutex.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * A cache of malloc()ed buffers, sorted into power of two size classes, for
+ * servers that need buffers only while they handle a request.  Buffers can
+ * be released from any thread.
+ *
+ * At most getMaxCachedBytes() bytes are kept; buffers that would exceed
+ * that are freed.
+ */
+class TBufferPool {
+public:
+  /// Default limit on the memory kept in the pool
+  static const size_t DEFAULT_MAX_CACHED_BYTES = 4 * 1024 * 1024;
+
+  TBufferPool(size_t maxCachedBytes = DEFAULT_MAX_CACHED_BYTES);
+
+  ~TBufferPool();
+
+  /**
+   * Get a buffer of at least size bytes.
+   *
+   * @param size the number of bytes needed.
+   * @param capacity set to the usable size of the buffer, a power of two.
+   * @return a buffer allocated with malloc(), which belongs to the caller
+   * until it is released.
+   */
+  uint8_t* acquire(uint32_t size, uint32_t* capacity);
+
+  /**
+   * Give a buffer back to the pool, or free it if the pool is full.
+   *
+   * @param buffer a buffer allocated with malloc() (or nullptr).
+   * @param capacity the size of the buffer.
+   */
+  void release(uint8_t* buffer, uint32_t capacity);
+
+  /// Free all the buffers in the pool.
+  void clear();
+
+  size_t getMaxCachedBytes() const;
+
+  void setMaxCachedBytes(size_t maxCachedBytes);
+
+  /// Return the number of bytes of the buffers in the pool.
+  size_t getCachedBytes() const;
+
+  /// Return the number of buffers acquire() had to allocate.
+  uint64_t getAllocations() const;
+
+private:
+  /// Buffers smaller than this are not worth pooling separately
+  static const uint32_t MIN_SIZE_CLASS = 6;
+
+  static const uint32_t NUM_SIZE_CLASSES = 33;
+
+  /// Free the cached buffers that exceed maxCachedBytes_, largest first
+  void trim();
+
+  mutable apache::thrift::concurrency::Mutex mutex_;
+
+  /// Buffers of at least 2^i bytes
+  std::vector<uint8_t*> buffers_[NUM_SIZE_CLASSES];
+
+  size_t cachedBytes_;
+  size_t maxCachedBytes_;
+  uint64_t allocations_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TBUFFERPOOL_H_
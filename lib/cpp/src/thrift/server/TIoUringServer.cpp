@@ -0,0 +1,881 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/server/TIoUringServer.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TSocket.h>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stack>
+#include <typeinfo>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::shared_ptr;
+
+namespace {
+
+/**
+ * Minimal io_uring wrapper on top of the raw system calls, so that no
+ * liburing is needed.  Not thread safe: a ring belongs to one IO thread.
+ */
+class Ring {
+public:
+  explicit Ring(unsigned entries)
+    : fd_(-1),
+      sqRing_(MAP_FAILED),
+      cqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      cqRingSize_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqesSize_(0),
+      sqeTail_(0) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    // multishot accept and pipelined clients can complete more than one
+    // request per submission, so give the completion queue some room
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0 && errno == EINVAL) {
+      std::memset(&params, 0, sizeof(params));
+      fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    }
+    if (fd_ < 0) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TIoUringServer io_uring_setup() ", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, "io_uring_setup()", errno_copy);
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+      sqRingSize_ = cqRingSize_ = (std::max)(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                   IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+      fail("mmap() submission queue");
+    }
+    if (singleMmap) {
+      cqRing_ = sqRing_;
+    } else {
+      cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                     IORING_OFF_CQ_RING);
+      if (cqRing_ == MAP_FAILED) {
+        fail("mmap() completion queue");
+      }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      fail("mmap() submission queue entries");
+    }
+
+    auto* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    // entries are always used in order, so the indirection array is fixed
+    auto* sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+      sqArray[i] = i;
+    }
+    sqeTail_ = *sqTail_;
+
+    auto* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  ~Ring() { release(); }
+
+  /**
+   * Returns a cleared submission queue entry, submitting what is queued
+   * already if the submission queue is full.
+   */
+  io_uring_sqe* getSqe() {
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+      submit(0);
+    }
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+      throw TTransportException(TTransportException::UNKNOWN, "io_uring submission queue full");
+    }
+    io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    ++sqeTail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  /**
+   * Submits all queued entries and waits for at least waitNr completions.
+   */
+  void submit(unsigned waitNr) {
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    while (true) {
+      unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+      long ret = syscall(__NR_io_uring_enter, fd_, toSubmit, waitNr,
+                         waitNr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+      if (ret >= 0) {
+        return;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EBUSY) {
+        // the completion queue is backed up; the caller reaps and retries
+        return;
+      }
+      int errno_copy = errno;
+      GlobalOutput.perror("TIoUringServer io_uring_enter() ", errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "io_uring_enter()", errno_copy);
+    }
+  }
+
+  /** Returns the next completion, or nullptr if there is none. */
+  io_uring_cqe* peekCqe() {
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      return nullptr;
+    }
+    return &cqes_[head & cqMask_];
+  }
+
+  /** Marks the completion returned by peekCqe() as consumed. */
+  void cqeSeen() { __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE); }
+
+  bool registerBuffers(const iovec* iovs, unsigned count) {
+    return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iovs, count) == 0;
+  }
+
+private:
+  void fail(const char* what) {
+    int errno_copy = errno;
+    GlobalOutput.perror((std::string("TIoUringServer ") + what + " ").c_str(), errno_copy);
+    release();
+    throw TTransportException(TTransportException::NOT_OPEN, what, errno_copy);
+  }
+
+  void release() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqesSize_);
+      sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+      munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = MAP_FAILED;
+    if (sqRing_ != MAP_FAILED) {
+      munmap(sqRing_, sqRingSize_);
+      sqRing_ = MAP_FAILED;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int fd_;
+  void* sqRing_;
+  void* cqRing_;
+  size_t sqRingSize_;
+  size_t cqRingSize_;
+  io_uring_sqe* sqes_;
+  size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned sqeTail_;
+
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  io_uring_cqe* cqes_;
+};
+
+// user_data values of the requests that do not belong to a connection; a
+// connection's requests carry its (aligned, hence even) address
+const uint64_t ACCEPT_REQUEST = 1;
+const uint64_t WAKEUP_REQUEST = 3;
+const uint64_t CANCEL_REQUEST = 5;
+}
+
+/**
+ * An IO thread: one ring with a listen socket, a wakeup eventfd and all the
+ * connections accepted on that socket.  Each connection has at most one
+ * receive or send in flight and alternates between reading requests and
+ * writing the responses of all requests that arrived together.
+ */
+class TIoUringServer::Loop : public concurrency::Runnable {
+public:
+  Loop(TIoUringServer* server, THRIFT_SOCKET listenSocket, bool ownListenSocket)
+    : server_(server),
+      listenSocket_(listenSocket),
+      ownListenSocket_(ownListenSocket),
+      ring_(server->getQueueDepth()),
+      wakeupFd_(-1),
+      wakeupValue_(0),
+      stopping_(false),
+      inflight_(0),
+      multishotAccept_(true),
+      bufferSize_(server->getBufferSize()),
+      buffers_(MAP_FAILED),
+      buffersSize_(0),
+      numConnections_(0) {
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC);
+    if (wakeupFd_ < 0) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TIoUringServer eventfd() ", errno_copy);
+      throw TTransportException(TTransportException::NOT_OPEN, "eventfd()", errno_copy);
+    }
+    registerBuffers(server->getNumRegisteredBuffers());
+  }
+
+  ~Loop() override {
+    while (!connectionStack_.empty()) {
+      delete connectionStack_.top();
+      connectionStack_.pop();
+    }
+    if (buffers_ != MAP_FAILED) {
+      munmap(buffers_, buffersSize_);
+    }
+    if (wakeupFd_ >= 0) {
+      ::close(wakeupFd_);
+    }
+    if (ownListenSocket_ && listenSocket_ != THRIFT_INVALID_SOCKET) {
+      ::THRIFT_CLOSESOCKET(listenSocket_);
+    }
+  }
+
+  void run() override {
+    armAccept();
+    armWakeup();
+
+    while (!stopping_) {
+      ring_.submit(1);
+      reap();
+    }
+
+    shutdown();
+  }
+
+  /** Makes run() return soon; can be called from any thread. */
+  void stop() {
+    stopping_ = true;
+    uint64_t one = 1;
+    if (write(wakeupFd_, &one, sizeof(one)) < 0) {
+      GlobalOutput.perror("TIoUringServer::stop() write() ", errno);
+    }
+  }
+
+  size_t getNumConnections() const { return numConnections_; }
+
+  void setThread(const shared_ptr<Thread>& thread) { thread_ = thread; }
+
+  void join() {
+    if (thread_) {
+      thread_->join();
+    }
+  }
+
+private:
+  struct Connection {
+    shared_ptr<TSocket> socket;
+    THRIFT_SOCKET fd;
+    size_t index;
+
+    // Receive buffer: a registered slot (bufferIndex >= 0) or heap memory.
+    int bufferIndex;
+    uint8_t* buffer;
+    uint32_t readLen;
+    std::vector<uint8_t> heapBuffer;
+
+    // A frame too large for the receive buffer is assembled here.
+    std::vector<uint8_t> largeFrame;
+    uint32_t largeFramePos;
+
+    bool writing;
+    uint32_t writePos;
+
+    shared_ptr<TMemoryBuffer> inputTransport;
+    shared_ptr<TMemoryBuffer> outputTransport;
+    shared_ptr<TTransport> factoryInputTransport;
+    shared_ptr<TTransport> factoryOutputTransport;
+    shared_ptr<TProtocol> inputProtocol;
+    shared_ptr<TProtocol> outputProtocol;
+    shared_ptr<TProcessor> processor;
+    void* connectionContext;
+
+    Connection()
+      : fd(THRIFT_INVALID_SOCKET),
+        index(0),
+        bufferIndex(-1),
+        buffer(nullptr),
+        readLen(0),
+        largeFramePos(0),
+        writing(false),
+        writePos(0),
+        inputTransport(new TMemoryBuffer()),
+        outputTransport(new TMemoryBuffer()),
+        connectionContext(nullptr) {}
+  };
+
+  void registerBuffers(unsigned count) {
+    if (count == 0) {
+      return;
+    }
+    buffersSize_ = static_cast<size_t>(count) * bufferSize_;
+    buffers_ = mmap(nullptr, buffersSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+    if (buffers_ == MAP_FAILED) {
+      GlobalOutput.perror("TIoUringServer mmap() registered buffers ", errno);
+      return;
+    }
+    std::vector<iovec> iovs(count);
+    for (unsigned i = 0; i < count; ++i) {
+      iovs[i].iov_base = static_cast<uint8_t*>(buffers_) + static_cast<size_t>(i) * bufferSize_;
+      iovs[i].iov_len = bufferSize_;
+    }
+    if (!ring_.registerBuffers(iovs.data(), count)) {
+      // typically RLIMIT_MEMLOCK; plain receives still work
+      GlobalOutput.perror("TIoUringServer: not using registered buffers, io_uring_register() ",
+                          errno);
+      munmap(buffers_, buffersSize_);
+      buffers_ = MAP_FAILED;
+      return;
+    }
+    for (unsigned i = count; i > 0; --i) {
+      freeBuffers_.push_back(static_cast<int>(i - 1));
+    }
+  }
+
+  void armAccept() {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSocket_;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if (multishotAccept_) {
+      sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+    }
+    sqe->user_data = ACCEPT_REQUEST;
+    ++inflight_;
+  }
+
+  void armWakeup() {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeupFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+    sqe->len = sizeof(wakeupValue_);
+    sqe->user_data = WAKEUP_REQUEST;
+    ++inflight_;
+  }
+
+  void armRead(Connection* conn) {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->fd = conn->fd;
+    if (!conn->largeFrame.empty()) {
+      sqe->opcode = IORING_OP_RECV;
+      sqe->addr = reinterpret_cast<uint64_t>(conn->largeFrame.data() + conn->largeFramePos);
+      sqe->len = static_cast<uint32_t>(conn->largeFrame.size()) - conn->largeFramePos;
+    } else {
+      sqe->opcode = conn->bufferIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_RECV;
+      sqe->addr = reinterpret_cast<uint64_t>(conn->buffer + conn->readLen);
+      sqe->len = bufferSize_ - conn->readLen;
+      if (conn->bufferIndex >= 0) {
+        sqe->buf_index = static_cast<uint16_t>(conn->bufferIndex);
+      }
+    }
+    sqe->user_data = reinterpret_cast<uint64_t>(conn);
+    conn->writing = false;
+    ++inflight_;
+  }
+
+  void armWrite(Connection* conn) {
+    uint8_t* buf;
+    uint32_t size;
+    conn->outputTransport->getBuffer(&buf, &size);
+
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf + conn->writePos);
+    sqe->len = size - conn->writePos;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(conn);
+    conn->writing = true;
+    ++inflight_;
+  }
+
+  /** Handles all available completions. */
+  void reap() {
+    while (io_uring_cqe* cqe = ring_.peekCqe()) {
+      uint64_t userData = cqe->user_data;
+      int res = cqe->res;
+      unsigned flags = cqe->flags;
+      ring_.cqeSeen();
+
+      if (!(flags & IORING_CQE_F_MORE)) {
+        --inflight_;
+      }
+
+      if (userData == ACCEPT_REQUEST) {
+        handleAccept(res, flags);
+      } else if (userData == WAKEUP_REQUEST) {
+        if (!stopping_) {
+          armWakeup();
+        }
+      } else if (userData == CANCEL_REQUEST) {
+        // nothing to do
+      } else {
+        auto* conn = reinterpret_cast<Connection*>(userData);
+        if (conn->writing) {
+          handleWrite(conn, res);
+        } else {
+          handleRead(conn, res);
+        }
+      }
+    }
+  }
+
+  void handleAccept(int res, unsigned flags) {
+    if (res >= 0) {
+      if (stopping_) {
+        ::THRIFT_CLOSESOCKET(res);
+      } else {
+        newConnection(res);
+      }
+    } else if (res == -EINVAL && multishotAccept_) {
+      GlobalOutput.printf("TIoUringServer: multishot accept not supported, falling back");
+      multishotAccept_ = false;
+    } else if (res != -ECANCELED && res != -EAGAIN && res != -EINTR) {
+      GlobalOutput.perror("TIoUringServer accept ", -res);
+    }
+
+    if (!(flags & IORING_CQE_F_MORE) && !stopping_) {
+      armAccept();
+    }
+  }
+
+  void newConnection(THRIFT_SOCKET fd) {
+    Connection* conn;
+    if (connectionStack_.empty()) {
+      conn = new Connection();
+    } else {
+      conn = connectionStack_.top();
+      connectionStack_.pop();
+    }
+
+    conn->fd = fd;
+    conn->socket = std::make_shared<TSocket>(fd);
+    conn->readLen = 0;
+    conn->largeFramePos = 0;
+    conn->writePos = 0;
+    if (freeBuffers_.empty()) {
+      conn->bufferIndex = -1;
+      conn->heapBuffer.resize(bufferSize_);
+      conn->buffer = conn->heapBuffer.data();
+    } else {
+      conn->bufferIndex = freeBuffers_.back();
+      freeBuffers_.pop_back();
+      conn->buffer = static_cast<uint8_t*>(buffers_)
+                     + static_cast<size_t>(conn->bufferIndex) * bufferSize_;
+    }
+
+    conn->factoryInputTransport = server_->getInputTransportFactory()->getTransport(
+        conn->inputTransport);
+    conn->factoryOutputTransport = server_->getOutputTransportFactory()->getTransport(
+        conn->outputTransport);
+    conn->inputProtocol = server_->getInputProtocolFactory()->getProtocol(
+        conn->factoryInputTransport);
+    conn->outputProtocol = server_->getOutputProtocolFactory()->getProtocol(
+        conn->factoryOutputTransport);
+
+    shared_ptr<TServerEventHandler> eventHandler = server_->getEventHandler();
+    conn->connectionContext = eventHandler ? eventHandler->createContext(conn->inputProtocol,
+                                                                         conn->outputProtocol)
+                                           : nullptr;
+    conn->processor = server_->getProcessor(conn->inputProtocol, conn->outputProtocol,
+                                            conn->socket);
+
+    conn->index = connections_.size();
+    connections_.push_back(conn);
+    numConnections_ = connections_.size();
+
+    armRead(conn);
+  }
+
+  void closeConnection(Connection* conn) {
+    shared_ptr<TServerEventHandler> eventHandler = server_->getEventHandler();
+    if (eventHandler) {
+      eventHandler->deleteContext(conn->connectionContext, conn->inputProtocol,
+                                  conn->outputProtocol);
+    }
+    conn->connectionContext = nullptr;
+
+    conn->socket->close();
+    conn->socket.reset();
+    conn->fd = THRIFT_INVALID_SOCKET;
+    conn->factoryInputTransport->close();
+    conn->factoryOutputTransport->close();
+    conn->factoryInputTransport.reset();
+    conn->factoryOutputTransport.reset();
+    conn->inputProtocol.reset();
+    conn->outputProtocol.reset();
+    conn->processor.reset();
+    conn->outputTransport->resetBuffer();
+    std::vector<uint8_t>().swap(conn->largeFrame);
+
+    if (conn->bufferIndex >= 0) {
+      freeBuffers_.push_back(conn->bufferIndex);
+      conn->bufferIndex = -1;
+    }
+    conn->buffer = nullptr;
+
+    connections_[conn->index] = connections_.back();
+    connections_[conn->index]->index = conn->index;
+    connections_.pop_back();
+    numConnections_ = connections_.size();
+
+    connectionStack_.push(conn);
+  }
+
+  void handleRead(Connection* conn, int res) {
+    if (res == -EINTR || res == -EAGAIN) {
+      armRead(conn);
+      return;
+    }
+    if (res <= 0 || stopping_) {
+      if (res < 0 && res != -ECONNRESET && res != -ECANCELED) {
+        GlobalOutput.perror("TIoUringServer recv ", -res);
+      }
+      closeConnection(conn);
+      return;
+    }
+
+    if (!conn->largeFrame.empty()) {
+      conn->largeFramePos += static_cast<uint32_t>(res);
+      if (conn->largeFramePos < conn->largeFrame.size()) {
+        armRead(conn);
+        return;
+      }
+      bool ok = processFrame(conn, conn->largeFrame.data() + 4,
+                             static_cast<uint32_t>(conn->largeFrame.size()) - 4);
+      std::vector<uint8_t>().swap(conn->largeFrame);
+      conn->largeFramePos = 0;
+      if (!ok) {
+        closeConnection(conn);
+        return;
+      }
+    } else {
+      conn->readLen += static_cast<uint32_t>(res);
+      if (!processBuffer(conn)) {
+        closeConnection(conn);
+        return;
+      }
+    }
+
+    uint8_t* buf;
+    uint32_t size;
+    conn->outputTransport->getBuffer(&buf, &size);
+    if (size > 0) {
+      conn->writePos = 0;
+      armWrite(conn);
+    } else {
+      armRead(conn);
+    }
+  }
+
+  /**
+   * Processes every complete frame in the receive buffer, appending the
+   * responses to the output buffer.  Returns false if the connection must
+   * be closed.
+   */
+  bool processBuffer(Connection* conn) {
+    uint32_t pos = 0;
+    while (conn->readLen - pos >= 4) {
+      uint32_t frameSize;
+      std::memcpy(&frameSize, conn->buffer + pos, 4);
+      frameSize = ntohl(frameSize);
+
+      if (frameSize > server_->getMaxFrameSize()) {
+        GlobalOutput.printf("TIoUringServer: frame size too large (%u > %u), closing connection",
+                            frameSize, server_->getMaxFrameSize());
+        return false;
+      }
+
+      if (frameSize > bufferSize_ - 4) {
+        // continue receiving this frame into a buffer of its own
+        conn->largeFrame.resize(4 + static_cast<size_t>(frameSize));
+        conn->largeFramePos = conn->readLen - pos;
+        std::memcpy(conn->largeFrame.data(), conn->buffer + pos, conn->largeFramePos);
+        pos = conn->readLen;
+        break;
+      }
+      if (conn->readLen - pos - 4 < frameSize) {
+        break;
+      }
+      if (!processFrame(conn, conn->buffer + pos + 4, frameSize)) {
+        return false;
+      }
+      pos += 4 + frameSize;
+    }
+
+    if (pos > 0) {
+      std::memmove(conn->buffer, conn->buffer + pos, conn->readLen - pos);
+      conn->readLen -= pos;
+    }
+    return true;
+  }
+
+  bool processFrame(Connection* conn, uint8_t* frame, uint32_t frameSize) {
+    uint32_t before = conn->outputTransport->available_read();
+
+    conn->inputTransport->resetBuffer(frame, frameSize);
+    // leave room for the frame size of the response
+    conn->outputTransport->getWritePtr(4);
+    conn->outputTransport->wroteBytes(4);
+
+    try {
+      shared_ptr<TServerEventHandler> eventHandler = server_->getEventHandler();
+      if (eventHandler) {
+        eventHandler->processContext(conn->connectionContext, conn->socket);
+      }
+      conn->processor->process(conn->inputProtocol, conn->outputProtocol,
+                               conn->connectionContext);
+    } catch (const TTransportException& ttx) {
+      GlobalOutput.printf("TIoUringServer transport error in process(): %s", ttx.what());
+      return false;
+    } catch (const std::exception& x) {
+      GlobalOutput.printf("TIoUringServer::process() uncaught exception: %s: %s",
+                          typeid(x).name(), x.what());
+      return false;
+    } catch (...) {
+      GlobalOutput.printf("TIoUringServer::process() unknown exception");
+      return false;
+    }
+
+    uint8_t* buf;
+    uint32_t size;
+    conn->outputTransport->getBuffer(&buf, &size);
+    uint32_t responseSize = size - before - 4;
+    if (responseSize > 0) {
+      uint32_t framing = htonl(responseSize);
+      std::memcpy(buf + before, &framing, 4);
+    } else if (before == 0) {
+      // oneway request, drop the room left for the frame size again
+      conn->outputTransport->resetBuffer();
+    } else {
+      std::string pending(reinterpret_cast<const char*>(buf), before);
+      conn->outputTransport->resetBuffer();
+      conn->outputTransport->write(reinterpret_cast<const uint8_t*>(pending.data()), before);
+    }
+    return true;
+  }
+
+  void handleWrite(Connection* conn, int res) {
+    if (res == -EINTR || res == -EAGAIN) {
+      armWrite(conn);
+      return;
+    }
+    if (res < 0 || stopping_) {
+      if (res < 0 && res != -EPIPE && res != -ECONNRESET && res != -ECANCELED) {
+        GlobalOutput.perror("TIoUringServer send ", -res);
+      }
+      closeConnection(conn);
+      return;
+    }
+
+    conn->writePos += static_cast<uint32_t>(res);
+    if (conn->writePos < conn->outputTransport->available_read()) {
+      armWrite(conn);
+      return;
+    }
+
+    conn->writePos = 0;
+    conn->outputTransport->resetBuffer();
+    armRead(conn);
+  }
+
+  /**
+   * Cancels the outstanding requests and closes all connections.  Requests
+   * can still write into connection buffers until they completed, so we
+   * have to wait for them before letting go of the memory.
+   */
+  void shutdown() {
+    io_uring_sqe* sqe = ring_.getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = ACCEPT_REQUEST;
+    sqe->user_data = CANCEL_REQUEST;
+    ++inflight_;
+
+    for (Connection* conn : connections_) {
+      ::shutdown(conn->fd, SHUT_RDWR);
+    }
+
+    while (inflight_ > 0) {
+      ring_.submit(1);
+      reap();
+    }
+
+    while (!connections_.empty()) {
+      closeConnection(connections_.back());
+    }
+  }
+
+  TIoUringServer* server_;
+  THRIFT_SOCKET listenSocket_;
+  bool ownListenSocket_;
+  Ring ring_;
+
+  int wakeupFd_;
+  uint64_t wakeupValue_;
+  std::atomic<bool> stopping_;
+
+  /// Requests submitted whose final completion has not been reaped yet
+  size_t inflight_;
+
+  bool multishotAccept_;
+
+  const uint32_t bufferSize_;
+  void* buffers_;
+  size_t buffersSize_;
+  std::vector<int> freeBuffers_;
+
+  std::vector<Connection*> connections_;
+  std::stack<Connection*> connectionStack_;
+  std::atomic<size_t> numConnections_;
+
+  shared_ptr<Thread> thread_;
+};
+
+TIoUringServer::~TIoUringServer() = default;
+
+void TIoUringServer::serve() {
+  serverTransport_->listen();
+
+  {
+    Guard g(loopsMutex_);
+    assert(loops_.empty());
+    size_t numIOThreads = numIOThreads_ ? numIOThreads_ : 1;
+    for (size_t id = 0; id < numIOThreads; ++id) {
+      // the first IO thread listens on the server socket, the others on
+      // sockets of their own sharing its port
+      if (id == 0) {
+        loops_.push_back(std::make_shared<Loop>(this, serverTransport_->getSocketFD(), false));
+      } else {
+        THRIFT_SOCKET listenSocket = serverTransport_->listenReusePort();
+        loops_.push_back(std::make_shared<Loop>(this, listenSocket, true));
+      }
+    }
+    if (stopped_) {
+      for (auto& loop : loops_) {
+        loop->stop();
+      }
+    }
+  }
+
+  // Notify handler of the preServe event
+  if (eventHandler_) {
+    eventHandler_->preServe();
+  }
+
+  GlobalOutput.printf("TIoUringServer: Serving with %d io threads.",
+                      static_cast<int>(loops_.size()));
+
+  if (loops_.size() > 1) {
+    ioThreadFactory_.reset(new ThreadFactory(false));
+    for (size_t i = 1; i < loops_.size(); ++i) {
+      shared_ptr<Thread> thread = ioThreadFactory_->newThread(loops_[i]);
+      loops_[i]->setThread(thread);
+      thread->start();
+    }
+  }
+
+  loops_[0]->run();
+
+  for (size_t i = 1; i < loops_.size(); ++i) {
+    loops_[i]->join();
+    // break the cycle between thread and runnable
+    loops_[i]->setThread(shared_ptr<Thread>());
+  }
+
+  Guard g(loopsMutex_);
+  loops_.clear();
+  stopped_ = false;
+}
+
+void TIoUringServer::stop() {
+  Guard g(loopsMutex_);
+  stopped_ = true;
+  for (auto& loop : loops_) {
+    loop->stop();
+  }
+}
+
+size_t TIoUringServer::getNumConnections() const {
+  Guard g(loopsMutex_);
+  size_t count = 0;
+  for (const auto& loop : loops_) {
+    count += loop->getNumConnections();
+  }
+  return count;
+}
+}
+}
+} // apache::thrift::server
+
+#endif // HAVE_LINUX_IO_URING_H
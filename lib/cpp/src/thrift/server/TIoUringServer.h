@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_SERVER_TIOURINGSERVER_H_
+#define _THRIFT_SERVER_TIOURINGSERVER_H_ 1
+
+#include <thrift/Thrift.h>
+#include <thrift/server/TServer.h>
+#include <thrift/transport/TNonblockingServerTransport.h>
+#include <thrift/concurrency/Mutex.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <memory>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace server {
+
+/**
+ * A Linux io_uring based server for framed Thrift protocols.
+ *
+ * Like TNonblockingServer it expects TFramedTransport on the client side and
+ * processes requests on its IO threads, but instead of waiting for socket
+ * readiness with libevent and then issuing one read() or write() per
+ * operation, every IO thread submits its receives, sends and a multishot
+ * accept to an io_uring and reaps their completions in batches, so a busy
+ * thread needs a single system call per loop iteration.  Receives go into
+ * registered buffers where possible.
+ *
+ * With more than one IO thread each thread accepts on its own SO_REUSEPORT
+ * listen socket obtained from TNonblockingServerTransport::listenReusePort(),
+ * e.g. from a TNonblockingServerSocket with setReusePort(true).
+ *
+ * Only available on Linux hosts with io_uring support.
+ */
+class TIoUringServer : public TServer {
+public:
+  /// Default number of submission queue entries per IO thread
+  static const unsigned DEFAULT_QUEUE_DEPTH = 256;
+
+  /// Default number of registered receive buffers per IO thread
+  static const unsigned DEFAULT_REGISTERED_BUFFERS = 256;
+
+  /// Default size of a receive buffer
+  static const unsigned DEFAULT_BUFFER_SIZE = 16 * 1024;
+
+  /// Default limit on frame size
+  static const uint32_t MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+  TIoUringServer(const std::shared_ptr<TProcessorFactory>& processorFactory,
+                 const std::shared_ptr<transport::TNonblockingServerTransport>& serverTransport)
+    : TServer(processorFactory), serverTransport_(serverTransport) {
+    init();
+  }
+
+  TIoUringServer(const std::shared_ptr<TProcessor>& processor,
+                 const std::shared_ptr<transport::TNonblockingServerTransport>& serverTransport)
+    : TServer(processor), serverTransport_(serverTransport) {
+    init();
+  }
+
+  TIoUringServer(const std::shared_ptr<TProcessorFactory>& processorFactory,
+                 const std::shared_ptr<TProtocolFactory>& protocolFactory,
+                 const std::shared_ptr<transport::TNonblockingServerTransport>& serverTransport)
+    : TServer(processorFactory), serverTransport_(serverTransport) {
+    init();
+
+    setInputProtocolFactory(protocolFactory);
+    setOutputProtocolFactory(protocolFactory);
+  }
+
+  TIoUringServer(const std::shared_ptr<TProcessor>& processor,
+                 const std::shared_ptr<TProtocolFactory>& protocolFactory,
+                 const std::shared_ptr<transport::TNonblockingServerTransport>& serverTransport)
+    : TServer(processor), serverTransport_(serverTransport) {
+    init();
+
+    setInputProtocolFactory(protocolFactory);
+    setOutputProtocolFactory(protocolFactory);
+  }
+
+  ~TIoUringServer() override;
+
+  /**
+   * Starts listening and runs the first IO thread's loop in the calling
+   * thread until stop() is called.
+   *
+   * @throws TTransportException if io_uring is not available or the listen
+   *                             sockets could not be created
+   */
+  void serve() override;
+
+  /**
+   * Causes the server to terminate gracefully (can be called from any thread).
+   */
+  void stop() override;
+
+  int getListenPort() { return serverTransport_->getListenPort(); }
+
+  /**
+   * Sets the number of IO threads used by this server. Can only be used before
+   * the call to serve() and has no effect afterwards.
+   */
+  void setNumIOThreads(size_t numThreads) { numIOThreads_ = numThreads; }
+
+  /** Return the number of IO threads used by this server. */
+  size_t getNumIOThreads() const { return numIOThreads_; }
+
+  /** Set the number of submission queue entries of each IO thread's ring. */
+  void setQueueDepth(unsigned depth) { queueDepth_ = depth; }
+
+  unsigned getQueueDepth() const { return queueDepth_; }
+
+  /**
+   * Set how many receive buffers each IO thread registers with its ring.
+   * Connections beyond that receive into ordinary heap buffers.  0 disables
+   * registered buffers.
+   */
+  void setNumRegisteredBuffers(unsigned count) { numRegisteredBuffers_ = count; }
+
+  unsigned getNumRegisteredBuffers() const { return numRegisteredBuffers_; }
+
+  /**
+   * Set the size of the per-connection receive buffer.  Frames that do not
+   * fit are assembled in a separate buffer of their own size.
+   */
+  void setBufferSize(unsigned size) { bufferSize_ = size; }
+
+  unsigned getBufferSize() const { return bufferSize_; }
+
+  /** Set the maximum frame size accepted from clients. */
+  void setMaxFrameSize(uint32_t maxFrameSize) { maxFrameSize_ = maxFrameSize; }
+
+  uint32_t getMaxFrameSize() const { return maxFrameSize_; }
+
+  /** Return the number of open connections over all IO threads. */
+  size_t getNumConnections() const;
+
+private:
+  class Loop;
+  friend class Loop;
+
+  void init() {
+    numIOThreads_ = 1;
+    queueDepth_ = DEFAULT_QUEUE_DEPTH;
+    numRegisteredBuffers_ = DEFAULT_REGISTERED_BUFFERS;
+    bufferSize_ = DEFAULT_BUFFER_SIZE;
+    maxFrameSize_ = MAX_FRAME_SIZE;
+    stopped_ = false;
+  }
+
+  std::shared_ptr<transport::TNonblockingServerTransport> serverTransport_;
+
+  size_t numIOThreads_;
+  unsigned queueDepth_;
+  unsigned numRegisteredBuffers_;
+  unsigned bufferSize_;
+  uint32_t maxFrameSize_;
+
+  /// Guards loops_ and stopped_ against a concurrent stop()
+  mutable concurrency::Mutex loopsMutex_;
+  std::vector<std::shared_ptr<Loop> > loops_;
+  bool stopped_;
+  std::shared_ptr<concurrency::ThreadFactory> ioThreadFactory_;
+};
+}
+}
+} // apache::thrift::server
+
+#endif // #ifndef _THRIFT_SERVER_TIOURINGSERVER_H_
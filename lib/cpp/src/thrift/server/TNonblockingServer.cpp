@@ -63,6 +63,10 @@
 #include <sched.h>
 #endif
 
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
 #ifndef AF_LOCAL
 #define AF_LOCAL AF_UNIX
 #endif
@@ -224,8 +228,13 @@ public:
     // Allocate input and output transports these only need to be allocated
     // once per TConnection (they don't need to be reallocated on init() call)
     inputTransport_.reset(new TMemoryBuffer(readBuffer_, readBufferSize_));
-    outputTransport_.reset(
-        new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    if (server_->useBufferPool()) {
+      // the write buffer is borrowed for each request
+      outputTransport_.reset(new TMemoryBuffer(nullptr, 0, TMemoryBuffer::TAKE_OWNERSHIP));
+    } else {
+      outputTransport_.reset(
+          new TMemoryBuffer(static_cast<uint32_t>(server_->getWriteBufferDefaultSize())));
+    }
 
     tSocket_ =  socket;
 
@@ -245,6 +254,12 @@ public:
     */
   void checkIdleBufferMemLimit(size_t readLimit, size_t writeLimit);
 
+  /// Give the read buffer back to the IO thread's buffer pool.
+  void releaseReadBuffer();
+
+  /// Give the write buffer back to the IO thread's buffer pool.
+  void releaseWriteBuffer();
+
   /// Initialize
   void init(TNonblockingIOThread* ioThread);
 
@@ -298,6 +313,18 @@ public:
     }
   }
 
+  /**
+   * Closes a connection that notifyIOThread() queued for its IO thread, but
+   * that the IO thread will never pick up, since it could not be woken up.
+   */
+  void closeUnnotified() {
+    // only fresh connections don't hold an active processor
+    if (appState_ != APP_INIT) {
+      server_->decrementActiveProcessors();
+    }
+    close();
+  }
+
   /// return the server this connection was initialized for.
   TNonblockingServer* getServer() const { return server_; }
 
@@ -593,6 +620,12 @@ void TNonblockingServer::TConnection::transition() {
   case APP_READ_REQUEST:
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
+    if (server_->useBufferPool()) {
+      uint32_t capacity;
+      uint8_t* buffer = ioThread_->getBufferPool().acquire(
+          static_cast<uint32_t>(server_->getWriteBufferDefaultSize()), &capacity);
+      outputTransport_->resetBuffer(buffer, capacity, TMemoryBuffer::TAKE_OWNERSHIP);
+    }
     if (server_->getHeaderTransport()) {
       inputTransport_->resetBuffer(readBuffer_, readBufferPos_);
       outputTransport_->resetBuffer();
@@ -678,6 +711,10 @@ void TNonblockingServer::TConnection::transition() {
     // the writeBuffer_ for actual writing by the libevent thread
 
     server_->decrementActiveProcessors();
+    // The request has been processed
+    if (server_->useBufferPool()) {
+      releaseReadBuffer();
+    }
     // Get the result of the operation
     outputTransport_->getBuffer(&writeBuffer_, &writeBufferSize_);
 
@@ -706,15 +743,18 @@ void TNonblockingServer::TConnection::transition() {
     goto LABEL_APP_INIT;
 
   case APP_SEND_RESULT:
-    // it's now safe to perform buffer size housekeeping.
-    if (writeBufferSize_ > largestWriteBufferSize_) {
-      largestWriteBufferSize_ = writeBufferSize_;
-    }
-    if (server_->getResizeBufferEveryN() > 0
-        && ++callsForResize_ >= server_->getResizeBufferEveryN()) {
-      checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
-                              server_->getIdleWriteBufferLimit());
-      callsForResize_ = 0;
+    // it's now safe to perform buffer size housekeeping (pooled buffers are
+    // returned below instead).
+    if (!server_->useBufferPool()) {
+      if (writeBufferSize_ > largestWriteBufferSize_) {
+        largestWriteBufferSize_ = writeBufferSize_;
+      }
+      if (server_->getResizeBufferEveryN() > 0
+          && ++callsForResize_ >= server_->getResizeBufferEveryN()) {
+        checkIdleBufferMemLimit(server_->getIdleReadBufferLimit(),
+                                server_->getIdleWriteBufferLimit());
+        callsForResize_ = 0;
+      }
     }
     // fallthrough
 
@@ -727,6 +767,9 @@ void TNonblockingServer::TConnection::transition() {
     writeBuffer_ = nullptr;
     writeBufferPos_ = 0;
     writeBufferSize_ = 0;
+    if (server_->useBufferPool()) {
+      releaseWriteBuffer();
+    }
 
     // Into read4 state we go
     socketState_ = SOCKET_RECV_FRAMING;
@@ -743,8 +786,11 @@ void TNonblockingServer::TConnection::transition() {
     readWant_ += 4;
 
     // We just read the request length
-    // Double the buffer size until it is big enough
-    if (readWant_ > readBufferSize_) {
+    if (server_->useBufferPool()) {
+      // Borrow a buffer until the request has been processed
+      readBuffer_ = ioThread_->getBufferPool().acquire(readWant_, &readBufferSize_);
+    } else if (readWant_ > readBufferSize_) {
+      // Double the buffer size until it is big enough
       if (readBufferSize_ == 0) {
         readBufferSize_ = 1;
       }
@@ -847,6 +893,10 @@ void TNonblockingServer::TConnection::close() {
   if (serverEventHandler_) {
     serverEventHandler_->deleteContext(connectionContext_, inputProtocol_, outputProtocol_);
   }
+  if (server_->useBufferPool()) {
+    releaseReadBuffer();
+    releaseWriteBuffer();
+  }
   ioThread_ = nullptr;
 
   // Close the socket
@@ -863,7 +913,25 @@ void TNonblockingServer::TConnection::close() {
   server_->returnConnection(this);
 }
 
+void TNonblockingServer::TConnection::releaseReadBuffer() {
+  ioThread_->getBufferPool().release(readBuffer_, readBufferSize_);
+  readBuffer_ = nullptr;
+  readBufferSize_ = 0;
+  inputTransport_->resetBuffer(nullptr, 0);
+}
+
+void TNonblockingServer::TConnection::releaseWriteBuffer() {
+  uint32_t capacity;
+  uint8_t* buffer = outputTransport_->releaseBuffer(&capacity);
+  ioThread_->getBufferPool().release(buffer, capacity);
+}
+
 void TNonblockingServer::TConnection::checkIdleBufferMemLimit(size_t readLimit, size_t writeLimit) {
+  if (server_->useBufferPool()) {
+    // idle connections hold no buffers
+    return;
+  }
+
   if (readLimit > 0 && readBufferSize_ > readLimit) {
     free(readBuffer_);
     readBuffer_ = nullptr;
@@ -902,16 +970,19 @@ TNonblockingServer::~TNonblockingServer() {
  * Creates a new connection either by reusing an object off the stack or
  * by allocating a new one entirely
  */
-TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket) {
+TNonblockingServer::TConnection* TNonblockingServer::createConnection(std::shared_ptr<TSocket> socket,
+                                                                      TNonblockingIOThread* ioThread) {
   // Check the stack
   Guard g(connMutex_);
 
   // pick an IO thread to handle this connection -- currently round robin
-  assert(nextIOThread_ < ioThreads_.size());
-  int selectedThreadIdx = nextIOThread_;
-  nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
+  if (ioThread == nullptr) {
+    assert(nextIOThread_ < ioThreads_.size());
+    int selectedThreadIdx = nextIOThread_;
+    nextIOThread_ = static_cast<uint32_t>((nextIOThread_ + 1) % ioThreads_.size());
 
-  TNonblockingIOThread* ioThread = ioThreads_[selectedThreadIdx].get();
+    ioThread = ioThreads_[selectedThreadIdx].get();
+  }
 
   // Check the connection stack to see if we can re-use
   TConnection* result = nullptr;
@@ -952,15 +1023,17 @@ void TNonblockingServer::returnConnection(TConnection* connection) {
  * Server socket had something happen.  We accept all waiting client
  * connections on fd and assign TConnection objects to handle those requests.
  */
-void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
+void TNonblockingServer::handleEvent(THRIFT_SOCKET fd,
+                                     short which,
+                                     TNonblockingIOThread* ioThread) {
   (void)which;
   // Make sure that libevent didn't mess up the socket handles
-  assert(fd == serverSocket_);
+  assert(fd == serverSocket_ || useReusePortAcceptors_);
 
   // Going to accept a new client socket
   std::shared_ptr<TSocket> clientSocket;
 
-  clientSocket = serverTransport_->accept();
+  clientSocket = serverTransport_->accept(fd);
   if (clientSocket) {
     // If we're overloaded, take action here
     if (overloadAction_ != T_OVERLOAD_NO_ACTION && serverOverloaded()) {
@@ -979,8 +1052,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
       }
     }
 
-    // Create a new TConnection for this client socket.
-    TConnection* clientConnection = createConnection(clientSocket);
+    // Create a new TConnection for this client socket.  With per-thread
+    // acceptors the connection stays on the thread that accepted it.
+    TConnection* clientConnection
+        = createConnection(clientSocket, useReusePortAcceptors_ ? ioThread : nullptr);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == nullptr) {
@@ -997,11 +1072,10 @@ void TNonblockingServer::handleEvent(THRIFT_SOCKET fd, short which) {
      * (We need to avoid writing to our own notification pipe, to
      * avoid possible deadlocks if the pipe is full.)
      *
-     * The IO thread #0 is the only one that handles these listen
-     * events, so unless the connection has been assigned to thread #0
-     * we know it's not on our thread.
+     * The connection is on our thread if it was assigned to the IO
+     * thread that handled this listen event.
      */
-    if (clientConnection->getIOThreadNumber() == 0) {
+    if (clientConnection->getIOThreadNumber() == ioThread->getThreadNumber()) {
       clientConnection->transition();
     } else {
       if (!clientConnection->notifyIOThread()) {
@@ -1076,6 +1150,38 @@ void TNonblockingServer::expireClose(std::shared_ptr<Runnable> task) {
   connection->forceClose();
 }
 
+uint64_t TNonblockingServer::getNumNotifyWakeups() const {
+  uint64_t wakeups = 0;
+  for (const auto& ioThread : ioThreads_) {
+    wakeups += ioThread->getNotifyWakeups();
+  }
+  return wakeups;
+}
+
+uint64_t TNonblockingServer::getNumNotifyCompletions() const {
+  uint64_t completions = 0;
+  for (const auto& ioThread : ioThreads_) {
+    completions += ioThread->getNotifyCompletions();
+  }
+  return completions;
+}
+
+uint64_t TNonblockingServer::getNumBufferPoolAllocations() const {
+  uint64_t allocations = 0;
+  for (const auto& ioThread : ioThreads_) {
+    allocations += ioThread->getBufferPool().getAllocations();
+  }
+  return allocations;
+}
+
+size_t TNonblockingServer::getBufferPoolCachedBytes() const {
+  size_t bytes = 0;
+  for (const auto& ioThread : ioThreads_) {
+    bytes += ioThread->getBufferPool().getCachedBytes();
+  }
+  return bytes;
+}
+
 void TNonblockingServer::stop() {
   // Breaks the event loop in all threads so that they end ASAP.
   for (auto & ioThread : ioThreads_) {
@@ -1099,8 +1205,14 @@ void TNonblockingServer::registerEvents(event_base* user_event_base) {
   assert(numIOThreads_ == 1 || !userEventBase_);
 
   for (uint32_t id = 0; id < numIOThreads_; ++id) {
-    // the first IO thread also does the listening on server socket
-    THRIFT_SOCKET listenFd = (id == 0 ? serverSocket_ : THRIFT_INVALID_SOCKET);
+    // the first IO thread also does the listening on server socket; with
+    // SO_REUSEPORT acceptors every other one gets a listen socket of its own
+    THRIFT_SOCKET listenFd = THRIFT_INVALID_SOCKET;
+    if (id == 0) {
+      listenFd = serverSocket_;
+    } else if (useReusePortAcceptors_) {
+      listenFd = serverTransport_->listenReusePort();
+    }
 
     shared_ptr<TNonblockingIOThread> thread(
         new TNonblockingIOThread(this, id, listenFd, useHighPriorityIOThreads_));
@@ -1172,7 +1284,12 @@ TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
     eventBase_(nullptr),
     ownEventBase_(false),
     serverEvent_{},
-    notificationEvent_{} {
+    notificationEvent_{},
+    notifyStop_(false),
+    notifyPending_(false),
+    notifyWakeups_(0),
+    notifyCompletions_(0),
+    bufferPool_(server->getBufferPoolCacheLimit()) {
   notificationPipeFDs_[0] = -1;
   notificationPipeFDs_[1] = -1;
 }
@@ -1193,7 +1310,11 @@ TNonblockingIOThread::~TNonblockingIOThread() {
     listenSocket_ = THRIFT_INVALID_SOCKET;
   }
 
-  for (auto notificationPipeFD : notificationPipeFDs_) {
+  // an eventfd is both ends of the pipe
+  if (notificationPipeFDs_[1] == notificationPipeFDs_[0]) {
+    notificationPipeFDs_[1] = THRIFT_INVALID_SOCKET;
+  }
+  for (auto& notificationPipeFD : notificationPipeFDs_) {
     if (notificationPipeFD >= 0) {
       if (0 != ::THRIFT_CLOSESOCKET(notificationPipeFD)) {
         GlobalOutput.perror("TNonblockingIOThread notificationPipe close(): ",
@@ -1205,6 +1326,17 @@ TNonblockingIOThread::~TNonblockingIOThread() {
 }
 
 void TNonblockingIOThread::createNotificationPipe() {
+#ifdef HAVE_SYS_EVENTFD_H
+  // Only a wakeup is passed through the pipe, so an eventfd does the job
+  // with a single descriptor and no buffer to fill up.
+  int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd >= 0) {
+    notificationPipeFDs_[0] = efd;
+    notificationPipeFDs_[1] = efd;
+    return;
+  }
+  GlobalOutput.perror("TNonblockingServer::createNotificationPipe eventfd ", errno);
+#endif
   if (evutil_socketpair(AF_LOCAL, SOCK_STREAM, 0, notificationPipeFDs_) == -1) {
     GlobalOutput.perror("TNonblockingServer::createNotificationPipe ", EVUTIL_SOCKET_ERROR());
     throw TException("can't create notification pipe");
@@ -1258,7 +1390,7 @@ void TNonblockingIOThread::registerEvents() {
               listenSocket_,
               EV_READ | EV_PERSIST,
               TNonblockingIOThread::listenHandler,
-              server_);
+              this);
     event_base_set(eventBase_, &serverEvent_);
 
     // Add the event and start up the server
@@ -1292,14 +1424,70 @@ void TNonblockingIOThread::registerEvents() {
 }
 
 bool TNonblockingIOThread::notify(TNonblockingServer::TConnection* conn) {
+  if (getNotificationSendFD() < 0) {
+    return false;
+  }
+
+  // Queue the connection and only write to the pipe if no wakeup is pending
+  // already; notifyHandler() drains everything queued until then at once.
+  bool signal;
+  {
+    Guard g(notifyMutex_);
+    if (conn == nullptr) {
+      notifyStop_ = true;
+    } else {
+      notifyQueue_.push_back(conn);
+    }
+    signal = !notifyPending_;
+    notifyPending_ = true;
+  }
+
+  if (signal && !signalNotification()) {
+    // The connections other threads queued behind ours would wait for this
+    // wakeup forever.  Our caller closes conn, close the others here.
+    std::vector<TNonblockingServer::TConnection*> unnotified;
+    {
+      Guard g(notifyMutex_);
+      notifyPending_ = false;
+      unnotified.swap(notifyQueue_);
+    }
+    for (auto connection : unnotified) {
+      if (connection != conn) {
+        connection->closeUnnotified();
+      }
+    }
+    return false;
+  }
+  return true;
+}
+
+bool TNonblockingIOThread::signalNotification() {
   auto fd = getNotificationSendFD();
   if (fd < 0) {
     return false;
   }
 
+#ifdef HAVE_SYS_EVENTFD_H
+  if (fd == getNotificationRecvFD()) {
+    const uint64_t one = 1;
+    while (true) {
+      ssize_t ret = write(fd, &one, sizeof(one));
+      if (ret == static_cast<ssize_t>(sizeof(one))) {
+        return true;
+      }
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      // EAGAIN means the counter is saturated, so the reader is woken anyway
+      return ret < 0 && errno == EAGAIN;
+    }
+  }
+#endif
+
   int ret = -1;
-  long kSize = sizeof(conn);
-  const char * pos = (const char *)const_cast_sockopt(&conn);
+  const char token = 0;
+  long kSize = sizeof(token);
+  const char * pos = &token;
 
 #if defined(HAVE_POLL_H) || defined(HAVE_SYS_POLL_H)
   struct pollfd pfd = {fd, POLLOUT, 0};
@@ -1379,38 +1567,56 @@ void TNonblockingIOThread::notifyHandler(evutil_socket_t fd, short which, void*
   assert(ioThread);
   (void)which;
 
-  while (true) {
-    TNonblockingServer::TConnection* connection = nullptr;
-    const int kSize = sizeof(connection);
-    long nBytes = recv(fd, cast_sockopt(&connection), kSize, 0);
-    if (nBytes == kSize) {
-      if (connection == nullptr) {
-        // this is the command to stop our thread, exit the handler!
-        ioThread->breakLoop(false);
-        return;
-      }
-      connection->transition();
-    } else if (nBytes > 0) {
-      // throw away these bytes and hope that next time we get a solid read
-      GlobalOutput.printf("notifyHandler: Bad read of %d bytes, wanted %d", nBytes, kSize);
+  // Consume the wakeup before looking at the queue, so that a notify()
+  // racing with us either ends up in this batch or writes a new wakeup.
+#ifdef HAVE_SYS_EVENTFD_H
+  if (fd == ioThread->getNotificationSendFD()) {
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      GlobalOutput.perror("TNonblocking: notifyHandler read() failed: ", errno);
       ioThread->breakLoop(true);
       return;
-    } else if (nBytes == 0) {
+    }
+  } else
+#endif
+  {
+    char buf[64];
+    long nBytes = recv(fd, cast_sockopt(buf), sizeof(buf), 0);
+    if (nBytes == 0) {
       GlobalOutput.printf("notifyHandler: Notify socket closed!");
       ioThread->breakLoop(false);
-      // exit the loop
-      break;
-    } else { // nBytes < 0
+      return;
+    } else if (nBytes < 0) {
       if (THRIFT_GET_SOCKET_ERROR != THRIFT_EWOULDBLOCK
           && THRIFT_GET_SOCKET_ERROR != THRIFT_EAGAIN) {
         GlobalOutput.perror("TNonblocking: notifyHandler read() failed: ", THRIFT_GET_SOCKET_ERROR);
         ioThread->breakLoop(true);
         return;
       }
-      // exit the loop
-      break;
     }
   }
+
+  bool stop;
+  {
+    Guard g(ioThread->notifyMutex_);
+    ioThread->notifyBatch_.swap(ioThread->notifyQueue_);
+    stop = ioThread->notifyStop_;
+    ioThread->notifyStop_ = false;
+    ioThread->notifyPending_ = false;
+  }
+
+  ioThread->notifyWakeups_++;
+  ioThread->notifyCompletions_ += ioThread->notifyBatch_.size();
+
+  for (auto connection : ioThread->notifyBatch_) {
+    connection->transition();
+  }
+  ioThread->notifyBatch_.clear();
+
+  if (stop) {
+    // this is the command to stop our thread
+    ioThread->breakLoop(false);
+  }
 }
 
 void TNonblockingIOThread::breakLoop(bool error) {
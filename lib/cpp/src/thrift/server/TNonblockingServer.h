@@ -23,6 +23,7 @@
 #include <thrift/Thrift.h>
 #include <memory>
 #include <thrift/server/TServer.h>
+#include <thrift/server/TBufferPool.h>
 #include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TSocket.h>
@@ -32,6 +33,7 @@
 #include <thrift/concurrency/Thread.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Mutex.h>
+#include <atomic>
 #include <stack>
 #include <vector>
 #include <string>
@@ -152,6 +154,15 @@ private:
   /// Whether to set high scheduling priority for IO threads
   bool useHighPriorityIOThreads_;
 
+  /// Whether every IO thread accepts on its own SO_REUSEPORT listen socket
+  bool useReusePortAcceptors_;
+
+  /// Whether connections borrow their buffers from their IO thread's pool
+  bool useBufferPool_;
+
+  /// Limit on the memory each IO thread's buffer pool keeps
+  size_t bufferPoolCacheLimit_;
+
   /// Server socket file descriptor
   THRIFT_SOCKET serverSocket_;
 
@@ -271,14 +282,18 @@ private:
    * to handle those requests.
    *
    * @param which the event flag that triggered the handler.
+   * @param ioThread the IO thread owning the listen socket.
    */
-  void handleEvent(THRIFT_SOCKET fd, short which);
+  void handleEvent(THRIFT_SOCKET fd, short which, TNonblockingIOThread* ioThread);
 
   void init() {
     serverSocket_ = THRIFT_INVALID_SOCKET;
     numIOThreads_ = DEFAULT_IO_THREADS;
     nextIOThread_ = 0;
     useHighPriorityIOThreads_ = false;
+    useReusePortAcceptors_ = false;
+    useBufferPool_ = false;
+    bufferPoolCacheLimit_ = TBufferPool::DEFAULT_MAX_CACHED_BYTES;
     userEventBase_ = nullptr;
     threadPoolProcessing_ = false;
     numTConnections_ = 0;
@@ -399,9 +414,77 @@ public:
   /** Set whether the IO threads will get high scheduling priority. */
   void setUseHighPriorityIOThreads(bool val) { useHighPriorityIOThreads_ = val; }
 
+  /** Return whether each IO thread accepts on its own listen socket. */
+  bool useReusePortAcceptors() const { return useReusePortAcceptors_; }
+
+  /**
+   * Set whether each IO thread accepts on its own SO_REUSEPORT listen socket
+   * and serves the connections it accepted itself, instead of IO thread #0
+   * accepting everything and handing connections out round robin.  The
+   * kernel then spreads new connections over the IO threads.  Requires a
+   * server transport that supports listenReusePort(), e.g. a
+   * TNonblockingServerSocket with setReusePort(true).  Can only be used
+   * before the call to serve().
+   */
+  void setUseReusePortAcceptors(bool val) { useReusePortAcceptors_ = val; }
+
+  /** Return whether connections borrow their buffers from a pool. */
+  bool useBufferPool() const { return useBufferPool_; }
+
+  /**
+   * Set whether connections borrow their read and write buffers from a
+   * pool of their IO thread for each request, and return them once the
+   * response is sent, instead of keeping buffers of their own.  Idle
+   * connections then hold no buffer memory, and requests do not allocate
+   * once the pool has buffers of the sizes they need.  The idle buffer
+   * limits and getResizeBufferEveryN() do not apply to pooled buffers.
+   * Can only be used before the call to serve().
+   */
+  void setUseBufferPool(bool val) { useBufferPool_ = val; }
+
+  /** Return the limit on the memory each IO thread's buffer pool keeps. */
+  size_t getBufferPoolCacheLimit() const { return bufferPoolCacheLimit_; }
+
+  /**
+   * Set the limit on the memory each IO thread's buffer pool keeps for
+   * reuse.  Buffers returned to a full pool are freed.  Can only be used
+   * before the call to serve().
+   */
+  void setBufferPoolCacheLimit(size_t limit) { bufferPoolCacheLimit_ = limit; }
+
+  /**
+   * Return the number of buffers the buffer pools had to allocate, summed
+   * over all IO threads.
+   */
+  uint64_t getNumBufferPoolAllocations() const;
+
+  /**
+   * Return the memory held by the buffer pools for reuse, summed over all
+   * IO threads.
+   */
+  size_t getBufferPoolCachedBytes() const;
+
   /** Return the number of IO threads used by this server. */
   size_t getNumIOThreads() const { return numIOThreads_; }
 
+  /** Return the IO thread with the given number, once the server is serving. */
+  std::shared_ptr<TNonblockingIOThread> getIOThread(size_t number) const {
+    return ioThreads_.at(number);
+  }
+
+  /**
+   * Return the number of times an IO thread was woken up to process
+   * completed tasks, summed over all IO threads.  Compare with
+   * getNumNotifyCompletions() to see how well wakeups are coalesced.
+   */
+  uint64_t getNumNotifyWakeups() const;
+
+  /**
+   * Return the number of task completions (and fresh connections handed to
+   * another IO thread) processed by the IO threads.
+   */
+  uint64_t getNumNotifyCompletions() const;
+
   /**
    * Get the maximum number of unused TConnection we will hold in reserve.
    *
@@ -714,11 +797,12 @@ private:
    * and flags.
    *
    * @param socket FD of socket associated with this connection.
-   * @param addr the sockaddr of the client
-   * @param addrLen the length of addr
+   * @param ioThread IO thread to serve the connection on, or nullptr to pick
+   * one round robin.
    * @return pointer to initialized TConnection object.
    */
-  TConnection* createConnection(std::shared_ptr<TSocket> socket);
+  TConnection* createConnection(std::shared_ptr<TSocket> socket,
+                                TNonblockingIOThread* ioThread = nullptr);
 
   /**
    * Returns a connection to pool or deletion.  If the connection pool
@@ -755,7 +839,8 @@ public:
   // only be called after the thread has been started.
   Thread::id_t getThreadId() const { return threadId_; }
 
-  // Returns the send-fd for task complete notifications.
+  // Returns the send-fd for task complete notifications.  Both ends are the
+  // same descriptor when an eventfd is used.
   evutil_socket_t getNotificationSendFD() const { return notificationPipeFDs_[1]; }
 
   // Returns the read-fd for task complete notifications.
@@ -770,6 +855,16 @@ public:
   // Used by TConnection objects to indicate processing has finished.
   bool notify(TNonblockingServer::TConnection* conn);
 
+  // Returns the number of times the thread was woken up by notify().
+  uint64_t getNotifyWakeups() const { return notifyWakeups_; }
+
+  // Returns the number of connections handed to the thread by notify().
+  uint64_t getNotifyCompletions() const { return notifyCompletions_; }
+
+  // Returns the pool the thread's connections borrow their buffers from.
+  TBufferPool& getBufferPool() { return bufferPool_; }
+  const TBufferPool& getBufferPool() const { return bufferPool_; }
+
   // Enters the event loop and does not return until a call to stop().
   void run() override;
 
@@ -785,9 +880,9 @@ public:
 private:
   /**
    * C-callable event handler for signaling task completion.  Provides a
-   * callback that libevent can understand that will read a connection
-   * object's address from a pipe and call connection->transition() for
-   * that object.
+   * callback that libevent can understand that will drain the queue of
+   * connections filled by notify() and call connection->transition() for
+   * each of them.
    *
    * @param fd the descriptor the event occurred on.
    */
@@ -799,10 +894,11 @@ private:
    *
    * @param fd the descriptor the event occurred on.
    * @param which the flags associated with the event.
-   * @param v void* callback arg where we placed TNonblockingServer's "this".
+   * @param v void* callback arg where we placed TNonblockingIOThread's "this".
    */
   static void listenHandler(evutil_socket_t fd, short which, void* v) {
-    ((TNonblockingServer*)v)->handleEvent(fd, which);
+    TNonblockingIOThread* ioThread = (TNonblockingIOThread*)v;
+    ioThread->getServer()->handleEvent(fd, which, ioThread);
   }
 
   /// Exits the loop ASAP in case of shutdown or error.
@@ -811,6 +907,9 @@ private:
   /// Create the pipe used to notify I/O process of task completion.
   void createNotificationPipe();
 
+  /// Writes the wakeup token into the notification pipe.
+  bool signalNotification();
+
   /// Unregisters our events for notification and listen sockets.
   void cleanupEvents();
 
@@ -849,6 +948,29 @@ private:
   /// File descriptors for pipe used for task completion notification.
   evutil_socket_t notificationPipeFDs_[2];
 
+  /// Guards notifyQueue_, notifyStop_ and notifyPending_.
+  Mutex notifyMutex_;
+
+  /// Connections handed to us by notify() and not yet transitioned.
+  std::vector<TNonblockingServer::TConnection*> notifyQueue_;
+
+  /// The queue being drained by notifyHandler(), kept to reuse its storage.
+  std::vector<TNonblockingServer::TConnection*> notifyBatch_;
+
+  /// Set by notify(nullptr) to ask the thread to leave its loop.
+  bool notifyStop_;
+
+  /// Set while a wakeup token is in the pipe that has not been handled yet;
+  /// notify() only writes a token when this is clear.
+  bool notifyPending_;
+
+  /// Statistics for notification coalescing.
+  std::atomic<uint64_t> notifyWakeups_;
+  std::atomic<uint64_t> notifyCompletions_;
+
+  /// Buffers for the connections of this thread, see setUseBufferPool()
+  TBufferPool bufferPool_;
+
   /// Actual IO Thread
   std::shared_ptr<Thread> thread_;
 };
@@ -48,6 +48,7 @@
 #  define THRIFT_OPEN _open
 #  define THRIFT_FTRUNCATE _chsize_s
 #  define THRIFT_FSYNC _commit
+#  define THRIFT_FDATASYNC _commit
 #  define THRIFT_LSEEK _lseek
 #  define THRIFT_WRITE _write
 #  define THRIFT_READ _read
@@ -104,6 +105,11 @@
 #  define THRIFT_OPEN open
 #  define THRIFT_FTRUNCATE ftruncate
 #  define THRIFT_FSYNC fsync
+#  ifdef __APPLE__
+#    define THRIFT_FDATASYNC fsync
+#  else
+#    define THRIFT_FDATASYNC fdatasync
+#  endif
 #  define THRIFT_LSEEK lseek
 #  define THRIFT_WRITE write
 #  define THRIFT_READ read
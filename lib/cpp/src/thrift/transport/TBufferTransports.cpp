@@ -207,10 +207,7 @@ bool TFramedTransport::readFrame() {
     throw TTransportException(TTransportException::CORRUPTED_DATA, "Received an oversized frame");
 
   // Read the frame payload, and reset markers.
-  if (sz > static_cast<int32_t>(rBufSize_)) {
-    rBuf_.reset(new uint8_t[sz]);
-    rBufSize_ = sz;
-  }
+  ensureReadBuffer(static_cast<uint32_t>(sz));
   transport_->readAll(rBuf_.get(), sz);
   setReadBuffer(rBuf_.get(), sz);
   return true;
@@ -297,6 +294,25 @@ const uint8_t* TFramedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
   return nullptr;
 }
 
+void TFramedTransport::ensureReadBuffer(uint32_t sz) {
+  if (sz > rBufSize_) {
+    rBuf_.reset(new uint8_t[sz], std::default_delete<uint8_t[]>());
+    rBufSize_ = sz;
+  } else if (rBuf_.use_count() > 1) {
+    // Data returned by borrowShared() still refers to the old buffer
+    rBufSize_ = (std::max)(sz, static_cast<uint32_t>(DEFAULT_BUFFER_SIZE));
+    rBuf_.reset(new uint8_t[rBufSize_], std::default_delete<uint8_t[]>());
+  }
+}
+
+std::shared_ptr<const uint8_t> TFramedTransport::borrowShared(uint32_t len) {
+  if (rBuf_ && rBase_ >= rBuf_.get() && rBound_ <= rBuf_.get() + rBufSize_
+      && len <= static_cast<uint32_t>(rBound_ - rBase_)) {
+    return std::shared_ptr<const uint8_t>(rBuf_, rBase_);
+  }
+  return std::shared_ptr<const uint8_t>();
+}
+
 uint32_t TFramedTransport::readEnd() {
   // include framing bytes
   auto bytes_read = static_cast<uint32_t>(rBound_ - rBuf_.get() + sizeof(uint32_t));
@@ -377,6 +377,12 @@ public:
 
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len) override;
 
+  /**
+   * Lends out data of the current frame.  A frame buffer that is still
+   * borrowed is not reused for the next frame.
+   */
+  std::shared_ptr<const uint8_t> borrowShared(uint32_t len);
+
   std::shared_ptr<TTransport> getUnderlyingTransport() { return transport_; }
 
   /*
@@ -409,6 +415,11 @@ protected:
    */
   virtual bool readFrame();
 
+  /**
+   * Makes rBuf_ a buffer of at least sz bytes that is not borrowed.
+   */
+  void ensureReadBuffer(uint32_t sz);
+
   void initPointers() {
     setReadBuffer(nullptr, 0);
     setWriteBuffer(wBuf_.get(), wBufSize_);
@@ -422,7 +433,7 @@ protected:
 
   uint32_t rBufSize_;
   uint32_t wBufSize_;
-  boost::scoped_array<uint8_t> rBuf_;
+  std::shared_ptr<uint8_t> rBuf_;
   boost::scoped_array<uint8_t> wBuf_;
   uint32_t bufReclaimThresh_;
   uint32_t maxFrameSize_;
@@ -627,17 +638,38 @@ public:
     // I don't expect resetBuffer to be a common operation, so I'm willing to
     // bite the performance bullet to make the method this simple.
 
-    // Construct the new buffer.
-    TMemoryBuffer new_buffer(buf, sz, policy);
+    // Construct the new buffer, sharing our configuration rather than
+    // allocating a default one.
+    TMemoryBuffer new_buffer(buf, sz, policy, configuration_);
     // Move it into ourself.
     this->swap(new_buffer);
     // Our old self gets destroyed.
   }
 
+  /**
+   * Hand the buffer over to the caller, who has to free() it, and leave
+   * this empty.  Writing allocates a new buffer.
+   *
+   * @param sz  Set to the allocated size of the buffer.
+   * @return the buffer, or nullptr if this does not own one.
+   */
+  uint8_t* releaseBuffer(uint32_t* sz) {
+    if (!owner_ || buffer_ == nullptr) {
+      *sz = 0;
+      return nullptr;
+    }
+    uint8_t* buf = buffer_;
+    *sz = bufferSize_;
+    buffer_ = nullptr;
+    bufferSize_ = 0;
+    rBase_ = rBound_ = wBase_ = wBound_ = nullptr;
+    return buf;
+  }
+
   /// See constructor documentation.
   void resetBuffer(uint32_t sz) {
     // Construct the new buffer.
-    TMemoryBuffer new_buffer(sz);
+    TMemoryBuffer new_buffer(sz, configuration_);
     // Move it into ourself.
     this->swap(new_buffer);
     // Our old self gets destroyed.
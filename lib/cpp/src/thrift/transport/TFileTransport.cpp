@@ -38,6 +38,7 @@
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -49,6 +50,9 @@
 
 #ifdef _WIN32
 #include <io.h>
+#else
+#include <limits.h>
+#include <sys/uio.h>
 #endif
 
 namespace apache {
@@ -63,6 +67,56 @@ using std::string;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::concurrency;
 
+namespace {
+
+#ifdef _WIN32
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+#endif
+
+// number of buffers the writer thread hands to one writev()
+#if defined(IOV_MAX) && IOV_MAX < 1024
+const int MAX_WRITE_IOVECS = IOV_MAX;
+#else
+const int MAX_WRITE_IOVECS = 1024;
+#endif
+
+// Writes all buffers, returns false on error
+bool writeFully(int fd, struct iovec* iov, int count) {
+#ifdef _WIN32
+  for (int i = 0; i < count; ++i) {
+    if (-1 == ::THRIFT_WRITE(fd, iov[i].iov_base, static_cast<unsigned int>(iov[i].iov_len))) {
+      return false;
+    }
+  }
+  return true;
+#else
+  while (count > 0) {
+    ssize_t written = ::writev(fd, iov, count);
+    if (written == -1) {
+      if (THRIFT_ERRNO == THRIFT_EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // skip what was written and retry the rest
+    while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+#endif
+}
+}
+
 TFileTransport::TFileTransport(string path, bool readOnly, std::shared_ptr<TConfiguration> config)
   : TTransport(config),
     readState_(),
@@ -79,13 +133,20 @@ TFileTransport::TFileTransport(string path, bool readOnly, std::shared_ptr<TConf
     eofSleepTime_(DEFAULT_EOF_SLEEP_TIME_US),
     corruptedEventSleepTime_(DEFAULT_CORRUPTED_SLEEP_TIME_US),
     writerThreadIOErrorSleepTime_(DEFAULT_WRITER_THREAD_SLEEP_TIME_US),
-    dequeueBuffer_(nullptr),
-    enqueueBuffer_(nullptr),
+    ringMask_(0),
+    enqueuePos_(0),
+    dequeuePos_(0),
+    syncedPos_(0),
+    lostFrom_(0),
+    lostPos_(0),
     notFull_(&mutex_),
     notEmpty_(&mutex_),
+    writersWaiting_(0),
+    writerThreadWaiting_(false),
     closing_(false),
     flushed_(&mutex_),
-    forceFlush_(false),
+    syncWaiters_(0),
+    groupCommit_(false),
     filename_(path),
     fd_(0),
     bufferAndThreadInitialized_(false),
@@ -134,22 +195,15 @@ TFileTransport::~TFileTransport() {
 
     // wake up the writer thread
     // Since closing_ is true, it will attempt to flush all data, then exit.
-    notEmpty_.notify();
+    {
+      Guard g(mutex_);
+      notEmpty_.notify();
+    }
 
     writerThread_->join();
     writerThread_.reset();
   }
 
-  if (dequeueBuffer_) {
-    delete dequeueBuffer_;
-    dequeueBuffer_ = nullptr;
-  }
-
-  if (enqueueBuffer_) {
-    delete enqueueBuffer_;
-    enqueueBuffer_ = nullptr;
-  }
-
   if (readBuff_) {
     delete[] readBuff_;
     readBuff_ = nullptr;
@@ -177,14 +231,22 @@ bool TFileTransport::initBufferAndWriteThread() {
     return false;
   }
 
+  uint64_t ringSize = 1;
+  while (ringSize < eventBufferSize_) {
+    ringSize <<= 1;
+  }
+  ring_.reset(new EventSlot[ringSize]);
+  for (uint64_t i = 0; i < ringSize; ++i) {
+    ring_[i].sequence_.store(i, std::memory_order_relaxed);
+  }
+  ringMask_ = ringSize - 1;
+
   if (!writerThread_.get()) {
     writerThread_ = threadFactory_.newThread(
         apache::thrift::concurrency::FunctionRunner::create(startWriterThread, this));
     writerThread_->start();
   }
 
-  dequeueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
-  enqueueBuffer_ = new TFileTransportBuffer(eventBufferSize_);
   bufferAndThreadInitialized_ = true;
 
   return true;
@@ -195,110 +257,212 @@ void TFileTransport::write(const uint8_t* buf, uint32_t len) {
     throw TTransportException("TFileTransport: attempting to write to file opened readonly");
   }
 
-  enqueueEvent(buf, len);
+  uint64_t end = enqueueEvent(buf, len);
+  if (end != 0 && groupCommit_) {
+    waitForSync(end);
+  }
 }
 
-template <class _T>
-struct uniqueDeleter
-{
-  void operator()(_T *ptr) const { delete ptr; }
-};
-
-void TFileTransport::enqueueEvent(const uint8_t* buf, uint32_t eventLen) {
+uint64_t TFileTransport::enqueueEvent(const uint8_t* buf, uint32_t eventLen) {
   // can't enqueue more events if file is going to close
   if (closing_) {
-    return;
+    return 0;
   }
 
   // make sure that event size is valid
   if ((maxEventSize_ > 0) && (eventLen > maxEventSize_)) {
     T_ERROR("msg size is greater than max event size: %u > %u\n", eventLen, maxEventSize_);
-    return;
+    return 0;
   }
 
   if (eventLen == 0) {
     T_ERROR("%s", "cannot enqueue an empty event");
-    return;
+    return 0;
   }
 
-  std::unique_ptr<eventInfo, uniqueDeleter<eventInfo> > toEnqueue(new eventInfo());
-  toEnqueue->eventBuff_ = new uint8_t[(sizeof(uint8_t) * eventLen) + 4];
-
-  // first 4 bytes is the event length
-  memcpy(toEnqueue->eventBuff_, (void*)(&eventLen), 4);
-  // actual event contents
-  memcpy(toEnqueue->eventBuff_ + 4, buf, eventLen);
-  toEnqueue->eventSize_ = eventLen + 4;
-
-  // lock mutex
-  Guard g(mutex_);
-
-  // make sure that enqueue buffer is initialized and writer thread is running
+  // make sure that the ring is initialized and writer thread is running
   if (!bufferAndThreadInitialized_) {
-    if (!initBufferAndWriteThread()) {
-      return;
+    Guard g(mutex_);
+    if (!bufferAndThreadInitialized_ && !initBufferAndWriteThread()) {
+      return 0;
     }
   }
 
-  // Can't enqueue while buffer is full
-  while (enqueueBuffer_->isFull()) {
-    notFull_.wait();
+  // claim the slot at the head of the ring
+  uint64_t pos = enqueuePos_.load(std::memory_order_relaxed);
+  EventSlot* slot;
+  while (true) {
+    slot = &ring_[pos & ringMask_];
+    uint64_t sequence = slot->sequence_.load();
+    auto diff = static_cast<int64_t>(sequence - pos);
+    if (diff == 0) {
+      if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The slot still holds an event that was not written yet, so the ring
+      // is full.  Wait until the writer thread hands slots back.
+      Guard g(mutex_);
+      ++writersWaiting_;
+      if (slot->sequence_.load() == sequence && !closing_) {
+        notFull_.wait();
+      }
+      --writersWaiting_;
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+    } else {
+      // another writer claimed it first
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+    }
   }
 
-  // We shouldn't be trying to enqueue new data while a forced flush is
-  // requested.  (Otherwise the writer thread might not ever be able to finish
-  // the flush if more data keeps being enqueued.)
-  assert(!forceFlush_);
-
-  // add to the buffer
-  eventInfo* pEvent = toEnqueue.release();
-  if (!enqueueBuffer_->addEvent(pEvent)) {
-    delete pEvent;
-    return;
+  // first 4 bytes is the event length, followed by the event contents
+  uint32_t eventSize = eventLen + 4;
+  if (slot->capacity_ < eventSize) {
+    delete[] slot->buff_;
+    slot->buff_ = nullptr;
+    slot->capacity_ = 0;
+    try {
+      slot->buff_ = new uint8_t[eventSize];
+    } catch (...) {
+      // publish the slot as empty, the writer thread must not wait for it
+      slot->size_ = 0;
+      slot->sequence_.store(pos + 1);
+      throw;
+    }
+    slot->capacity_ = eventSize;
+  }
+  memcpy(slot->buff_, (void*)(&eventLen), 4);
+  memcpy(slot->buff_ + 4, buf, eventLen);
+  slot->size_ = eventSize;
+  slot->sequence_.store(pos + 1);
+
+  // signal the writer thread if it waits for events
+  if (writerThreadWaiting_) {
+    Guard g(mutex_);
+    notEmpty_.notify();
   }
 
-  // signal anybody who's waiting for the buffer to be non-empty
-  notEmpty_.notify();
+  return pos + 1;
+}
 
-  // this really should be a loop where it makes sure it got flushed
-  // because condition variables can get triggered by the os for no reason
-  // it is probably a non-factor for the time being
+bool TFileTransport::eventReady() {
+  return ring_[dequeuePos_ & ringMask_].sequence_.load() == dequeuePos_ + 1;
 }
 
-bool TFileTransport::swapEventBuffers(const std::chrono::time_point<std::chrono::steady_clock> *deadline) {
-  bool swap;
-  Guard g(mutex_);
+bool TFileTransport::waitForEvents(const std::chrono::time_point<std::chrono::steady_clock> *deadline) {
+  if (eventReady()) {
+    return true;
+  }
 
-  if (!enqueueBuffer_->isEmpty()) {
-    swap = true;
-  } else if (closing_) {
-    // even though there is no data to write,
-    // return immediately if the transport is closing
-    swap = false;
-  } else {
+  Guard g(mutex_);
+  writerThreadWaiting_ = true;
+  // don't wait if the transport is closing or somebody waits for a sync,
+  // even though there is no data to write
+  if (!eventReady() && !closing_ && syncWaiters_ == 0) {
     if (deadline != nullptr) {
       // if we were handed a deadline time struct, do a timed wait
       notEmpty_.waitForTime(*deadline);
     } else {
-      // just wait until the buffer gets an item
+      // just wait until the ring gets an item
       notEmpty_.wait();
     }
+  }
+  writerThreadWaiting_ = false;
+
+  // could be empty if we timed out
+  return eventReady();
+}
 
-    // could be empty if we timed out
-    swap = enqueueBuffer_->isEmpty();
+void TFileTransport::writeEvents(uint32_t& unflushed, bool& hasIOError) {
+  // Gather the events that are ready and write them out with one call.  If
+  // there is any IO error, for instance, the output file is unmounted or
+  // deleted, then these events are dropped.
+  struct iovec iov[MAX_WRITE_IOVECS];
+  int iovCount = 0;
+  uint32_t maxPadding = 0;
+  off_t end = offset_;
+  uint64_t pos = dequeuePos_;
+  // an event may need a second buffer for padding
+  while (iovCount + 2 <= MAX_WRITE_IOVECS) {
+    EventSlot& slot = ring_[pos & ringMask_];
+    if (slot.sequence_.load(std::memory_order_acquire) != pos + 1) {
+      break;
+    }
+    ++pos;
+    if (slot.size_ == 0) {
+      continue;
+    }
+
+    // If chunking is required, then make sure that msg does not cross chunk boundary
+    if (chunkSize_ != 0) {
+      // event size must be less than chunk size
+      if (slot.size_ > chunkSize_) {
+        T_ERROR("TFileTransport: event size(%u) > chunk size(%u): skipping event",
+                slot.size_,
+                chunkSize_);
+        continue;
+      }
+
+      int64_t chunk1 = end / chunkSize_;
+      int64_t chunk2 = (end + slot.size_ - 1) / chunkSize_;
+
+      // if adding this event will cross a chunk boundary, pad the chunk with zeros
+      if (chunk1 != chunk2) {
+        auto padding = static_cast<uint32_t>((chunk1 + 1) * chunkSize_ - end);
+        // points to the zeros once they are allocated
+        iov[iovCount].iov_base = nullptr;
+        iov[iovCount].iov_len = padding;
+        maxPadding = (std::max)(maxPadding, padding);
+        ++iovCount;
+        end += padding;
+      }
+    }
+
+    iov[iovCount].iov_base = slot.buff_;
+    iov[iovCount].iov_len = slot.size_;
+    ++iovCount;
+    end += slot.size_;
   }
 
-  if (swap) {
-    TFileTransportBuffer* temp = enqueueBuffer_;
-    enqueueBuffer_ = dequeueBuffer_;
-    dequeueBuffer_ = temp;
+  if (maxPadding > 0) {
+    if (padding_.size() < maxPadding) {
+      padding_.resize(maxPadding);
+    }
+    for (int i = 0; i < iovCount; ++i) {
+      if (iov[i].iov_base == nullptr) {
+        iov[i].iov_base = &padding_[0];
+      }
+    }
   }
 
-  if (swap) {
-    notFull_.notify();
+  if (iovCount > 0) {
+    if (writeFully(fd_, iov, iovCount)) {
+      unflushed += static_cast<uint32_t>(end - offset_);
+      offset_ = end;
+    } else {
+      int errno_copy = THRIFT_ERRNO;
+      GlobalOutput.perror("TFileTransport: error while writing events ", errno_copy);
+      hasIOError = true;
+    }
   }
 
-  return swap;
+  // hand the slots back to the writers
+  for (; dequeuePos_ != pos; ++dequeuePos_) {
+    EventSlot& slot = ring_[dequeuePos_ & ringMask_];
+    if (slot.capacity_ > MAX_KEPT_EVENT_BUFFER_SIZE) {
+      delete[] slot.buff_;
+      slot.buff_ = nullptr;
+      slot.capacity_ = 0;
+    }
+    slot.sequence_.store(dequeuePos_ + ringMask_ + 1);
+  }
+  if (writersWaiting_ > 0) {
+    Guard g(mutex_);
+    notFull_.notifyAll();
+  }
+  if (hasIOError) {
+    loseUnsynced(dequeuePos_);
+  }
 }
 
 void TFileTransport::writerThread() {
@@ -344,12 +508,21 @@ void TFileTransport::writerThread() {
     // this will only be true when the destructor is being invoked
     if (closing_) {
       if (hasIOError) {
+        loseUnsynced((std::numeric_limits<uint64_t>::max)());
         return;
       }
 
-      // Try to empty buffers before exit
-      if (enqueueBuffer_->isEmpty() && dequeueBuffer_->isEmpty()) {
-        ::THRIFT_FSYNC(fd_);
+      // Try to empty the ring before exit
+      if (!eventReady()) {
+        if (0 == ::THRIFT_FSYNC(fd_)) {
+          Guard g(mutex_);
+          syncedPos_ = dequeuePos_;
+        } else {
+          int errno_copy = THRIFT_ERRNO;
+          GlobalOutput.perror("TFileTransport: writerThread() fsync ", errno_copy);
+        }
+        // nothing is written after this, wake up whoever still waits
+        loseUnsynced((std::numeric_limits<uint64_t>::max)());
         if (-1 == ::THRIFT_CLOSE(fd_)) {
           int errno_copy = THRIFT_ERRNO;
           GlobalOutput.perror("TFileTransport: writerThread() ::close() ", errno_copy);
@@ -361,133 +534,54 @@ void TFileTransport::writerThread() {
       }
     }
 
-    if (swapEventBuffers(&ts_next_flush)) {
-      eventInfo* outEvent;
-      while (nullptr != (outEvent = dequeueBuffer_->getNext())) {
-        // Remove an event from the buffer and write it out to disk. If there is any IO error, for
-        // instance,
-        // the output file is unmounted or deleted, then this event is dropped. However, the writer
-        // thread
-        // will: (1) sleep for a short while; (2) try to reopen the file; (3) if successful then
-        // start writing
-        // from the end.
-
-        while (hasIOError) {
-          T_ERROR(
-              "TFileTransport: writer thread going to sleep for %u microseconds due to IO errors",
-              writerThreadIOErrorSleepTime_);
-          THRIFT_SLEEP_USEC(writerThreadIOErrorSleepTime_);
-          if (closing_) {
-            return;
-          }
-          if (!fd_) {
-            ::THRIFT_CLOSE(fd_);
-            fd_ = 0;
-          }
-          try {
-            openLogFile();
-            seekToEnd();
-            unflushed = 0;
-            hasIOError = false;
-            T_LOG_OPER(
-                "TFileTransport: log file %s reopened by writer thread during error recovery",
-                filename_.c_str());
-          } catch (...) {
-            T_ERROR("TFileTransport: unable to reopen log file %s during error recovery",
-                    filename_.c_str());
-          }
+    if (waitForEvents(&ts_next_flush)) {
+      // If there was an IO error, the writer thread will: (1) sleep for a
+      // short while; (2) try to reopen the file; (3) if successful then start
+      // writing from the end.
+      while (hasIOError) {
+        T_ERROR(
+            "TFileTransport: writer thread going to sleep for %u microseconds due to IO errors",
+            writerThreadIOErrorSleepTime_);
+        THRIFT_SLEEP_USEC(writerThreadIOErrorSleepTime_);
+        if (closing_) {
+          loseUnsynced((std::numeric_limits<uint64_t>::max)());
+          return;
         }
-
-        // sanity check on event
-        if ((maxEventSize_ > 0) && (outEvent->eventSize_ > maxEventSize_)) {
-          T_ERROR("msg size is greater than max event size: %u > %u\n",
-                  outEvent->eventSize_,
-                  maxEventSize_);
-          continue;
+        if (fd_) {
+          ::THRIFT_CLOSE(fd_);
+          fd_ = 0;
         }
-
-        // If chunking is required, then make sure that msg does not cross chunk boundary
-        if ((outEvent->eventSize_ > 0) && (chunkSize_ != 0)) {
-          // event size must be less than chunk size
-          if (outEvent->eventSize_ > chunkSize_) {
-            T_ERROR("TFileTransport: event size(%u) > chunk size(%u): skipping event",
-                    outEvent->eventSize_,
-                    chunkSize_);
-            continue;
-          }
-
-          int64_t chunk1 = offset_ / chunkSize_;
-          int64_t chunk2 = (offset_ + outEvent->eventSize_ - 1) / chunkSize_;
-
-          // if adding this event will cross a chunk boundary, pad the chunk with zeros
-          if (chunk1 != chunk2) {
-            // refetch the offset to keep in sync
-            offset_ = THRIFT_LSEEK(fd_, 0, SEEK_CUR);
-            auto padding = (int32_t)((offset_ / chunkSize_ + 1) * chunkSize_ - offset_);
-
-            auto* zeros = new uint8_t[padding];
-            memset(zeros, '\0', padding);
-            boost::scoped_array<uint8_t> array(zeros);
-            if (-1 == ::THRIFT_WRITE(fd_, zeros, padding)) {
-              int errno_copy = THRIFT_ERRNO;
-              GlobalOutput.perror("TFileTransport: writerThread() error while padding zeros ",
-                                  errno_copy);
-              hasIOError = true;
-              continue;
-            }
-            unflushed += padding;
-            offset_ += padding;
-          }
-        }
-
-        // write the dequeued event to the file
-        if (outEvent->eventSize_ > 0) {
-          if (-1 == ::THRIFT_WRITE(fd_, outEvent->eventBuff_, outEvent->eventSize_)) {
-            int errno_copy = THRIFT_ERRNO;
-            GlobalOutput.perror("TFileTransport: error while writing event ", errno_copy);
-            hasIOError = true;
-            continue;
-          }
-          unflushed += outEvent->eventSize_;
-          offset_ += outEvent->eventSize_;
+        try {
+          openLogFile();
+          seekToEnd();
+          unflushed = 0;
+          hasIOError = false;
+          T_LOG_OPER(
+              "TFileTransport: log file %s reopened by writer thread during error recovery",
+              filename_.c_str());
+        } catch (...) {
+          T_ERROR("TFileTransport: unable to reopen log file %s during error recovery",
+                  filename_.c_str());
         }
       }
-      dequeueBuffer_->reset();
+
+      writeEvents(unflushed, hasIOError);
     }
 
     if (hasIOError) {
       continue;
     }
 
-    // Local variable to cache the state of forceFlush_.
-    //
-    // We only want to check the value of forceFlush_ once each time around the
-    // loop.  If we check it more than once without holding the lock the entire
-    // time, it could have changed state in between.  This will result in us
-    // making inconsistent decisions.
-    bool forced_flush = false;
-    {
-      Guard g(mutex_);
-      if (forceFlush_) {
-        if (!enqueueBuffer_->isEmpty()) {
-          // If forceFlush_ is true, we need to flush all available data.
-          // If enqueueBuffer_ is not empty, go back to the start of the loop to
-          // write it out.
-          //
-          // We know the main thread is waiting on forceFlush_ to be cleared,
-          // so no new events will be added to enqueueBuffer_ until we clear
-          // forceFlush_.  Therefore the next time around the loop enqueueBuffer_
-          // is guaranteed to be empty.  (I.e., we're guaranteed to make progress
-          // and clear forceFlush_ the next time around the loop.)
-          continue;
-        }
-        forced_flush = true;
-      }
+    // If somebody waits for a sync, write out whatever else is ready first,
+    // so that one sync covers as many events as possible.
+    bool sync_requested = syncWaiters_ > 0;
+    if (sync_requested && unflushed <= flushMaxBytes_ && eventReady()) {
+      continue;
     }
 
     // determine if we need to perform an fsync
     bool flush = false;
-    if (forced_flush || unflushed > flushMaxBytes_) {
+    if (sync_requested || unflushed > flushMaxBytes_) {
       flush = true;
     } else {
       if (std::chrono::steady_clock::now() > ts_next_flush) {
@@ -503,39 +597,70 @@ void TFileTransport::writerThread() {
 
     if (flush) {
       // sync (force flush) file to disk
-      THRIFT_FSYNC(fd_);
+      if (unflushed > 0) {
+        int rv = groupCommit_ ? THRIFT_FDATASYNC(fd_) : THRIFT_FSYNC(fd_);
+        if (rv != 0) {
+          // The events written since the last sync may not be on disk, and
+          // the file can't be trusted any more: reopen it.
+          int errno_copy = THRIFT_ERRNO;
+          GlobalOutput.perror("TFileTransport: writerThread() sync ", errno_copy);
+          hasIOError = true;
+          loseUnsynced(dequeuePos_);
+        }
+      }
       unflushed = 0;
       ts_next_flush = getNextFlushTime();
+      if (hasIOError) {
+        continue;
+      }
 
       // notify anybody waiting for flush completion
-      if (forced_flush) {
-        Guard g(mutex_);
-        forceFlush_ = false;
-        assert(enqueueBuffer_->isEmpty());
-        assert(dequeueBuffer_->isEmpty());
+      Guard g(mutex_);
+      syncedPos_ = dequeuePos_;
+      if (syncWaiters_ > 0) {
         flushed_.notifyAll();
       }
     }
   }
 }
 
-void TFileTransport::flush() {
-  resetConsumedMessageSize();
-  // file must be open for writing for any flushing to take place
-  if (!writerThread_.get()) {
+void TFileTransport::waitForSync(uint64_t position) {
+  if (syncedPos_ >= position && lostPos_ < position) {
     return;
   }
-  // wait for flush to take place
-  Guard g(mutex_);
 
-  // Indicate that we are requesting a flush
-  forceFlush_ = true;
+  Guard g(mutex_);
+  ++syncWaiters_;
   // Wake up the writer thread so it will perform the flush immediately
   notEmpty_.notify();
-
-  while (forceFlush_) {
+  while (syncedPos_ < position && lostPos_ < position) {
     flushed_.wait();
   }
+  --syncWaiters_;
+  if (lostFrom_ < position && position <= lostPos_) {
+    throw TTransportException("TFileTransport: events were lost before they were synced");
+  }
+}
+
+void TFileTransport::loseUnsynced(uint64_t end) {
+  Guard g(mutex_);
+  // Keep the earlier lost events while somebody may still wait for them,
+  // at the cost of failing events that were synced in between.
+  if (lostPos_ == 0 || syncWaiters_ == 0) {
+    lostFrom_ = syncedPos_;
+  }
+  lostPos_ = (std::max)(lostPos_.load(), end);
+  flushed_.notifyAll();
+}
+
+void TFileTransport::flush() {
+  resetConsumedMessageSize();
+  // file must be open for writing for any flushing to take place
+  if (!writerThread_.get()) {
+    return;
+  }
+  // wait until everything that was written so far is synced
+  waitForSync(enqueuePos_);
 }
 
 uint32_t TFileTransport::readAll(uint8_t* buf, uint32_t len) {
@@ -25,7 +25,9 @@
 #include <thrift/TProcessor.h>
 
 #include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 #include <stdio.h>
 
 #include <thrift/concurrency/Mutex.h>
@@ -107,8 +109,9 @@ typedef struct readState {
 } readState;
 
 /**
- * TFileTransportBuffer - buffer class used by TFileTransport for queueing up events
- * to be written to disk.  Should be used in the following way:
+ * TFileTransportBuffer - buffer class for queueing up events to be written to disk.
+ * TFileTransport no longer uses it, it queues events in a ring of slots instead.
+ * Should be used in the following way:
  *  1) Buffer created
  *  2) Buffer written to (addEvent)
  *  3) Buffer read from (getNext)
@@ -216,6 +219,11 @@ public:
   }
   uint32_t getChunkSize() override { return chunkSize_; }
 
+  /**
+   * Sets the number of events that can be queued for the writer thread,
+   * which is rounded up to a power of two.  Writers block while the queue is
+   * full.
+   */
   void setEventBufferSize(uint32_t bufferSize) {
     if (bufferAndThreadInitialized_) {
       GlobalOutput("Cannot change the buffer size after writer thread started");
@@ -240,6 +248,16 @@ public:
   }
   uint32_t getFlushMaxBytes() { return flushMaxBytes_; }
 
+  /**
+   * With group commit, write() returns once the event is on disk.  The
+   * writer thread syncs the file with fdatasync() after each batch of
+   * events it writes, so the events of all threads that wait for their
+   * writes share one sync.  If the events can't be written or synced,
+   * write() and flush() throw a TTransportException instead.
+   */
+  void setGroupCommit(bool groupCommit) { groupCommit_ = groupCommit; }
+  bool getGroupCommit() { return groupCommit_; }
+
   void setMaxEventSize(uint32_t maxEventSize) { maxEventSize_ = maxEventSize; }
   uint32_t getMaxEventSize() { return maxEventSize_; }
 
@@ -255,6 +273,13 @@ public:
   }
   uint32_t getEofSleepTimeUs() { return eofSleepTime_; }
 
+  void setWriterThreadIOErrorSleepTimeUs(uint32_t writerThreadIOErrorSleepTime) {
+    if (writerThreadIOErrorSleepTime) {
+      writerThreadIOErrorSleepTime_ = writerThreadIOErrorSleepTime;
+    }
+  }
+  uint32_t getWriterThreadIOErrorSleepTimeUs() { return writerThreadIOErrorSleepTime_; }
+
   /*
    * Override TTransport *_virt() functions to invoke our implementations.
    * We cannot use TVirtualTransport to provide these, since we need to inherit
@@ -265,9 +290,28 @@ public:
   void write_virt(const uint8_t* buf, uint32_t len) override { this->write(buf, len); }
 
 private:
+  // A queued event.  Writers claim a slot, copy the event into its buffer
+  // and publish it by advancing sequence_; the writer thread hands the slot
+  // back by advancing sequence_ once more after writing the event.  The
+  // buffers are kept for the next events that use the slot.
+  struct EventSlot {
+    std::atomic<uint64_t> sequence_;
+    uint8_t* buff_;
+    // size of the event, including its 4 byte length
+    uint32_t size_;
+    uint32_t capacity_;
+
+    EventSlot() : sequence_(0), buff_(nullptr), size_(0), capacity_(0) {}
+    ~EventSlot() { delete[] buff_; }
+  };
+
   // helper functions for writing to a file
-  void enqueueEvent(const uint8_t* buf, uint32_t eventLen);
-  bool swapEventBuffers(const std::chrono::time_point<std::chrono::steady_clock> *deadline);
+  uint64_t enqueueEvent(const uint8_t* buf, uint32_t eventLen);
+  bool eventReady();
+  bool waitForEvents(const std::chrono::time_point<std::chrono::steady_clock> *deadline);
+  void writeEvents(uint32_t& unflushed, bool& hasIOError);
+  void waitForSync(uint64_t position);
+  void loseUnsynced(uint64_t end);
   bool initBufferAndWriteThread();
 
   // control for writer thread
@@ -339,20 +383,41 @@ private:
   apache::thrift::concurrency::ThreadFactory threadFactory_;
   std::shared_ptr<apache::thrift::concurrency::Thread> writerThread_;
 
-  // buffers to hold data before it is flushed. Each element of the buffer stores a msg that
-  // needs to be written to the file.  The buffers are swapped by the writer thread.
-  TFileTransportBuffer* dequeueBuffer_;
-  TFileTransportBuffer* enqueueBuffer_;
-
-  // conditions used to block when the buffer is full or empty
+  // ring of events waiting to be written, indexed by the position of an event
+  // in the stream of events masked with ringMask_
+  std::unique_ptr<EventSlot[]> ring_;
+  uint64_t ringMask_;
+  // position of the next event to be claimed by a writer
+  std::atomic<uint64_t> enqueuePos_;
+  // position of the next event to be written, only used by the writer thread
+  uint64_t dequeuePos_;
+  // events before this position are synced to disk, except for the lost ones
+  std::atomic<uint64_t> syncedPos_;
+  // events from lostFrom_ up to lostPos_ were dropped, or written but not
+  // synced, because of an IO error or because the writer thread exited.
+  // lostPos_ is 0 until that happens.  Both are set with mutex_ held.
+  uint64_t lostFrom_;
+  std::atomic<uint64_t> lostPos_;
+
+  // largest slot buffer that is kept after its event was written
+  static const uint32_t MAX_KEPT_EVENT_BUFFER_SIZE = 64 * 1024;
+
+  // zeros written to pad chunks, only used by the writer thread
+  std::vector<uint8_t> padding_;
+
+  // conditions used to block when the ring is full or empty.  Writers and the
+  // writer thread only grab the mutex to wait, or when they know of a waiter.
   Monitor notFull_, notEmpty_;
+  std::atomic<uint32_t> writersWaiting_;
+  std::atomic<bool> writerThreadWaiting_;
   std::atomic<bool> closing_;
 
-  // To keep track of whether the buffer has been flushed
+  // signalled when syncedPos_ moves, for the threads that wait for a sync
   Monitor flushed_;
-  std::atomic<bool> forceFlush_;
+  std::atomic<uint32_t> syncWaiters_;
+  std::atomic<bool> groupCommit_;
 
-  // Mutex that is grabbed when enqueueing and swapping the read/write buffers
+  // Mutex that guards the monitors and the initialization of the writer thread
   Mutex mutex_;
 
   // File information
@@ -360,7 +425,7 @@ private:
   int fd_;
 
   // Whether the writer thread and buffers have been initialized
-  bool bufferAndThreadInitialized_;
+  std::atomic<bool> bufferAndThreadInitialized_;
 
   // Offset within the file
   off_t offset_;
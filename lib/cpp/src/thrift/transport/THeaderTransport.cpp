@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include <thrift/thrift-config.h>
+
 #include <thrift/transport/THeaderTransport.h>
 #include <thrift/TApplicationException.h>
 #include <thrift/protocol/TProtocolTypes.h>
@@ -24,11 +26,20 @@
 #include <thrift/protocol/TCompactProtocol.h>
 
 #include <limits>
+#include <new>
 #include <utility>
 #include <string>
 #include <string.h>
 #include <zlib.h>
 
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
 using std::map;
 using std::string;
 using std::vector;
@@ -43,6 +54,57 @@ namespace transport {
 using namespace apache::thrift::protocol;
 using apache::thrift::protocol::TBinaryProtocol;
 
+struct THeaderTransport::TransformContexts {
+  TransformContexts() : deflateReady(false), inflateReady(false) {
+#ifdef HAVE_LIBZSTD
+    zstdCompress = nullptr;
+    zstdDecompress = nullptr;
+#endif
+  }
+
+  ~TransformContexts() {
+    if (deflateReady) {
+      deflateEnd(&deflateStream);
+    }
+    if (inflateReady) {
+      inflateEnd(&inflateStream);
+    }
+#ifdef HAVE_LIBZSTD
+    ZSTD_freeCCtx(zstdCompress);
+    ZSTD_freeDCtx(zstdDecompress);
+#endif
+  }
+
+  z_stream deflateStream;
+  bool deflateReady;
+  z_stream inflateStream;
+  bool inflateReady;
+#ifdef HAVE_LIBZSTD
+  ZSTD_CCtx* zstdCompress;
+  ZSTD_DCtx* zstdDecompress;
+#endif
+#ifdef HAVE_LIBLZ4
+  std::vector<char> lz4State;
+#endif
+};
+
+bool THeaderTransport::isTransformSupported(uint16_t transId) {
+  switch (transId) {
+  case ZLIB_TRANSFORM:
+    return true;
+#ifdef HAVE_LIBZSTD
+  case ZSTD_TRANSFORM:
+    return true;
+#endif
+#ifdef HAVE_LIBLZ4
+  case LZ4_TRANSFORM:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
 uint32_t THeaderTransport::readSlow(uint8_t* buf, uint32_t len) {
   if (clientType == THRIFT_UNFRAMED_BINARY || clientType == THRIFT_UNFRAMED_COMPACT) {
     return transport_->read(buf, len);
@@ -61,13 +123,6 @@ uint16_t THeaderTransport::getProtocolId() const {
   }
 }
 
-void THeaderTransport::ensureReadBuffer(uint32_t sz) {
-  if (sz > rBufSize_) {
-    rBuf_.reset(new uint8_t[sz]);
-    rBufSize_ = sz;
-  }
-}
-
 bool THeaderTransport::readFrame() {
   // szN is network byte order of sz
   uint32_t szN;
@@ -265,46 +320,125 @@ void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
   resizeTransformBuffer();
 
   for (vector<uint16_t>::const_iterator it = readTrans_.begin(); it != readTrans_.end(); ++it) {
-    const uint16_t transId = *it;
+    sz = decompress(*it, ptr, sz);
 
-    if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
+    // The frame has been decompressed completely, so its buffer can be
+    // replaced by one that is large enough for the result
+    ensureReadBuffer(sz);
+    memcpy(rBuf_.get(), tBuf_.get(), sz);
+    ptr = rBuf_.get();
+  }
+
+  setReadBuffer(ptr, sz);
+}
 
-      stream.next_in = ptr;
-      stream.avail_in = sz;
+/**
+ * Decompresses sz bytes at ptr into the transform buffer and returns the
+ * size of the result.
+ */
+uint32_t THeaderTransport::decompress(uint16_t transId, const uint8_t* ptr, uint32_t sz) {
+  if (!contexts_) {
+    contexts_ = std::make_shared<TransformContexts>();
+  }
 
+  if (transId == ZLIB_TRANSFORM) {
+    z_stream& stream = contexts_->inflateStream;
+    int err;
+    if (!contexts_->inflateReady) {
       // Setting these to 0 means use the default free/alloc functions
       stream.zalloc = (alloc_func)nullptr;
       stream.zfree = (free_func)nullptr;
       stream.opaque = (voidpf)nullptr;
+      stream.next_in = nullptr;
+      stream.avail_in = 0;
       err = inflateInit(&stream);
       if (err != Z_OK) {
         throw TApplicationException(TApplicationException::MISSING_RESULT,
                                     "Error while zlib deflateInit");
       }
-      stream.next_out = tBuf_.get();
-      stream.avail_out = tBufSize_;
-      err = inflate(&stream, Z_FINISH);
-      if (err != Z_STREAM_END || stream.avail_out == 0) {
-        throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflate");
-      }
-      sz = stream.total_out;
+      contexts_->inflateReady = true;
+    } else if (inflateReset(&stream) != Z_OK) {
+      throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                  "Error while zlib inflateReset");
+    }
 
-      err = inflateEnd(&stream);
-      if (err != Z_OK) {
-        throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib deflateEnd");
+    stream.next_in = const_cast<uint8_t*>(ptr);
+    stream.avail_in = sz;
+    stream.next_out = tBuf_.get();
+    stream.avail_out = tBufSize_;
+    while ((err = inflate(&stream, Z_NO_FLUSH)) == Z_OK) {
+      if (stream.avail_out == 0) {
+        if (tBufSize_ > MAX_FRAME_SIZE) {
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Decompressed frame is too large");
+        }
+        auto used = static_cast<uint32_t>(stream.total_out);
+        growTransformBuffer(tBufSize_ * 2, used);
+        stream.next_out = tBuf_.get() + used;
+        stream.avail_out = tBufSize_ - used;
       }
+    }
+    if (err != Z_STREAM_END) {
+      throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                  "Error while zlib deflate");
+    }
+    return static_cast<uint32_t>(stream.total_out);
+  }
 
-      memcpy(ptr, tBuf_.get(), sz);
-    } else {
-      throw TApplicationException(TApplicationException::MISSING_RESULT, "Unknown transform");
+#ifdef HAVE_LIBZSTD
+  if (transId == ZSTD_TRANSFORM) {
+    if (contexts_->zstdDecompress == nullptr) {
+      contexts_->zstdDecompress = ZSTD_createDCtx();
+      if (contexts_->zstdDecompress == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+    unsigned long long size = ZSTD_getFrameContentSize(ptr, sz);
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Invalid zstd frame");
+    }
+    if (size > MAX_FRAME_SIZE) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Decompressed frame is too large");
+    }
+    growTransformBuffer(static_cast<uint32_t>(size));
+    size_t result = ZSTD_decompressDCtx(contexts_->zstdDecompress, tBuf_.get(), tBufSize_, ptr, sz);
+    if (ZSTD_isError(result) || result != size) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Error while zstd decompress");
     }
+    return static_cast<uint32_t>(result);
   }
+#endif
+
+#ifdef HAVE_LIBLZ4
+  if (transId == LZ4_TRANSFORM) {
+    // The block is preceded by the size of the uncompressed data
+    uint32_t sizeN;
+    if (sz < sizeof(sizeN)) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA, "Invalid lz4 frame");
+    }
+    memcpy(&sizeN, ptr, sizeof(sizeN));
+    uint32_t size = ntohl(sizeN);
+    if (size > MAX_FRAME_SIZE) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Decompressed frame is too large");
+    }
+    growTransformBuffer(size);
+    int result = LZ4_decompress_safe(reinterpret_cast<const char*>(ptr) + sizeof(sizeN),
+                                     reinterpret_cast<char*>(tBuf_.get()),
+                                     static_cast<int>(sz - sizeof(sizeN)),
+                                     static_cast<int>(size));
+    if (result < 0 || static_cast<uint32_t>(result) != size) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Error while lz4 decompress");
+    }
+    return size;
+  }
+#endif
 
-  setReadBuffer(ptr, sz);
+  throw TApplicationException(TApplicationException::MISSING_RESULT, "Unknown transform");
 }
 
 /**
@@ -316,27 +450,65 @@ void THeaderTransport::untransform(uint8_t* ptr, uint32_t sz) {
  */
 void THeaderTransport::resizeTransformBuffer(uint32_t additionalSize) {
   if (tBufSize_ < wBufSize_ + DEFAULT_BUFFER_SIZE) {
-    uint32_t new_size = wBufSize_ + DEFAULT_BUFFER_SIZE + additionalSize;
-    auto* new_buf = new uint8_t[new_size];
+    growTransformBuffer(wBufSize_ + DEFAULT_BUFFER_SIZE + additionalSize);
+  }
+}
+
+void THeaderTransport::growTransformBuffer(uint32_t size, uint32_t keep) {
+  if (tBufSize_ < size) {
+    auto* new_buf = new uint8_t[size];
+    if (keep > 0) {
+      memcpy(new_buf, tBuf_.get(), keep);
+    }
     tBuf_.reset(new_buf);
-    tBufSize_ = new_size;
+    tBufSize_ = size;
   }
 }
 
+/**
+ * Applies the write transforms to the frame.  A transform that would not
+ * make the frame smaller, or any transform if the frame is smaller than
+ * minCompressBytes_, is left out; appliedTrans_ lists the ones that were
+ * applied for the frame header.
+ */
 void THeaderTransport::transform(uint8_t* ptr, uint32_t sz) {
   // Update the transform buffer size if needed
   resizeTransformBuffer();
 
+  appliedTrans_.clear();
   for (vector<uint16_t>::const_iterator it = writeTrans_.begin(); it != writeTrans_.end(); ++it) {
     const uint16_t transId = *it;
+    if (!isTransformSupported(transId)) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
+    }
+    if (sz < minCompressBytes_) {
+      continue;
+    }
 
-    if (transId == ZLIB_TRANSFORM) {
-      z_stream stream;
-      int err;
+    uint32_t compressed = compress(transId, ptr, sz);
+    if (compressed > 0 && compressed < sz) {
+      memcpy(ptr, tBuf_.get(), compressed);
+      sz = compressed;
+      appliedTrans_.push_back(transId);
+    }
+  }
+
+  wBase_ = wBuf_.get() + sz;
+}
 
-      stream.next_in = ptr;
-      stream.avail_in = sz;
+/**
+ * Compresses sz bytes at ptr into the transform buffer.  Returns the size of
+ * the result, or 0 if it would not have fit into the buffer.
+ */
+uint32_t THeaderTransport::compress(uint16_t transId, const uint8_t* ptr, uint32_t sz) {
+  if (!contexts_) {
+    contexts_ = std::make_shared<TransformContexts>();
+  }
 
+  if (transId == ZLIB_TRANSFORM) {
+    z_stream& stream = contexts_->deflateStream;
+    int err;
+    if (!contexts_->deflateReady) {
       stream.zalloc = (alloc_func)nullptr;
       stream.zfree = (free_func)nullptr;
       stream.opaque = (voidpf)nullptr;
@@ -345,30 +517,65 @@ void THeaderTransport::transform(uint8_t* ptr, uint32_t sz) {
         throw TTransportException(TTransportException::CORRUPTED_DATA,
                                   "Error while zlib deflateInit");
       }
-      uint32_t tbuf_size = 0;
-      while (err == Z_OK) {
-        resizeTransformBuffer(tbuf_size);
-
-        stream.next_out = tBuf_.get();
-        stream.avail_out = tBufSize_;
-        err = deflate(&stream, Z_FINISH);
-        tbuf_size += DEFAULT_BUFFER_SIZE;
-      }
-      sz = stream.total_out;
+      contexts_->deflateReady = true;
+    } else if (deflateReset(&stream) != Z_OK) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Error while zlib deflateReset");
+    }
 
-      err = deflateEnd(&stream);
-      if (err != Z_OK) {
-        throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateEnd");
+    stream.next_in = const_cast<uint8_t*>(ptr);
+    stream.avail_in = sz;
+    stream.next_out = tBuf_.get();
+    stream.avail_out = tBufSize_;
+    err = deflate(&stream, Z_FINISH);
+    if (err == Z_STREAM_END) {
+      return static_cast<uint32_t>(stream.total_out);
+    }
+    if (err == Z_OK || err == Z_BUF_ERROR) {
+      // out of space
+      return 0;
+    }
+    throw TTransportException(TTransportException::CORRUPTED_DATA, "Error while zlib deflate");
+  }
+
+#ifdef HAVE_LIBZSTD
+  if (transId == ZSTD_TRANSFORM) {
+    if (contexts_->zstdCompress == nullptr) {
+      contexts_->zstdCompress = ZSTD_createCCtx();
+      if (contexts_->zstdCompress == nullptr) {
+        throw std::bad_alloc();
       }
+    }
+    // zstd's default compression level
+    size_t result = ZSTD_compressCCtx(contexts_->zstdCompress, tBuf_.get(), tBufSize_, ptr, sz, 3);
+    if (ZSTD_isError(result)) {
+      return 0;
+    }
+    return static_cast<uint32_t>(result);
+  }
+#endif
 
-      memcpy(ptr, tBuf_.get(), sz);
-    } else {
-      throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
+#ifdef HAVE_LIBLZ4
+  if (transId == LZ4_TRANSFORM) {
+    if (contexts_->lz4State.empty()) {
+      contexts_->lz4State.resize(LZ4_sizeofState());
     }
+    uint32_t sizeN = htonl(sz);
+    memcpy(tBuf_.get(), &sizeN, sizeof(sizeN));
+    int result = LZ4_compress_fast_extState(&contexts_->lz4State[0],
+                                            reinterpret_cast<const char*>(ptr),
+                                            reinterpret_cast<char*>(tBuf_.get()) + sizeof(sizeN),
+                                            static_cast<int>(sz),
+                                            static_cast<int>(tBufSize_ - sizeof(sizeN)),
+                                            1);
+    if (result <= 0) {
+      return 0;
+    }
+    return static_cast<uint32_t>(result) + sizeof(sizeN);
   }
+#endif
 
-  wBase_ = wBuf_.get() + sz;
+  throw TTransportException(TTransportException::CORRUPTED_DATA, "Unknown transform");
 }
 
 void THeaderTransport::resetProtocol() {
@@ -437,7 +644,8 @@ void THeaderTransport::flush() {
   if (clientType == THRIFT_HEADER_CLIENT_TYPE) {
     // header size will need to be updated at the end because of varints.
     // Make it big enough here for max varint size, plus 4 for padding.
-    uint32_t headerSize = (2 + getNumTransforms()) * THRIFT_MAX_VARINT32_BYTES + 4;
+    auto numTransforms = safe_numeric_cast<uint16_t>(appliedTrans_.size());
+    uint32_t headerSize = (2 + numTransforms) * THRIFT_MAX_VARINT32_BYTES + 4;
     // add approximate size of info headers
     headerSize += getMaxWriteHeadersSize();
 
@@ -475,10 +683,10 @@ void THeaderTransport::flush() {
     headerStart = pkt;
 
     pkt += writeVarint32(protoId, pkt);
-    pkt += writeVarint32(getNumTransforms(), pkt);
+    pkt += writeVarint32(numTransforms, pkt);
 
     // For now, each transform is only the ID, no following data.
-    for (vector<uint16_t>::const_iterator it = writeTrans_.begin(); it != writeTrans_.end(); ++it) {
+    for (vector<uint16_t>::const_iterator it = appliedTrans_.begin(); it != appliedTrans_.end(); ++it) {
       pkt += writeVarint32(*it, pkt);
     }
 
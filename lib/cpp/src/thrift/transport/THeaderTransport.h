@@ -26,6 +26,7 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <memory>
 
 #ifdef HAVE_STDINT_H
 #include <stdint.h>
@@ -82,6 +83,7 @@ public:
       clientType(THRIFT_HEADER_CLIENT_TYPE),
       seqId(0),
       flags(0),
+      minCompressBytes_(0),
       tBufSize_(0),
       tBuf_(nullptr) {
     if (!transport_) throw std::invalid_argument("transport is empty");
@@ -97,6 +99,7 @@ public:
       clientType(THRIFT_HEADER_CLIENT_TYPE),
       seqId(0),
       flags(0),
+      minCompressBytes_(0),
       tBufSize_(0),
       tBuf_(nullptr) {
     if (!transport_) throw std::invalid_argument("inTransport is empty");
@@ -148,6 +151,25 @@ public:
 
   void setTransform(uint16_t transId) { writeTrans_.push_back(transId); }
 
+  // the transforms that were applied to the last frame read
+  const std::vector<uint16_t>& getReadTransforms() const { return readTrans_; }
+
+  /**
+   * Returns whether this build of the library can apply and remove a
+   * transform.  ZSTD_TRANSFORM and LZ4_TRANSFORM depend on the libraries
+   * being available at build time.
+   */
+  static bool isTransformSupported(uint16_t transId);
+
+  /**
+   * Frames with a payload smaller than this are sent without applying the
+   * compression transforms, since the savings would not pay for the work.
+   * A transform is also left out of a frame it would not make smaller.
+   * The receiver sees which transforms were applied in the frame header.
+   */
+  void setMinCompressBytes(uint32_t minCompressBytes) { minCompressBytes_ = minCompressBytes; }
+  uint32_t getMinCompressBytes() const { return minCompressBytes_; }
+
   // Info headers
 
   typedef std::map<std::string, std::string> StringToStringMap;
@@ -168,6 +190,8 @@ public:
 
   enum TRANSFORMS {
     ZLIB_TRANSFORM = 0x01,
+    ZSTD_TRANSFORM = 0x05,
+    LZ4_TRANSFORM = 0x06,
   };
 
 protected:
@@ -179,7 +203,6 @@ protected:
    */
   bool readFrame() override;
 
-  void ensureReadBuffer(uint32_t sz);
   uint32_t getWriteBytes();
 
   void initBuffers() {
@@ -203,6 +226,9 @@ protected:
 
   std::vector<uint16_t> readTrans_;
   std::vector<uint16_t> writeTrans_;
+  // The transforms applied to the frame being flushed
+  std::vector<uint16_t> appliedTrans_;
+  uint32_t minCompressBytes_;
 
   // Map to use for headers
   StringToStringMap readHeaders_;
@@ -225,6 +251,20 @@ protected:
   uint32_t tBufSize_;
   boost::scoped_array<uint8_t> tBuf_;
 
+  /**
+   * Grows the transform buffer to at least size bytes, keeping the first
+   * keep bytes of its contents.
+   */
+  void growTransformBuffer(uint32_t size, uint32_t keep = 0);
+
+  // Compression and decompression state, kept for the lifetime of the
+  // transport so that it is not set up again for every frame
+  struct TransformContexts;
+  std::shared_ptr<TransformContexts> contexts_;
+
+  uint32_t compress(uint16_t transId, const uint8_t* ptr, uint32_t sz);
+  uint32_t decompress(uint16_t transId, const uint8_t* ptr, uint32_t sz);
+
   void readString(uint8_t*& ptr, /* out */ std::string& str, uint8_t const* headerBoundary);
 
   void writeString(uint8_t*& ptr, const std::string& str);
@@ -17,7 +17,6 @@
  * under the License.
  */
 
-#include <limits>
 #include <cstdlib>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
@@ -37,15 +36,17 @@ THttpClient::THttpClient(std::shared_ptr<TTransport> transport,
                          std::string path,
                          std::shared_ptr<TConfiguration> config)
   : THttpTransport(transport, config),
-    host_(host), 
-    path_(path) {
+    host_(host),
+    path_(path),
+    pipelining_(false) {
 }
 
 THttpClient::THttpClient(string host, int port, string path, 
                          std::shared_ptr<TConfiguration> config)
   : THttpTransport(std::shared_ptr<TTransport>(new TSocket(host, port)), config),
     host_(host),
-    path_(path) {
+    path_(path),
+    pipelining_(false) {
 }
 
 THttpClient::~THttpClient() = default;
@@ -96,30 +97,33 @@ bool THttpClient::parseStatusLine(char* status) {
   }
 }
 
+void THttpClient::close() {
+  if (isOpen()) {
+    sendQueuedMessages();
+  }
+  THttpTransport::close();
+}
+
 void THttpClient::flush() {
   resetConsumedMessageSize();
-  // Fetch the contents of the write buffer
-  uint8_t* buf;
-  uint32_t len;
-  writeBuffer_.getBuffer(&buf, &len);
 
   // Construct the HTTP header
   std::ostringstream h;
   h << "POST " << path_ << " HTTP/1.1" << CRLF << "Host: " << host_ << CRLF
-    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << len << CRLF
+    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << bodyLength() << CRLF
     << "Accept: application/x-thrift" << CRLF << "User-Agent: Thrift/" << PACKAGE_VERSION
     << " (C++/THttpClient)" << CRLF << CRLF;
-  string header = h.str();
 
-  if (header.size() > (std::numeric_limits<uint32_t>::max)())
-    throw TTransportException("Header too big");
-  // Write the header, then the data, then flush
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
-  transport_->flush();
+  if (pipelining_) {
+    // Sent with the requests that follow, when the client reads a response
+    writeMessage(h.str(), queuedMessages_);
+  } else {
+    // Write the header, then the data, then flush
+    writeMessage(h.str(), *transport_);
+    transport_->flush();
+  }
 
-  // Reset the buffer and header variables
-  writeBuffer_.resetBuffer();
+  // Reset the header variables
   readHeaders_ = true;
 }
 
@@ -53,13 +53,30 @@ public:
 
   ~THttpClient() override;
 
+  void close() override;
+
   void flush() override;
 
   void setPath(std::string path);
 
+  /**
+   * Holds the requests back until the client reads a response, so that
+   * requests sent before reading the responses to earlier ones go out in one
+   * write (HTTP/1.1 pipelining).  The server answers them in order:
+   *
+   *   client.send_a();
+   *   client.send_b();
+   *   client.recv_a();  // sends both requests
+   *   client.recv_b();
+   *
+   * Oneway requests wait for the next response to be read, or close().
+   */
+  void setPipelining(bool pipelining) { pipelining_ = pipelining; }
+
 protected:
   std::string host_;
   std::string path_;
+  bool pipelining_;
 
   void parseHeader(char* header) override;
   bool parseStatusLine(char* status) override;
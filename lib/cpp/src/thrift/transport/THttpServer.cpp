@@ -35,8 +35,7 @@ namespace thrift {
 namespace transport {
 
 THttpServer::THttpServer(std::shared_ptr<TTransport> transport, std::shared_ptr<TConfiguration> config) 
-  : THttpTransport(transport, config) {
-
+  : THttpTransport(transport, config), responseChunkSize_(0), http11_(false), streaming_(false) {
 }
 
 THttpServer::~THttpServer() = default;
@@ -88,6 +87,8 @@ bool THttpServer::parseStatusLine(char* status) {
     throw TTransportException(string("Bad Status: ") + status);
   }
   *http = '\0';
+  // Only HTTP/1.1 clients understand chunked responses
+  http11_ = strcmp(http + 1, "HTTP/1.1") == 0;
 
   if (strcmp(method, "POST") == 0) {
     // POST method ok, looking for content.
@@ -95,9 +96,6 @@ bool THttpServer::parseStatusLine(char* status) {
   } else if (strcmp(method, "OPTIONS") == 0) {
     // preflight OPTIONS method, we don't need further content.
     // how to graciously close connection?
-    uint8_t* buf;
-    uint32_t len;
-    writeBuffer_.getBuffer(&buf, &len);
 
     // Construct the HTTP header
     std::ostringstream h;
@@ -107,44 +105,70 @@ bool THttpServer::parseStatusLine(char* status) {
     string header = h.str();
 
     // Write the header, then the data, then flush
-    transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-    transport_->write(buf, len);
+    writeMessage(header, *transport_);
     transport_->flush();
 
-    // Reset the buffer and header variables
-    writeBuffer_.resetBuffer();
+    // Reset the header variables
     readHeaders_ = true;
     return true;
   }
   throw TTransportException(string("Bad Status (unsupported method): ") + status);
 }
 
+void THttpServer::write(const uint8_t* buf, uint32_t len) {
+  THttpTransport::write(buf, len);
+  if (responseChunkSize_ > 0 && http11_ && bodyLength() >= responseChunkSize_) {
+    writeChunk(false);
+  }
+}
+
 void THttpServer::flush() {
   resetConsumedMessageSize();
-  // Fetch the contents of the write buffer
-  uint8_t* buf;
-  uint32_t len;
-  writeBuffer_.getBuffer(&buf, &len);
-
-  // Construct the HTTP header
-  string header = getHeader(len);
-
-  // Write the header, then the data, then flush
-  // cast should be fine, because none of "header" is under attacker control
-  transport_->write((const uint8_t*)header.c_str(), static_cast<uint32_t>(header.size()));
-  transport_->write(buf, len);
+  if (streaming_) {
+    writeChunk(true);
+    streaming_ = false;
+  } else {
+    // Write the header, then the data, then flush
+    writeMessage(getHeader(bodyLength()), *transport_);
+  }
   transport_->flush();
 
-  // Reset the buffer and header variables
-  writeBuffer_.resetBuffer();
+  // Reset the header variables
   readHeaders_ = true;
 }
 
+void THttpServer::writeChunk(bool last) {
+  std::ostringstream h;
+  if (!streaming_) {
+    h << getResponseHeader("Transfer-Encoding: chunked");
+    streaming_ = true;
+  }
+  // The chunk goes out straight from writeBuffer_, between its size and CRLF
+  uint32_t len = bodyLength();
+  if (len > 0) {
+    h << std::hex << len << CRLF;
+    writeBuffer_.write(reinterpret_cast<const uint8_t*>(CRLF), CRLF_LEN);
+  }
+  if (last) {
+    writeBuffer_.write(reinterpret_cast<const uint8_t*>("0\r\n\r\n"), 5);
+  }
+  writeMessage(h.str(), *transport_);
+  if (!last) {
+    transport_->flush();
+  }
+}
+
 std::string THttpServer::getHeader(uint32_t len) {
+  std::ostringstream h;
+  h << "Content-Length: " << len;
+  return getResponseHeader(h.str());
+}
+
+std::string THttpServer::getResponseHeader(const std::string& length) {
   std::ostringstream h;
   h << "HTTP/1.1 200 OK" << CRLF << "Date: " << getTimeRFC1123() << CRLF << "Server: Thrift/"
     << PACKAGE_VERSION << CRLF << "Access-Control-Allow-Origin: *" << CRLF
-    << "Content-Type: application/x-thrift" << CRLF << "Content-Length: " << len << CRLF
+    << "Content-Type: application/x-thrift" << CRLF << length << CRLF
     << "Connection: Keep-Alive" << CRLF << CRLF;
   return h.str();
 }
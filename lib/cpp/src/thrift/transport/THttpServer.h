@@ -32,14 +32,34 @@ public:
 
   ~THttpServer() override;
 
+  /**
+   * Streams responses to HTTP/1.1 clients in chunks of size bytes, with
+   * chunked transfer encoding, instead of holding them until flush().
+   * 0, the default, sends every response at once with its length.
+   */
+  void setResponseChunkSize(uint32_t size) { responseChunkSize_ = size; }
+
+  void write(const uint8_t* buf, uint32_t len);
+
+  void write_virt(const uint8_t* buf, uint32_t len) override { write(buf, len); }
+
   void flush() override;
 
 protected:
   virtual std::string getHeader(uint32_t len);
+  std::string getResponseHeader(const std::string& length);
   void readHeaders();
   void parseHeader(char* header) override;
   bool parseStatusLine(char* status) override;
   std::string getTimeRFC1123();
+
+  void writeChunk(bool last);
+
+  uint32_t responseChunkSize_;
+  // Whether the client of the current request speaks HTTP/1.1
+  bool http11_;
+  // Whether the current response is being sent in chunks
+  bool streaming_;
 };
 
 /**
@@ -49,14 +69,26 @@ class THttpServerTransportFactory : public TTransportFactory {
 public:
   THttpServerTransportFactory() = default;
 
+  /**
+   * Streams responses in chunks of responseChunkSize bytes, see
+   * THttpServer::setResponseChunkSize().
+   */
+  explicit THttpServerTransportFactory(uint32_t responseChunkSize)
+    : responseChunkSize_(responseChunkSize) {}
+
   ~THttpServerTransportFactory() override = default;
 
   /**
    * Wraps the transport into a buffered one.
    */
   std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override {
-    return std::shared_ptr<TTransport>(new THttpServer(trans));
+    auto server = new THttpServer(trans);
+    server->setResponseChunkSize(responseChunkSize_);
+    return std::shared_ptr<TTransport>(server);
   }
+
+private:
+  uint32_t responseChunkSize_ = 0;
 };
 }
 }
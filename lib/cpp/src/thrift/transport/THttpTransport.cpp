@@ -17,6 +17,9 @@
  * under the License.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <sstream>
 
 #include <thrift/transport/THttpTransport.h>
@@ -40,6 +43,9 @@ THttpTransport::THttpTransport(std::shared_ptr<TTransport> transport, std::share
     chunkedDone_(false),
     chunkSize_(0),
     contentLength_(0),
+    contentRemaining_(0),
+    chunkTrailer_(false),
+    headerReserved_(false),
     httpBuf_(nullptr),
     httpPos_(0),
     httpBufLen_(0),
@@ -63,20 +69,41 @@ THttpTransport::~THttpTransport() {
 
 uint32_t THttpTransport::read(uint8_t* buf, uint32_t len) {
   checkReadBytesAvailable(len);
-  if (readBuffer_.available_read() == 0) {
-    readBuffer_.resetBuffer();
+  if (contentRemaining_ == 0) {
     uint32_t got = readMoreData();
     if (got == 0) {
       return 0;
     }
   }
-  return readBuffer_.read(buf, len);
+
+  // The content is handed over from httpBuf_, or straight from the
+  // transport when the caller asks for more than httpBuf_ holds
+  uint32_t give = (std::min)(len, contentRemaining_);
+  if (httpPos_ == httpBufLen_) {
+    httpPos_ = 0;
+    httpBufLen_ = 0;
+    if (give >= httpBufSize_) {
+      give = transport_->read(buf, give);
+      if (give == 0) {
+        throw TTransportException(TTransportException::END_OF_FILE, "Could not read content");
+      }
+      contentRemaining_ -= give;
+      return give;
+    }
+    refill();
+  }
+  give = (std::min)(give, httpBufLen_ - httpPos_);
+  memcpy(buf, httpBuf_ + httpPos_, give);
+  httpPos_ += give;
+  contentRemaining_ -= give;
+  return give;
 }
 
 uint32_t THttpTransport::readEnd() {
   // Read any pending chunked data (footers etc.)
   if (chunked_) {
     while (!chunkedDone_) {
+      skipContent();
       readChunked();
     }
   }
@@ -84,41 +111,36 @@ uint32_t THttpTransport::readEnd() {
 }
 
 uint32_t THttpTransport::readMoreData() {
-  uint32_t size;
-
-  if (httpPos_ == httpBufLen_) {
-    // Get more data!
-    refill();
-  }
-
   if (readHeaders_) {
+    // The peer can't answer messages it didn't get
+    sendQueuedMessages();
     readHeaders();
+    if (!chunked_) {
+      contentRemaining_ = contentLength_;
+      readHeaders_ = true;
+      return contentLength_;
+    }
   }
-
-  if (chunked_) {
-    size = readChunked();
-  } else {
-    size = readContent(contentLength_);
-    readHeaders_ = true;
-  }
-
-  return size;
+  return chunked_ ? readChunked() : 0;
 }
 
 uint32_t THttpTransport::readChunked() {
-  uint32_t length = 0;
+  if (chunkTrailer_) {
+    // Read trailing CRLF after content
+    readLine();
+    chunkTrailer_ = false;
+  }
 
   char* line = readLine();
   uint32_t chunkSize = parseChunkSize(line);
   if (chunkSize == 0) {
     readChunkedFooters();
   } else {
-    // Read data content
-    length += readContent(chunkSize);
-    // Read trailing CRLF after content
-    readLine();
+    // The data content is read by read()
+    contentRemaining_ = chunkSize;
+    chunkTrailer_ = true;
   }
-  return length;
+  return chunkSize;
 }
 
 void THttpTransport::readChunkedFooters() {
@@ -127,6 +149,8 @@ void THttpTransport::readChunkedFooters() {
     char* line = readLine();
     if (strlen(line) == 0) {
       chunkedDone_ = true;
+      // The next message starts with its headers
+      readHeaders_ = true;
       break;
     }
   }
@@ -142,46 +166,39 @@ uint32_t THttpTransport::parseChunkSize(char* line) {
   return size;
 }
 
-uint32_t THttpTransport::readContent(uint32_t size) {
-  uint32_t need = size;
-  while (need > 0) {
-    uint32_t avail = httpBufLen_ - httpPos_;
-    if (avail == 0) {
-      // We have given all the data, reset position to head of the buffer
+void THttpTransport::skipContent() {
+  while (contentRemaining_ > 0) {
+    if (httpPos_ == httpBufLen_) {
       httpPos_ = 0;
       httpBufLen_ = 0;
       refill();
-
-      // Now have available however much we read
-      avail = httpBufLen_;
     }
-    uint32_t give = avail;
-    if (need < give) {
-      give = need;
-    }
-    readBuffer_.write((uint8_t*)(httpBuf_ + httpPos_), give);
-    httpPos_ += give;
-    need -= give;
+    uint32_t skip = (std::min)(contentRemaining_, httpBufLen_ - httpPos_);
+    httpPos_ += skip;
+    contentRemaining_ -= skip;
   }
-  return size;
 }
 
 char* THttpTransport::readLine() {
+  // Only the data that arrived since the last search is searched again
+  uint32_t searched = httpPos_;
   while (true) {
-    char* eol = nullptr;
-
-    eol = strstr(httpBuf_ + httpPos_, CRLF);
+    auto eol = static_cast<char*>(memchr(httpBuf_ + searched, '\n', httpBufLen_ - searched));
 
-    // No CRLF yet?
+    // No end of line yet?
     if (eol == nullptr) {
       // Shift whatever we have now to front and refill
+      searched = httpBufLen_ - httpPos_;
       shift();
       refill();
     } else {
-      // Return pointer to next line
-      *eol = '\0';
+      // Return pointer to next line, which ends with CRLF, or a bare LF
       char* line = httpBuf_ + httpPos_;
-      httpPos_ = static_cast<uint32_t>((eol - httpBuf_) + CRLF_LEN);
+      httpPos_ = static_cast<uint32_t>(eol - httpBuf_) + 1;
+      if (eol > line && eol[-1] == '\r') {
+        --eol;
+      }
+      *eol = '\0';
       return line;
     }
   }
@@ -203,6 +220,10 @@ void THttpTransport::shift() {
 void THttpTransport::refill() {
   uint32_t avail = httpBufSize_ - httpBufLen_;
   if (avail <= (httpBufSize_ / 4)) {
+    // Only a header line longer than the buffer makes it grow
+    if (httpBufSize_ >= static_cast<uint32_t>(getConfiguration()->getMaxMessageSize())) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA, "HTTP header too long");
+    }
     httpBufSize_ *= 2;
     char* tmpBuf = (char*)std::realloc(httpBuf_, httpBufSize_ + 1);
     if (tmpBuf == nullptr) {
@@ -224,8 +245,10 @@ void THttpTransport::refill() {
 void THttpTransport::readHeaders() {
   // Initialize headers state variables
   contentLength_ = 0;
+  contentRemaining_ = 0;
   chunked_ = false;
   chunkedDone_ = false;
+  chunkTrailer_ = false;
   chunkSize_ = 0;
 
   // Control state flow
@@ -256,9 +279,51 @@ void THttpTransport::readHeaders() {
 }
 
 void THttpTransport::write(const uint8_t* buf, uint32_t len) {
+  if (writeBuffer_.available_read() == 0) {
+    writeBuffer_.getWritePtr(HEADER_RESERVE);
+    writeBuffer_.wroteBytes(HEADER_RESERVE);
+    headerReserved_ = true;
+  }
   writeBuffer_.write(buf, len);
 }
 
+void THttpTransport::writeMessage(const std::string& header, TTransport& out) {
+  if (header.size() > (std::numeric_limits<uint32_t>::max)()) {
+    throw TTransportException("Header too big");
+  }
+  auto headerSize = static_cast<uint32_t>(header.size());
+  uint8_t* body;
+  uint32_t len;
+  writeBuffer_.getBuffer(&body, &len);
+  if (headerReserved_) {
+    body += HEADER_RESERVE;
+    len -= HEADER_RESERVE;
+  }
+
+  if (headerReserved_ && headerSize <= HEADER_RESERVE) {
+    memcpy(body - headerSize, header.data(), headerSize);
+    out.write(body - headerSize, headerSize + len);
+  } else {
+    // cast should be fine, because none of "header" is under attacker control
+    out.write((const uint8_t*)header.c_str(), headerSize);
+    out.write(body, len);
+  }
+
+  writeBuffer_.resetBuffer();
+  headerReserved_ = false;
+}
+
+void THttpTransport::sendQueuedMessages() {
+  if (queuedMessages_.available_read() > 0) {
+    uint8_t* buf;
+    uint32_t len;
+    queuedMessages_.getBuffer(&buf, &len);
+    transport_->write(buf, len);
+    transport_->flush();
+    queuedMessages_.resetBuffer();
+  }
+}
+
 const std::string THttpTransport::getOrigin() const {
   std::ostringstream oss;
   if (!origin_.empty()) {
@@ -44,7 +44,8 @@ public:
 
   bool isOpen() const override { return transport_->isOpen(); }
 
-  bool peek() override { return transport_->peek(); }
+  // Pipelined messages may have arrived with the last one
+  bool peek() override { return httpPos_ < httpBufLen_ || transport_->peek(); }
 
   void close() override { transport_->close(); }
 
@@ -66,12 +67,20 @@ protected:
 
   TMemoryBuffer writeBuffer_;
   TMemoryBuffer readBuffer_;
+  // Messages that wait for the next read to be sent
+  TMemoryBuffer queuedMessages_;
 
   bool readHeaders_;
   bool chunked_;
   bool chunkedDone_;
   uint32_t chunkSize_;
   uint32_t contentLength_;
+  // The part of the body, or of the current chunk, that is still to be read
+  uint32_t contentRemaining_;
+  // Whether the CRLF that ends the current chunk is still to be read
+  bool chunkTrailer_;
+  // Whether writeBuffer_ starts with HEADER_RESERVE bytes of room for the header
+  bool headerReserved_;
 
   char* httpBuf_;
   uint32_t httpPos_;
@@ -90,14 +99,32 @@ protected:
   uint32_t readChunked();
   void readChunkedFooters();
   uint32_t parseChunkSize(char* line);
-
-  uint32_t readContent(uint32_t size);
+  void skipContent();
 
   void refill();
   void shift();
 
+  /**
+   * The length of the body in writeBuffer_.
+   */
+  uint32_t bodyLength() const {
+    return writeBuffer_.available_read() - (headerReserved_ ? HEADER_RESERVE : 0);
+  }
+
+  /**
+   * Writes header and the body in writeBuffer_ to out, at once if the header
+   * fits in the room reserved in front of the body, and empties writeBuffer_.
+   */
+  void writeMessage(const std::string& header, TTransport& out);
+
+  /**
+   * Sends queuedMessages_.
+   */
+  void sendQueuedMessages();
+
   static const char* CRLF;
   static const int CRLF_LEN;
+  static const uint32_t HEADER_RESERVE = 512;
 };
 }
 }
@@ -0,0 +1,598 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/thrift-config.h>
+
+#include <thrift/transport/TMappedFileTransport.h>
+#include <thrift/transport/TTransportUtils.h>
+#include <thrift/transport/PlatformSocket.h>
+#include <thrift/concurrency/FunctionRunner.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+using std::cerr;
+using std::endl;
+using std::shared_ptr;
+using apache::thrift::concurrency::FunctionRunner;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::protocol::TProtocol;
+
+namespace {
+
+// The index file starts with this header, followed by the offsets of the
+// events in the log.  Both are in host byte order, like the event sizes in
+// the log itself.
+struct IndexHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t chunkSize;
+  uint32_t reserved;
+  // where indexing stopped, which is where the next event will start
+  uint64_t scanned;
+  uint64_t numEvents;
+};
+
+const char INDEX_MAGIC[4] = {'T', 'F', 'I', 'X'};
+const uint32_t INDEX_VERSION = 1;
+
+bool readAt(int fd, void* buf, size_t len, off_t offset) {
+  auto* pos = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t got = ::pread(fd, pos, len, offset);
+    if (got == -1 && THRIFT_ERRNO == THRIFT_EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    pos += got;
+    len -= got;
+    offset += got;
+  }
+  return true;
+}
+
+bool writeAt(int fd, const void* buf, size_t len, off_t offset) {
+  const auto* pos = static_cast<const uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t written = ::pwrite(fd, pos, len, offset);
+    if (written == -1 && THRIFT_ERRNO == THRIFT_EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    pos += written;
+    len -= written;
+    offset += written;
+  }
+  return true;
+}
+}
+
+// The file as it was mapped at one point in time, together with the offsets
+// of its events.  It is shared by the readers for single chunks, and
+// replaced by refresh() once the file grows.
+struct TMappedFileTransport::Mapping {
+  explicit Mapping(uint32_t chunkSize)
+    : base_(nullptr), size_(0), scanned_(0), chunkSize_(chunkSize) {}
+
+  ~Mapping() {
+    if (base_) {
+      ::munmap(const_cast<uint8_t*>(base_), size_);
+    }
+  }
+
+  // maps the file as it is now
+  void map(int fd) {
+    struct THRIFT_STAT info;
+    if (::THRIFT_FSTAT(fd, &info) == -1) {
+      int errno_copy = THRIFT_ERRNO;
+      throw TTransportException(TTransportException::UNKNOWN,
+                                "TMappedFileTransport: fstat()",
+                                errno_copy);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ == 0) {
+      return;
+    }
+    void* base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      int errno_copy = THRIFT_ERRNO;
+      size_ = 0;
+      throw TTransportException(TTransportException::UNKNOWN,
+                                "TMappedFileTransport: mmap()",
+                                errno_copy);
+    }
+    base_ = static_cast<const uint8_t*>(base);
+  }
+
+  // Indexes the events after scanned_, following the rules that
+  // TFileTransport writes the log with: an event length never crosses a
+  // chunk boundary, a length of zero is padding, and events never cross
+  // chunk boundaries either.
+  void indexEvents() {
+    uint64_t pos = scanned_;
+    while (pos < size_) {
+      uint64_t chunkEnd = (pos / chunkSize_ + 1) * chunkSize_;
+      if (pos + 4 > chunkEnd) {
+        pos = chunkEnd;
+        continue;
+      }
+      if (pos + 4 > size_) {
+        break;
+      }
+      uint32_t eventSize;
+      memcpy(&eventSize, base_ + pos, 4);
+      if (eventSize == 0) {
+        pos += 4;
+        continue;
+      }
+      if (eventSize > chunkSize_ || pos + 4 + eventSize > chunkEnd) {
+        T_ERROR("TMappedFileTransport: corrupt event at offset %lu, skipping to the next chunk",
+                static_cast<unsigned long>(pos));
+        pos = chunkEnd;
+        continue;
+      }
+      if (pos + 4 + eventSize > size_) {
+        // still being written
+        break;
+      }
+      offsets_.push_back(pos + 4);
+      pos += 4 + eventSize;
+    }
+    scanned_ = pos;
+  }
+
+  uint32_t eventSize(uint64_t event) const {
+    uint32_t size;
+    memcpy(&size, base_ + offsets_[event] - 4, 4);
+    return size;
+  }
+
+  const uint8_t* base_;
+  size_t size_;
+  uint64_t scanned_;
+  uint32_t chunkSize_;
+  // offsets of the contents of the events, behind their lengths
+  std::vector<uint64_t> offsets_;
+};
+
+const uint32_t TMappedFileTransport::DEFAULT_CHUNK_SIZE;
+const uint64_t TMappedFileTransport::UNBOUNDED;
+
+TMappedFileTransport::TMappedFileTransport(const std::string& path,
+                                           uint32_t chunkSize,
+                                           std::shared_ptr<TConfiguration> config)
+  : TTransport(config),
+    path_(path),
+    fd_(-1),
+    chunkSize_(chunkSize ? chunkSize : DEFAULT_CHUNK_SIZE),
+    firstEvent_(0),
+    endEvent_(UNBOUNDED),
+    curEvent_(0),
+    eventPos_(0),
+    readTimeout_(TFileTransport::NO_TAIL_READ_TIMEOUT),
+    eofSleepTime_(DEFAULT_EOF_SLEEP_TIME_US) {
+  fd_ = ::THRIFT_OPEN(path_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    int errno_copy = THRIFT_ERRNO;
+    GlobalOutput.perror("TMappedFileTransport: open() file: " + path_, errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, path_, errno_copy);
+  }
+
+  try {
+    mapping_ = std::make_shared<Mapping>(chunkSize_);
+    mapping_->map(fd_);
+    bool loaded = loadIndex(*mapping_);
+    uint64_t numEvents = mapping_->offsets_.size();
+    uint64_t scanned = mapping_->scanned_;
+    mapping_->indexEvents();
+    if (!loaded) {
+      saveIndex(0);
+    } else if (mapping_->scanned_ != scanned) {
+      saveIndex(numEvents);
+    }
+  } catch (...) {
+    ::THRIFT_CLOSE(fd_);
+    throw;
+  }
+}
+
+TMappedFileTransport::TMappedFileTransport(std::shared_ptr<Mapping> mapping,
+                                           uint64_t firstEvent,
+                                           uint64_t endEvent,
+                                           std::shared_ptr<TConfiguration> config)
+  : TTransport(config),
+    fd_(-1),
+    chunkSize_(mapping->chunkSize_),
+    mapping_(mapping),
+    firstEvent_(firstEvent),
+    endEvent_(endEvent),
+    curEvent_(firstEvent),
+    eventPos_(0),
+    readTimeout_(TFileTransport::NO_TAIL_READ_TIMEOUT),
+    eofSleepTime_(DEFAULT_EOF_SLEEP_TIME_US) {
+}
+
+TMappedFileTransport::~TMappedFileTransport() {
+  if (fd_ != -1) {
+    ::THRIFT_CLOSE(fd_);
+  }
+}
+
+bool TMappedFileTransport::loadIndex(Mapping& mapping) {
+  int fd = ::THRIFT_OPEN(getIndexPath(path_).c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  IndexHeader header;
+  struct THRIFT_STAT info;
+  bool valid = readAt(fd, &header, sizeof(header), 0)
+               && memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+               && header.version == INDEX_VERSION
+               && header.chunkSize == mapping.chunkSize_
+               && ::THRIFT_FSTAT(fd, &info) == 0
+               && header.numEvents <= (info.st_size - sizeof(header)) / sizeof(uint64_t);
+  if (valid) {
+    mapping.offsets_.resize(header.numEvents);
+    valid = readAt(fd,
+                   mapping.offsets_.data(),
+                   mapping.offsets_.size() * sizeof(uint64_t),
+                   sizeof(header));
+  }
+  ::THRIFT_CLOSE(fd);
+
+  // Make sure the index belongs to this log, which may have been replaced
+  // since.  Checking every event would touch the whole file, so only the
+  // last event is checked.
+  if (valid) {
+    const std::vector<uint64_t>& offsets = mapping.offsets_;
+    for (size_t i = 1; valid && i < offsets.size(); ++i) {
+      valid = offsets[i - 1] < offsets[i];
+    }
+    if (valid && !offsets.empty()) {
+      uint64_t last = offsets.back();
+      valid = last >= 4 && last <= mapping.size_;
+      if (valid) {
+        uint32_t size = mapping.eventSize(offsets.size() - 1);
+        valid = size != 0 && last + size <= mapping.size_ && last + size <= header.scanned;
+      }
+    }
+  }
+  if (!valid) {
+    GlobalOutput.printf("TMappedFileTransport: rebuilding invalid index %s",
+                        getIndexPath(path_).c_str());
+    mapping.offsets_.clear();
+    return false;
+  }
+  mapping.scanned_ = header.scanned;
+  return true;
+}
+
+void TMappedFileTransport::saveIndex(uint64_t firstNewEvent) {
+  std::string indexPath = getIndexPath(path_);
+  int flags = firstNewEvent == 0 ? O_WRONLY | O_CREAT | O_TRUNC : O_WRONLY;
+  int fd = ::THRIFT_OPEN(indexPath.c_str(), flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    // the index only saves time, reading works without it
+    GlobalOutput.perror("TMappedFileTransport: cannot write index " + indexPath, THRIFT_ERRNO);
+    return;
+  }
+
+  const std::vector<uint64_t>& offsets = mapping_->offsets_;
+  IndexHeader header;
+  memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.version = INDEX_VERSION;
+  header.chunkSize = chunkSize_;
+  header.reserved = 0;
+  header.scanned = mapping_->scanned_;
+  header.numEvents = offsets.size();
+
+  // Append the new offsets before the header that counts them, so that a
+  // reader never sees a header for offsets that were not written yet.
+  if (!writeAt(fd,
+               offsets.data() + firstNewEvent,
+               (offsets.size() - firstNewEvent) * sizeof(uint64_t),
+               sizeof(header) + firstNewEvent * sizeof(uint64_t))
+      || !writeAt(fd, &header, sizeof(header), 0)) {
+    GlobalOutput.perror("TMappedFileTransport: cannot write index " + indexPath, THRIFT_ERRNO);
+  }
+  ::THRIFT_CLOSE(fd);
+}
+
+bool TMappedFileTransport::refresh() {
+  // readers for single chunks have a fixed set of events
+  if (fd_ == -1) {
+    return false;
+  }
+
+  struct THRIFT_STAT info;
+  if (::THRIFT_FSTAT(fd_, &info) == -1
+      || static_cast<size_t>(info.st_size) <= mapping_->size_) {
+    return false;
+  }
+
+  auto mapping = std::make_shared<Mapping>(chunkSize_);
+  mapping->map(fd_);
+  mapping->scanned_ = mapping_->scanned_;
+  if (mapping_.use_count() == 1) {
+    mapping->offsets_.swap(mapping_->offsets_);
+  } else {
+    mapping->offsets_ = mapping_->offsets_;
+  }
+  uint64_t numEvents = mapping->offsets_.size();
+  uint64_t scanned = mapping->scanned_;
+  mapping->indexEvents();
+  mapping_ = mapping;
+
+  if (mapping_->scanned_ != scanned) {
+    saveIndex(numEvents);
+  }
+  return mapping_->offsets_.size() > numEvents;
+}
+
+uint64_t TMappedFileTransport::endEvent() {
+  return (std::min)(endEvent_, static_cast<uint64_t>(mapping_->offsets_.size()));
+}
+
+uint64_t TMappedFileTransport::findEvent(uint64_t offset) {
+  const std::vector<uint64_t>& offsets = mapping_->offsets_;
+  // the first event whose length starts at the offset or after it
+  auto event = std::lower_bound(offsets.begin() + firstEvent_, offsets.begin() + endEvent(), offset + 4);
+  return static_cast<uint64_t>(event - offsets.begin());
+}
+
+bool TMappedFileTransport::waitForEvent() {
+  if (curEvent_ < endEvent()) {
+    return true;
+  }
+  if (endEvent_ != UNBOUNDED) {
+    return false;
+  }
+
+  // look for events that were appended in the meantime
+  if (refresh()) {
+    return true;
+  }
+  if (readTimeout_ == TFileTransport::TAIL_READ_TIMEOUT) {
+    // wait indefinitely
+    while (true) {
+      THRIFT_SLEEP_USEC(eofSleepTime_);
+      if (refresh()) {
+        return true;
+      }
+    }
+  } else if (readTimeout_ > 0) {
+    THRIFT_SLEEP_USEC(readTimeout_ * 1000);
+    return refresh();
+  }
+  return false;
+}
+
+const uint8_t* TMappedFileTransport::currentEvent(uint32_t* remaining) {
+  *remaining = mapping_->eventSize(curEvent_) - eventPos_;
+  return mapping_->base_ + mapping_->offsets_[curEvent_] + eventPos_;
+}
+
+void TMappedFileTransport::consumeEvent(uint32_t len) {
+  eventPos_ += len;
+  if (eventPos_ == mapping_->eventSize(curEvent_)) {
+    ++curEvent_;
+    eventPos_ = 0;
+  }
+}
+
+bool TMappedFileTransport::peek() {
+  return waitForEvent();
+}
+
+uint32_t TMappedFileTransport::read(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  // did not manage to find an event, either because the timeout expired or
+  // because there are no more events
+  if (!waitForEvent()) {
+    return 0;
+  }
+
+  // read as much of the current event as possible
+  uint32_t remaining;
+  const uint8_t* data = currentEvent(&remaining);
+  uint32_t get = (std::min)(len, remaining);
+  memcpy(buf, data, get);
+  consumeEvent(get);
+  return get;
+}
+
+uint32_t TMappedFileTransport::readAll(uint8_t* buf, uint32_t len) {
+  checkReadBytesAvailable(len);
+  uint32_t have = 0;
+
+  while (have < len) {
+    uint32_t get = read(buf + have, len - have);
+    if (get == 0) {
+      throw TEOFException();
+    }
+    have += get;
+  }
+
+  return have;
+}
+
+const uint8_t* TMappedFileTransport::borrow_virt(uint8_t* buf, uint32_t* len) {
+  (void)buf;
+  if (curEvent_ >= endEvent()) {
+    return nullptr;
+  }
+  uint32_t remaining;
+  const uint8_t* data = currentEvent(&remaining);
+  if (remaining < *len) {
+    return nullptr;
+  }
+  *len = remaining;
+  return data;
+}
+
+std::shared_ptr<const uint8_t> TMappedFileTransport::borrowShared_virt(uint32_t len) {
+  if (curEvent_ >= endEvent()) {
+    return std::shared_ptr<const uint8_t>();
+  }
+  uint32_t remaining;
+  const uint8_t* data = currentEvent(&remaining);
+  if (remaining < len) {
+    return std::shared_ptr<const uint8_t>();
+  }
+  // the mapping stays alive as long as the data is referenced
+  return std::shared_ptr<const uint8_t>(mapping_, data);
+}
+
+void TMappedFileTransport::consume_virt(uint32_t len) {
+  uint32_t remaining = 0;
+  if (curEvent_ < endEvent()) {
+    currentEvent(&remaining);
+  }
+  if (remaining < len) {
+    throw TTransportException(TTransportException::BAD_ARGS, "consume did not follow a borrow.");
+  }
+  consumeEvent(len);
+}
+
+uint64_t TMappedFileTransport::getNumEvents() {
+  return endEvent() - firstEvent_;
+}
+
+void TMappedFileTransport::seekToEvent(uint64_t event) {
+  curEvent_ = firstEvent_ + (std::min)(event, getNumEvents());
+  eventPos_ = 0;
+}
+
+uint32_t TMappedFileTransport::getNumChunks() {
+  // empty file has no chunks
+  if (mapping_->size_ == 0) {
+    return 0;
+  }
+  return static_cast<uint32_t>(mapping_->size_ / chunkSize_ + 1);
+}
+
+uint32_t TMappedFileTransport::getCurChunk() {
+  uint64_t offset;
+  if (curEvent_ < endEvent()) {
+    offset = mapping_->offsets_[curEvent_] - 4;
+  } else {
+    offset = (std::min)(static_cast<uint64_t>(mapping_->size_), mapping_->scanned_);
+  }
+  return static_cast<uint32_t>(offset / chunkSize_);
+}
+
+void TMappedFileTransport::seekToChunk(int32_t chunk) {
+  int32_t numChunks = getNumChunks();
+
+  // file is empty, seeking to chunk is pointless
+  if (numChunks == 0) {
+    return;
+  }
+
+  // negative indicates reverse seek (from the end)
+  if (chunk < 0) {
+    chunk += numChunks;
+  }
+
+  // too large a value for reverse seek, just seek to beginning
+  if (chunk < 0) {
+    chunk = 0;
+  }
+
+  curEvent_ = findEvent(static_cast<uint64_t>(chunk) * chunkSize_);
+  eventPos_ = 0;
+}
+
+void TMappedFileTransport::seekToEnd() {
+  curEvent_ = endEvent();
+  eventPos_ = 0;
+}
+
+std::shared_ptr<TMappedFileTransport> TMappedFileTransport::getChunkReader(uint32_t chunk) {
+  uint64_t first = findEvent(static_cast<uint64_t>(chunk) * chunkSize_);
+  uint64_t end = findEvent(static_cast<uint64_t>(chunk + 1) * chunkSize_);
+  return std::shared_ptr<TMappedFileTransport>(
+      new TMappedFileTransport(mapping_, first, end, configuration_));
+}
+
+TMappedFileProcessor::TMappedFileProcessor(shared_ptr<TProcessor> processor,
+                                           shared_ptr<TProtocolFactory> protocolFactory,
+                                           shared_ptr<TMappedFileTransport> inputTransport)
+  : processor_(processor),
+    protocolFactory_(protocolFactory),
+    inputTransport_(inputTransport),
+    nextChunk_(0),
+    numChunks_(0) {
+}
+
+void TMappedFileProcessor::process(uint32_t numThreads) {
+  nextChunk_ = 0;
+  numChunks_ = inputTransport_->getNumChunks();
+
+  // the calling thread processes chunks as well
+  ThreadFactory threadFactory(false);
+  std::vector<shared_ptr<Thread> > threads;
+  for (uint32_t i = 1; i < numThreads; ++i) {
+    threads.push_back(threadFactory.newThread(
+        FunctionRunner::create(std::bind(&TMappedFileProcessor::processChunks, this))));
+    threads.back()->start();
+  }
+  processChunks();
+  for (auto& thread : threads) {
+    thread->join();
+  }
+}
+
+void TMappedFileProcessor::processChunks() {
+  shared_ptr<TTransport> outputTransport = std::make_shared<TNullTransport>();
+  shared_ptr<TProtocol> outputProtocol = protocolFactory_->getProtocol(outputTransport);
+
+  for (uint32_t chunk = nextChunk_++; chunk < numChunks_; chunk = nextChunk_++) {
+    shared_ptr<TMappedFileTransport> reader = inputTransport_->getChunkReader(chunk);
+    shared_ptr<TProtocol> inputProtocol = protocolFactory_->getProtocol(reader);
+    while (reader->peek()) {
+      try {
+        processor_->process(inputProtocol, outputProtocol, nullptr);
+      } catch (TException& te) {
+        cerr << te.what() << endl;
+        break;
+      }
+    }
+  }
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,200 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
+#define _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_ 1
+
+#include <thrift/transport/TFileTransport.h>
+
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * Reads the log files written by TFileTransport through a memory mapping.
+ *
+ * The offsets of all events in the file are indexed when the transport is
+ * created.  The index is kept in a sidecar file next to the log, see
+ * getIndexPath(), so that later readers only have to index the events that
+ * were appended since.  With the index, seekToEvent() is a constant time
+ * operation, and getChunkReader() hands out readers for single chunks that
+ * can be replayed by different threads, see TMappedFileProcessor.
+ *
+ * Events appended while the log is being read are picked up once the
+ * reader runs out of events, or by refresh().
+ */
+class TMappedFileTransport : public TFileReaderTransport {
+public:
+  static const uint32_t DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024;
+
+  /**
+   * @param path      the log file
+   * @param chunkSize the chunk size the log was written with
+   */
+  TMappedFileTransport(const std::string& path,
+                       uint32_t chunkSize = DEFAULT_CHUNK_SIZE,
+                       std::shared_ptr<TConfiguration> config = nullptr);
+  ~TMappedFileTransport() override;
+
+  bool isOpen() const override { return true; }
+  bool peek() override;
+
+  uint32_t read(uint8_t* buf, uint32_t len);
+  uint32_t readAll(uint8_t* buf, uint32_t len);
+
+  int32_t getReadTimeout() override { return readTimeout_; }
+  void setReadTimeout(int32_t readTimeout) override { readTimeout_ = readTimeout; }
+
+  void setEofSleepTimeUs(uint32_t eofSleepTime) {
+    if (eofSleepTime) {
+      eofSleepTime_ = eofSleepTime;
+    }
+  }
+  uint32_t getEofSleepTimeUs() { return eofSleepTime_; }
+
+  uint32_t getChunkSize() { return chunkSize_; }
+
+  // log-file specific functions
+  uint32_t getNumChunks() override;
+  uint32_t getCurChunk() override;
+  void seekToChunk(int32_t chunk) override;
+  void seekToEnd() override;
+
+  /**
+   * Returns the number of events this transport can read.
+   */
+  uint64_t getNumEvents();
+
+  /**
+   * Returns the number of the event that is read next.
+   */
+  uint64_t getCurEvent() { return curEvent_ - firstEvent_; }
+
+  /**
+   * Continues reading at the given event, or at the end if there are fewer
+   * events.
+   */
+  void seekToEvent(uint64_t event);
+
+  /**
+   * Maps and indexes the events that were appended to the log since it was
+   * last indexed.  Returns whether there are new events.  Readers for single
+   * chunks never see new events.
+   */
+  bool refresh();
+
+  /**
+   * Returns a reader for the events that start in the given chunk.  It
+   * shares the mapping of this transport, and can be used on another
+   * thread.
+   */
+  std::shared_ptr<TMappedFileTransport> getChunkReader(uint32_t chunk);
+
+  /**
+   * Returns the path of the index file for a log file.
+   */
+  static std::string getIndexPath(const std::string& path) { return path + ".idx"; }
+
+  uint32_t read_virt(uint8_t* buf, uint32_t len) override { return this->read(buf, len); }
+  uint32_t readAll_virt(uint8_t* buf, uint32_t len) override { return this->readAll(buf, len); }
+  const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) override;
+  std::shared_ptr<const uint8_t> borrowShared_virt(uint32_t len) override;
+  void consume_virt(uint32_t len) override;
+
+private:
+  struct Mapping;
+
+  TMappedFileTransport(std::shared_ptr<Mapping> mapping,
+                       uint64_t firstEvent,
+                       uint64_t endEvent,
+                       std::shared_ptr<TConfiguration> config);
+
+  uint64_t endEvent();
+  uint64_t findEvent(uint64_t offset);
+  bool waitForEvent();
+  const uint8_t* currentEvent(uint32_t* remaining);
+  void consumeEvent(uint32_t len);
+
+  bool loadIndex(Mapping& mapping);
+  void saveIndex(uint64_t firstNewEvent);
+
+  std::string path_;
+  int fd_;
+  uint32_t chunkSize_;
+  std::shared_ptr<Mapping> mapping_;
+
+  // the events this transport reads, endEvent_ is unbounded when reading
+  // the whole file
+  uint64_t firstEvent_;
+  uint64_t endEvent_;
+  static const uint64_t UNBOUNDED = (std::numeric_limits<uint64_t>::max)();
+
+  // the event that is read next, and the read position within it
+  uint64_t curEvent_;
+  uint32_t eventPos_;
+
+  int32_t readTimeout_;
+  uint32_t eofSleepTime_;
+  static const uint32_t DEFAULT_EOF_SLEEP_TIME_US = 500 * 1000;
+};
+
+/**
+ * Replays the events of a log file with several threads, each of which
+ * processes whole chunks.  The events of a chunk are processed in order, but
+ * different chunks are processed concurrently, so the handler behind the
+ * processor must be thread safe.
+ */
+class TMappedFileProcessor {
+public:
+  /**
+   * @param processor processes log-file events
+   * @param protocolFactory protocol factory
+   * @param inputTransport the log file
+   */
+  TMappedFileProcessor(std::shared_ptr<TProcessor> processor,
+                       std::shared_ptr<TProtocolFactory> protocolFactory,
+                       std::shared_ptr<TMappedFileTransport> inputTransport);
+
+  /**
+   * processes all events of the file
+   *
+   * @param numThreads number of threads that process chunks
+   */
+  void process(uint32_t numThreads);
+
+private:
+  void processChunks();
+
+  std::shared_ptr<TProcessor> processor_;
+  std::shared_ptr<TProtocolFactory> protocolFactory_;
+  std::shared_ptr<TMappedFileTransport> inputTransport_;
+
+  // the chunks that still need to be processed
+  std::atomic<uint32_t> nextChunk_;
+  uint32_t numChunks_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
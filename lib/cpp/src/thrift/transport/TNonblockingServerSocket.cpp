@@ -94,6 +94,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -109,6 +110,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(int port, int sendTimeout, in
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -125,6 +127,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& address, int po
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -141,6 +144,7 @@ TNonblockingServerSocket::TNonblockingServerSocket(const string& path)
     tcpSendBuffer_(0),
     tcpRecvBuffer_(0),
     keepAlive_(false),
+    reusePort_(false),
     listening_(false) {
 }
 
@@ -335,6 +339,23 @@ void TNonblockingServerSocket::_setup_tcp_sockopts() {
   }
 #endif
 
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT, cast_sockopt(&one), sizeof(one))) {
+      int errno_copy = THRIFT_GET_SOCKET_ERROR;
+      GlobalOutput.perror("TNonblockingServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not set SO_REUSEPORT",
+                                errno_copy);
+    }
+#else
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "SO_REUSEPORT is not supported on this platform");
+#endif
+  }
+
 } // _setup_tcp_sockopts()
 
 void TNonblockingServerSocket::listen() {
@@ -515,6 +536,31 @@ void TNonblockingServerSocket::listen() {
   listening_ = true;
 }
 
+THRIFT_SOCKET TNonblockingServerSocket::listenReusePort() {
+  if (!listening_) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TNonblockingServerSocket not listening");
+  }
+  if (!reusePort_ || isUnixDomainSocket()) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "listenReusePort() requires a TCP socket with setReusePort(true)");
+  }
+
+  // Bind a twin of this socket to the port actually in use, which differs
+  // from port_ if we were asked for an ephemeral one.
+  TNonblockingServerSocket twin(address_, listenPort_);
+  twin.acceptBacklog_ = acceptBacklog_;
+  twin.tcpSendBuffer_ = tcpSendBuffer_;
+  twin.tcpRecvBuffer_ = tcpRecvBuffer_;
+  twin.reusePort_ = true;
+  twin.listenCallback_ = listenCallback_;
+  twin.listen();
+
+  THRIFT_SOCKET result = twin.serverSocket_;
+  twin.serverSocket_ = THRIFT_INVALID_SOCKET;
+  return result;
+}
+
 int TNonblockingServerSocket::getPort() {
   return port_;
 }
@@ -532,7 +578,11 @@ bool TNonblockingServerSocket::isUnixDomainSocket() const {
 }
 
 shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
-  if (serverSocket_ == THRIFT_INVALID_SOCKET) {
+  return acceptFrom(serverSocket_);
+}
+
+shared_ptr<TSocket> TNonblockingServerSocket::acceptFrom(THRIFT_SOCKET listenSocket) {
+  if (serverSocket_ == THRIFT_INVALID_SOCKET || listenSocket == THRIFT_INVALID_SOCKET) {
     throw TTransportException(TTransportException::NOT_OPEN,
                               "TNonblockingServerSocket not listening");
   }
@@ -540,7 +590,7 @@ shared_ptr<TSocket> TNonblockingServerSocket::acceptImpl() {
   struct sockaddr_storage clientAddress;
   int size = sizeof(clientAddress);
   THRIFT_SOCKET clientSocket
-      = ::accept(serverSocket_, (struct sockaddr*)&clientAddress, (socklen_t*)&size);
+      = ::accept(listenSocket, (struct sockaddr*)&clientAddress, (socklen_t*)&size);
 
   if (clientSocket == THRIFT_INVALID_SOCKET) {
     int errno_copy = THRIFT_GET_SOCKET_ERROR;
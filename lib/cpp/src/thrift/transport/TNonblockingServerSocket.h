@@ -85,6 +85,10 @@ public:
 
   void setKeepAlive(bool keepAlive) { keepAlive_ = keepAlive; }
 
+  // Sets SO_REUSEPORT on the listen socket; required before listen() for
+  // listenReusePort() to work.  TCP sockets only.
+  void setReusePort(bool reusePort) { reusePort_ = reusePort; }
+
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
@@ -110,10 +114,12 @@ public:
   bool isUnixDomainSocket() const;
 
   void listen() override;
+  THRIFT_SOCKET listenReusePort() override;
   void close() override;
 
 protected:
   std::shared_ptr<TSocket> acceptImpl() override;
+  std::shared_ptr<TSocket> acceptFrom(THRIFT_SOCKET listenSocket) override;
   virtual std::shared_ptr<TSocket> createSocket(THRIFT_SOCKET client);
 
 private:
@@ -134,6 +140,7 @@ private:
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
   bool keepAlive_;
+  bool reusePort_;
   bool listening_;
 
   socket_func_t listenCallback_;
@@ -63,6 +63,38 @@ public:
     return result;
   }
 
+  /**
+   * Accepts a connection on one of the additional listen sockets returned by
+   * listenReusePort(), or on getSocketFD().  The returned socket is configured
+   * exactly like the ones returned by accept().
+   *
+   * @param listenSocket the listen socket that became readable
+   * @return A new TSocket object
+   * @throws TTransportException if there is an error
+   */
+  std::shared_ptr<TSocket> accept(THRIFT_SOCKET listenSocket) {
+    std::shared_ptr<TSocket> result = acceptFrom(listenSocket);
+    if (!result) {
+      throw TTransportException("accept() may not return nullptr");
+    }
+    return result;
+  }
+
+  /**
+   * Creates one more listen socket bound to the same address as this
+   * transport, relying on SO_REUSEPORT to let the kernel spread incoming
+   * connections over all of them.  Only valid after listen().  The caller
+   * owns the returned socket and accepts on it with accept(THRIFT_SOCKET).
+   *
+   * @return the new listen socket
+   * @throws TTransportException if the transport does not support it or the
+   *                             socket could not be created
+   */
+  virtual THRIFT_SOCKET listenReusePort() {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "listenReusePort() not supported by this transport");
+  }
+
   /**
   * Utility method
   * 
@@ -92,6 +124,21 @@ protected:
    */
   virtual std::shared_ptr<TSocket> acceptImpl() = 0;
 
+  /**
+   * Subclasses supporting listenReusePort() should implement this function
+   * for accepting on an additional listen socket.
+   *
+   * @return A newly allocated TSocket object
+   * @throw TTransportException If an error occurs
+   */
+  virtual std::shared_ptr<TSocket> acceptFrom(THRIFT_SOCKET listenSocket) {
+    if (listenSocket != getSocketFD()) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "accept() on a socket not owned by this transport");
+    }
+    return acceptImpl();
+  }
+
 };
 }
 }
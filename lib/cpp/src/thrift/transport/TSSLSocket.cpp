@@ -19,6 +19,7 @@
 
 #include <thrift/thrift-config.h>
 
+#include <algorithm>
 #include <cstring>
 #include <errno.h>
 #include <memory>
@@ -36,6 +37,9 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #define OPENSSL_VERSION_NO_THREAD_ID_BEFORE    0x10000000L
 #define OPENSSL_ENGINE_CLEANUP_REQUIRED_BEFORE 0x10100000L
@@ -187,6 +191,8 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
     throw TSSLException("SSL_CTX_new: " + errors);
   }
   SSL_CTX_set_mode(ctx_, SSL_MODE_AUTO_RETRY);
+  SSL_CTX_set_app_data(ctx_, this);
+  maxSessions_ = 0;
 
   // Disable horribly insecure SSLv2 and SSLv3 protocols but allow a handshake
   // with older clients so they get a graceful denial.
@@ -197,12 +203,86 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
 }
 
 SSLContext::~SSLContext() {
+  clearSessions();
   if (ctx_ != nullptr) {
     SSL_CTX_free(ctx_);
     ctx_ = nullptr;
   }
 }
 
+void SSLContext::setSessionCache(bool enable, size_t size) {
+  if (enable) {
+    // Servers refuse to resume sessions of authenticated clients without a
+    // session id context
+    static const unsigned char sessionIdContext[] = "thrift";
+    SSL_CTX_set_session_id_context(ctx_, sessionIdContext, sizeof(sessionIdContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_BOTH);
+    SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(size));
+    SSL_CTX_clear_options(ctx_, SSL_OP_NO_TICKET);
+    SSL_CTX_sess_set_new_cb(ctx_, newSessionCallback);
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+    SSL_CTX_sess_set_new_cb(ctx_, nullptr);
+  }
+  Guard guard(sessionsMutex_);
+  maxSessions_ = enable ? size : 0;
+  if (!enable) {
+    clearSessions();
+  }
+}
+
+SSL_SESSION* SSLContext::takeSession(const string& peer) {
+  Guard guard(sessionsMutex_);
+  auto it = sessions_.find(peer);
+  if (it == sessions_.end()) {
+    return nullptr;
+  }
+  // TLS 1.3 sessions should not be resumed twice, the server issues a new
+  // one with every handshake
+  SSL_SESSION* session = it->second;
+  sessions_.erase(it);
+  return session;
+}
+
+/*
+ * Keeps the sessions clients receive, which is after the handshake for TLS 1.3.
+ */
+int SSLContext::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  auto* context = static_cast<SSLContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  auto* socket = static_cast<TSSLSocket*>(SSL_get_app_data(ssl));
+  if (SSL_is_server(ssl) || context == nullptr || socket == nullptr || socket->getHost().empty()) {
+    return 0;
+  }
+  string peer = socket->getHost() + ":" + to_string(socket->getPort());
+
+  Guard guard(context->sessionsMutex_);
+  if (context->maxSessions_ == 0) {
+    return 0;
+  }
+  auto it = context->sessions_.find(peer);
+  if (it != context->sessions_.end()) {
+    SSL_SESSION_free(it->second);
+    it->second = session;
+    return 1;
+  }
+  if (context->sessions_.size() >= context->maxSessions_) {
+    // make room by forgetting the session of some other server
+    SSL_SESSION_free(context->sessions_.begin()->second);
+    context->sessions_.erase(context->sessions_.begin());
+  }
+  context->sessions_[peer] = session;
+  // the cache keeps the reference of the caller
+  return 1;
+}
+
+void SSLContext::clearSessions() {
+  for (auto& session : sessions_) {
+    SSL_SESSION_free(session.second);
+  }
+  sessions_.clear();
+}
+
 SSL* SSLContext::createSSL() {
   SSL* ssl = SSL_new(ctx_);
   if (ssl == nullptr) {
@@ -270,6 +350,32 @@ void TSSLSocket::init() {
   eventSafe_ = false;
 }
 
+bool TSSLSocket::isKernelTLSSend() const {
+  if (ssl_ == nullptr) {
+    return false;
+  }
+#ifdef SSL_OP_ENABLE_KTLS
+  return BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+bool TSSLSocket::isKernelTLSRecv() const {
+  if (ssl_ == nullptr) {
+    return false;
+  }
+#ifdef SSL_OP_ENABLE_KTLS
+  return BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+bool TSSLSocket::isSessionReused() const {
+  return ssl_ != nullptr && SSL_session_reused(ssl_);
+}
+
 bool TSSLSocket::isOpen() const {
   if (ssl_ == nullptr || !TSocket::isOpen()) {
     return false;
@@ -556,6 +662,67 @@ uint32_t TSSLSocket::write_partial(const uint8_t* buf, uint32_t len) {
   return written;
 }
 
+/*
+ * Note: This method is not libevent safe.
+*/
+void TSSLSocket::sendFile(int fd, off_t offset, size_t size) {
+  initializeHandshake();
+  if (!checkHandshake())
+    throw TSSLException("sendFile: Handshake is not completed");
+#ifdef SSL_OP_ENABLE_KTLS
+  if (isKernelTLSSend()) {
+    while (size > 0) {
+      ERR_clear_error();
+      ossl_ssize_t bytes = SSL_sendfile(ssl_, fd, offset, size, 0);
+      if (bytes <= 0) {
+        int errno_copy = THRIFT_GET_SOCKET_ERROR;
+        int error = SSL_get_error(ssl_, static_cast<int>(bytes));
+        switch (error) {
+          case SSL_ERROR_SYSCALL:
+            if ((errno_copy != THRIFT_EINTR)
+                && (errno_copy != THRIFT_EAGAIN)) {
+              break;
+            }
+          // fallthrough
+          case SSL_ERROR_WANT_READ:
+          case SSL_ERROR_WANT_WRITE:
+            waitForEvent(error == SSL_ERROR_WANT_READ);
+            continue;
+          default:;// do nothing
+        }
+        string errors;
+        buildErrors(errors, errno_copy, error);
+        throw TSSLException("SSL_sendfile: " + errors);
+      }
+      offset += bytes;
+      size -= static_cast<size_t>(bytes);
+    }
+    return;
+  }
+#endif
+  if (::THRIFT_LSEEK(fd, offset, SEEK_SET) == -1) {
+    int errno_copy = THRIFT_ERRNO;
+    throw TTransportException(TTransportException::UNKNOWN, "sendFile: lseek() failed", errno_copy);
+  }
+  // the size of the largest TLS record
+  uint8_t buf[16 * 1024];
+  while (size > 0) {
+    auto bytes = ::THRIFT_READ(fd, buf, static_cast<unsigned int>((std::min)(size, sizeof(buf))));
+    if (bytes < 0) {
+      int errno_copy = THRIFT_ERRNO;
+      if (errno_copy == EINTR) {
+        continue;
+      }
+      throw TTransportException(TTransportException::UNKNOWN, "sendFile: read() failed", errno_copy);
+    }
+    if (bytes == 0) {
+      throw TTransportException(TTransportException::END_OF_FILE, "sendFile: file too short");
+    }
+    write(buf, static_cast<uint32_t>(bytes));
+    size -= static_cast<size_t>(bytes);
+  }
+}
+
 void TSSLSocket::flush() {
   resetConsumedMessageSize();
   // Don't throw exception if not open. Thrift servers close socket twice.
@@ -590,6 +757,15 @@ void TSSLSocket::initializeHandshakeParams() {
   ssl_ = ctx_->createSSL();
 
   SSL_set_fd(ssl_, static_cast<int>(socket_));
+  SSL_set_app_data(ssl_, this);
+  if (!server()) {
+    // offer the session of the last connection to the server, if any
+    SSL_SESSION* session = ctx_->takeSession(getHost() + ":" + to_string(getPort()));
+    if (session != nullptr) {
+      SSL_set_session(ssl_, session);
+      SSL_SESSION_free(session);
+    }
+  }
 }
 
 bool TSSLSocket::checkHandshake() {
@@ -923,6 +1099,24 @@ void TSSLSocketFactory::setup(std::shared_ptr<TSSLSocket> ssl) {
   }
 }
 
+void TSSLSocketFactory::enableKernelTLS(bool enable) {
+#ifdef SSL_OP_ENABLE_KTLS
+  if (enable) {
+    SSL_CTX_set_options(ctx_->get(), SSL_OP_ENABLE_KTLS);
+  } else {
+    SSL_CTX_clear_options(ctx_->get(), SSL_OP_ENABLE_KTLS);
+  }
+#else
+  if (enable) {
+    throw TSSLException("enableKernelTLS: OpenSSL does not support kernel TLS");
+  }
+#endif
+}
+
+void TSSLSocketFactory::enableSessionCache(bool enable, size_t size) {
+  ctx_->setSessionCache(enable, size);
+}
+
 void TSSLSocketFactory::ciphers(const string& enable) {
   int rc = SSL_CTX_set_cipher_list(ctx_->get(), enable.c_str());
   if (ERR_peek_error() != 0) {
@@ -24,7 +24,9 @@
 #include <thrift/transport/TSocket.h>
 
 #include <openssl/ssl.h>
+#include <map>
 #include <string>
+#include <sys/types.h>
 #include <thrift/concurrency/Mutex.h>
 
 namespace apache {
@@ -106,6 +108,33 @@ public:
    * Determines whether SSL Socket is libevent safe or not.
    */
   bool isLibeventSafe() const { return eventSafe_; }
+  /**
+   * Determines whether the kernel encrypts the records this socket sends,
+   * see TSSLSocketFactory::enableKernelTLS().
+   */
+  bool isKernelTLSSend() const;
+  /**
+   * Determines whether the kernel decrypts the records this socket receives.
+   */
+  bool isKernelTLSRecv() const;
+  /**
+   * Determines whether the handshake resumed an earlier session, see
+   * TSSLSocketFactory::enableSessionCache().
+   */
+  bool isSessionReused() const;
+  /**
+   * Send part of a file.  If the kernel encrypts the records of this socket,
+   * the file is sent without copying it to user space, otherwise it is read
+   * and written in pieces.  Transports on top of this socket must be flushed
+   * first.
+   *
+   * Note: This method is not libevent safe.
+   *
+   * @param fd     File to send
+   * @param offset Offset of the first byte to send
+   * @param size   Number of bytes to send
+   */
+  void sendFile(int fd, off_t offset, size_t size);
 
 protected:
   /**
@@ -245,6 +274,30 @@ public:
   * @param port  Remote port to be connected to
   */
   virtual std::shared_ptr<TSSLSocket> createSocket(const std::string& host, int port, std::shared_ptr<THRIFT_SOCKET> interruptListener);
+  /**
+   * Enable/Disable kernel TLS.  Once the handshake is done, the kernel
+   * encrypts and decrypts the records of connections, and
+   * TSSLSocket::sendFile() sends files without copying them to user space.
+   * Connections fall back to OpenSSL if the kernel does not support TLS or
+   * the negotiated cipher.
+   *
+   * @param enable Use kernel TLS if true
+   * @throw TSSLException if OpenSSL was built without kernel TLS support
+   */
+  virtual void enableKernelTLS(bool enable);
+  /**
+   * Enable/Disable session resumption, which saves the expensive part of the
+   * handshake when a client reconnects.  Servers cache sessions and issue
+   * session tickets.  Clients keep the last session of every server, by host
+   * and port, and offer it when they connect to the server again.
+   *
+   * Without a call to this method, the OpenSSL defaults apply, under which
+   * servers resume sessions but clients never offer them.
+   *
+   * @param enable Resume sessions if true
+   * @param size   Maximum number of cached sessions
+   */
+  virtual void enableSessionCache(bool enable, size_t size = 1024);
   /**
    * Set ciphers to be used in SSL handshake process.
    *
@@ -359,8 +412,27 @@ public:
   SSL* createSSL();
   SSL_CTX* get() { return ctx_; }
 
+  /**
+   * Enable/Disable session resumption, see
+   * TSSLSocketFactory::enableSessionCache().
+   */
+  void setSessionCache(bool enable, size_t size);
+  /**
+   * Remove the session kept for a server from the client session cache.
+   *
+   * @param  peer Host and port of the server
+   * @return The session, which the caller must free, or nullptr
+   */
+  SSL_SESSION* takeSession(const std::string& peer);
+
 private:
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+  void clearSessions();
+
   SSL_CTX* ctx_;
+  concurrency::Mutex sessionsMutex_;
+  std::map<std::string, SSL_SESSION*> sessions_;
+  size_t maxSessions_;
 };
 
 /**
@@ -20,12 +20,21 @@
 #include <thrift/thrift-config.h>
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <memory>
-#if __cplusplus >= 201703L
-#include <random>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
 #endif
 
+#include <thrift/transport/PlatformSocket.h>
 #include <thrift/transport/TSocketPool.h>
 
 using std::pair;
@@ -36,14 +45,50 @@ namespace apache {
 namespace thrift {
 namespace transport {
 
+using apache::thrift::concurrency::Guard;
 using std::shared_ptr;
 
+namespace {
+
+// Weight of a new sample in the moving average of the latency
+const double LATENCY_SAMPLE_WEIGHT = 0.3;
+
+// Time without samples after which the latency counts half
+const double LATENCY_HALF_LIFE_US = 10.0 * 1000 * 1000;
+
+double elapsedUs(std::chrono::steady_clock::time_point since,
+                 std::chrono::steady_clock::time_point now) {
+  return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::microseconds>(now - since).count());
+}
+
+void closeSocket(THRIFT_SOCKET socket) {
+  shutdown(socket, THRIFT_SHUT_RDWR);
+  ::THRIFT_CLOSESOCKET(socket);
+}
+
+// An idle connection must neither have data nor be closed by the server
+bool isIdleSocketUsable(THRIFT_SOCKET socket) {
+  struct THRIFT_POLLFD fds[1];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = socket;
+  fds[0].events = THRIFT_POLLIN;
+  return THRIFT_POLL(fds, 1, 0) == 0;
+}
+}
+
 /**
  * TSocketPoolServer implementation
  *
  */
 TSocketPoolServer::TSocketPoolServer()
-  : host_(""), port_(0), socket_(THRIFT_INVALID_SOCKET), lastFailTime_(0), consecutiveFailures_(0) {
+  : host_(""),
+    port_(0),
+    socket_(THRIFT_INVALID_SOCKET),
+    lastFailTime_(0),
+    consecutiveFailures_(0),
+    outstanding_(0),
+    latencyUs_(0) {
 }
 
 /**
@@ -54,7 +99,70 @@ TSocketPoolServer::TSocketPoolServer(const string& host, int port)
     port_(port),
     socket_(THRIFT_INVALID_SOCKET),
     lastFailTime_(0),
-    consecutiveFailures_(0) {
+    consecutiveFailures_(0),
+    outstanding_(0),
+    latencyUs_(0) {
+}
+
+TSocketPoolServer::~TSocketPoolServer() {
+  for (THRIFT_SOCKET socket : idleSockets_) {
+    closeSocket(socket);
+  }
+}
+
+double TSocketPoolServer::decayedLatencyUs(std::chrono::steady_clock::time_point now) {
+  if (latencyUs_ == 0) {
+    return 0;
+  }
+  return latencyUs_ * std::exp2(-elapsedUs(lastSampleTime_, now) / LATENCY_HALF_LIFE_US);
+}
+
+void TSocketPoolServer::addLatencySample(double latencyUs) {
+  Guard g(mutex_);
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (latencyUs_ == 0) {
+    latencyUs_ = latencyUs;
+  } else {
+    double latency = decayedLatencyUs(now);
+    latencyUs_ = latency + LATENCY_SAMPLE_WEIGHT * (latencyUs - latency);
+  }
+  // a latency of 0 means that there are no samples
+  latencyUs_ = (std::max)(latencyUs_, 1.0);
+  lastSampleTime_ = now;
+}
+
+double TSocketPoolServer::getLatencyUs() {
+  Guard g(mutex_);
+  return decayedLatencyUs(std::chrono::steady_clock::now());
+}
+
+double TSocketPoolServer::getLoad() {
+  // servers without samples cost nothing, so that they are tried soon
+  return getLatencyUs() * (outstanding_ + 1);
+}
+
+THRIFT_SOCKET TSocketPoolServer::takeIdleSocket() {
+  Guard g(mutex_);
+  while (!idleSockets_.empty()) {
+    THRIFT_SOCKET socket = idleSockets_.back();
+    idleSockets_.pop_back();
+    if (isIdleSocketUsable(socket)) {
+      return socket;
+    }
+    closeSocket(socket);
+  }
+  return THRIFT_INVALID_SOCKET;
+}
+
+void TSocketPoolServer::returnIdleSocket(THRIFT_SOCKET socket, size_t maxIdleSockets) {
+  {
+    Guard g(mutex_);
+    if (idleSockets_.size() < maxIdleSockets) {
+      idleSockets_.push_back(socket);
+      return;
+    }
+  }
+  closeSocket(socket);
 }
 
 /**
@@ -68,7 +176,9 @@ TSocketPool::TSocketPool()
     retryInterval_(60),
     maxConsecutiveFailures_(1),
     randomize_(true),
-    alwaysTryLast_(true) {
+    alwaysTryLast_(true),
+    maxIdleConnections_(0),
+    rng_(std::random_device()()) {
 }
 
 TSocketPool::TSocketPool(const vector<string>& hosts, const vector<int>& ports)
@@ -77,7 +187,9 @@ TSocketPool::TSocketPool(const vector<string>& hosts, const vector<int>& ports)
     retryInterval_(60),
     maxConsecutiveFailures_(1),
     randomize_(true),
-    alwaysTryLast_(true) {
+    alwaysTryLast_(true),
+    maxIdleConnections_(0),
+    rng_(std::random_device()()) {
   if (hosts.size() != ports.size()) {
     GlobalOutput("TSocketPool::TSocketPool: hosts.size != ports.size");
     throw TTransportException(TTransportException::BAD_ARGS);
@@ -94,7 +206,9 @@ TSocketPool::TSocketPool(const vector<pair<string, int> >& servers)
     retryInterval_(60),
     maxConsecutiveFailures_(1),
     randomize_(true),
-    alwaysTryLast_(true) {
+    alwaysTryLast_(true),
+    maxIdleConnections_(0),
+    rng_(std::random_device()()) {
   for (const auto & server : servers) {
     addServer(server.first, server.second);
   }
@@ -107,7 +221,9 @@ TSocketPool::TSocketPool(const vector<shared_ptr<TSocketPoolServer> >& servers)
     retryInterval_(60),
     maxConsecutiveFailures_(1),
     randomize_(true),
-    alwaysTryLast_(true) {
+    alwaysTryLast_(true),
+    maxIdleConnections_(0),
+    rng_(std::random_device()()) {
 }
 
 TSocketPool::TSocketPool(const string& host, int port)
@@ -116,11 +232,16 @@ TSocketPool::TSocketPool(const string& host, int port)
     retryInterval_(60),
     maxConsecutiveFailures_(1),
     randomize_(true),
-    alwaysTryLast_(true) {
+    alwaysTryLast_(true),
+    maxIdleConnections_(0),
+    rng_(std::random_device()()) {
   addServer(host, port);
 }
 
 TSocketPool::~TSocketPool() {
+  if (requestServer_) {
+    finishRequest(false);
+  }
   vector<shared_ptr<TSocketPoolServer> >::const_iterator iter = servers_.begin();
   vector<shared_ptr<TSocketPoolServer> >::const_iterator iterEnd = servers_.end();
   for (; iter != iterEnd; ++iter) {
@@ -167,6 +288,10 @@ void TSocketPool::setAlwaysTryLast(bool alwaysTryLast) {
   alwaysTryLast_ = alwaysTryLast;
 }
 
+void TSocketPool::setMaxIdleConnections(size_t maxIdleConnections) {
+  maxIdleConnections_ = maxIdleConnections;
+}
+
 void TSocketPool::setCurrentServer(const shared_ptr<TSocketPoolServer>& server) {
   currentServer_ = server;
   host_ = server->host_;
@@ -192,13 +317,11 @@ void TSocketPool::open() {
   }
 
   if (randomize_ && numServers > 1) {
-#if __cplusplus >= 201703L
-    std::random_device rng;
-    std::mt19937 urng(rng());
-    std::shuffle(servers_.begin(), servers_.end(), urng);
-#else
-    std::random_shuffle(servers_.begin(), servers_.end());
-#endif
+    std::shuffle(servers_.begin(), servers_.end(), rng_);
+    // Of the first two random servers, try the one with the lower load first
+    if (servers_[1]->getLoad() < servers_[0]->getLoad()) {
+      std::swap(servers_[0], servers_[1]);
+    }
   }
 
   for (size_t i = 0; i < numServers; ++i) {
@@ -212,6 +335,13 @@ void TSocketPool::open() {
       return;
     }
 
+    // Reuse a cached connection to the server
+    socket_ = server->takeIdleSocket();
+    if (socket_ != THRIFT_INVALID_SOCKET) {
+      server->socket_ = socket_;
+      return;
+    }
+
     bool retryIntervalPassed = (server->lastFailTime_ == 0);
     bool isLastServer = alwaysTryLast_ ? (i == (numServers - 1)) : false;
 
@@ -225,6 +355,7 @@ void TSocketPool::open() {
 
     if (retryIntervalPassed || isLastServer) {
       for (int j = 0; j < numRetries_; ++j) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         try {
           TSocket::open();
         } catch (const TException &e) {
@@ -234,6 +365,7 @@ void TSocketPool::open() {
           continue;
         }
 
+        server->addLatencySample(elapsedUs(start, std::chrono::steady_clock::now()));
         // Copy over the opened socket so that we can keep it persistent
         server->socket_ = socket_;
         // reset lastFailTime_ is required
@@ -256,11 +388,61 @@ void TSocketPool::open() {
 }
 
 void TSocketPool::close() {
+  // A connection with an unread response can't be reused
+  bool reusable = maxIdleConnections_ > 0 && currentServer_ && !requestServer_;
+  if (requestServer_) {
+    finishRequest(false);
+  }
+  if (reusable && socket_ != THRIFT_INVALID_SOCKET) {
+    currentServer_->returnIdleSocket(socket_, maxIdleConnections_);
+    socket_ = THRIFT_INVALID_SOCKET;
+  }
   TSocket::close();
   if (currentServer_) {
     currentServer_->socket_ = THRIFT_INVALID_SOCKET;
   }
 }
+
+/**
+ * The latency of a request is the time from the flush() that sends it to the
+ * first byte of the response.  Requests that fail count with the time they
+ * waited, so that servers that time out look slow.
+ */
+uint32_t TSocketPool::read(uint8_t* buf, uint32_t len) {
+  if (!requestServer_) {
+    return TSocket::read(buf, len);
+  }
+  uint32_t got;
+  try {
+    got = TSocket::read(buf, len);
+  } catch (const TTransportException&) {
+    finishRequest(true);
+    throw;
+  }
+  finishRequest(got > 0);
+  return got;
+}
+
+void TSocketPool::flush() {
+  TSocket::flush();
+  if (!currentServer_) {
+    return;
+  }
+  // A oneway request has no response, so the next request restarts the clock
+  if (!requestServer_) {
+    requestServer_ = currentServer_;
+    ++requestServer_->outstanding_;
+  }
+  requestTime_ = std::chrono::steady_clock::now();
+}
+
+void TSocketPool::finishRequest(bool addSample) {
+  if (addSample) {
+    requestServer_->addLatencySample(elapsedUs(requestTime_, std::chrono::steady_clock::now()));
+  }
+  --requestServer_->outstanding_;
+  requestServer_.reset();
+}
 }
 }
 } // apache::thrift::transport
@@ -20,7 +20,11 @@
 #ifndef _THRIFT_TRANSPORT_TSOCKETPOOL_H_
 #define _THRIFT_TRANSPORT_TSOCKETPOOL_H_ 1
 
+#include <atomic>
+#include <chrono>
+#include <random>
 #include <vector>
+#include <thrift/concurrency/Mutex.h>
 #include <thrift/transport/TSocket.h>
 
 namespace apache {
@@ -44,6 +48,43 @@ public:
    */
   TSocketPoolServer(const std::string& host, int port);
 
+  /**
+   * Closes the cached connections.
+   */
+  ~TSocketPoolServer();
+
+  /**
+   * Adds a connect or request latency, in microseconds, to the moving
+   * average of the latency of this server.
+   */
+  void addLatencySample(double latencyUs);
+
+  /**
+   * Returns the moving average of the latency in microseconds, or 0 if
+   * there are no samples.  It halves for every ten seconds without new
+   * samples, so that servers which were slow once get tried again.
+   */
+  double getLatencyUs();
+
+  /**
+   * Returns the expected cost of sending a request to this server, based
+   * on its latency and the requests it is still working on.
+   */
+  double getLoad();
+
+  /**
+   * Takes a cached connection to this server, or returns
+   * THRIFT_INVALID_SOCKET if there is none.  Connections that were closed
+   * by the server in the meantime are dropped.
+   */
+  THRIFT_SOCKET takeIdleSocket();
+
+  /**
+   * Caches a connection to this server for later reuse, or closes it if
+   * there are maxIdleSockets cached connections already.
+   */
+  void returnIdleSocket(THRIFT_SOCKET socket, size_t maxIdleSockets);
+
   // Host name
   std::string host_;
 
@@ -58,11 +99,29 @@ public:
 
   // Number of consecutive times connecting to this server failed
   int consecutiveFailures_;
+
+  // Number of requests sent to this server that wait for their response
+  std::atomic<int> outstanding_;
+
+private:
+  double decayedLatencyUs(std::chrono::steady_clock::time_point now);
+
+  apache::thrift::concurrency::Mutex mutex_;
+  double latencyUs_;
+  std::chrono::steady_clock::time_point lastSampleTime_;
+  std::vector<THRIFT_SOCKET> idleSockets_;
 };
 
 /**
- * TCP Socket implementation of the TTransport interface.
+ * TCP Socket implementation of the TTransport interface that connects to
+ * one of a list of servers.
  *
+ * Unless randomization is turned off, open() picks two random servers and
+ * tries the one with the lower load first, see TSocketPoolServer::getLoad(),
+ * before trying the others in random order.  The pool measures the latency
+ * of connecting and of each request, from flush() to the first byte of the
+ * response, for this purpose.  Pools that share TSocketPoolServer objects
+ * share what they learn about the servers.
  */
 class TSocketPool : public TSocket {
 
@@ -152,6 +211,12 @@ public:
    */
   void setAlwaysTryLast(bool alwaysTryLast);
 
+  /**
+   * Sets how many connections to keep open per server for reuse when pools
+   * that share the server are closed.  Defaults to 0, which closes them.
+   */
+  void setMaxIdleConnections(size_t maxIdleConnections);
+
   /**
    * Creates and opens the UNIX socket.
    */
@@ -162,8 +227,13 @@ public:
    */
   void close() override;
 
+  uint32_t read(uint8_t* buf, uint32_t len) override;
+
+  void flush() override;
+
 protected:
   void setCurrentServer(const std::shared_ptr<TSocketPoolServer>& server);
+  void finishRequest(bool addSample);
 
   /** List of servers to connect to */
   std::vector<std::shared_ptr<TSocketPoolServer> > servers_;
@@ -187,6 +257,15 @@ protected:
 
   /** Always try last host, even if marked down? */
   bool alwaysTryLast_;
+
+  /** Connections to cache per server */
+  size_t maxIdleConnections_;
+
+  /** Server of the request that waits for its response, and when it was sent */
+  std::shared_ptr<TSocketPoolServer> requestServer_;
+  std::chrono::steady_clock::time_point requestTime_;
+
+  std::mt19937 rng_;
 };
 }
 }
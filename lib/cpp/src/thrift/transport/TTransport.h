@@ -221,6 +221,28 @@ public:
   }
   virtual const uint8_t* borrow_virt(uint8_t* /* buf */, uint32_t* /* len */) { return nullptr; }
 
+  /**
+   * Like borrow(), but for data that is allowed to outlive the next read:
+   * attempts to return a pointer to the next \c len bytes in the transport's
+   * internal buffer that also keeps the buffer alive for as long as it (or a
+   * copy of it) exists.  The transport must not reuse that memory before all
+   * such pointers are gone.  Does not consume the bytes, see consume().
+   *
+   * Used by protocols to deserialize string and binary values without
+   * copying them, see TStringView.  Most transports do not support this
+   * and return nullptr, in which case the data has to be read as usual.
+   *
+   * @param len  The number of bytes to borrow
+   * @return A pointer to the borrowed data, or nullptr
+   */
+  std::shared_ptr<const uint8_t> borrowShared(uint32_t len) {
+    T_VIRTUAL_CALL();
+    return borrowShared_virt(len);
+  }
+  virtual std::shared_ptr<const uint8_t> borrowShared_virt(uint32_t /* len */) {
+    return std::shared_ptr<const uint8_t>();
+  }
+
   /**
    * Remove len bytes from the transport.  This should always follow a borrow
    * of at least len bytes, and should always succeed.
@@ -30,7 +30,7 @@ namespace transport {
  * Helper class that provides default implementations of TTransport methods.
  *
  * This class provides default implementations of read(), readAll(), write(),
- * borrow() and consume().
+ * borrow(), borrowShared() and consume().
  *
  * In the TTransport base class, each of these methods simply invokes its
  * virtual counterpart.  This class overrides them to always perform the
@@ -54,6 +54,9 @@ public:
   const uint8_t* borrow(uint8_t* buf, uint32_t* len) {
     return this->TTransport::borrow_virt(buf, len);
   }
+  std::shared_ptr<const uint8_t> borrowShared(uint32_t len) {
+    return this->TTransport::borrowShared_virt(len);
+  }
   void consume(uint32_t len) { this->TTransport::consume_virt(len); }
 
 protected:
@@ -100,6 +103,10 @@ public:
     return static_cast<Transport_*>(this)->borrow(buf, len);
   }
 
+  std::shared_ptr<const uint8_t> borrowShared_virt(uint32_t len) override {
+    return static_cast<Transport_*>(this)->borrowShared(len);
+  }
+
   void consume_virt(uint32_t len) override { static_cast<Transport_*>(this)->consume(len); }
 
   /*
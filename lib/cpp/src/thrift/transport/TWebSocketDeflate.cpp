@@ -0,0 +1,250 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+#include <thrift/transport/TWebSocketDeflate.h>
+#include <thrift/transport/TZlibTransport.h>
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+namespace {
+
+// Ends every compressed message, the sender leaves it out
+const uint8_t MESSAGE_TAIL[4] = {0x00, 0x00, 0xff, 0xff};
+
+// Zlib can't make raw deflate streams with a window of 2^8 bytes
+const int MIN_WINDOW_BITS = 9;
+
+std::string trim(const std::string& s) {
+  size_t begin = s.find_first_not_of(" \t");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  size_t end = s.find_last_not_of(" \t");
+  return s.substr(begin, end - begin + 1);
+}
+
+// Parses the value of a window bits parameter, which may be quoted
+bool parseWindowBits(std::string value, int min, int& bits) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  if (value.empty() || value.size() > 2
+      || value.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  bits = atoi(value.c_str());
+  return bits >= min && bits <= MAX_WBITS;
+}
+
+z_stream_s* newStream() {
+  auto stream = new z_stream;
+  stream->zalloc = Z_NULL;
+  stream->zfree = Z_NULL;
+  stream->opaque = Z_NULL;
+  stream->next_in = Z_NULL;
+  stream->avail_in = 0;
+  return stream;
+}
+}
+
+TWebSocketDeflate::TWebSocketDeflate(int level, uint32_t minSize, bool noContextTakeover)
+  : level_(level),
+    minSize_(minSize),
+    noContextTakeover_(noContextTakeover),
+    windowBits_(MAX_WBITS),
+    deflate_(nullptr),
+    inflate_(nullptr) {
+}
+
+TWebSocketDeflate::~TWebSocketDeflate() {
+  if (deflate_ != nullptr) {
+    deflateEnd(deflate_);
+    delete deflate_;
+  }
+  if (inflate_ != nullptr) {
+    inflateEnd(inflate_);
+    delete inflate_;
+  }
+}
+
+std::shared_ptr<TWebSocketCompression> TWebSocketDeflate::accept(const std::string& offers,
+                                                                 std::string& response) {
+  // The offers are in the order the client prefers them
+  size_t begin = 0;
+  while (begin <= offers.size()) {
+    size_t end = offers.find(',', begin);
+    if (end == std::string::npos) {
+      end = offers.size();
+    }
+    bool noContextTakeover = noContextTakeover_;
+    int windowBits = MAX_WBITS;
+    if (acceptOffer(offers.substr(begin, end - begin), response, noContextTakeover, windowBits)) {
+      std::shared_ptr<TWebSocketDeflate> session(
+          new TWebSocketDeflate(level_, minSize_, noContextTakeover));
+      session->windowBits_ = windowBits;
+      return session;
+    }
+    begin = end + 1;
+  }
+  return nullptr;
+}
+
+bool TWebSocketDeflate::acceptOffer(const std::string& offer,
+                                    std::string& response,
+                                    bool& noContextTakeover,
+                                    int& windowBits) {
+  size_t begin = offer.find(';');
+  if (trim(offer.substr(0, begin)) != "permessage-deflate") {
+    return false;
+  }
+
+  bool windowBitsOffered = false;
+  std::set<std::string> names;
+  while (begin != std::string::npos) {
+    size_t end = offer.find(';', begin + 1);
+    std::string parameter = offer.substr(begin + 1, end == std::string::npos ? end : end - begin - 1);
+    begin = end;
+
+    size_t equals = parameter.find('=');
+    std::string name = trim(parameter.substr(0, equals));
+    std::string value = equals == std::string::npos ? "" : trim(parameter.substr(equals + 1));
+    // Offers with a parameter twice are invalid
+    if (!names.insert(name).second) {
+      return false;
+    }
+
+    int bits;
+    if (name == "server_no_context_takeover" && equals == std::string::npos) {
+      noContextTakeover = true;
+    } else if (name == "client_no_context_takeover" && equals == std::string::npos) {
+      // The inflater works whether or not the client keeps its context
+    } else if (name == "server_max_window_bits" && parseWindowBits(value, MIN_WINDOW_BITS, bits)) {
+      windowBits = bits;
+      windowBitsOffered = true;
+    } else if (name == "client_max_window_bits"
+               && (equals == std::string::npos || parseWindowBits(value, 8, bits))) {
+      // The inflater takes the largest window, so the client may use any
+    } else {
+      return false;
+    }
+  }
+
+  response = "permessage-deflate";
+  if (noContextTakeover) {
+    response += "; server_no_context_takeover";
+  }
+  if (windowBitsOffered) {
+    response += "; server_max_window_bits=" + to_string(windowBits);
+  }
+  return true;
+}
+
+bool TWebSocketDeflate::compress(const uint8_t* data, uint32_t len, std::vector<uint8_t>& out) {
+  if (len < minSize_) {
+    return false;
+  }
+  if (deflate_ == nullptr) {
+    deflate_ = newStream();
+    // Negative window bits make a raw deflate stream, without the zlib header
+    int rv = deflateInit2(deflate_, level_, Z_DEFLATED, -windowBits_, 8, Z_DEFAULT_STRATEGY);
+    if (rv != Z_OK) {
+      delete deflate_;
+      deflate_ = nullptr;
+      throw TZlibTransportException(rv, nullptr);
+    }
+  }
+
+  size_t begin = out.size();
+  size_t size = begin;
+  // A sync flush takes a few bytes more than deflateBound() counts for the stream end
+  out.resize(begin + deflateBound(deflate_, len) + 16);
+  deflate_->next_in = const_cast<Bytef*>(data);
+  deflate_->avail_in = len;
+  for (;;) {
+    deflate_->next_out = out.data() + size;
+    deflate_->avail_out = static_cast<uInt>(out.size() - size);
+    int rv = ::deflate(deflate_, Z_SYNC_FLUSH);
+    if (rv != Z_OK && rv != Z_BUF_ERROR) {
+      throw TZlibTransportException(rv, deflate_->msg);
+    }
+    size = out.size() - deflate_->avail_out;
+    if (deflate_->avail_out != 0) {
+      break;
+    }
+    out.resize(out.size() * 2);
+  }
+
+  // The sync flush ends with the message tail, which is left out
+  out.resize(size - sizeof(MESSAGE_TAIL));
+  if (noContextTakeover_) {
+    deflateReset(deflate_);
+  }
+  return true;
+}
+
+bool TWebSocketDeflate::decompress(const uint8_t* data,
+                                   uint32_t len,
+                                   TMemoryBuffer& out,
+                                   uint32_t maxSize) {
+  if (inflate_ == nullptr) {
+    inflate_ = newStream();
+    int rv = inflateInit2(inflate_, -MAX_WBITS);
+    if (rv != Z_OK) {
+      delete inflate_;
+      inflate_ = nullptr;
+      throw TZlibTransportException(rv, nullptr);
+    }
+  }
+
+  uint32_t size = 0;
+  uint32_t chunkSize = (std::max)(len * 2, 4096u);
+  const uint8_t* input[2] = {data, MESSAGE_TAIL};
+  uint32_t inputSize[2] = {len, sizeof(MESSAGE_TAIL)};
+  for (int i = 0; i < 2; ++i) {
+    inflate_->next_in = const_cast<Bytef*>(input[i]);
+    inflate_->avail_in = inputSize[i];
+    do {
+      inflate_->next_out = out.getWritePtr(chunkSize);
+      inflate_->avail_out = chunkSize;
+      int rv = ::inflate(inflate_, Z_SYNC_FLUSH);
+      if (rv == Z_STREAM_END) {
+        // The client ended the stream with the message, the next one starts a new one
+        inflateReset(inflate_);
+      } else if (rv != Z_OK && rv != Z_BUF_ERROR) {
+        throw TZlibTransportException(rv, inflate_->msg);
+      }
+      uint32_t produced = chunkSize - inflate_->avail_out;
+      out.wroteBytes(produced);
+      size += produced;
+      if (size > maxSize) {
+        return false;
+      }
+    } while (inflate_->avail_in > 0 || inflate_->avail_out == 0);
+  }
+  return true;
+}
+}
+}
+} // apache::thrift::transport
@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TWEBSOCKETDEFLATE_H_
+#define _THRIFT_TRANSPORT_TWEBSOCKETDEFLATE_H_ 1
+
+#include <thrift/transport/TWebSocketServer.h>
+#include <zlib.h>
+
+struct z_stream_s;
+
+namespace apache {
+namespace thrift {
+namespace transport {
+
+/**
+ * The permessage-deflate WebSocket extension (RFC 7692).
+ *
+ *   auto deflate = std::make_shared<TWebSocketDeflate>();
+ *   auto transportFactory = std::make_shared<TBinaryWebSocketServerTransportFactory>(deflate);
+ *
+ * Connections keep the compression context from one message to the next,
+ * unless noContextTakeover is set or the client asks for it; that takes
+ * less memory per connection, but compresses less.
+ */
+class TWebSocketDeflate : public TWebSocketCompression {
+public:
+  static const uint32_t DEFAULT_MIN_SIZE = 256;
+
+  /**
+   * @param level            zlib compression level
+   * @param minSize          messages shorter than this are sent uncompressed
+   * @param noContextTakeover compress every message on its own
+   */
+  TWebSocketDeflate(int level = Z_DEFAULT_COMPRESSION,
+                    uint32_t minSize = DEFAULT_MIN_SIZE,
+                    bool noContextTakeover = false);
+
+  ~TWebSocketDeflate() override;
+
+  TWebSocketDeflate(const TWebSocketDeflate&) = delete;
+  TWebSocketDeflate& operator=(const TWebSocketDeflate&) = delete;
+
+  std::shared_ptr<TWebSocketCompression> accept(const std::string& offers,
+                                                std::string& response) override;
+
+  bool compress(const uint8_t* data, uint32_t len, std::vector<uint8_t>& out) override;
+
+  bool decompress(const uint8_t* data, uint32_t len, TMemoryBuffer& out, uint32_t maxSize) override;
+
+private:
+  bool acceptOffer(const std::string& offer, std::string& response, bool& noContextTakeover,
+                   int& windowBits);
+
+  const int level_;
+  const uint32_t minSize_;
+  bool noContextTakeover_;
+  // The window of the messages the server sends, the client may limit it
+  int windowBits_;
+
+  // Created with the first message in each direction
+  struct z_stream_s* deflate_;
+  struct z_stream_s* inflate_;
+};
+}
+}
+} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TWEBSOCKETDEFLATE_H_
@@ -21,8 +21,10 @@
 #define _THRIFT_TRANSPORT_TWEBSOCKETSERVER_H_ 1
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <openssl/sha.h>
 
@@ -38,9 +40,6 @@
 #define THRIFT_strncasecmp(str1, str2, len) strncasecmp(str1, str2, len)
 #define THRIFT_strcasestr(haystack, needle) strcasestr(haystack, needle)
 #endif
-#if defined(__CYGWIN__)
-#include <alloca.h>
-#endif
 
 using std::string;
 
@@ -50,6 +49,40 @@ namespace transport {
 
 std::string base64Encode(unsigned char* data, int length);
 
+/**
+ * A WebSocket extension that compresses the messages of a connection, such
+ * as permessage-deflate (TWebSocketDeflate, in libthriftz).
+ *
+ * The instance given to the server only answers the offers of the clients;
+ * every connection that accepts one compresses with an instance of its own.
+ */
+class TWebSocketCompression {
+public:
+  virtual ~TWebSocketCompression() = default;
+
+  /**
+   * Answers the value of the Sec-WebSocket-Extensions header of a handshake.
+   * Returns the compression of the connection and sets response to the
+   * value of the Sec-WebSocket-Extensions header of the answer, or returns
+   * nullptr if none of the offers is acceptable.
+   */
+  virtual std::shared_ptr<TWebSocketCompression> accept(const std::string& offers,
+                                                        std::string& response) = 0;
+
+  /**
+   * Appends the compressed payload of a message to out.  Returns false if
+   * the message should be sent as it is.
+   */
+  virtual bool compress(const uint8_t* data, uint32_t len, std::vector<uint8_t>& out) = 0;
+
+  /**
+   * Appends the payload of a compressed message to out.  Returns false if it
+   * is longer than maxSize.
+   */
+  virtual bool decompress(const uint8_t* data, uint32_t len, TMemoryBuffer& out, uint32_t maxSize)
+      = 0;
+};
+
 template <bool binary>
 class TWebSocketServer : public THttpServer {
 public:
@@ -60,52 +93,66 @@ public:
 
   ~TWebSocketServer() override = default;
 
-  uint32_t readAll_virt(uint8_t* buf, uint32_t len) override {
-    // If we do not have a good handshake, the client will attempt one.
-    if (!handshakeComplete()) {
-      resetHandshake();
-      THttpServer::read(buf, len);
-      // If we did not get everything we expected, the handshake failed
-      // and we need to send a 400 response back.
-      if (!handshakeComplete()) {
-        sendBadRequest();
-        return 0;
-      }
-      // Otherwise, send back the 101 response.
-      THttpServer::flush();
-    }
-
-    uint32_t want = len;
-    auto have = readBuffer_.available_read();
+  /**
+   * Compresses the messages of the clients that offer the extension.
+   */
+  void setCompression(std::shared_ptr<TWebSocketCompression> compression) {
+    compression_ = compression;
+  }
 
-    // If we have some data in the buffer, copy it out and return it.
-    // We have to return it without attempting to read more, since we aren't
-    // guaranteed that the underlying transport actually has more data, so
-    // attempting to read from it could block.
-    if (have > 0 && have >= want) {
-      return readBuffer_.read(buf, want);
-    }
+  uint32_t read(uint8_t* buf, uint32_t len) { return readFrames(buf, len, false); }
 
-    // Read another frame.
-    if (!readFrame()) {
-      // EOF.  No frame available.
-      return 0;
-    }
+  uint32_t readAll(uint8_t* buf, uint32_t len) { return readFrames(buf, len, true); }
 
-    // Hand over whatever we have.
-    uint32_t give = (std::min)(want, readBuffer_.available_read());
-    return readBuffer_.read(buf, give);
+  void write(const uint8_t* buf, uint32_t len) {
+    reserveFrameHeader();
+    writeBuffer_.write(buf, len);
   }
 
+  uint32_t read_virt(uint8_t* buf, uint32_t len) override { return read(buf, len); }
+
+  uint32_t readAll_virt(uint8_t* buf, uint32_t len) override { return readAll(buf, len); }
+
+  void write_virt(const uint8_t* buf, uint32_t len) override { write(buf, len); }
+
   void flush() override {
     resetConsumedMessageSize();
-    writeFrameHeader();
-    uint8_t* buffer;
+    reserveFrameHeader();
+    uint8_t* payload;
     uint32_t length;
-    writeBuffer_.getBuffer(&buffer, &length);
-    transport_->write(buffer, length);
+    writeBuffer_.getBuffer(&payload, &length);
+    bool reserved = frameHeaderReserved_;
+    if (reserved) {
+      payload += MAX_FRAME_HEADER_SIZE;
+      length -= MAX_FRAME_HEADER_SIZE;
+    }
+
+    bool compressed = false;
+    if (session_ && length > 0) {
+      compressed_.resize(MAX_FRAME_HEADER_SIZE);
+      if (session_->compress(payload, length, compressed_)) {
+        payload = compressed_.data() + MAX_FRAME_HEADER_SIZE;
+        length = static_cast<uint32_t>(compressed_.size()) - MAX_FRAME_HEADER_SIZE;
+        compressed = true;
+        reserved = true;
+      }
+    }
+
+    auto opcode = binary ? Opcode::Binary : Opcode::Text;
+    uint32_t headerSize = frameHeaderSize(length);
+    if (reserved) {
+      // The header goes right in front of the payload, so the frame is written at once
+      writeFrameHeader(payload - headerSize, opcode, length, compressed);
+      transport_->write(payload - headerSize, headerSize + length);
+    } else {
+      uint8_t header[MAX_FRAME_HEADER_SIZE];
+      writeFrameHeader(header, opcode, length, compressed);
+      transport_->write(header, headerSize);
+      transport_->write(payload, length);
+    }
     transport_->flush();
     writeBuffer_.resetBuffer();
+    frameHeaderReserved_ = false;
   }
 
 protected:
@@ -114,7 +161,11 @@ protected:
     std::ostringstream h;
     h << "HTTP/1.1 101 Switching Protocols" << CRLF << "Server: Thrift/" << PACKAGE_VERSION << CRLF
       << "Upgrade: websocket" << CRLF << "Connection: Upgrade" << CRLF
-      << "Sec-WebSocket-Accept: " << acceptKey_ << CRLF << CRLF;
+      << "Sec-WebSocket-Accept: " << acceptKey_ << CRLF;
+    if (session_) {
+      h << "Sec-WebSocket-Extensions: " << extensionResponse_ << CRLF;
+    }
+    h << CRLF;
     return h.str();
   }
 
@@ -145,6 +196,12 @@ protected:
       if (THRIFT_strcasestr(value, "13") != nullptr) {
         secWebSocketVersion_ = true;
       }
+    } else if (THRIFT_strncasecmp(header, "Sec-WebSocket-Extensions", sz) == 0) {
+      // The header may be repeated, which is the same as a list of its values
+      if (!extensions_.empty()) {
+        extensions_ += ',';
+      }
+      extensions_ += value;
     }
   }
 
@@ -198,10 +255,16 @@ private:
     Pong = 0xA
   };
 
+  // The header of an unmasked frame, with a 64-bit length
+  static const uint32_t MAX_FRAME_HEADER_SIZE = 10;
+  static const uint32_t MAX_CONTROL_PAYLOAD_SIZE = 125;
+
   void failConnection(CloseCode reason) {
-    writeFrameHeader(Opcode::Close);
-    auto buffer = htons(static_cast<uint16_t>(reason));
-    transport_->write(reinterpret_cast<const uint8_t*>(&buffer), 2);
+    uint8_t frame[4];
+    writeFrameHeader(frame, Opcode::Close, 2, false);
+    auto code = htons(static_cast<uint16_t>(reason));
+    memcpy(frame + 2, &code, 2);
+    transport_->write(frame, sizeof(frame));
     transport_->flush();
     transport_->close();
   }
@@ -210,115 +273,250 @@ private:
     return upgrade_ && connection_ && secWebSocketKey_ && secWebSocketVersion_;
   }
 
-  void pong() {
-    writeFrameHeader(Opcode::Pong);
-    uint8_t* buffer;
-    uint32_t size;
-    readBuffer_.getBuffer(&buffer, &size);
-    transport_->write(buffer, size);
+  void pong(const uint8_t* payload, uint32_t length) {
+    uint8_t frame[2 + MAX_CONTROL_PAYLOAD_SIZE];
+    writeFrameHeader(frame, Opcode::Pong, length, false);
+    memcpy(frame + 2, payload, length);
+    transport_->write(frame, 2 + length);
     transport_->flush();
   }
 
-  bool readFrame() {
-    uint8_t headerBuffer[8];
-
-    auto read = transport_->read(headerBuffer, 2);
-    if (read < 2) {
-      return false;
-    }
-    // Since Thrift has its own message end marker and we read frame by frame,
-    // it doesn't really matter if the frame is marked as FIN.
-    // Capture it only for debugging only.
-    auto fin = (headerBuffer[0] & 0x80) != 0;
-    THRIFT_UNUSED_VARIABLE(fin);
-
-    // RSV1, RSV2, RSV3
-    if ((headerBuffer[0] & 0x70) != 0) {
-      failConnection(CloseCode::ProtocolError);
-      throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                "Reserved bits must be zeroes");
+  /**
+   * Reads the payload of data frames into buf, until it is full if all is
+   * set, or until there is some data otherwise.  The payload of uncompressed
+   * messages is read from the transport straight into buf.
+   */
+  uint32_t readFrames(uint8_t* buf, uint32_t len, bool all) {
+    // If we do not have a good handshake, the client will attempt one.
+    if (!handshakeComplete()) {
+      resetHandshake();
+      THttpServer::read(buf, len);
+      // If we did not get everything we expected, the handshake failed
+      // and we need to send a 400 response back.
+      if (!handshakeComplete()) {
+        sendBadRequest();
+        return 0;
+      }
+      if (compression_ && !extensions_.empty()) {
+        session_ = compression_->accept(extensions_, extensionResponse_);
+      }
+      // Otherwise, send back the 101 response.
+      THttpServer::flush();
     }
 
-    auto opcode = (Opcode)(headerBuffer[0] & 0x0F);
-
-    // Mask
-    if ((headerBuffer[1] & 0x80) == 0) {
-      failConnection(CloseCode::ProtocolError);
-      throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                "Messages from the client must be masked");
+    uint32_t have = 0;
+    while (have < len) {
+      if (readBuffer_.available_read() > 0) {
+        // Control frames and decompressed messages
+        have += readBuffer_.read(buf + have, len - have);
+      } else if (frameRemaining_ > 0) {
+        uint32_t size = (std::min)(len - have, frameRemaining_);
+        if (!readFully(buf + have, size)) {
+          return have;
+        }
+        unmask(buf + have, size);
+        frameRemaining_ -= size;
+        have += size;
+      } else if ((have > 0 && !all) || !readFrame()) {
+        // We can't tell whether the next frame has arrived yet, so a partial
+        // read hands over what it has rather than risk blocking.
+        break;
+      }
     }
+    return have;
+  }
 
-    // Read the length
-    uint64_t payloadLength = headerBuffer[1] & 0x7F;
-    if (payloadLength == 126) {
-      read = transport_->read(headerBuffer, 2);
-      if (read < 2) {
+  // Reads len bytes from the transport, unless the connection ends first
+  bool readFully(uint8_t* buf, uint32_t len) {
+    uint32_t have = 0;
+    while (have < len) {
+      uint32_t got = transport_->read(buf + have, len - have);
+      if (got == 0) {
         return false;
       }
-      payloadLength = ntohs(*reinterpret_cast<uint16_t*>(headerBuffer));
-    } else if (payloadLength == 127) {
-      read = transport_->read(headerBuffer, 8);
-      if (read < 8) {
+      have += got;
+    }
+    return true;
+  }
+
+  /**
+   * Reads frame headers until one starts a payload to hand over.  The payload
+   * of an uncompressed data frame is left in the transport, frameRemaining_
+   * bytes of it; a compressed message is read whole and decompressed into
+   * readBuffer_.
+   */
+  bool readFrame() {
+    for (;;) {
+      uint8_t headerBuffer[8];
+      if (!readFully(headerBuffer, 2)) {
         return false;
       }
-      payloadLength = THRIFT_ntohll(*reinterpret_cast<uint64_t*>(headerBuffer));
-      if ((payloadLength & 0x8000000000000000) != 0) {
+      // Since Thrift has its own message end marker, the end of uncompressed
+      // messages doesn't matter, only compressed ones are read up to it.
+      auto fin = (headerBuffer[0] & 0x80) != 0;
+      auto compressed = (headerBuffer[0] & 0x40) != 0;
+      auto opcode = (Opcode)(headerBuffer[0] & 0x0F);
+
+      // RSV1 marks the first frame of a compressed message, RSV2 and RSV3 are unused
+      if ((headerBuffer[0] & 0x30) != 0
+          || (compressed && (!session_ || (opcode != Opcode::Text && opcode != Opcode::Binary)))) {
         failConnection(CloseCode::ProtocolError);
-        throw TTransportException(
-            TTransportException::CORRUPTED_DATA,
-            "The most significant bit of the payload length must be zero");
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Reserved bits must be zeroes");
       }
-    }
 
-    // size_t is smaller than a ulong on a 32-bit system
-    if (payloadLength > UINT32_MAX) {
-      failConnection(CloseCode::MessageTooBig);
-      return false;
-    }
+      // Mask
+      if ((headerBuffer[1] & 0x80) == 0) {
+        failConnection(CloseCode::ProtocolError);
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Messages from the client must be masked");
+      }
 
-    auto length = static_cast<uint32_t>(payloadLength);
+      // Read the length
+      uint64_t payloadLength = headerBuffer[1] & 0x7F;
+      if (payloadLength == 126) {
+        if (!readFully(headerBuffer, 2)) {
+          return false;
+        }
+        uint16_t length16;
+        memcpy(&length16, headerBuffer, 2);
+        payloadLength = ntohs(length16);
+      } else if (payloadLength == 127) {
+        if (!readFully(headerBuffer, 8)) {
+          return false;
+        }
+        memcpy(&payloadLength, headerBuffer, 8);
+        payloadLength = THRIFT_ntohll(payloadLength);
+        if ((payloadLength & 0x8000000000000000) != 0) {
+          failConnection(CloseCode::ProtocolError);
+          throw TTransportException(
+              TTransportException::CORRUPTED_DATA,
+              "The most significant bit of the payload length must be zero");
+        }
+      }
 
-    if (length > 0) {
-      // Read the masking key
-      read = transport_->read(headerBuffer, 4);
-      if (read < 4) {
+      // size_t is smaller than a ulong on a 32-bit system
+      if (payloadLength > UINT32_MAX) {
+        failConnection(CloseCode::MessageTooBig);
         return false;
       }
 
-      readBuffer_.resetBuffer(length);
-      uint8_t* buffer = readBuffer_.getWritePtr(length);
-      read = transport_->read(buffer, length);
-      readBuffer_.wroteBytes(read);
-      if (read < length) {
+      auto length = static_cast<uint32_t>(payloadLength);
+
+      // Read the masking key, which is there even if the payload is empty
+      if (!readFully(mask_, 4)) {
         return false;
       }
-      
-      // Unmask the data
-      for (size_t i = 0; i < length; i++) {
-        buffer[i] ^= headerBuffer[i % 4];
+      maskOffset_ = 0;
+
+      T_DEBUG("FIN=%d, Opcode=%X, length=%d", fin, opcode, length);
+
+      switch (opcode) {
+      case Opcode::Close:
+      case Opcode::Ping:
+      case Opcode::Pong: {
+        if (length > MAX_CONTROL_PAYLOAD_SIZE) {
+          failConnection(CloseCode::ProtocolError);
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Control frames must not be longer than 125 bytes");
+        }
+        uint8_t payload[MAX_CONTROL_PAYLOAD_SIZE];
+        if (!readFully(payload, length)) {
+          return false;
+        }
+        unmask(payload, length);
+        if (opcode == Opcode::Close) {
+          if (length >= 2) {
+            uint16_t code;
+            memcpy(&code, payload, 2);
+            CloseCode closeCode = static_cast<CloseCode>(ntohs(code));
+            THRIFT_UNUSED_VARIABLE(closeCode);
+            string closeReason(reinterpret_cast<char*>(payload) + 2, length - 2);
+            T_DEBUG("Connection closed: %d %s", closeCode, closeReason.c_str());
+          }
+          transport_->close();
+          return false;
+        }
+        if (opcode == Opcode::Ping) {
+          pong(payload, length);
+        }
+        break;
+      }
+      default:
+        if (opcode != Opcode::Continuation) {
+          messageCompressed_ = compressed;
+          compressed_.clear();
+        }
+        if (!messageCompressed_) {
+          frameRemaining_ = length;
+          return true;
+        }
+        if (!readCompressed(length, fin)) {
+          return false;
+        }
+        if (fin) {
+          return true;
+        }
       }
-
-      T_DEBUG("FIN=%d, Opcode=%X, length=%d, payload=%s", fin, opcode, length,
-              binary ? readBuffer_.toHexString() : cast(string) readBuffer_);
     }
+  }
 
-    switch (opcode) {
-    case Opcode::Close:
-      if (length >= 2) {
-        uint8_t buffer[2];
-        readBuffer_.read(buffer, 2);
-        CloseCode closeCode = static_cast<CloseCode>(ntohs(*reinterpret_cast<uint16_t*>(buffer)));
-        THRIFT_UNUSED_VARIABLE(closeCode);
-        string closeReason = readBuffer_.readAsString(length - 2);
-        T_DEBUG("Connection closed: %d %s", closeCode, closeReason);
-      }
-      transport_->close();
+  // Adds a frame of a compressed message to compressed_, and decompresses the
+  // message into readBuffer_ once it is complete.
+  bool readCompressed(uint32_t length, bool fin) {
+    auto maxSize = static_cast<uint32_t>(getConfiguration()->getMaxMessageSize());
+    size_t offset = compressed_.size();
+    if (length > maxSize - offset) {
+      failConnection(CloseCode::MessageTooBig);
+      throw TTransportException(TTransportException::CORRUPTED_DATA, "MaxMessageSize reached");
+    }
+    compressed_.resize(offset + length);
+    if (!readFully(compressed_.data() + offset, length)) {
       return false;
-    case Opcode::Ping:
-      pong();
-      return readFrame();
-    default:
-      return true;
+    }
+    unmask(compressed_.data() + offset, length);
+    if (fin) {
+      readBuffer_.resetBuffer();
+      if (!session_->decompress(compressed_.data(), static_cast<uint32_t>(compressed_.size()),
+                                readBuffer_, maxSize)) {
+        failConnection(CloseCode::MessageTooBig);
+        throw TTransportException(TTransportException::CORRUPTED_DATA, "MaxMessageSize reached");
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Unmasks data that continues the payload of the current frame.  The mask
+   * repeats every 4 bytes, so it is applied a word at a time, which the
+   * compiler turns into vector instructions where it can.
+   */
+  void unmask(uint8_t* data, uint32_t len) {
+    uint8_t key[8];
+    for (uint32_t i = 0; i < 8; ++i) {
+      key[i] = mask_[(maskOffset_ + i) & 3];
+    }
+    uint64_t word;
+    memcpy(&word, key, 8);
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+      uint64_t chunk;
+      memcpy(&chunk, data + i, 8);
+      chunk ^= word;
+      memcpy(data + i, &chunk, 8);
+    }
+    for (; i < len; ++i) {
+      data[i] ^= key[i & 7];
+    }
+    maskOffset_ = (maskOffset_ + len) & 3;
+  }
+
+  // Leaves room for the frame header in front of the payload of a message
+  void reserveFrameHeader() {
+    if (writeBuffer_.available_read() == 0) {
+      writeBuffer_.getWritePtr(MAX_FRAME_HEADER_SIZE);
+      writeBuffer_.wroteBytes(MAX_FRAME_HEADER_SIZE);
+      frameHeaderReserved_ = true;
     }
   }
 
@@ -327,6 +525,12 @@ private:
     secWebSocketKey_ = false;
     secWebSocketVersion_ = false;
     upgrade_ = false;
+    extensions_.clear();
+    extensionResponse_.clear();
+    session_.reset();
+    frameRemaining_ = 0;
+    messageCompressed_ = false;
+    frameHeaderReserved_ = false;
   }
 
   void sendBadRequest() {
@@ -338,34 +542,24 @@ private:
     transport_->close();
   }
 
-  void writeFrameHeader(Opcode opcode = Opcode::Continuation) {
-    uint32_t headerSize = 1;
-    uint32_t length = writeBuffer_.available_read();
-    if (length < 126) {
-      ++headerSize;
-    } else if (length < 65536) {
-      headerSize += 3;
-    } else {
-      headerSize += 9;
-    }
-    // The server does not mask the response
+  static uint32_t frameHeaderSize(uint32_t length) {
+    return length < 126 ? 2 : length < 65536 ? 4 : 10;
+  }
 
-    uint8_t* header = static_cast<uint8_t*>(alloca(headerSize));
-    if (opcode == Opcode::Continuation) {
-      opcode = binary ? Opcode::Binary : Opcode::Text;
-    }
-    header[0] = static_cast<uint8_t>(opcode) | 0x80;
+  static void writeFrameHeader(uint8_t* header, Opcode opcode, uint32_t length, bool compressed) {
+    // The server does not mask the response
+    header[0] = static_cast<uint8_t>(opcode) | 0x80 | (compressed ? 0x40 : 0);
     if (length < 126) {
       header[1] = static_cast<uint8_t>(length);
     } else if (length < 65536) {
       header[1] = 126;
-      *reinterpret_cast<uint16_t*>(header + 2) = htons(length);
+      auto length16 = htons(static_cast<uint16_t>(length));
+      memcpy(header + 2, &length16, 2);
     } else {
       header[1] = 127;
-      *reinterpret_cast<uint64_t*>(header + 2) = THRIFT_htonll(length);
+      auto length64 = THRIFT_htonll(static_cast<uint64_t>(length));
+      memcpy(header + 2, &length64, 8);
     }
-
-    transport_->write(header, headerSize);
   }
 
   // Add constant here to avoid a linker error on Windows
@@ -375,6 +569,19 @@ private:
   bool secWebSocketKey_;
   bool secWebSocketVersion_;
   bool upgrade_;
+  std::string extensions_;
+  std::string extensionResponse_;
+  std::shared_ptr<TWebSocketCompression> compression_;
+  std::shared_ptr<TWebSocketCompression> session_;
+  // The part of the current data frame's payload that is still to be read
+  uint32_t frameRemaining_;
+  uint8_t mask_[4];
+  uint32_t maskOffset_;
+  bool messageCompressed_;
+  // Whether writeBuffer_ starts with room for the frame header
+  bool frameHeaderReserved_;
+  // The compressed payload of the message being read or written
+  std::vector<uint8_t> compressed_;
 };
 
 /**
@@ -384,14 +591,25 @@ class TBinaryWebSocketServerTransportFactory : public TTransportFactory {
 public:
   TBinaryWebSocketServerTransportFactory() = default;
 
+  /**
+   * Compresses the messages of the clients that offer the extension.
+   */
+  explicit TBinaryWebSocketServerTransportFactory(std::shared_ptr<TWebSocketCompression> compression)
+    : compression_(compression) {}
+
   ~TBinaryWebSocketServerTransportFactory() override = default;
 
   /**
    * Wraps the transport into a buffered one.
    */
   std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override {
-    return std::shared_ptr<TTransport>(new TWebSocketServer<true>(trans));
+    auto transport = new TWebSocketServer<true>(trans);
+    transport->setCompression(compression_);
+    return std::shared_ptr<TTransport>(transport);
   }
+
+private:
+  std::shared_ptr<TWebSocketCompression> compression_;
 };
 
 /**
@@ -401,14 +619,25 @@ class TTextWebSocketServerTransportFactory : public TTransportFactory {
 public:
   TTextWebSocketServerTransportFactory() = default;
 
+  /**
+   * Compresses the messages of the clients that offer the extension.
+   */
+  explicit TTextWebSocketServerTransportFactory(std::shared_ptr<TWebSocketCompression> compression)
+    : compression_(compression) {}
+
   ~TTextWebSocketServerTransportFactory() override = default;
 
   /**
    * Wraps the transport into a buffered one.
    */
   std::shared_ptr<TTransport> getTransport(std::shared_ptr<TTransport> trans) override {
-    return std::shared_ptr<TTransport>(new TWebSocketServer<false>(trans));
+    auto transport = new TWebSocketServer<false>(trans);
+    transport->setCompression(compression_);
+    return std::shared_ptr<TTransport>(transport);
   }
+
+private:
+  std::shared_ptr<TWebSocketCompression> compression_;
 };
 } // namespace transport
 } // namespace thrift
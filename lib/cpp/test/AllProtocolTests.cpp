@@ -45,3 +45,16 @@ BOOST_AUTO_TEST_CASE(test_little_binary_protocol) {
 BOOST_AUTO_TEST_CASE(test_compact_protocol) {
   testProtocol<TCompactProtocol>("TCompactProtocol");
 }
+
+BOOST_AUTO_TEST_CASE(test_skip_invalid_data) {
+  const uint8_t negativeSize[] = {0xff, 0xff, 0xff, 0xff};
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(const_cast<uint8_t*>(negativeSize),
+                                                     sizeof(negativeSize)));
+  TBinaryProtocol binary(buffer);
+  BOOST_CHECK_THROW(binary.skip(T_STRING), TProtocolException);
+
+  const uint8_t longVarint[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+  buffer.reset(new TMemoryBuffer(const_cast<uint8_t*>(longVarint), sizeof(longVarint)));
+  TCompactProtocol compact(buffer);
+  BOOST_CHECK_THROW(compact.skip(T_I64), TProtocolException);
+}
@@ -21,6 +21,7 @@
 #define _THRIFT_TEST_GENERICPROTOCOLTEST_TCC_ 1
 
 #include <limits>
+#include <vector>
 
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TBufferTransports.h>
@@ -94,6 +95,214 @@ void testField(const Val val) {
   protocol->readStructEnd();
 }
 
+/*
+ * Writes values with the array function and reads them back through a
+ * buffered transport of bufferSize bytes, so that values are split across
+ * buffer refills.  The array functions have to produce the same encoding as
+ * writing the values one by one.
+ */
+template <typename TProto, typename Val>
+void testArray(const std::vector<Val>& vals, uint32_t bufferSize) {
+  shared_ptr<TMemoryBuffer> single(new TMemoryBuffer());
+  shared_ptr<TProtocol> singleProtocol(new TProto(single));
+  uint32_t singleSize = 0;
+  for (size_t i = 0; i < vals.size(); ++i) {
+    singleSize += GenericIO::write(singleProtocol, vals[i]);
+  }
+
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TProtocol> writer(new TProto(buffer));
+  uint32_t count = static_cast<uint32_t>(vals.size());
+  uint32_t size = GenericIO::writeArray(writer, vals.data(), count);
+  if (size != singleSize || buffer->getBufferAsString() != single->getBufferAsString()) {
+    THRIFT_SNPRINTF(errorMessage,
+                    ERR_LEN,
+                    "Invalid array encoding (type: %s)",
+                    ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+
+  shared_ptr<TTransport> transport(new TBufferedTransport(buffer, bufferSize));
+  shared_ptr<TProtocol> reader(new TProto(transport));
+  std::vector<Val> out(vals.size() + 1);
+  if (GenericIO::readArray(reader, out.data(), count) != size || out[count] != Val()) {
+    THRIFT_SNPRINTF(errorMessage,
+                    ERR_LEN,
+                    "Invalid array size (type: %s)",
+                    ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+  out.pop_back();
+  if (out != vals) {
+    THRIFT_SNPRINTF(errorMessage,
+                    ERR_LEN,
+                    "Invalid array test (type: %s)",
+                    ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+}
+
+template <typename TProto>
+void testArrays() {
+  std::vector<int32_t> i32s;
+  std::vector<int64_t> i64s;
+  std::vector<double> doubles;
+  for (int32_t i = 0; i < 1000; i++) {
+    // runs of small values, then values of every varint length
+    int32_t small = (i / 20) % 2 == 0 ? i % 50 - 25 : 0;
+    int32_t shift = i % 31;
+    i32s.push_back(small != 0 ? small : (i % 2 == 0 ? 1 : -1) * (1 << shift));
+    i64s.push_back(small != 0 ? small : (i % 2 == 0 ? 1LL : -1LL) << (i % 63));
+    doubles.push_back(i * 1.5 - 300.25);
+  }
+  i32s.push_back((std::numeric_limits<int32_t>::min)());
+  i32s.push_back((std::numeric_limits<int32_t>::max)());
+  i64s.push_back((std::numeric_limits<int64_t>::min)());
+  i64s.push_back((std::numeric_limits<int64_t>::max)());
+
+  const uint32_t bufferSizes[] = {7, 64, 1 << 16};
+  for (size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); i++) {
+    testArray<TProto, int32_t>(i32s, bufferSizes[i]);
+    testArray<TProto, int64_t>(i64s, bufferSizes[i]);
+    testArray<TProto, double>(doubles, bufferSizes[i]);
+    testArray<TProto, int32_t>(std::vector<int32_t>(), bufferSizes[i]);
+  }
+}
+
+/*
+ * Writes a struct with fields of every type, containers of fixed and
+ * variable width elements and nested structs.
+ */
+inline void writeSkipStruct(TProtocol& protocol, int depth) {
+  protocol.writeStructBegin("SkipStruct");
+  protocol.writeFieldBegin("bool", T_BOOL, 1);
+  protocol.writeBool(true);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("byte", T_BYTE, 2);
+  protocol.writeByte(-3);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("i16", T_I16, 3);
+  protocol.writeI16(-300);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("i64", T_I64, 40);
+  protocol.writeI64(1LL << 50);
+  protocol.writeFieldEnd();
+  protocol.writeFieldBegin("double", T_DOUBLE, 5);
+  protocol.writeDouble(2.5);
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("binaries", T_LIST, 6);
+  protocol.writeListBegin(T_STRING, 20);
+  for (int i = 0; i < 20; i++) {
+    protocol.writeBinary(std::string(i * 37, 'b'));
+  }
+  protocol.writeListEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("i32s", T_LIST, 7);
+  protocol.writeListBegin(T_I32, 300);
+  for (int32_t i = 0; i < 300; i++) {
+    protocol.writeI32(i % 3 == 0 ? i : i * 100000);
+  }
+  protocol.writeListEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("bools", T_SET, 8);
+  protocol.writeSetBegin(T_BOOL, 2);
+  protocol.writeBool(false);
+  protocol.writeBool(true);
+  protocol.writeSetEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("doubles", T_MAP, 9);
+  protocol.writeMapBegin(T_BYTE, T_DOUBLE, 10);
+  for (int8_t i = 0; i < 10; i++) {
+    protocol.writeByte(i);
+    protocol.writeDouble(i / 4.0);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("i64s", T_MAP, 10);
+  protocol.writeMapBegin(T_I16, T_I64, 10);
+  for (int16_t i = 0; i < 10; i++) {
+    protocol.writeI16(i * 1000);
+    protocol.writeI64(-i);
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("lists", T_MAP, 11);
+  protocol.writeMapBegin(T_STRING, T_LIST, 3);
+  for (int i = 0; i < 3; i++) {
+    protocol.writeString(std::string(i, 'k'));
+    protocol.writeListBegin(T_I64, i);
+    for (int j = 0; j < i; j++) {
+      protocol.writeI64(j);
+    }
+    protocol.writeListEnd();
+  }
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  protocol.writeFieldBegin("empty", T_MAP, 12);
+  protocol.writeMapBegin(T_STRING, T_STRUCT, 0);
+  protocol.writeMapEnd();
+  protocol.writeFieldEnd();
+
+  if (depth > 0) {
+    protocol.writeFieldBegin("nested", T_STRUCT, 13);
+    writeSkipStruct(protocol, depth - 1);
+    protocol.writeFieldEnd();
+    protocol.writeFieldBegin("structs", T_LIST, 14);
+    protocol.writeListBegin(T_STRUCT, 2);
+    writeSkipStruct(protocol, depth - 1);
+    writeSkipStruct(protocol, depth - 1);
+    protocol.writeListEnd();
+    protocol.writeFieldEnd();
+  }
+  protocol.writeFieldBegin("last", T_BOOL, 15);
+  protocol.writeBool(false);
+  protocol.writeFieldEnd();
+  protocol.writeFieldStop();
+  protocol.writeStructEnd();
+}
+
+/*
+ * The protocol's own skip() has to consume as many bytes as the generic
+ * skip(), which reads every value, also when values are split across
+ * buffer refills.
+ */
+template <typename TProto>
+void testSkip() {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TProto writer(buffer);
+  writeSkipStruct(writer, 3);
+  writer.writeI32(12345);
+  std::string data = buffer->getBufferAsString();
+
+  const uint32_t bufferSizes[] = {7, 64, 1 << 16};
+  for (size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); i++) {
+    uint32_t sizes[2];
+    for (int generic = 0; generic < 2; generic++) {
+      shared_ptr<TMemoryBuffer> input(new TMemoryBuffer(reinterpret_cast<uint8_t*>(&data[0]),
+                                                        static_cast<uint32_t>(data.size())));
+      shared_ptr<TTransport> transport(new TBufferedTransport(input, bufferSizes[i]));
+      shared_ptr<TProtocol> reader(new TProto(transport));
+      sizes[generic] = generic ? apache::thrift::protocol::skip(*reader, T_STRUCT)
+                               : reader->skip(T_STRUCT);
+      int32_t sentinel;
+      reader->readI32(sentinel);
+      if (sentinel != 12345) {
+        throw TException("skip stopped at the wrong place");
+      }
+    }
+    if (sizes[0] != sizes[1]) {
+      throw TException("skip returned the wrong size");
+    }
+  }
+}
+
 template <typename TProto>
 void testMessage() {
   struct TMessage {
@@ -213,6 +422,10 @@ void testProtocol(const char* protoname) {
     testField<TProto, T_STRING, std::string>("borderlinetiny");
     testField<TProto, T_STRING, std::string>("a bit longer than the smallest possible");
 
+    testArrays<TProto>();
+
+    testSkip<TProto>();
+
     testMessage<TProto>();
 
     printf("%s => OK\n", protoname);
@@ -0,0 +1,251 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE ArenaTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/TArena.h>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <type_traits>
+
+#include "gen-cpp/ArenaService.h"
+#include "gen-cpp/ArenaTest_types.h"
+
+using apache::thrift::TArena;
+using apache::thrift::TArenaAllocator;
+using apache::thrift::TArenaString;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using std::make_shared;
+using std::shared_ptr;
+using namespace thrift::test::arena;
+
+namespace {
+
+Leaf makeLeaf(const char* name) {
+  Leaf leaf;
+  leaf.__set_name(name);
+  leaf.__set_data(TArenaString(1000, 'x'));
+  for (int32_t i = 0; i < 100; ++i) {
+    leaf.values.push_back(i);
+  }
+  return leaf;
+}
+
+Node makeNode() {
+  Node node;
+  for (int i = 0; i < 10; ++i) {
+    node.children.resize(node.children.size() + 1);
+    node.children.back()["first"] = makeLeaf("first");
+    node.children.back()["second"] = makeLeaf("second");
+  }
+  node.tags.insert("a");
+  node.tags.insert("b");
+  node.__set_leaf(makeLeaf("leaf"));
+  node.flags.push_back(true);
+  node.flags.push_back(false);
+  return node;
+}
+
+template <typename T>
+TArena* arenaOf(const T& value) {
+  return value.get_allocator().getArena();
+}
+
+template <class Protocol_>
+void checkRoundTrip() {
+  Node node = makeNode();
+  auto buffer = make_shared<TMemoryBuffer>();
+  Protocol_ prot(buffer);
+  node.write(&prot);
+
+  TArena arena;
+  Node read;
+  read.read(&prot, arena);
+  BOOST_CHECK(read == node);
+  BOOST_CHECK(TArena::current() == nullptr);
+
+  // every string and container, however deeply nested, lives in the arena
+  BOOST_CHECK_EQUAL(arenaOf(read.children), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(read.children[3]), &arena);
+  const Leaf& leaf = read.children[3]["second"];
+  BOOST_CHECK_EQUAL(arenaOf(leaf.name), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(leaf.data), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(leaf.values), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(read.tags), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(*read.tags.begin()), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(read.leaf.name), &arena);
+  BOOST_CHECK_EQUAL(arenaOf(read.flags), &arena);
+  BOOST_CHECK_GT(arena.getBytesAllocated(), 21u * 1000u);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ArenaTest)
+
+BOOST_AUTO_TEST_CASE(generated_types) {
+  Leaf leaf;
+  BOOST_CHECK((std::is_same<decltype(leaf.name), TArenaString>::value));
+  BOOST_CHECK((std::is_same<decltype(leaf.values), apache::thrift::TArenaVector<int32_t> >::value));
+  BOOST_CHECK(arenaOf(leaf.name) == nullptr);
+  BOOST_CHECK_EQUAL(leaf.comment, "none");
+}
+
+BOOST_AUTO_TEST_CASE(arena_allocate) {
+  TArena arena(64);
+  BOOST_CHECK_EQUAL(arena.getBytesAllocated(), 0u);
+
+  void* a = arena.allocate(1, 1);
+  void* b = arena.allocate(8, 8);
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(b) % 8, 0u);
+  BOOST_CHECK(b > a);
+
+  // larger than a block
+  auto* large = static_cast<char*>(arena.allocate(10000));
+  std::fill(large, large + 10000, 'x');
+  void* aligned = arena.allocate(16, 64);
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(aligned) % 64, 0u);
+  BOOST_CHECK_EQUAL(arena.getBytesAllocated(), 1u + 8u + 10000u + 16u);
+
+  arena.reset();
+  BOOST_CHECK_EQUAL(arena.getBytesAllocated(), 0u);
+  BOOST_CHECK(arena.allocate(100) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(scope) {
+  TArena outer;
+  TArena inner;
+  BOOST_CHECK(TArena::current() == nullptr);
+  {
+    TArena::Scope outerScope(outer);
+    BOOST_CHECK_EQUAL(TArenaAllocator<int>().getArena(), &outer);
+    {
+      TArena::Scope innerScope(inner);
+      TArenaString str("a string that does not fit into the small string buffer");
+      BOOST_CHECK_EQUAL(arenaOf(str), &inner);
+    }
+    BOOST_CHECK_EQUAL(TArena::current(), &outer);
+  }
+  BOOST_CHECK(TArena::current() == nullptr);
+  BOOST_CHECK_EQUAL(inner.getBytesAllocated() > 0, true);
+  BOOST_CHECK_EQUAL(outer.getBytesAllocated(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(binary_round_trip) {
+  checkRoundTrip<TBinaryProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(compact_round_trip) {
+  checkRoundTrip<TCompactProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(json_round_trip) {
+  checkRoundTrip<TJSONProtocol>();
+}
+
+BOOST_AUTO_TEST_CASE(read_without_arena) {
+  Node node = makeNode();
+  auto buffer = make_shared<TMemoryBuffer>();
+  TBinaryProtocol prot(buffer);
+  node.write(&prot);
+
+  Node read;
+  read.read(&prot);
+  BOOST_CHECK(read == node);
+  BOOST_CHECK(arenaOf(read.leaf.name) == nullptr);
+  BOOST_CHECK(arenaOf(read.children[0]["first"].values) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(absent_fields_keep_their_values) {
+  Leaf leaf = makeLeaf("leaf");
+  leaf.__isset.comment = false;
+  auto buffer = make_shared<TMemoryBuffer>();
+  TBinaryProtocol prot(buffer);
+  leaf.write(&prot);
+
+  TArena arena;
+  Leaf read;
+  read.read(&prot, arena);
+  BOOST_CHECK_EQUAL(read.comment, "none");
+  BOOST_CHECK_EQUAL(arenaOf(read.comment), &arena);
+}
+
+BOOST_AUTO_TEST_CASE(copies_leave_the_arena) {
+  Node node = makeNode();
+  auto buffer = make_shared<TMemoryBuffer>();
+  TBinaryProtocol prot(buffer);
+  node.write(&prot);
+
+  Node copy;
+  {
+    TArena arena;
+    Node read;
+    read.read(&prot, arena);
+    copy = read;
+    Node constructed(read);
+    BOOST_CHECK(arenaOf(constructed.leaf.name) == nullptr);
+    BOOST_CHECK(arenaOf(constructed.children[0]["first"].data) == nullptr);
+  }
+  BOOST_CHECK(copy == node);
+  BOOST_CHECK(arenaOf(copy.leaf.name) == nullptr);
+  BOOST_CHECK(apache::thrift::to_string(copy).find("leaf") != std::string::npos);
+}
+
+class Handler : public ArenaServiceIf {
+public:
+  Handler() : argsInArena(false) {}
+
+  void echo(Node& _return, const Node& node, const TArenaString& suffix) override {
+    argsInArena = arenaOf(node.leaf.name) != nullptr && arenaOf(suffix) != nullptr;
+    _return = node;
+    _return.leaf.name += suffix;
+  }
+
+  bool argsInArena;
+};
+
+BOOST_AUTO_TEST_CASE(processor_reads_arguments_into_arena) {
+  auto handler = make_shared<Handler>();
+  ArenaServiceProcessor processor(handler);
+
+  auto requests = make_shared<TMemoryBuffer>();
+  auto responses = make_shared<TMemoryBuffer>();
+  auto requestProt = make_shared<TBinaryProtocol>(requests);
+  auto responseProt = make_shared<TBinaryProtocol>(responses);
+  ArenaServiceClient client(responseProt, requestProt);
+
+  Node node = makeNode();
+  client.send_echo(node, "-suffix");
+  BOOST_REQUIRE(processor.process(requestProt, responseProt, nullptr));
+  Node result;
+  client.recv_echo(result);
+
+  BOOST_CHECK(handler->argsInArena);
+  BOOST_CHECK_EQUAL(result.leaf.name, "leaf-suffix");
+  BOOST_CHECK(result.children == node.children);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
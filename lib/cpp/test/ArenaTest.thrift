@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Compiled with --gen cpp:arena
+
+namespace cpp thrift.test.arena
+
+struct Leaf {
+  1: string name
+  2: binary data
+  3: list<i32> values
+  4: optional string comment = "none"
+}
+
+struct Node {
+  1: list<map<string, Leaf>> children
+  2: set<string> tags
+  3: Leaf leaf
+  4: list<bool> flags
+}
+
+service ArenaService {
+  Node echo(1: Node node, 2: string suffix)
+}
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE ConcurrentClientSyncInfoTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/TApplicationException.h>
+#include <thrift/async/TConcurrentClientSyncInfo.h>
+#include <thrift/transport/TTransportException.h>
+
+#include <limits>
+#include <set>
+#include <thread>
+#include <vector>
+
+using apache::thrift::TApplicationException;
+using apache::thrift::async::TConcurrentClientSyncInfo;
+using apache::thrift::async::TConcurrentRecvSentry;
+using apache::thrift::async::TConcurrentSendSentry;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::T_REPLY;
+using apache::thrift::transport::TTransportException;
+
+namespace {
+
+// Completes the call the way generated code does once its reply was read
+void finishCall(TConcurrentClientSyncInfo& sync, int32_t seqid) {
+  TConcurrentRecvSentry sentry(&sync, seqid);
+  sentry.commit();
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ConcurrentClientSyncInfoTest)
+
+BOOST_AUTO_TEST_CASE(seqids_roll_over) {
+  TConcurrentClientSyncInfo sync(4);
+  std::vector<int32_t> seqids;
+  for (int i = 0; i < 20; ++i) {
+    int32_t seqid = sync.generateSeqId();
+    seqids.push_back(seqid);
+    finishCall(sync, seqid);
+  }
+  BOOST_CHECK_EQUAL(seqids.front(), (std::numeric_limits<int32_t>::max)() - 10);
+  BOOST_CHECK_EQUAL(seqids[10], (std::numeric_limits<int32_t>::max)());
+  BOOST_CHECK_EQUAL(seqids[11], (std::numeric_limits<int32_t>::min)());
+}
+
+BOOST_AUTO_TEST_CASE(outstanding_calls_are_bounded) {
+  TConcurrentClientSyncInfo sync(3);
+  std::set<int32_t> seqids;
+  for (int i = 0; i < 4; ++i) {
+    seqids.insert(sync.generateSeqId());
+  }
+  BOOST_CHECK_EQUAL(seqids.size(), 4u);
+  BOOST_CHECK_THROW(sync.generateSeqId(), TApplicationException);
+
+  // a finished call frees its slot again
+  finishCall(sync, *seqids.begin());
+  int32_t seqid = sync.generateSeqId();
+  BOOST_CHECK(seqids.find(seqid) == seqids.end());
+}
+
+BOOST_AUTO_TEST_CASE(busy_slots_are_skipped) {
+  TConcurrentClientSyncInfo sync(2);
+  int32_t longRunning = sync.generateSeqId();
+  for (int i = 0; i < 10; ++i) {
+    int32_t seqid = sync.generateSeqId();
+    BOOST_CHECK_NE(seqid, longRunning);
+    finishCall(sync, seqid);
+  }
+  finishCall(sync, longRunning);
+}
+
+BOOST_AUTO_TEST_CASE(reply_for_unknown_seqid) {
+  TConcurrentClientSyncInfo sync;
+  int32_t seqid = sync.generateSeqId();
+  TConcurrentRecvSentry sentry(&sync, seqid);
+  BOOST_CHECK_THROW(sync.updatePending("method", T_REPLY, seqid + 1), TApplicationException);
+}
+
+BOOST_AUTO_TEST_CASE(reply_is_handed_to_its_caller) {
+  TConcurrentClientSyncInfo sync;
+  int32_t reader = sync.generateSeqId();
+  int32_t waiter = sync.generateSeqId();
+
+  bool received = false;
+  std::thread waiting([&] {
+    TConcurrentRecvSentry sentry(&sync, waiter);
+    std::string fname;
+    TMessageType mtype;
+    int32_t rseqid;
+    while (!sync.getPending(fname, mtype, rseqid)) {
+      // pretend to read a reply that belongs to the other thread
+      sync.updatePending("method", T_REPLY, reader);
+      sync.waitForWork(waiter);
+    }
+    received = rseqid == waiter;
+    sentry.commit();
+  });
+
+  {
+    TConcurrentRecvSentry sentry(&sync, reader);
+    std::string fname;
+    TMessageType mtype;
+    int32_t rseqid;
+    while (!sync.getPending(fname, mtype, rseqid) || rseqid != reader) {
+      sync.waitForWork(reader);
+    }
+    BOOST_CHECK_EQUAL(fname, "method");
+    // and read the reply of the waiting thread
+    sync.updatePending("method", T_REPLY, waiter);
+    sentry.commit();
+  }
+  waiting.join();
+  BOOST_CHECK(received);
+}
+
+BOOST_AUTO_TEST_CASE(failed_send_kills_the_client) {
+  TConcurrentClientSyncInfo sync;
+  int32_t seqid = sync.generateSeqId();
+  { TConcurrentSendSentry sentry(&sync); }
+  BOOST_CHECK_THROW(sync.generateSeqId(), TTransportException);
+  TConcurrentRecvSentry sentry(&sync, seqid);
+  std::string fname;
+  TMessageType mtype;
+  int32_t rseqid;
+  BOOST_CHECK_THROW(sync.getPending(fname, mtype, rseqid), TTransportException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,215 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE FutureClientTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/async/TEvSocketClientChannel.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TNonblockingServerSocket.h>
+#include <thrift/transport/TSocket.h>
+
+#include <event2/event.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gen-cpp/FutureService.h"
+
+using apache::thrift::async::TEvSocketClientChannel;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TCompactProtocolFactory;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::server::TNonblockingServer;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TNonblockingServerSocket;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransportException;
+using std::make_shared;
+using std::shared_ptr;
+using namespace thrift::test::future;
+
+namespace {
+
+class Handler : public FutureServiceIf {
+public:
+  Handler() : recorded_(0) {}
+
+  int32_t add(const int32_t a, const int32_t b) override { return a + b; }
+  void echo(std::string& _return, const std::string& message) override { _return = message; }
+  void range(std::vector<int32_t>& _return, const int32_t count) override {
+    for (int32_t i = 0; i < count; ++i) {
+      _return.push_back(i);
+    }
+  }
+  void fail(const std::string& message) override {
+    Failure failure;
+    failure.message = message;
+    throw failure;
+  }
+  void record(const int32_t value) override { recorded_ = value; }
+  int32_t recorded() override { return recorded_; }
+
+private:
+  int32_t recorded_;
+};
+
+class ReadyHandler : public TServerEventHandler {
+public:
+  void preServe() override { ready.set_value(); }
+  std::promise<void> ready;
+};
+
+struct FutureClientFixture {
+  FutureClientFixture() : base(event_base_new()) {
+    auto socket = make_shared<TNonblockingServerSocket>(0);
+    server = make_shared<TNonblockingServer>(
+        make_shared<FutureServiceProcessor>(make_shared<Handler>()),
+        make_shared<TBinaryProtocolFactory>(),
+        socket);
+    auto readyHandler = make_shared<ReadyHandler>();
+    std::future<void> ready = readyHandler->ready.get_future();
+    server->setServerEventHandler(readyHandler);
+    serverThread = std::thread([this] { server->serve(); });
+    ready.wait();
+
+    // the server only reacts to stop() once its event loop runs
+    auto ping = make_shared<TSocket>("localhost", server->getListenPort());
+    ping->open();
+    FutureServiceClient(make_shared<TBinaryProtocol>(make_shared<TFramedTransport>(ping))).add(0, 0);
+  }
+
+  ~FutureClientFixture() {
+    client.reset();
+    channel.reset();
+    server->stop();
+    serverThread.join();
+    event_base_free(base);
+  }
+
+  void connect(int port, shared_ptr<TProtocolFactory> protocolFactory) {
+    protocolFactory_ = protocolFactory;
+    channel = make_shared<TEvSocketClientChannel>("localhost", port, base);
+    client = make_shared<FutureServiceFutureClient>(channel, protocolFactory_.get());
+  }
+
+  void connect() { connect(server->getListenPort(), make_shared<TBinaryProtocolFactory>()); }
+
+  template <typename T>
+  void runUntilReady(const std::future<T>& future) {
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      event_base_loop(base, EVLOOP_ONCE);
+    }
+  }
+
+  event_base* base;
+  shared_ptr<TNonblockingServer> server;
+  std::thread serverThread;
+  shared_ptr<TProtocolFactory> protocolFactory_;
+  shared_ptr<TEvSocketClientChannel> channel;
+  shared_ptr<FutureServiceFutureClient> client;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(FutureClientTest, FutureClientFixture)
+
+BOOST_AUTO_TEST_CASE(pipelined_calls) {
+  connect();
+
+  // every call is written before the first response is read
+  std::vector<std::future<int32_t> > sums;
+  std::vector<std::future<std::string> > echoes;
+  for (int32_t i = 0; i < 1000; ++i) {
+    sums.push_back(client->add(i, 1));
+    echoes.push_back(client->echo(std::to_string(i)));
+  }
+  BOOST_CHECK_EQUAL(channel->getPendingCount(), 2000u);
+
+  runUntilReady(echoes.back());
+  BOOST_CHECK_EQUAL(channel->getPendingCount(), 0u);
+  for (int32_t i = 0; i < 1000; ++i) {
+    BOOST_CHECK_EQUAL(sums[i].get(), i + 1);
+    BOOST_CHECK_EQUAL(echoes[i].get(), std::to_string(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(containers) {
+  connect();
+  std::future<std::vector<int32_t> > range = client->range(100);
+  runUntilReady(range);
+  std::vector<int32_t> values = range.get();
+  BOOST_REQUIRE_EQUAL(values.size(), 100u);
+  BOOST_CHECK_EQUAL(values[99], 99);
+}
+
+BOOST_AUTO_TEST_CASE(declared_exceptions) {
+  connect();
+  std::future<void> failed = client->fail("expected");
+  std::future<int32_t> next = client->add(1, 2);
+  runUntilReady(next);
+  try {
+    failed.get();
+    BOOST_ERROR("no exception");
+  } catch (const Failure& failure) {
+    BOOST_CHECK_EQUAL(failure.message, "expected");
+  }
+  BOOST_CHECK_EQUAL(next.get(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(oneway_calls) {
+  connect();
+  std::future<void> sent = client->record(42);
+  runUntilReady(sent);
+  sent.get();
+
+  std::future<int32_t> recorded = client->recorded();
+  runUntilReady(recorded);
+  BOOST_CHECK_EQUAL(recorded.get(), 42);
+}
+
+BOOST_AUTO_TEST_CASE(connection_failure) {
+  // nothing listens on a port that was just released
+  int port;
+  {
+    TNonblockingServerSocket unused(0);
+    unused.listen();
+    port = unused.getListenPort();
+  }
+  connect(port, make_shared<TCompactProtocolFactory>());
+
+  std::future<int32_t> sum = client->add(1, 2);
+  runUntilReady(sum);
+  BOOST_CHECK_THROW(sum.get(), TTransportException);
+  BOOST_CHECK(channel->error());
+
+  // later calls fail right away
+  std::future<std::string> echo = client->echo("late");
+  BOOST_CHECK(echo.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+  BOOST_CHECK_THROW(echo.get(), TTransportException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,38 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Compiled with --gen cpp:future_style
+
+namespace cpp thrift.test.future
+
+exception Failure {
+  1: string message
+}
+
+service BaseService {
+  i32 add(1: i32 a, 2: i32 b)
+}
+
+service FutureService extends BaseService {
+  string echo(1: string message)
+  list<i32> range(1: i32 count)
+  void fail(1: string message) throws (1: Failure failure)
+  oneway void record(1: i32 value)
+  i32 recorded()
+}
@@ -87,6 +87,18 @@ public:
     return proto->writeString(val);
   }
 
+  static uint32_t writeArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, const int32_t* vals, uint32_t count) {
+    return proto->writeI32Array(vals, count);
+  }
+
+  static uint32_t writeArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, const int64_t* vals, uint32_t count) {
+    return proto->writeI64Array(vals, count);
+  }
+
+  static uint32_t writeArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, const double* vals, uint32_t count) {
+    return proto->writeDoubleArray(vals, count);
+  }
+
   /* Read functions */
 
   static uint32_t read(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, int8_t& val) { return proto->readByte(val); }
@@ -102,6 +114,18 @@ public:
   static uint32_t read(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, std::string& val) {
     return proto->readString(val);
   }
+
+  static uint32_t readArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, int32_t* vals, uint32_t count) {
+    return proto->readI32Array(vals, count);
+  }
+
+  static uint32_t readArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, int64_t* vals, uint32_t count) {
+    return proto->readI64Array(vals, count);
+  }
+
+  static uint32_t readArray(std::shared_ptr<apache::thrift::protocol::TProtocol> proto, double* vals, uint32_t count) {
+    return proto->readDoubleArray(vals, count);
+  }
 };
 
 #endif
@@ -0,0 +1,135 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * THttpClient and THttpServer benchmarks against a TThreadedServer on
+ * localhost, with the OneWayService of OneWayHTTPTest:
+ *
+ *   roundtrip/<chunk>   calls that wait for their response before the next
+ *                       one is sent
+ *   pipelined/<chunk>   batches of 16 calls sent before reading the
+ *                       responses, see THttpClient::setPipelining()
+ *
+ * chunk is the response chunk size of the server, 0 for whole responses.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <memory>
+#include <thread>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TThreadedServer.h>
+#include <thrift/transport/THttpClient.h>
+#include <thrift/transport/THttpServer.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+
+#include "gen-cpp/OneWayService.h"
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::server::TThreadedServer;
+using apache::thrift::transport::THttpClient;
+using apache::thrift::transport::THttpServerTransportFactory;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocket;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const int BATCH_SIZE = 16;
+
+class Handler : public onewaytest::OneWayServiceIf {
+public:
+  void roundTripRPC() override {}
+  void oneWayRPC() override {}
+};
+
+class ReadyHandler : public TServerEventHandler {
+public:
+  void preServe() override { listening.set_value(); }
+
+  std::promise<void> listening;
+};
+
+struct Setup {
+  Setup(uint32_t responseChunkSize) {
+    serverSocket = make_shared<TServerSocket>("localhost", 0);
+    server.reset(new TThreadedServer(
+        make_shared<onewaytest::OneWayServiceProcessor>(make_shared<Handler>()),
+        serverSocket,
+        make_shared<THttpServerTransportFactory>(responseChunkSize),
+        make_shared<TBinaryProtocolFactory>()));
+    auto ready = make_shared<ReadyHandler>();
+    server->setServerEventHandler(ready);
+    thread = std::thread([this] { server->serve(); });
+    ready->listening.get_future().wait();
+
+    transport = make_shared<THttpClient>(make_shared<TSocket>("localhost", serverSocket->getPort()),
+                                         "localhost",
+                                         "/service");
+    client.reset(new onewaytest::OneWayServiceClient(make_shared<TBinaryProtocol>(transport)));
+    transport->open();
+  }
+
+  ~Setup() {
+    transport->close();
+    server->stop();
+    thread.join();
+  }
+
+  shared_ptr<TServerSocket> serverSocket;
+  std::unique_ptr<TThreadedServer> server;
+  std::thread thread;
+  shared_ptr<THttpClient> transport;
+  std::unique_ptr<onewaytest::OneWayServiceClient> client;
+};
+
+void roundTrips(benchmark::State& state) {
+  Setup setup(static_cast<uint32_t>(state.range(0)));
+  for (auto _ : state) {
+    setup.client->roundTripRPC();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void pipelinedCalls(benchmark::State& state) {
+  Setup setup(static_cast<uint32_t>(state.range(0)));
+  setup.transport->setPipelining(true);
+  for (auto _ : state) {
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+      setup.client->send_roundTripRPC();
+    }
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+      setup.client->recv_roundTripRPC();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+}
+}
+
+BENCHMARK(roundTrips)->Name("roundtrip")->Arg(0)->Arg(1)->UseRealTime();
+BENCHMARK(pipelinedCalls)->Name("pipelined")->Arg(0)->Arg(1)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -350,3 +350,129 @@ BOOST_AUTO_TEST_CASE(test_json_unicode_escaped_missing_hi_surrogate) {
   BOOST_CHECK_THROW(ooe2.read(proto.get()),
     apache::thrift::protocol::TProtocolException);
 }
+
+// Escapes str the way TJSONProtocol does, one character at a time
+static std::string escapeJSONString(const std::string& str) {
+  std::ostringstream ss;
+  ss << '"';
+  for (char c : str) {
+    auto ch = static_cast<uint8_t>(c);
+    switch (ch) {
+    case '"': ss << "\\\""; break;
+    case '\\': ss << "\\\\"; break;
+    case '\b': ss << "\\b"; break;
+    case '\f': ss << "\\f"; break;
+    case '\n': ss << "\\n"; break;
+    case '\r': ss << "\\r"; break;
+    case '\t': ss << "\\t"; break;
+    default:
+      if (ch < 0x20) {
+        ss << "\\u00" << std::hex << std::setw(2) << std::setfill('0') << int(ch) << std::dec;
+      } else {
+        ss << c;
+      }
+    }
+  }
+  ss << '"';
+  return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(test_json_strings) {
+  std::vector<std::string> strings;
+  // every character but NUL, which reads back as an empty string
+  std::string all;
+  for (int ch = 1; ch < 256; ++ch) {
+    all += static_cast<char>(ch);
+  }
+  strings.push_back(all);
+  strings.push_back("");
+  strings.push_back(std::string(100, 'x') + "\"" + std::string(33, 'y') + "\\\x1f" + "z");
+  for (std::size_t i = 0; i < 40; ++i) {
+    // a special character at every position of a vector
+    strings.push_back(std::string(i, 'a') + "\n" + std::string(40 - i, 'b'));
+  }
+
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol proto(buffer);
+  std::string expected;
+  for (const std::string& str : strings) {
+    buffer->resetBuffer();
+    proto.writeString(str);
+    expected = escapeJSONString(str);
+    BOOST_CHECK_EQUAL(buffer->getBufferAsString(), expected);
+  }
+
+  // read them back through a buffer that is smaller than the strings
+  buffer->resetBuffer();
+  proto.writeListBegin(apache::thrift::protocol::T_STRING, static_cast<uint32_t>(strings.size()));
+  for (const std::string& str : strings) {
+    proto.writeString(str);
+  }
+  proto.writeListEnd();
+  std::shared_ptr<apache::thrift::transport::TBufferedTransport> buffered(
+      new apache::thrift::transport::TBufferedTransport(buffer, 7));
+  TJSONProtocol reader(buffered);
+  apache::thrift::protocol::TType type;
+  uint32_t size;
+  reader.readListBegin(type, size);
+  BOOST_REQUIRE_EQUAL(size, strings.size());
+  for (const std::string& str : strings) {
+    std::string read;
+    reader.readString(read);
+    BOOST_CHECK_MESSAGE(read == str, toHexSequence(str) << " read as " << toHexSequence(read));
+  }
+  reader.readListEnd();
+}
+
+BOOST_AUTO_TEST_CASE(test_json_numbers) {
+  std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TJSONProtocol proto(buffer);
+  proto.writeMapBegin(apache::thrift::protocol::T_I64, apache::thrift::protocol::T_DOUBLE, 4);
+  proto.writeI64((std::numeric_limits<int64_t>::min)());
+  proto.writeDouble(0.1);
+  proto.writeI64((std::numeric_limits<int64_t>::max)());
+  proto.writeDouble(-1e-300);
+  proto.writeI64(0);
+  proto.writeDouble(1e21);
+  proto.writeI64(-1);
+  proto.writeDouble(5e-324);
+  proto.writeMapEnd();
+  BOOST_CHECK_EQUAL(buffer->getBufferAsString(),
+                    "[\"i64\",\"dbl\",4,{\"-9223372036854775808\":0.10000000000000001,"
+                    "\"9223372036854775807\":-1e-300,\"0\":1e+21,"
+                    "\"-1\":4.9406564584124654e-324}]");
+
+  apache::thrift::protocol::TType keyType;
+  apache::thrift::protocol::TType valType;
+  uint32_t size;
+  int64_t i64;
+  double dub;
+  proto.readMapBegin(keyType, valType, size);
+  proto.readI64(i64);
+  BOOST_CHECK_EQUAL(i64, (std::numeric_limits<int64_t>::min)());
+  proto.readDouble(dub);
+  BOOST_CHECK_EQUAL(dub, 0.1);
+  proto.readI64(i64);
+  BOOST_CHECK_EQUAL(i64, (std::numeric_limits<int64_t>::max)());
+  proto.readDouble(dub);
+  BOOST_CHECK_EQUAL(dub, -1e-300);
+  proto.readI64(i64);
+  proto.readDouble(dub);
+  BOOST_CHECK_EQUAL(dub, 1e21);
+  proto.readI64(i64);
+  BOOST_CHECK_EQUAL(i64, -1);
+  proto.readDouble(dub);
+  BOOST_CHECK_EQUAL(dub, 5e-324);
+  proto.readMapEnd();
+
+  // numbers that do not fit are rejected
+  for (const char* json : {"3000000000", "-2147483649", "", "1-", "+-1", "1.5"}) {
+    std::string data(json);
+    data += ']';
+    std::shared_ptr<TMemoryBuffer> input(
+        new TMemoryBuffer((uint8_t*)&data[0], static_cast<uint32_t>(data.size())));
+    TJSONProtocol reader(input);
+    int32_t i32;
+    BOOST_CHECK_THROW(reader.readI32(i32), apache::thrift::protocol::TProtocolException);
+  }
+}
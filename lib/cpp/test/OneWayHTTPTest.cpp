@@ -30,6 +30,7 @@
 #include <thrift/transport/THttpClient.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
+#include <thrift/transport/TVirtualTransport.h>
 #include <memory>
 #include <thrift/transport/TBufferTransports.h>
 #include "gen-cpp/OneWayService.h"
@@ -54,6 +55,7 @@ using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TSocket;
 using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TVirtualTransport;
 using std::shared_ptr;
 using std::cout;
 using std::cerr;
@@ -239,4 +241,151 @@ BOOST_AUTO_TEST_CASE( JSON_BufferedHTTP )
 #endif
 }
 
+// Hands over what the peer sent, a few bytes at a time, and keeps what is written
+class TMemoryConnection : public TVirtualTransport<TMemoryConnection> {
+public:
+  TMemoryConnection() : maxRead(100) {}
+
+  uint32_t read(uint8_t* buf, uint32_t len) { return input.read(buf, (std::min)(len, maxRead)); }
+
+  void write(const uint8_t* buf, uint32_t len) { output.write(buf, len); }
+
+  bool peek() override { return input.peek(); }
+
+  void append(const std::string& data) {
+    input.write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+  }
+
+  TMemoryBuffer input;
+  TMemoryBuffer output;
+  uint32_t maxRead;
+};
+
+std::string readString(TTransport& transport, uint32_t size) {
+  std::string data(size, '\0');
+  transport.readAll(reinterpret_cast<uint8_t*>(&data[0]), size);
+  transport.readEnd();
+  return data;
+}
+
+BOOST_AUTO_TEST_CASE( HTTP_PipelinedMessages )
+{
+  std::shared_ptr<TMemoryConnection> connection(new TMemoryConnection);
+  connection->maxRead = 100000;
+  std::shared_ptr<THttpServer> server(new THttpServer(connection));
+
+  // two requests at once: one with a header longer than the buffer and bare
+  // line feeds, and a chunked one
+  connection->append("POST /service HTTP/1.1\nX-Long: " + std::string(3000, 'x')
+                     + "\nContent-Length: 5\n\nhello"
+                     "POST /service HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                     "3\r\nabc\r\n5;ext=1\r\ndefgh\r\n0\r\nX-Footer: 1\r\n\r\n");
+  BOOST_CHECK_EQUAL(readString(*server, 5), "hello");
+  BOOST_CHECK(!connection->input.peek());
+  server->write(reinterpret_cast<const uint8_t*>("ok"), 2);
+  server->flush();
+  std::string response = connection->output.getBufferAsString();
+  BOOST_CHECK(response.find("\r\nContent-Length: 2\r\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(response.substr(response.size() - 6), "\r\n\r\nok");
+
+  // the second request arrived with the first one
+  BOOST_CHECK(server->peek());
+  BOOST_CHECK_EQUAL(readString(*server, 8), "abcdefgh");
+  BOOST_CHECK(!server->peek());
+}
+
+BOOST_AUTO_TEST_CASE( HTTP_ChunkedResponses )
+{
+  std::shared_ptr<TMemoryConnection> connection(new TMemoryConnection);
+  std::shared_ptr<THttpServer> server(new THttpServer(connection));
+  server->setResponseChunkSize(1000);
+  std::shared_ptr<TMemoryConnection> clientConnection(new TMemoryConnection);
+  std::shared_ptr<THttpClient> client(new THttpClient(clientConnection));
+
+  std::string body;
+  for (int i = 0; i < 2500; ++i) {
+    body += static_cast<char>('a' + i % 26);
+  }
+  for (int i = 0; i < 2; ++i) {
+    connection->append("POST /service HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    uint8_t buf[1];
+    BOOST_CHECK_EQUAL(server->read(buf, sizeof(buf)), 0u);
+    // the first two chunks go out before the response is complete
+    for (size_t pos = 0; pos < body.size(); pos += 500) {
+      server->write(reinterpret_cast<const uint8_t*>(body.data() + pos), 500);
+    }
+    BOOST_CHECK_EQUAL(connection->output.available_read() > 2000, true);
+    server->flush();
+  }
+  std::string responses = connection->output.getBufferAsString();
+  BOOST_CHECK(responses.find("\r\nTransfer-Encoding: chunked\r\n") != std::string::npos);
+  BOOST_CHECK(responses.find("Content-Length") == std::string::npos);
+
+  // the client reads both responses
+  clientConnection->append(responses);
+  BOOST_CHECK(readString(*client, 2500) == body);
+  BOOST_CHECK(readString(*client, 2500) == body);
+
+  // HTTP/1.0 clients get the whole response at once
+  connection->output.resetBuffer();
+  connection->append("POST /service HTTP/1.0\r\nContent-Length: 0\r\n\r\n");
+  uint8_t buf[1];
+  BOOST_CHECK_EQUAL(server->read(buf, sizeof(buf)), 0u);
+  server->write(reinterpret_cast<const uint8_t*>(body.data()), 2500);
+  server->flush();
+  BOOST_CHECK(connection->output.getBufferAsString().find("\r\nContent-Length: 2500\r\n")
+              != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( Binary_PipelinedHTTP )
+{
+  // with responses sent at once, and in chunks
+  for (uint32_t responseChunkSize : {0u, 1u}) {
+    std::shared_ptr<TServerSocket> ss = std::make_shared<TServerSocket>(0) ;
+    TThreadedServer server(
+      std::make_shared<onewaytest::OneWayServiceProcessorFactory>(std::make_shared<OneWayServiceCloneFactory>()),
+      ss, //port
+      std::make_shared<THttpServerTransportFactory>(responseChunkSize),
+      std::make_shared<TBinaryProtocolFactory>());
+
+    std::shared_ptr<TServerReadyEventHandler> pEventHandler(new TServerReadyEventHandler) ;
+    server.setServerEventHandler(pEventHandler);
+    RPC0ThreadClass t(server) ;
+    boost::thread thread(&RPC0ThreadClass::Run, &t);
+    {
+      Synchronized sync(*(pEventHandler.get()));
+      while (!pEventHandler->isListening()) {
+        pEventHandler->wait();
+      }
+    }
+
+    {
+      std::shared_ptr<TSocket> socket(new TSocket("localhost", ss->getPort()));
+      socket->setRecvTimeout(10000) ;
+      std::shared_ptr<THttpClient> transport(new THttpClient(socket, "localhost", "/service"));
+      transport->setPipelining(true);
+      std::shared_ptr<TProtocol> protocol(new TBinaryProtocol(transport));
+      onewaytest::OneWayServiceClient client(protocol);
+
+      transport->open();
+      for (int round = 0; round < 3; ++round) {
+        client.send_roundTripRPC();
+        client.send_roundTripRPC();
+        client.send_roundTripRPC();
+        try {
+          client.recv_roundTripRPC();
+          client.recv_roundTripRPC();
+          client.recv_roundTripRPC();
+        } catch (const TTransportException &e) {
+          BOOST_ERROR( "we should not get a transport exception -- this means we failed: " + std::string(e.what()) ) ;
+        }
+      }
+      BOOST_CHECK_EQUAL(pEventHandler->acceptedCount(), 1u);
+      transport->close();
+    }
+    server.stop();
+    thread.join() ;
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * TSSLSocket benchmarks against a server on localhost:
+ *
+ *   handshake/full, handshake/resumed  handshakes per second, without and
+ *                                      with session resumption
+ *   write/<ktls>, sendfile/<ktls>      bytes per second of 1 MB messages,
+ *                                      with OpenSSL (0) or kernel TLS (1)
+ *
+ * Kernel TLS needs the tls kernel module; without it, the kernel TLS
+ * benchmarks measure OpenSSL, and report ktls=0.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thrift/transport/TSSLSocket.h>
+
+#include "SSLTestHelpers.h"
+
+using apache::thrift::transport::TSSLException;
+using apache::thrift::transport::TSSLSocket;
+using apache::thrift::transport::TSSLSocketFactory;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const uint32_t MESSAGE_SIZE = 1024 * 1024;
+
+struct Setup {
+  Setup(bool kernelTLS) {
+    std::string certificate;
+    std::string privateKey;
+    makeTestCertificate(certificate, privateKey);
+
+    serverFactory = make_shared<TSSLSocketFactory>();
+    serverFactory->server(true);
+    serverFactory->loadCertificateFromBuffer(certificate.c_str());
+    serverFactory->loadPrivateKeyFromBuffer(privateKey.c_str());
+    serverFactory->enableSessionCache(true);
+    clientFactory = make_shared<TSSLSocketFactory>();
+    clientFactory->loadTrustedCertificatesFromBuffer(certificate.c_str());
+    if (kernelTLS) {
+      try {
+        serverFactory->enableKernelTLS(true);
+        clientFactory->enableKernelTLS(true);
+      } catch (const TSSLException&) {
+        // OpenSSL without kernel TLS support
+      }
+    }
+    server.reset(new TestSSLServer(serverFactory));
+  }
+
+  void sendMessage(TSSLSocket& socket, const uint8_t* data, uint32_t size) {
+    socket.write(reinterpret_cast<uint8_t*>(&size), sizeof(size));
+    socket.write(data, size);
+  }
+
+  void receiveAnswer(TSSLSocket& socket) {
+    uint32_t sum;
+    socket.readAll(reinterpret_cast<uint8_t*>(&sum), sizeof(sum));
+  }
+
+  shared_ptr<TSSLSocketFactory> serverFactory;
+  shared_ptr<TSSLSocketFactory> clientFactory;
+  std::unique_ptr<TestSSLServer> server;
+};
+
+void handshake(benchmark::State& state, bool resume) {
+  Setup setup(false);
+  setup.clientFactory->enableSessionCache(resume);
+  uint8_t byte = 0;
+  for (auto _ : state) {
+    shared_ptr<TSSLSocket> socket = setup.clientFactory->createSocket("localhost",
+                                                                      setup.server->getPort());
+    socket->open();
+    // a round trip, so that the client receives the session tickets
+    setup.sendMessage(*socket, &byte, 1);
+    setup.receiveAnswer(*socket);
+    socket->close();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["resumed"]
+      = benchmark::Counter(setup.server->resumedConnections_ / static_cast<double>(state.iterations()));
+}
+
+void writeMessages(benchmark::State& state) {
+  Setup setup(state.range(0) != 0);
+  shared_ptr<TSSLSocket> socket = setup.clientFactory->createSocket("localhost",
+                                                                    setup.server->getPort());
+  socket->open();
+  std::vector<uint8_t> message(MESSAGE_SIZE, 'x');
+  for (auto _ : state) {
+    setup.sendMessage(*socket, message.data(), MESSAGE_SIZE);
+    setup.receiveAnswer(*socket);
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+  state.counters["ktls"] = socket->isKernelTLSSend();
+}
+
+void sendFiles(benchmark::State& state) {
+  Setup setup(state.range(0) != 0);
+  char path[] = "/tmp/thrift.SSLBenchmark.XXXXXX";
+  int fd = mkstemp(path);
+  std::vector<uint8_t> contents(MESSAGE_SIZE, 'x');
+  if (fd == -1 || ::write(fd, contents.data(), MESSAGE_SIZE) != static_cast<ssize_t>(MESSAGE_SIZE)) {
+    state.SkipWithError("cannot write the file to send");
+    return;
+  }
+
+  shared_ptr<TSSLSocket> socket = setup.clientFactory->createSocket("localhost",
+                                                                    setup.server->getPort());
+  socket->open();
+  for (auto _ : state) {
+    uint32_t size = MESSAGE_SIZE;
+    socket->write(reinterpret_cast<uint8_t*>(&size), sizeof(size));
+    socket->sendFile(fd, 0, size);
+    setup.receiveAnswer(*socket);
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+  state.counters["ktls"] = socket->isKernelTLSSend();
+  close(fd);
+  unlink(path);
+}
+}
+
+BENCHMARK_CAPTURE(handshake, full, false)->UseRealTime();
+BENCHMARK_CAPTURE(handshake, resumed, true)->UseRealTime();
+BENCHMARK(writeMessages)->Name("write")->Arg(0)->Arg(1)->UseRealTime();
+BENCHMARK(sendFiles)->Name("sendfile")->Arg(0)->Arg(1)->UseRealTime();
+
+int main(int argc, char** argv) {
+  // OpenSSL writes without MSG_NOSIGNAL
+  signal(SIGPIPE, SIG_IGN);
+  // keep OpenSSL initialized while factories come and go
+  TSSLSocketFactory factory;
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TEST_SSLTESTHELPERS_H_
+#define _THRIFT_TEST_SSLTESTHELPERS_H_ 1
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <thrift/transport/TSSLServerSocket.h>
+#include <thrift/transport/TSSLSocket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+std::string bioContents(BIO* bio) {
+  char* data;
+  long size = BIO_get_mem_data(bio, &data);
+  std::string contents(data, static_cast<size_t>(size));
+  BIO_free(bio);
+  return contents;
+}
+
+/**
+ * Creates a self-signed certificate for localhost, valid for a day, so that
+ * tests do not depend on certificate files that expire.  Both are PEM
+ * encoded.
+ */
+void makeTestCertificate(std::string& certificate, std::string& privateKey) {
+  EVP_PKEY* key = nullptr;
+  EVP_PKEY_CTX* keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  if (keyContext == nullptr || EVP_PKEY_keygen_init(keyContext) <= 0
+      || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext, NID_X9_62_prime256v1) <= 0
+      || EVP_PKEY_keygen(keyContext, &key) <= 0) {
+    throw std::runtime_error("cannot generate a key");
+  }
+  EVP_PKEY_CTX_free(keyContext);
+
+  X509* cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), -60);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 60 * 60);
+  X509_set_pubkey(cert, key);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  if (X509_sign(cert, key, EVP_sha256()) == 0) {
+    throw std::runtime_error("cannot sign the certificate");
+  }
+
+  BIO* bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_X509(bio, cert);
+  certificate = bioContents(bio);
+  bio = BIO_new(BIO_s_mem());
+  PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+  privateKey = bioContents(bio);
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+}
+
+/**
+ * Adds up the bytes of a message.
+ */
+uint32_t checksum(const uint8_t* data, size_t size, uint32_t sum = 0) {
+  for (size_t i = 0; i < size; ++i) {
+    sum += data[i];
+  }
+  return sum;
+}
+
+/**
+ * An SSL server on a thread that handles one connection at a time.  Clients
+ * send messages, a 32 bit length followed by the payload, and the server
+ * answers each with the checksum() of the payload.
+ */
+class TestSSLServer {
+public:
+  TestSSLServer(std::shared_ptr<apache::thrift::transport::TSSLSocketFactory> factory)
+    : socket_(std::make_shared<apache::thrift::transport::TSSLServerSocket>("localhost", 0, factory)),
+      connections_(0),
+      resumedConnections_(0),
+      kernelTLSConnections_(0) {
+    socket_->listen();
+    thread_ = std::thread([this] { serve(); });
+  }
+
+  ~TestSSLServer() {
+    socket_->interrupt();
+    thread_.join();
+    socket_->close();
+  }
+
+  int getPort() { return socket_->getPort(); }
+
+  std::atomic<int> connections_;
+  std::atomic<int> resumedConnections_;
+  std::atomic<int> kernelTLSConnections_;
+
+private:
+  void serve() {
+    using apache::thrift::transport::TSSLSocket;
+    using apache::thrift::transport::TTransportException;
+    while (true) {
+      std::shared_ptr<TSSLSocket> client;
+      try {
+        client = std::static_pointer_cast<TSSLSocket>(socket_->accept());
+      } catch (const TTransportException&) {
+        return;
+      }
+      try {
+        bool first = true;
+        uint8_t buf[64 * 1024];
+        while (true) {
+          uint32_t size;
+          client->readAll(reinterpret_cast<uint8_t*>(&size), sizeof(size));
+          if (first) {
+            first = false;
+            ++connections_;
+            if (client->isSessionReused()) {
+              ++resumedConnections_;
+            }
+            if (client->isKernelTLSRecv()) {
+              ++kernelTLSConnections_;
+            }
+          }
+          uint32_t sum = 0;
+          while (size > 0) {
+            uint32_t got = client->read(buf, (std::min)(size, static_cast<uint32_t>(sizeof(buf))));
+            if (got == 0) {
+              throw TTransportException(TTransportException::END_OF_FILE);
+            }
+            sum = checksum(buf, got, sum);
+            size -= got;
+          }
+          client->write(reinterpret_cast<uint8_t*>(&sum), sizeof(sum));
+        }
+      } catch (const TTransportException&) {
+        // the client disconnected
+      }
+      client->close();
+    }
+  }
+
+  std::shared_ptr<apache::thrift::transport::TSSLServerSocket> socket_;
+  std::thread thread_;
+};
+}
+
+#endif // _THRIFT_TEST_SSLTESTHELPERS_H_
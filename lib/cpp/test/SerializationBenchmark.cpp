@@ -0,0 +1,332 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Serialization benchmarks for every combination of protocol, transport and
+ * payload.  Each benchmark reports, besides the time per operation, the
+ * number of bytes on the wire (bytes/op) and the number of heap allocations
+ * (allocs/op) for writing or reading one struct.
+ *
+ * Use --benchmark_filter to select benchmarks, e.g.
+ *   SerializationBenchmark --benchmark_filter='read/compact/.*'
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/THeaderProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TZlibTransport.h>
+
+#include "gen-cpp/DebugProtoTest_types.h"
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+using namespace thrift::test::debug;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+// The benchmarks run on a single thread
+uint64_t allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  void* p = std::malloc(size != 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+typedef std::function<shared_ptr<TTransport>(shared_ptr<TMemoryBuffer>)> TransportFactory;
+typedef std::function<shared_ptr<TProtocol>(shared_ptr<TTransport>)> ProtocolFactory;
+
+struct Transport {
+  const char* name;
+  TransportFactory create;
+};
+
+struct Protocol {
+  const char* name;
+  ProtocolFactory create;
+};
+
+const Transport transports[] = {
+    {"memory", [](shared_ptr<TMemoryBuffer> memory) -> shared_ptr<TTransport> { return memory; }},
+    {"buffered",
+     [](shared_ptr<TMemoryBuffer> memory) -> shared_ptr<TTransport> {
+       return make_shared<TBufferedTransport>(memory);
+     }},
+    {"framed",
+     [](shared_ptr<TMemoryBuffer> memory) -> shared_ptr<TTransport> {
+       return make_shared<TFramedTransport>(memory);
+     }},
+    {"zlib",
+     [](shared_ptr<TMemoryBuffer> memory) -> shared_ptr<TTransport> {
+       return make_shared<TZlibTransport>(memory);
+     }},
+};
+
+const Protocol protocols[] = {
+    {"binary",
+     [](shared_ptr<TTransport> trans) -> shared_ptr<TProtocol> {
+       return make_shared<TBinaryProtocol>(trans);
+     }},
+    {"compact",
+     [](shared_ptr<TTransport> trans) -> shared_ptr<TProtocol> {
+       return make_shared<TCompactProtocol>(trans);
+     }},
+    {"json",
+     [](shared_ptr<TTransport> trans) -> shared_ptr<TProtocol> {
+       return make_shared<TJSONProtocol>(trans);
+     }},
+    {"header",
+     [](shared_ptr<TTransport> trans) -> shared_ptr<TProtocol> {
+       return make_shared<THeaderProtocol>(trans);
+     }},
+};
+
+/*
+ * Payloads
+ */
+
+OneOfEach makeOneOfEach(int32_t i) {
+  OneOfEach ooe;
+  ooe.im_true = true;
+  ooe.im_false = false;
+  ooe.a_bite = 0x7f;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1 << 24 | i;
+  ooe.integer64 = static_cast<int64_t>(6000) * 1000 * 1000 + i;
+  ooe.double_precision = 3.14159265358979 * i;
+  ooe.some_characters = "JSON THIS! \"\1";
+  ooe.zomg_unicode = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+  return ooe;
+}
+
+Bonk makeSmall() {
+  Bonk bonk;
+  bonk.type = 31337;
+  bonk.message = "Hello, world!";
+  return bonk;
+}
+
+Base64 makeLarge() {
+  Base64 large;
+  large.a = 1;
+  large.b1.assign(16 * 1024, 'a');
+  large.b2.assign(16 * 1024, 'b');
+  large.b3.assign(16 * 1024, 'c');
+  large.b4.assign(16 * 1024, 'd');
+  large.b5.assign(16 * 1024, 'e');
+  large.b6.assign(16 * 1024, 'f');
+  return large;
+}
+
+Nesting makeNested() {
+  Nesting nesting;
+  nesting.my_bonk = makeSmall();
+  nesting.my_ooe = makeOneOfEach(1);
+  return nesting;
+}
+
+HolyMoley makeContainers() {
+  HolyMoley hm;
+  for (int32_t i = 0; i < 100; ++i) {
+    hm.big.push_back(makeOneOfEach(i));
+  }
+  for (int32_t i = 0; i < 20; ++i) {
+    std::vector<std::string> strings;
+    for (int32_t j = 0; j <= i; ++j) {
+      strings.push_back(std::to_string(i * 100 + j));
+    }
+    hm.contain.insert(strings);
+  }
+  for (int32_t i = 0; i < 20; ++i) {
+    std::vector<Bonk>& bonks = hm.bonks["bonk" + std::to_string(i)];
+    for (int32_t j = 0; j < 5; ++j) {
+      bonks.push_back(makeSmall());
+    }
+  }
+  return hm;
+}
+
+/*
+ * Benchmarks
+ */
+
+struct Stack {
+  Stack(const Transport& transport, const Protocol& protocol, shared_ptr<TMemoryBuffer> memory)
+    : memory(memory), protocol(protocol.create(transport.create(memory))) {}
+
+  shared_ptr<TMemoryBuffer> memory;
+  shared_ptr<TProtocol> protocol;
+};
+
+template <typename T>
+void benchmarkWrite(benchmark::State& state,
+                    const Transport& transport,
+                    const Protocol& protocol,
+                    const T& value) {
+  Stack stack(transport, protocol, make_shared<TMemoryBuffer>(1024 * 1024));
+  shared_ptr<TTransport> trans = stack.protocol->getTransport();
+
+  uint64_t bytes = 0;
+  uint64_t allocationsBefore = allocations;
+  for (auto _ : state) {
+    stack.memory->resetBuffer();
+    value.write(stack.protocol.get());
+    trans->flush();
+    bytes += stack.memory->available_read();
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+  state.counters["bytes/op"]
+      = benchmark::Counter(static_cast<double>(bytes), benchmark::Counter::kAvgIterations);
+  state.counters["allocs/op"]
+      = benchmark::Counter(static_cast<double>(allocations - allocationsBefore),
+                           benchmark::Counter::kAvgIterations);
+}
+
+/*
+ * Reads a stream of up to about a megabyte of messages, written by the same
+ * transport and protocol.  When the stream is exhausted a new one is set up
+ * outside of the measurement.
+ */
+template <typename T>
+void benchmarkRead(benchmark::State& state,
+                   const Transport& transport,
+                   const Protocol& protocol,
+                   const T& value) {
+  auto written = make_shared<TMemoryBuffer>();
+  uint32_t count;
+  {
+    Stack writer(transport, protocol, written);
+    shared_ptr<TTransport> trans = writer.protocol->getTransport();
+    value.write(writer.protocol.get());
+    trans->flush();
+    count = (std::max)(1u, (std::min)(1000u, (1024u * 1024u) / written->available_read()));
+    for (uint32_t i = 1; i < count; ++i) {
+      value.write(writer.protocol.get());
+      trans->flush();
+    }
+  }
+  std::string stream = written->getBufferAsString();
+
+  shared_ptr<Stack> reader;
+  uint32_t remaining = 0;
+  uint64_t excluded = 0;
+  uint64_t allocationsBefore = allocations;
+  for (auto _ : state) {
+    if (remaining == 0) {
+      state.PauseTiming();
+      uint64_t before = allocations;
+      reader.reset();
+      reader = make_shared<Stack>(transport,
+                                  protocol,
+                                  make_shared<TMemoryBuffer>(
+                                      reinterpret_cast<uint8_t*>(&stream[0]),
+                                      static_cast<uint32_t>(stream.size())));
+      remaining = count;
+      excluded += allocations - before;
+      state.ResumeTiming();
+    }
+    T read;
+    read.read(reader->protocol.get());
+    --remaining;
+  }
+
+  double bytes = static_cast<double>(stream.size()) / count * state.iterations();
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+  state.counters["bytes/op"] = benchmark::Counter(bytes, benchmark::Counter::kAvgIterations);
+  state.counters["allocs/op"]
+      = benchmark::Counter(static_cast<double>(allocations - allocationsBefore - excluded),
+                           benchmark::Counter::kAvgIterations);
+}
+
+template <typename T>
+void registerPayload(const char* payloadName, const T& value) {
+  auto payload = make_shared<T>(value);
+  for (const Protocol& protocol : protocols) {
+    for (const Transport& transport : transports) {
+      std::string suffix = std::string(protocol.name) + "/" + transport.name + "/" + payloadName;
+      const Protocol* p = &protocol;
+      const Transport* t = &transport;
+      benchmark::RegisterBenchmark(("write/" + suffix).c_str(),
+                                   [=](benchmark::State& state) {
+                                     benchmarkWrite(state, *t, *p, *payload);
+                                   });
+      benchmark::RegisterBenchmark(("read/" + suffix).c_str(),
+                                   [=](benchmark::State& state) {
+                                     benchmarkRead(state, *t, *p, *payload);
+                                   });
+    }
+  }
+}
+}
+
+int main(int argc, char** argv) {
+  registerPayload("small", makeSmall());
+  registerPayload("large", makeLarge());
+  registerPayload("nested", makeNested());
+  registerPayload("containers", makeContainers());
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE StringViewTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/TStringView.h>
+#include <thrift/TToString.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/protocol/TJSONProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <type_traits>
+
+#include "gen-cpp/StringViewService.h"
+#include "gen-cpp/StringViewTest_types.h"
+
+using apache::thrift::TStringView;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using std::make_shared;
+using std::shared_ptr;
+using thrift::test::string_view::Record;
+
+namespace {
+
+Record makeRecord(const std::string& name, const std::string& payload) {
+  Record record;
+  record.__set_name(name);
+  record.__set_payload(payload);
+  record.__set_extra(std::string("\0\1\2", 3));
+  record.tags.push_back("a");
+  record.tags.push_back("b");
+  record.__set_id(42);
+  return record;
+}
+
+template <class Protocol_>
+void writeFrames(const shared_ptr<TMemoryBuffer>& buffer, const std::vector<Record>& records) {
+  auto framed = make_shared<TFramedTransport>(buffer);
+  Protocol_ prot(framed);
+  for (const auto& record : records) {
+    record.write(&prot);
+    framed->flush();
+  }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(StringViewTest)
+
+BOOST_AUTO_TEST_CASE(generated_types) {
+  Record record;
+  BOOST_CHECK((std::is_same<decltype(record.name), TStringView>::value));
+  BOOST_CHECK((std::is_same<decltype(record.payload), TStringView>::value));
+  BOOST_CHECK((std::is_same<decltype(record.extra), TStringView>::value));
+  BOOST_CHECK((std::is_same<decltype(record.tags), std::vector<std::string> >::value));
+  BOOST_CHECK_EQUAL(record.label, "default");
+  BOOST_CHECK(record.name.empty());
+
+  // service arguments keep the types of the handler interface
+  thrift::test::string_view::StringViewService_echo_args args;
+  BOOST_CHECK((std::is_same<decltype(args.suffix), std::string>::value));
+}
+
+BOOST_AUTO_TEST_CASE(string_view_basics) {
+  TStringView a("abc");
+  TStringView b(std::string("abd"));
+  TStringView c = a;
+  BOOST_CHECK(a == "abc");
+  BOOST_CHECK(a == std::string("abc"));
+  BOOST_CHECK(a != b);
+  BOOST_CHECK(a < b);
+  BOOST_CHECK(!(b < a));
+  BOOST_CHECK_EQUAL(c.data(), a.data());
+  BOOST_CHECK_EQUAL(a.str(), "abc");
+  BOOST_CHECK(TStringView("ab") < a);
+
+  TStringView binary(std::string("x\0y", 3));
+  BOOST_CHECK_EQUAL(binary.size(), 3u);
+  BOOST_CHECK(binary == std::string("x\0y", 3));
+
+  std::ostringstream out;
+  out << a;
+  BOOST_CHECK_EQUAL(out.str(), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_copies_from_memory_buffer) {
+  Record record = makeRecord("name", "payload");
+  auto buffer = make_shared<TMemoryBuffer>();
+  TBinaryProtocol prot(buffer);
+  record.write(&prot);
+
+  Record read;
+  read.read(&prot);
+  BOOST_CHECK(read == record);
+  BOOST_CHECK_EQUAL(read.extra.size(), 3u);
+
+  // TMemoryBuffer cannot lend out its buffer, so the fields hold copies
+  uint8_t* buf;
+  uint32_t size;
+  buffer->getBuffer(&buf, &size);
+  BOOST_CHECK(read.name.data() < reinterpret_cast<char*>(buf)
+              || read.name.data() >= reinterpret_cast<char*>(buf) + size);
+}
+
+BOOST_AUTO_TEST_CASE(binary_protocol_refers_to_frame) {
+  std::vector<Record> records;
+  records.push_back(makeRecord("first", std::string(1000, 'x')));
+  records.push_back(makeRecord("second", std::string(10, 'y')));
+  auto buffer = make_shared<TMemoryBuffer>();
+  writeFrames<TBinaryProtocol>(buffer, records);
+
+  auto framed = make_shared<TFramedTransport>(buffer);
+  TBinaryProtocol prot(framed);
+  Record first;
+  first.read(&prot);
+  framed->readEnd();
+
+  // the payload follows the name in the frame: field header (3) and size (4)
+  BOOST_CHECK_EQUAL(first.payload.data(), first.name.data() + first.name.size() + 7);
+
+  Record second;
+  second.read(&prot);
+  framed->readEnd();
+
+  // the first frame is still referenced and was not overwritten
+  BOOST_CHECK(first == records[0]);
+  BOOST_CHECK(second == records[1]);
+  BOOST_CHECK(first.payload.data() != second.payload.data());
+}
+
+BOOST_AUTO_TEST_CASE(compact_protocol_refers_to_frame) {
+  std::vector<Record> records;
+  records.push_back(makeRecord("first", std::string(100, 'x')));
+  records.push_back(makeRecord("second", std::string(10, 'y')));
+  auto buffer = make_shared<TMemoryBuffer>();
+  writeFrames<TCompactProtocol>(buffer, records);
+
+  auto framed = make_shared<TFramedTransport>(buffer);
+  TCompactProtocol prot(framed);
+  Record first;
+  first.read(&prot);
+  framed->readEnd();
+
+  // field header (1) and varint size (1)
+  BOOST_CHECK_EQUAL(first.payload.data(), first.name.data() + first.name.size() + 2);
+
+  Record second;
+  second.read(&prot);
+  framed->readEnd();
+  BOOST_CHECK(first == records[0]);
+  BOOST_CHECK(second == records[1]);
+}
+
+BOOST_AUTO_TEST_CASE(views_outlive_transport) {
+  std::vector<Record> records(1, makeRecord("name", "payload"));
+  auto buffer = make_shared<TMemoryBuffer>();
+  writeFrames<TBinaryProtocol>(buffer, records);
+
+  Record read;
+  {
+    auto framed = make_shared<TFramedTransport>(buffer);
+    TBinaryProtocol prot(framed);
+    read.read(&prot);
+  }
+  BOOST_CHECK(read == records[0]);
+}
+
+BOOST_AUTO_TEST_CASE(other_protocols_copy) {
+  Record record = makeRecord("name", std::string("\0\xff", 2));
+  auto buffer = make_shared<TMemoryBuffer>();
+  TJSONProtocol prot(buffer);
+  record.write(&prot);
+
+  Record read;
+  read.read(&prot);
+  BOOST_CHECK(read == record);
+}
+
+BOOST_AUTO_TEST_CASE(printing) {
+  Record record = makeRecord("name", "payload");
+  std::string printed = apache::thrift::to_string(record);
+  BOOST_CHECK(printed.find("name=name") != std::string::npos);
+  BOOST_CHECK(printed.find("payload=payload") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,12 @@
 #include <getopt.h>
 #include <boost/test/unit_test.hpp>
 
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
 #include <thrift/transport/TFileTransport.h>
 
 #ifdef __MINGW32__
@@ -48,6 +54,8 @@ static const char* tmp_dir = "/tmp";
 
 class FsyncLog;
 FsyncLog* fsync_log;
+// makes fsync() and fdatasync() fail with EIO
+bool fsync_fails = false;
 
 /**************************************************************************
  * Helper code
@@ -148,9 +156,26 @@ extern "C" int fsync(int fd) {
   if (fsync_log) {
     fsync_log->fsync(fd);
   }
+  if (fsync_fails) {
+    errno = EIO;
+    return -1;
+  }
   return 0;
 }
 
+#ifndef __APPLE__
+extern "C" int fdatasync(int fd) {
+  if (fsync_log) {
+    fsync_log->fsync(fd);
+  }
+  if (fsync_fails) {
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}
+#endif
+
 int time_diff(const struct timeval* t1, const struct timeval* t2) {
   return (t2->tv_usec - t1->tv_usec) + (t2->tv_sec - t1->tv_sec) * 1000000;
 }
@@ -336,6 +361,172 @@ BOOST_AUTO_TEST_CASE(test_noop_flush) {
   }
 }
 
+/**
+ * Write events from several threads at once and read them back.
+ *
+ * The chunks are small, so that many events need padding in front of them.
+ * Prints the number of events written per second.
+ */
+void test_concurrent_writes_impl(bool group_commit, unsigned int events_per_thread) {
+  unsigned int const NUM_THREADS = 4;
+  uint32_t const EVENT_SIZE = 100;
+  uint32_t const CHUNK_SIZE = 4096;
+
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+
+  // Record calls to fsync() and fdatasync()
+  FsyncLog log;
+  fsync_log = &log;
+
+  auto* transport = new TFileTransport(f.getPath());
+  transport->setChunkSize(CHUNK_SIZE);
+  transport->setGroupCommit(group_commit);
+  // a small ring, so that writers have to wait for the writer thread
+  transport->setEventBufferSize(64);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back([=] {
+      // each event holds its thread and its sequence number in that thread
+      uint8_t buf[EVENT_SIZE];
+      memset(buf, 'a' + t, sizeof(buf));
+      for (unsigned int n = 0; n < events_per_thread; ++n) {
+        memcpy(buf, &n, sizeof(n));
+        transport->write(buf, sizeof(buf));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  transport->flush();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  delete transport;
+  fsync_log = nullptr;
+
+  unsigned int total = NUM_THREADS * events_per_thread;
+  printf("TFileTransport%s: %u events of %u bytes from %u threads in %lld us (%.0f events/s), "
+         "%u syncs\n",
+         group_commit ? " with group commit" : "",
+         total,
+         EVENT_SIZE,
+         NUM_THREADS,
+         static_cast<long long>(elapsed.count()),
+         total * 1e6 / (elapsed.count() + 1),
+         static_cast<unsigned int>(log.getCalls()->size()));
+  if (group_commit) {
+    // every write waited for a sync, and the writers shared them
+    BOOST_CHECK_GE(log.getCalls()->size(), 1u);
+    BOOST_CHECK_LT(log.getCalls()->size(), total / 2);
+  }
+
+  // read the events back, each thread's events must be in order
+  TFileTransport reader(f.getPath(), true);
+  reader.setChunkSize(CHUNK_SIZE);
+  std::vector<unsigned int> next(NUM_THREADS, 0);
+  unsigned int events = 0;
+  uint8_t buf[EVENT_SIZE];
+  while (reader.read(buf, sizeof(buf)) == sizeof(buf)) {
+    unsigned int t = buf[EVENT_SIZE - 1] - 'a';
+    BOOST_REQUIRE_LT(t, NUM_THREADS);
+    unsigned int n;
+    memcpy(&n, buf, sizeof(n));
+    BOOST_REQUIRE_EQUAL(n, next[t]);
+    ++next[t];
+    ++events;
+  }
+  BOOST_CHECK_EQUAL(events, total);
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_writes) {
+  test_concurrent_writes_impl(false, 50000);
+}
+
+BOOST_AUTO_TEST_CASE(test_group_commit) {
+  test_concurrent_writes_impl(true, 5000);
+}
+
+/**
+ * With group commit, a write must fail if its event could not be synced, and
+ * writes must succeed again once the writer thread reopened the file.
+ */
+BOOST_AUTO_TEST_CASE(test_group_commit_sync_error) {
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+
+  TFileTransport transport(f.getPath());
+  transport.setGroupCommit(true);
+  transport.setWriterThreadIOErrorSleepTimeUs(1000);
+
+  uint8_t buf[16] = {0};
+  transport.write(buf, sizeof(buf));
+
+  fsync_fails = true;
+  BOOST_CHECK_THROW(transport.write(buf, sizeof(buf)), TTransportException);
+  fsync_fails = false;
+
+  transport.write(buf, sizeof(buf));
+  transport.flush();
+}
+
+/**
+ * Write events of varying sizes into small chunks, so that the batches the
+ * writer thread writes pad several chunks, with paddings of different sizes.
+ * Checks the file byte by byte: each event where it belongs, and zeros in
+ * front of the events that would have crossed a chunk boundary.
+ */
+BOOST_AUTO_TEST_CASE(test_chunk_padding) {
+  uint32_t const CHUNK_SIZE = 64;
+  unsigned int const NUM_EVENTS = 2000;
+
+  TempFile f(tmp_dir, "thrift.TFileTransportTest.");
+
+  // the file contents that are expected
+  std::vector<uint8_t> expected;
+  std::vector<std::vector<uint8_t> > events;
+  {
+    TFileTransport transport(f.getPath());
+    transport.setChunkSize(CHUNK_SIZE);
+    // the main thread writes most events before the writer thread wakes up,
+    // so most batches hold many of them
+    for (unsigned int n = 0; n < NUM_EVENTS; ++n) {
+      std::vector<uint8_t> event(1 + (n * 37) % 50, static_cast<uint8_t>('a' + n % 26));
+      transport.write(event.data(), static_cast<uint32_t>(event.size()));
+
+      auto eventLen = static_cast<uint32_t>(event.size());
+      size_t end = expected.size();
+      if (end / CHUNK_SIZE != (end + eventLen + 4 - 1) / CHUNK_SIZE) {
+        expected.resize((end / CHUNK_SIZE + 1) * CHUNK_SIZE, 0);
+      }
+      const auto* header = reinterpret_cast<const uint8_t*>(&eventLen);
+      expected.insert(expected.end(), header, header + 4);
+      expected.insert(expected.end(), event.begin(), event.end());
+      events.push_back(event);
+    }
+    transport.flush();
+  }
+
+  FILE* file = fopen(f.getPath(), "rb");
+  BOOST_REQUIRE(file);
+  std::vector<uint8_t> contents(expected.size() + 1);
+  size_t size = fread(contents.data(), 1, contents.size(), file);
+  fclose(file);
+  BOOST_REQUIRE_EQUAL(size, expected.size());
+  contents.resize(size);
+  BOOST_CHECK(contents == expected);
+
+  // and a reader skips the padding
+  TFileTransport reader(f.getPath(), true);
+  reader.setChunkSize(CHUNK_SIZE);
+  for (const auto& event : events) {
+    std::vector<uint8_t> buf(event.size());
+    BOOST_REQUIRE_EQUAL(reader.read(buf.data(), static_cast<uint32_t>(buf.size())),
+                        buf.size());
+    BOOST_REQUIRE(buf == event);
+  }
+}
+
 /**************************************************************************
  * General Initialization
  **************************************************************************/
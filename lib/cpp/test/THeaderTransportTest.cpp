@@ -0,0 +1,177 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE THeaderTransportTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/THeaderTransport.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using apache::thrift::transport::THeaderTransport;
+using apache::thrift::transport::TMemoryBuffer;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+
+namespace {
+
+string compressible(size_t size) {
+  string data;
+  while (data.size() < size) {
+    data += "The quick brown fox jumps over the lazy dog. ";
+  }
+  data.resize(size);
+  return data;
+}
+
+string incompressible(size_t size) {
+  string data(size, '\0');
+  uint32_t state = 12345;
+  for (char& c : data) {
+    state = state * 1103515245 + 12345;
+    c = static_cast<char>(state >> 16);
+  }
+  return data;
+}
+
+void writeFrame(THeaderTransport& trans, const string& data) {
+  trans.write(reinterpret_cast<const uint8_t*>(data.data()), static_cast<uint32_t>(data.size()));
+  trans.flush();
+}
+
+string readFrame(THeaderTransport& trans, size_t size) {
+  string data(size, '\0');
+  trans.readAll(reinterpret_cast<uint8_t*>(&data[0]), static_cast<uint32_t>(size));
+  return data;
+}
+
+/*
+ * Writes frames with the transform, reads them back and returns the size of
+ * the frames on the wire.
+ */
+uint32_t roundTrip(uint16_t transId,
+                   const std::vector<string>& frames,
+                   uint32_t minCompressBytes = 0,
+                   const std::vector<uint16_t>& expected = std::vector<uint16_t>(1, 0)) {
+  auto buffer = make_shared<TMemoryBuffer>();
+  THeaderTransport writer(buffer);
+  writer.setTransform(transId);
+  writer.setMinCompressBytes(minCompressBytes);
+  for (const string& frame : frames) {
+    writeFrame(writer, frame);
+  }
+  uint32_t written = buffer->available_read();
+
+  THeaderTransport reader(buffer);
+  for (const string& frame : frames) {
+    BOOST_CHECK(readFrame(reader, frame.size()) == frame);
+    if (expected.size() == 1 && expected[0] == 0) {
+      BOOST_CHECK_EQUAL(reader.getReadTransforms().size(), 1u);
+      BOOST_CHECK_EQUAL(reader.getReadTransforms()[0], transId);
+    } else {
+      BOOST_CHECK(reader.getReadTransforms() == expected);
+    }
+  }
+  return written;
+}
+
+void checkTransform(uint16_t transId) {
+  std::vector<string> frames;
+  frames.push_back(compressible(1000));
+  frames.push_back(compressible(100 * 1000));
+  frames.push_back(compressible(2000));
+  uint32_t size = roundTrip(transId, frames);
+  BOOST_CHECK_LT(size, 10000u);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(THeaderTransportTest)
+
+BOOST_AUTO_TEST_CASE(no_transform) {
+  auto buffer = make_shared<TMemoryBuffer>();
+  THeaderTransport writer(buffer);
+  writeFrame(writer, "hello");
+
+  THeaderTransport reader(buffer);
+  BOOST_CHECK_EQUAL(readFrame(reader, 5), "hello");
+  BOOST_CHECK(reader.getReadTransforms().empty());
+}
+
+BOOST_AUTO_TEST_CASE(zlib_transform) {
+  checkTransform(THeaderTransport::ZLIB_TRANSFORM);
+}
+
+BOOST_AUTO_TEST_CASE(zstd_transform) {
+  if (THeaderTransport::isTransformSupported(THeaderTransport::ZSTD_TRANSFORM)) {
+    checkTransform(THeaderTransport::ZSTD_TRANSFORM);
+  } else {
+    auto buffer = make_shared<TMemoryBuffer>();
+    THeaderTransport writer(buffer);
+    writer.setTransform(THeaderTransport::ZSTD_TRANSFORM);
+    writer.write(reinterpret_cast<const uint8_t*>("x"), 1);
+    BOOST_CHECK_THROW(writer.flush(), apache::thrift::transport::TTransportException);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(lz4_transform) {
+  if (THeaderTransport::isTransformSupported(THeaderTransport::LZ4_TRANSFORM)) {
+    checkTransform(THeaderTransport::LZ4_TRANSFORM);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(small_frames_are_not_compressed) {
+  std::vector<string> frames;
+  frames.push_back(compressible(100));
+  uint32_t size = roundTrip(THeaderTransport::ZLIB_TRANSFORM, frames, 200, std::vector<uint16_t>());
+  BOOST_CHECK_GT(size, 100u);
+
+  frames[0] = compressible(300);
+  roundTrip(THeaderTransport::ZLIB_TRANSFORM, frames, 200);
+}
+
+BOOST_AUTO_TEST_CASE(incompressible_frames_are_sent_as_is) {
+  std::vector<string> frames;
+  frames.push_back(incompressible(10000));
+  frames.push_back(compressible(10000));
+  auto buffer = make_shared<TMemoryBuffer>();
+  THeaderTransport writer(buffer);
+  writer.setTransform(THeaderTransport::ZLIB_TRANSFORM);
+  writeFrame(writer, frames[0]);
+  writeFrame(writer, frames[1]);
+
+  THeaderTransport reader(buffer);
+  BOOST_CHECK(readFrame(reader, frames[0].size()) == frames[0]);
+  BOOST_CHECK(reader.getReadTransforms().empty());
+  BOOST_CHECK(readFrame(reader, frames[1].size()) == frames[1]);
+  BOOST_CHECK_EQUAL(reader.getReadTransforms().size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(many_frames_reuse_contexts) {
+  std::vector<string> frames;
+  for (size_t i = 0; i < 200; ++i) {
+    frames.push_back(compressible(500 + i * 37));
+  }
+  roundTrip(THeaderTransport::ZLIB_TRANSFORM, frames);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
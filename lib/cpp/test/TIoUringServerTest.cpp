@@ -0,0 +1,234 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TIoUringServerTest
+#include <boost/test/unit_test.hpp>
+#include <memory>
+
+#include "thrift/concurrency/Monitor.h"
+#include "thrift/concurrency/Thread.h"
+#include "thrift/concurrency/ThreadFactory.h"
+#include "thrift/protocol/TBinaryProtocol.h"
+#include "thrift/server/TIoUringServer.h"
+#include "thrift/transport/TBufferTransports.h"
+#include "thrift/transport/TNonblockingServerSocket.h"
+#include "thrift/transport/TSocket.h"
+
+#include "gen-cpp/ParentService.h"
+
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::Mutex;
+using apache::thrift::concurrency::Runnable;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadFactory;
+using apache::thrift::server::TIoUringServer;
+using apache::thrift::server::TServerEventHandler;
+using std::make_shared;
+using std::shared_ptr;
+
+using namespace apache::thrift;
+
+struct Handler : public test::ParentServiceIf {
+  void addString(const std::string& s) override {
+    Guard g(mutex_);
+    strings_.push_back(s);
+  }
+  void getStrings(std::vector<std::string>& _return) override {
+    Guard g(mutex_);
+    _return = strings_;
+  }
+  void onewayWait() override { addString("oneway"); }
+  std::vector<std::string> strings_;
+  Mutex mutex_;
+
+  // dummy overrides not used in this test
+  int32_t incrementGeneration() override { return 0; }
+  int32_t getGeneration() override { return 0; }
+  void getDataWait(std::string&, const int32_t) override {}
+  void exceptionWait(const std::string&) override {}
+  void unexpectedExceptionWait(const std::string&) override {}
+};
+
+class Fixture {
+private:
+  struct ListenEventHandler : public TServerEventHandler {
+  public:
+    ListenEventHandler(Mutex* mutex) : listenMonitor_(mutex), ready_(false) {}
+
+    void preServe() override {
+      Guard g(listenMonitor_.mutex());
+      ready_ = true;
+      listenMonitor_.notify();
+    }
+
+    Monitor listenMonitor_;
+    bool ready_;
+  };
+
+  struct Runner : public Runnable {
+    shared_ptr<TIoUringServer> server;
+    shared_ptr<ListenEventHandler> listenHandler;
+    Mutex mutex_;
+
+    Runner() { listenHandler.reset(new ListenEventHandler(&mutex_)); }
+
+    void run() override { server->serve(); }
+
+    void readyBarrier() {
+      // block until server is listening and ready to accept connections
+      Guard g(mutex_);
+      while (!listenHandler->ready_) {
+        listenHandler->listenMonitor_.wait();
+      }
+    }
+  };
+
+protected:
+  Fixture() : handler(make_shared<Handler>()) {
+    socket.reset(new transport::TNonblockingServerSocket(0));
+    socket->setReusePort(true);
+    server.reset(new TIoUringServer(make_shared<test::ParentServiceProcessor>(handler), socket));
+  }
+
+  ~Fixture() {
+    if (server) {
+      server->stop();
+    }
+    if (thread) {
+      thread->join();
+    }
+  }
+
+  int startServer() {
+    shared_ptr<Runner> runner(new Runner);
+    runner->server = server;
+    server->setServerEventHandler(runner->listenHandler);
+
+    shared_ptr<ThreadFactory> threadFactory(new ThreadFactory(false));
+    thread = threadFactory->newThread(runner);
+    thread->start();
+    runner->readyBarrier();
+
+    return server->getListenPort();
+  }
+
+  shared_ptr<test::ParentServiceClient> connect(int port) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", port));
+    socket->open();
+    return make_shared<test::ParentServiceClient>(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+  }
+
+  shared_ptr<Handler> handler;
+  shared_ptr<transport::TNonblockingServerSocket> socket;
+  shared_ptr<TIoUringServer> server;
+
+private:
+  shared_ptr<Thread> thread;
+};
+
+BOOST_AUTO_TEST_SUITE(TIoUringServerTest)
+
+BOOST_FIXTURE_TEST_CASE(get_assigned_port, Fixture) {
+  int port = startServer();
+  BOOST_REQUIRE_NE(port, 0);
+
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+  client->addString("foo");
+  std::vector<std::string> strings;
+  client->getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 1u);
+  BOOST_CHECK_EQUAL(strings[0], "foo");
+}
+
+BOOST_FIXTURE_TEST_CASE(oneway_and_pipelined_requests, Fixture) {
+  int port = startServer();
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+
+  // a oneway call produces no response frame; the next reply must still match
+  client->onewayWait();
+  client->send_addString("a");
+  client->send_addString("b");
+  client->recv_addString();
+  client->recv_addString();
+  std::vector<std::string> strings;
+  client->getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 3u);
+  BOOST_CHECK_EQUAL(strings[0], "oneway");
+  BOOST_CHECK_EQUAL(strings[1], "a");
+  BOOST_CHECK_EQUAL(strings[2], "b");
+}
+
+BOOST_FIXTURE_TEST_CASE(frames_larger_than_buffer, Fixture) {
+  server->setBufferSize(1024);
+  int port = startServer();
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+
+  std::string large(100 * 1024, 'x');
+  client->addString(large);
+  client->addString("small");
+  std::vector<std::string> strings;
+  client->getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 2u);
+  BOOST_CHECK(strings[0] == large);
+  BOOST_CHECK_EQUAL(strings[1], "small");
+}
+
+BOOST_FIXTURE_TEST_CASE(more_connections_than_registered_buffers, Fixture) {
+  server->setNumRegisteredBuffers(2);
+  int port = startServer();
+
+  std::vector<shared_ptr<test::ParentServiceClient> > clients;
+  for (size_t i = 0; i < 8; ++i) {
+    clients.push_back(connect(port));
+  }
+  for (size_t i = 0; i < clients.size(); ++i) {
+    clients[i]->addString("foo");
+  }
+  std::vector<std::string> strings;
+  clients.back()->getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), clients.size());
+  BOOST_CHECK_EQUAL(server->getNumConnections(), clients.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(frame_size_limit, Fixture) {
+  server->setMaxFrameSize(1024);
+  int port = startServer();
+  shared_ptr<test::ParentServiceClient> client = connect(port);
+
+  BOOST_CHECK_THROW(client->addString(std::string(4096, 'x')), transport::TTransportException);
+  BOOST_CHECK(handler->strings_.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(multiple_io_threads, Fixture) {
+  server->setNumIOThreads(4);
+  int port = startServer();
+
+  // each connection lands on whichever IO thread's socket the kernel picks
+  for (size_t i = 1; i <= 16; ++i) {
+    shared_ptr<test::ParentServiceClient> client = connect(port);
+    client->addString("foo");
+    std::vector<std::string> strings;
+    client->getStrings(strings);
+    BOOST_CHECK_EQUAL(strings.size(), i);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,276 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TMappedFileTransportTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TFileTransport.h>
+#include <thrift/transport/TMappedFileTransport.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TEOFException;
+using apache::thrift::transport::TFileTransport;
+using apache::thrift::transport::TMappedFileProcessor;
+using apache::thrift::transport::TMappedFileTransport;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+// small chunks, so that many events need padding in front of them
+const uint32_t CHUNK_SIZE = 1024;
+
+// Event n holds the number n, followed by n % 100 bytes of filling
+std::string makeEvent(uint32_t n) {
+  std::string event(reinterpret_cast<const char*>(&n), sizeof(n));
+  event.append(n % 100, static_cast<char>('a' + n % 26));
+  return event;
+}
+
+struct TMappedFileTransportFixture {
+  TMappedFileTransportFixture() {
+    char path[] = "/tmp/thrift.TMappedFileTransportTest.XXXXXX";
+    int fd = mkstemp(path);
+    BOOST_REQUIRE(fd != -1);
+    close(fd);
+    logPath = path;
+  }
+
+  ~TMappedFileTransportFixture() {
+    unlink(logPath.c_str());
+    unlink(TMappedFileTransport::getIndexPath(logPath).c_str());
+  }
+
+  void writeEvents(uint32_t first, uint32_t end) {
+    TFileTransport writer(logPath);
+    writer.setChunkSize(CHUNK_SIZE);
+    for (uint32_t n = first; n < end; ++n) {
+      std::string event = makeEvent(n);
+      writer.write(reinterpret_cast<const uint8_t*>(event.data()),
+                   static_cast<uint32_t>(event.size()));
+    }
+  }
+
+  off_t indexSize() {
+    struct stat info;
+    if (stat(TMappedFileTransport::getIndexPath(logPath).c_str(), &info) != 0) {
+      return -1;
+    }
+    return info.st_size;
+  }
+
+  std::string logPath;
+};
+
+void checkEvent(TMappedFileTransport& reader, uint32_t n) {
+  std::string expected = makeEvent(n);
+  std::string event(expected.size(), '\0');
+  reader.readAll(reinterpret_cast<uint8_t*>(&event[0]), static_cast<uint32_t>(event.size()));
+  BOOST_REQUIRE_EQUAL(event, expected);
+}
+
+// Adds up the numbers at the start of the events
+class SumProcessor : public TProcessor {
+public:
+  SumProcessor() : events(0), sum(0) {}
+
+  bool process(shared_ptr<TProtocol> in, shared_ptr<TProtocol> out, void* context) override {
+    (void)out;
+    (void)context;
+    uint32_t n;
+    in->getTransport()->readAll(reinterpret_cast<uint8_t*>(&n), sizeof(n));
+    // skip the filling
+    std::string filling(n % 100, '\0');
+    in->getTransport()->readAll(reinterpret_cast<uint8_t*>(&filling[0]), n % 100);
+    ++events;
+    sum += n;
+    return true;
+  }
+
+  std::atomic<uint32_t> events;
+  std::atomic<uint64_t> sum;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(TMappedFileTransportTest, TMappedFileTransportFixture)
+
+BOOST_AUTO_TEST_CASE(reads_events) {
+  writeEvents(0, 1000);
+
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(reader.getNumEvents(), 1000u);
+  for (uint32_t n = 0; n < 1000; ++n) {
+    checkEvent(reader, n);
+  }
+  BOOST_CHECK(!reader.peek());
+  uint8_t buf[1];
+  BOOST_CHECK_THROW(reader.readAll(buf, 1), TEOFException);
+}
+
+BOOST_AUTO_TEST_CASE(reads_events_in_pieces) {
+  writeEvents(0, 10);
+
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  std::string expected = makeEvent(9);
+  reader.seekToEvent(9);
+  // a read never returns more than the rest of the event
+  uint8_t buf[200];
+  BOOST_CHECK_EQUAL(reader.read(buf, 5), 5u);
+  BOOST_CHECK_EQUAL(reader.read(buf + 5, sizeof(buf) - 5), expected.size() - 5);
+  BOOST_CHECK_EQUAL(std::string(reinterpret_cast<char*>(buf), expected.size()), expected);
+  BOOST_CHECK_EQUAL(reader.read(buf, sizeof(buf)), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(seeks_to_events_and_chunks) {
+  writeEvents(0, 1000);
+
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  reader.seekToEvent(567);
+  BOOST_CHECK_EQUAL(reader.getCurEvent(), 567u);
+  checkEvent(reader, 567);
+  reader.seekToEvent(5000);
+  BOOST_CHECK_EQUAL(reader.getCurEvent(), 1000u);
+
+  // compare with where TFileTransport finds the chunks
+  TFileTransport fileReader(logPath, true);
+  fileReader.setChunkSize(CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(reader.getNumChunks(), fileReader.getNumChunks());
+  for (int32_t chunk : {0, 1, 17, -1}) {
+    reader.seekToChunk(chunk);
+    fileReader.seekToChunk(chunk);
+    BOOST_CHECK_EQUAL(reader.getCurChunk(), fileReader.getCurChunk());
+    uint32_t n;
+    fileReader.readAll(reinterpret_cast<uint8_t*>(&n), sizeof(n));
+    checkEvent(reader, n);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(index_is_kept_next_to_the_log) {
+  writeEvents(0, 100);
+  { TMappedFileTransport reader(logPath, CHUNK_SIZE); }
+  off_t size = indexSize();
+  BOOST_CHECK_EQUAL(size, static_cast<off_t>(32 + 100 * sizeof(uint64_t)));
+
+  // the index is extended with the events that were appended
+  writeEvents(100, 150);
+  {
+    TMappedFileTransport reader(logPath, CHUNK_SIZE);
+    BOOST_CHECK_EQUAL(reader.getNumEvents(), 150u);
+    reader.seekToEvent(120);
+    checkEvent(reader, 120);
+  }
+  BOOST_CHECK_EQUAL(indexSize(), static_cast<off_t>(32 + 150 * sizeof(uint64_t)));
+
+  // an index for a different chunk size is rebuilt
+  { TMappedFileTransport reader(logPath, CHUNK_SIZE * 2); }
+  BOOST_CHECK_NE(indexSize(), static_cast<off_t>(32 + 150 * sizeof(uint64_t)));
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(reader.getNumEvents(), 150u);
+  checkEvent(reader, 0);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_index_is_rebuilt) {
+  writeEvents(0, 100);
+  FILE* index = fopen(TMappedFileTransport::getIndexPath(logPath).c_str(), "w");
+  BOOST_REQUIRE(index);
+  fputs("garbage", index);
+  fclose(index);
+
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(reader.getNumEvents(), 100u);
+  checkEvent(reader, 0);
+  BOOST_CHECK_EQUAL(indexSize(), static_cast<off_t>(32 + 100 * sizeof(uint64_t)));
+}
+
+BOOST_AUTO_TEST_CASE(appended_events_are_read) {
+  writeEvents(0, 10);
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+  reader.seekToEnd();
+  BOOST_CHECK(!reader.peek());
+
+  writeEvents(10, 20);
+  for (uint32_t n = 10; n < 20; ++n) {
+    checkEvent(reader, n);
+  }
+  BOOST_CHECK_EQUAL(reader.getNumEvents(), 20u);
+}
+
+BOOST_AUTO_TEST_CASE(shared_data_outlives_the_transport) {
+  writeEvents(0, 10);
+  shared_ptr<const uint8_t> data;
+  {
+    auto reader = make_shared<TMappedFileTransport>(logPath, CHUNK_SIZE);
+    reader->seekToEvent(7);
+    data = reader->borrowShared(4);
+    BOOST_REQUIRE(data);
+    reader->consume(4);
+    uint32_t len = 1;
+    const uint8_t* filling = reader->borrow(nullptr, &len);
+    BOOST_REQUIRE(filling);
+    BOOST_CHECK_EQUAL(len, 7u);
+    BOOST_CHECK_EQUAL(*filling, 'a' + 7);
+  }
+  uint32_t n;
+  memcpy(&n, data.get(), sizeof(n));
+  BOOST_CHECK_EQUAL(n, 7u);
+}
+
+BOOST_AUTO_TEST_CASE(chunk_readers) {
+  writeEvents(0, 1000);
+  TMappedFileTransport reader(logPath, CHUNK_SIZE);
+
+  // the chunk readers see every event once
+  uint64_t events = 0;
+  for (uint32_t chunk = 0; chunk < reader.getNumChunks(); ++chunk) {
+    shared_ptr<TMappedFileTransport> chunkReader = reader.getChunkReader(chunk);
+    uint64_t first = events;
+    while (chunkReader->peek()) {
+      BOOST_CHECK_EQUAL(chunkReader->getCurChunk(), chunk);
+      checkEvent(*chunkReader, static_cast<uint32_t>(events++));
+    }
+    BOOST_CHECK_EQUAL(chunkReader->getNumEvents(), events - first);
+  }
+  BOOST_CHECK_EQUAL(events, 1000u);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_replay) {
+  writeEvents(0, 5000);
+  auto processor = make_shared<SumProcessor>();
+  TMappedFileProcessor fileProcessor(processor,
+                                     make_shared<TBinaryProtocolFactory>(),
+                                     make_shared<TMappedFileTransport>(logPath, CHUNK_SIZE));
+  fileProcessor.process(4);
+  BOOST_CHECK_EQUAL(processor->events, 5000u);
+  BOOST_CHECK_EQUAL(processor->sum, 5000u * 4999u / 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TMetricsEventHandlerTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/processor/TMetricsEventHandler.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using apache::thrift::processor::THistogram;
+using apache::thrift::processor::TMethodMetrics;
+using apache::thrift::processor::TMetricsEventHandler;
+
+namespace {
+
+// Calls the hooks in the order a generated processor does
+void call(TMetricsEventHandler& handler, const char* fn_name, uint32_t requestBytes) {
+  void* ctx = handler.getContext(fn_name, nullptr);
+  handler.preRead(ctx, fn_name);
+  handler.postRead(ctx, fn_name, requestBytes);
+  handler.preWrite(ctx, fn_name);
+  handler.postWrite(ctx, fn_name, requestBytes * 2);
+  handler.freeContext(ctx, fn_name);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(TMetricsEventHandlerTest)
+
+BOOST_AUTO_TEST_CASE(histogram_percentiles) {
+  THistogram histogram;
+  BOOST_CHECK_EQUAL(histogram.getPercentile(50.0), 0u);
+  BOOST_CHECK_EQUAL(histogram.getMean(), 0.0);
+
+  // small values are exact
+  for (uint64_t value = 1; value <= 50; ++value) {
+    histogram.record(value);
+  }
+  BOOST_CHECK_EQUAL(histogram.getCount(), 50u);
+  BOOST_CHECK_EQUAL(histogram.getSum(), 1275u);
+  BOOST_CHECK_EQUAL(histogram.getPercentile(50.0), 25u);
+  BOOST_CHECK_EQUAL(histogram.getPercentile(90.0), 45u);
+  BOOST_CHECK_EQUAL(histogram.getMax(), 50u);
+
+  // larger ones are at most 1/32 too high
+  histogram.reset();
+  BOOST_CHECK_EQUAL(histogram.getCount(), 0u);
+  for (uint64_t value = 1; value <= 100000; ++value) {
+    histogram.record(value * 1000);
+  }
+  for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9, 100.0}) {
+    auto expected = static_cast<uint64_t>(percentile * 1000) * 1000;
+    uint64_t actual = histogram.getPercentile(percentile);
+    BOOST_CHECK_GE(actual, expected);
+    BOOST_CHECK_LE(actual, expected + expected / 32);
+  }
+
+  // even for values beyond the range
+  histogram.reset();
+  histogram.record(uint64_t(1) << 50);
+  BOOST_CHECK_GE(histogram.getMax(), (uint64_t(1) << 40) - 1);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_merge) {
+  THistogram a;
+  THistogram b;
+  for (uint64_t value = 0; value < 1000; ++value) {
+    (value % 2 ? a : b).record(value);
+  }
+  THistogram all(a);
+  all.merge(b);
+  BOOST_CHECK_EQUAL(all.getCount(), 1000u);
+  BOOST_CHECK_EQUAL(all.getSum(), 999u * 1000u / 2);
+  BOOST_CHECK_EQUAL(a.getCount(), 500u);
+  uint64_t median = all.getPercentile(50.0);
+  BOOST_CHECK_GE(median, 499u);
+  BOOST_CHECK_LE(median, 499u + 499u / 32);
+}
+
+BOOST_AUTO_TEST_CASE(records_calls) {
+  TMetricsEventHandler handler;
+  call(handler, "Service.ping", 10);
+  call(handler, "Service.ping", 20);
+  call(handler, "Service.add", 30);
+
+  std::map<std::string, TMethodMetrics> metrics = handler.getMetrics();
+  BOOST_REQUIRE_EQUAL(metrics.size(), 2u);
+  const TMethodMetrics& ping = metrics["Service.ping"];
+  BOOST_CHECK_EQUAL(ping.calls, 2u);
+  BOOST_CHECK_EQUAL(ping.errors, 0u);
+  BOOST_CHECK_EQUAL(ping.readTime.getCount(), 2u);
+  BOOST_CHECK_EQUAL(ping.handlerTime.getCount(), 2u);
+  BOOST_CHECK_EQUAL(ping.writeTime.getCount(), 2u);
+  BOOST_CHECK_EQUAL(ping.requestBytes.getSum(), 30u);
+  BOOST_CHECK_EQUAL(ping.responseBytes.getSum(), 60u);
+  BOOST_CHECK_EQUAL(ping.responseBytes.getMax(), 40u);
+  BOOST_CHECK_EQUAL(metrics["Service.add"].calls, 1u);
+
+  handler.reset();
+  metrics = handler.getMetrics();
+  BOOST_CHECK_EQUAL(metrics["Service.ping"].calls, 0u);
+  BOOST_CHECK_EQUAL(metrics["Service.ping"].readTime.getCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(records_errors_and_oneway_calls) {
+  TMetricsEventHandler handler;
+
+  // an undeclared exception is answered without preWrite() or postWrite()
+  void* ctx = handler.getContext("Service.fail", nullptr);
+  handler.preRead(ctx, "Service.fail");
+  handler.postRead(ctx, "Service.fail", 10);
+  handler.handlerError(ctx, "Service.fail");
+  handler.freeContext(ctx, "Service.fail");
+
+  ctx = handler.getContext("Service.notify", nullptr);
+  handler.preRead(ctx, "Service.notify");
+  handler.postRead(ctx, "Service.notify", 10);
+  handler.asyncComplete(ctx, "Service.notify");
+  handler.freeContext(ctx, "Service.notify");
+
+  std::map<std::string, TMethodMetrics> metrics = handler.getMetrics();
+  BOOST_CHECK_EQUAL(metrics["Service.fail"].calls, 1u);
+  BOOST_CHECK_EQUAL(metrics["Service.fail"].errors, 1u);
+  BOOST_CHECK_EQUAL(metrics["Service.fail"].handlerTime.getCount(), 1u);
+  BOOST_CHECK_EQUAL(metrics["Service.fail"].writeTime.getCount(), 0u);
+  BOOST_CHECK_EQUAL(metrics["Service.notify"].calls, 1u);
+  BOOST_CHECK_EQUAL(metrics["Service.notify"].errors, 0u);
+  BOOST_CHECK_EQUAL(metrics["Service.notify"].handlerTime.getCount(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(merges_threads) {
+  TMetricsEventHandler handler;
+  const int threads = 4;
+  const int calls = 1000;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&handler, i]() {
+      // the name need not be a literal
+      std::string name = i % 2 ? "Service.odd" : "Service.even";
+      for (int j = 0; j < calls; ++j) {
+        call(handler, name.c_str(), static_cast<uint32_t>(j));
+        call(handler, "Service.all", 1);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // the statistics of threads that ended are kept
+  std::map<std::string, TMethodMetrics> metrics = handler.getMetrics();
+  BOOST_CHECK_EQUAL(metrics["Service.all"].calls, static_cast<uint64_t>(threads * calls));
+  BOOST_CHECK_EQUAL(metrics["Service.odd"].calls, static_cast<uint64_t>(threads / 2 * calls));
+  BOOST_CHECK_EQUAL(metrics["Service.even"].requestBytes.getSum(),
+                    static_cast<uint64_t>(threads / 2 * calls * (calls - 1) / 2));
+}
+
+BOOST_AUTO_TEST_CASE(handlers_are_independent) {
+  TMetricsEventHandler first;
+  call(first, "Service.ping", 1);
+  {
+    TMetricsEventHandler second;
+    call(second, "Service.ping", 1);
+    call(second, "Service.ping", 1);
+    BOOST_CHECK_EQUAL(second.getMetrics()["Service.ping"].calls, 2u);
+  }
+  TMetricsEventHandler third;
+  call(third, "Service.ping", 1);
+  BOOST_CHECK_EQUAL(first.getMetrics()["Service.ping"].calls, 1u);
+  BOOST_CHECK_EQUAL(third.getMetrics()["Service.ping"].calls, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(exports_text) {
+  TMetricsEventHandler handler;
+  call(handler, "Service.ping", 10);
+  std::string text = handler.exportText();
+  BOOST_CHECK(text.find("Service.ping calls=1 errors=0\n") != std::string::npos);
+  BOOST_CHECK(text.find("Service.ping request_bytes count=1 mean=10 p50=10 p90=10 p99=10 "
+                        "p999=10 max=10\n")
+              != std::string::npos);
+  for (const char* measure : {" read_ns ", " handler_ns ", " write_ns ", " response_bytes "}) {
+    BOOST_CHECK(text.find(std::string("Service.ping") + measure + "count=1") != std::string::npos);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TMultiplexedProcessorTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/processor/TMultiplexedProcessor.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using apache::thrift::TException;
+using apache::thrift::TMultiplexedProcessor;
+using apache::thrift::TProcessor;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TMemoryBuffer;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+// Remembers the last message it processed
+class RecordingProcessor : public TProcessor {
+public:
+  RecordingProcessor() : calls(0), seqid(0), keepProtocol(false) {}
+
+  bool process(shared_ptr<TProtocol> in, shared_ptr<TProtocol> out, void* context) override {
+    (void)out;
+    (void)context;
+    in->readMessageBegin(name, type, seqid);
+    in->skip(apache::thrift::protocol::T_STRUCT);
+    in->readMessageEnd();
+    ++calls;
+    protocol = in.get();
+    if (keepProtocol) {
+      kept = in;
+    }
+    return true;
+  }
+
+  int calls;
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  TProtocol* protocol;
+  bool keepProtocol;
+  shared_ptr<TProtocol> kept;
+};
+
+struct TMultiplexedProcessorFixture {
+  TMultiplexedProcessorFixture()
+    : input(make_shared<TMemoryBuffer>()),
+      output(make_shared<TMemoryBuffer>()),
+      in(make_shared<TBinaryProtocol>(input)),
+      out(make_shared<TBinaryProtocol>(output)),
+      calculator(make_shared<RecordingProcessor>()),
+      weather(make_shared<RecordingProcessor>()) {
+    processor.registerProcessor("Calculator", calculator);
+    processor.registerProcessor("WeatherReport", weather);
+  }
+
+  // Sends an empty call of name through the multiplexed processor
+  bool call(const std::string& name, int32_t seqid = 1) {
+    in->writeMessageBegin(name, apache::thrift::protocol::T_CALL, seqid);
+    in->writeStructBegin("args");
+    in->writeFieldStop();
+    in->writeStructEnd();
+    in->writeMessageEnd();
+    return processor.process(in, out, nullptr);
+  }
+
+  shared_ptr<TMemoryBuffer> input;
+  shared_ptr<TMemoryBuffer> output;
+  shared_ptr<TProtocol> in;
+  shared_ptr<TProtocol> out;
+  shared_ptr<RecordingProcessor> calculator;
+  shared_ptr<RecordingProcessor> weather;
+  TMultiplexedProcessor processor;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(TMultiplexedProcessorTest, TMultiplexedProcessorFixture)
+
+BOOST_AUTO_TEST_CASE(routes_by_service) {
+  BOOST_CHECK(call("Calculator:add", 7));
+  BOOST_CHECK_EQUAL(calculator->calls, 1);
+  BOOST_CHECK_EQUAL(calculator->name, "add");
+  BOOST_CHECK_EQUAL(calculator->type, apache::thrift::protocol::T_CALL);
+  BOOST_CHECK_EQUAL(calculator->seqid, 7);
+
+  BOOST_CHECK(call("WeatherReport:getTemperature", 8));
+  BOOST_CHECK_EQUAL(weather->name, "getTemperature");
+  BOOST_CHECK_EQUAL(weather->seqid, 8);
+
+  // the method name is everything after the first separator
+  BOOST_CHECK(call("Calculator:add:v2"));
+  BOOST_CHECK_EQUAL(calculator->name, "add:v2");
+  BOOST_CHECK_EQUAL(calculator->calls, 2);
+  BOOST_CHECK_EQUAL(input->available_read(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(finds_many_services) {
+  std::vector<shared_ptr<RecordingProcessor> > services;
+  for (int i = 0; i < 100; ++i) {
+    services.push_back(make_shared<RecordingProcessor>());
+    processor.registerProcessor("Service" + std::to_string(i), services.back());
+  }
+  for (int i = 0; i < 100; ++i) {
+    call("Service" + std::to_string(i) + ":method");
+    BOOST_CHECK_EQUAL(services[i]->calls, 1);
+  }
+  BOOST_CHECK_THROW(call("Service100:method"), TException);
+  BOOST_CHECK_THROW(call("Service:method"), TException);
+
+  // registering a name again replaces its processor
+  processor.registerProcessor("Calculator", weather);
+  call("Calculator:add");
+  BOOST_CHECK_EQUAL(weather->calls, 1);
+  BOOST_CHECK_EQUAL(calculator->calls, 0);
+}
+
+BOOST_AUTO_TEST_CASE(answers_unknown_services_with_an_exception) {
+  BOOST_CHECK_THROW(call("Calendar:add", 9), TException);
+  BOOST_CHECK_EQUAL(input->available_read(), 0u);
+
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  out->readMessageBegin(name, type, seqid);
+  BOOST_CHECK_EQUAL(name, "Calendar:add");
+  BOOST_CHECK_EQUAL(type, apache::thrift::protocol::T_EXCEPTION);
+  BOOST_CHECK_EQUAL(seqid, 9);
+}
+
+BOOST_AUTO_TEST_CASE(forwards_plain_names_to_the_default_processor) {
+  BOOST_CHECK_THROW(call("add"), TException);
+
+  auto plain = make_shared<RecordingProcessor>();
+  processor.registerDefault(plain);
+  BOOST_CHECK(call("add", 3));
+  BOOST_CHECK_EQUAL(plain->name, "add");
+  BOOST_CHECK_EQUAL(plain->seqid, 3);
+  BOOST_CHECK_EQUAL(calculator->calls, 0);
+}
+
+BOOST_AUTO_TEST_CASE(reuses_the_stored_message_protocol) {
+  call("Calculator:add");
+  TProtocol* first = calculator->protocol;
+  call("Calculator:subtract");
+  BOOST_CHECK_EQUAL(calculator->protocol, first);
+
+  // it does not keep the connection's protocol
+  std::weak_ptr<TProtocol> connection = in;
+  in = make_shared<TBinaryProtocol>(input);
+  BOOST_CHECK(connection.expired());
+  call("Calculator:multiply");
+  BOOST_CHECK_EQUAL(calculator->protocol, first);
+  BOOST_CHECK_EQUAL(calculator->name, "multiply");
+
+  // nor one a processor kept
+  calculator->keepProtocol = true;
+  call("Calculator:add");
+  call("Calculator:divide");
+  BOOST_CHECK_NE(calculator->protocol, first);
+  BOOST_CHECK_EQUAL(calculator->name, "divide");
+  std::string name;
+  TMessageType type;
+  int32_t seqid;
+  BOOST_CHECK_EQUAL(calculator->kept->readMessageBegin(name, type, seqid), 0u);
+  BOOST_CHECK_EQUAL(name, "divide");
+  // and the kept protocol still forwards to the connection's protocol
+  BOOST_CHECK_EQUAL(calculator->kept->readStructBegin(name), 0u);
+  calculator->kept.reset();
+  call("Calculator:add");
+  BOOST_CHECK_EQUAL(calculator->name, "add");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,7 +19,17 @@
 
 #define BOOST_TEST_MODULE TNonblockingServerTest
 #include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
 
 #include "thrift/concurrency/Monitor.h"
 #include "thrift/concurrency/Thread.h"
@@ -36,6 +46,7 @@ using apache::thrift::concurrency::Mutex;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadManager;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::server::TServerEventHandler;
 using std::make_shared;
@@ -48,8 +59,10 @@ struct Handler : public test::ParentServiceIf {
   void getStrings(std::vector<std::string>& _return) override { _return = strings_; }
   std::vector<std::string> strings_;
 
+  int32_t incrementGeneration() override { return ++generation_; }
+  std::atomic<int32_t> generation_{0};
+
   // dummy overrides not used in this test
-  int32_t incrementGeneration() override { return 0; }
   int32_t getGeneration() override { return 0; }
   void getDataWait(std::string&, const int32_t) override {}
   void onewayWait() override {}
@@ -75,6 +88,9 @@ private:
 
   struct Runner : public Runnable {
     int port;
+    size_t reusePortThreads;
+    bool useBufferPool;
+    shared_ptr<ThreadManager> threadManager;
     shared_ptr<event_base> userEventBase;
     shared_ptr<TProcessor> processor;
     shared_ptr<server::TNonblockingServer> server;
@@ -84,6 +100,8 @@ private:
 
     Runner() {
       port = 0;
+      reusePortThreads = 0;
+      useBufferPool = false;
       listenHandler.reset(new ListenEventHandler(&mutex_));
     }
 
@@ -106,6 +124,15 @@ private:
         socket.reset(new transport::TNonblockingServerSocket(port));
         server.reset(new server::TNonblockingServer(processor, socket));
         server->setServerEventHandler(listenHandler);
+        if (reusePortThreads) {
+          socket->setReusePort(true);
+          server->setNumIOThreads(reusePortThreads);
+          server->setUseReusePortAcceptors(true);
+        }
+        server->setUseBufferPool(useBufferPool);
+        if (threadManager) {
+          server->setThreadManager(threadManager);
+        }
         if (userEventBase) {
           server->registerEvents(userEventBase.get());
         }
@@ -126,7 +153,7 @@ private:
   };
 
 protected:
-  Fixture() : processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
+  Fixture() : reusePortThreads_(0), useBufferPool_(false), processor(new test::ParentServiceProcessor(make_shared<Handler>())) {}
 
   ~Fixture() {
     if (server) {
@@ -141,11 +168,26 @@ protected:
     userEventBase_.reset(user_event_base, EventDeleter());
   }
 
+  void setReusePortAcceptors(size_t numIOThreads) { reusePortThreads_ = numIOThreads; }
+
+  void setUseBufferPool(bool useBufferPool) { useBufferPool_ = useBufferPool; }
+
+  void setThreadManager(const shared_ptr<ThreadManager>& threadManager) {
+    threadManager_ = threadManager;
+  }
+
+  void setHandler(const shared_ptr<Handler>& handler) {
+    processor.reset(new test::ParentServiceProcessor(handler));
+  }
+
   int startServer(int port) {
     shared_ptr<Runner> runner(new Runner);
     runner->port = port;
     runner->processor = processor;
     runner->userEventBase = userEventBase_;
+    runner->reusePortThreads = reusePortThreads_;
+    runner->useBufferPool = useBufferPool_;
+    runner->threadManager = threadManager_;
 
     shared_ptr<ThreadFactory> threadFactory(
         new ThreadFactory(false));
@@ -169,6 +211,9 @@ protected:
   }
 
 private:
+  size_t reusePortThreads_;
+  bool useBufferPool_;
+  shared_ptr<ThreadManager> threadManager_;
   shared_ptr<event_base> userEventBase_;
   shared_ptr<test::ParentServiceProcessor> processor;
 protected:
@@ -212,4 +257,151 @@ BOOST_FIXTURE_TEST_CASE(provide_event_base, Fixture) {
 #endif
 }
 
+BOOST_FIXTURE_TEST_CASE(notify_counters, Fixture) {
+  shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(2);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  setThreadManager(threadManager);
+  startServer(0);
+
+  // both calls complete on a worker and are handed back to the IO thread
+  BOOST_CHECK(canCommunicate(server->getListenPort()));
+  BOOST_CHECK_GE(server->getNumNotifyCompletions(), 2u);
+  BOOST_CHECK_GE(server->getNumNotifyWakeups(), 1u);
+  BOOST_CHECK_LE(server->getNumNotifyWakeups(), server->getNumNotifyCompletions());
+
+  server->stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(buffer_pool, Fixture) {
+  shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(2);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  setThreadManager(threadManager);
+  setUseBufferPool(true);
+  startServer(0);
+
+  shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost",
+                                                              server->getListenPort()));
+  socket->open();
+  test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+      make_shared<transport::TFramedTransport>(socket)));
+  // requests and responses larger than the default write buffer
+  const std::string large(100000, 'x');
+  client.addString(large);
+  std::vector<std::string> strings;
+  client.getStrings(strings);
+  BOOST_REQUIRE_EQUAL(strings.size(), 1u);
+  BOOST_CHECK(strings[0] == large);
+
+  // once the pool has the buffers a request needs, it does not allocate
+  client.addString("foo");
+  uint64_t allocations = server->getNumBufferPoolAllocations();
+  BOOST_CHECK_GT(allocations, 0u);
+  for (int i = 0; i < 100; ++i) {
+    client.addString("foo");
+  }
+  BOOST_CHECK_EQUAL(server->getNumBufferPoolAllocations(), allocations);
+  client.getStrings(strings);
+  BOOST_CHECK_EQUAL(strings.size(), 102u);
+  BOOST_CHECK_GT(server->getBufferPoolCachedBytes(), 0u);
+
+  server->stop();
+}
+
+#ifndef _WIN32
+BOOST_FIXTURE_TEST_CASE(notify_failure_closes_queued_connections, Fixture) {
+  const int numClients = 3;
+  shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(numClients);
+  threadManager->threadFactory(make_shared<ThreadFactory>());
+  threadManager->start();
+  setThreadManager(threadManager);
+  shared_ptr<Handler> handler = make_shared<Handler>();
+  setHandler(handler);
+  startServer(0);
+  // a first call makes sure the IO thread set up its notification fd
+  BOOST_REQUIRE(canCommunicate(server->getListenPort()));
+  BOOST_REQUIRE_EQUAL(server->getNumIOThreads(), 1u);
+  evutil_socket_t sendFD = server->getIOThread(0)->getNotificationSendFD();
+  BOOST_REQUIRE_GE(sendFD, 0);
+
+  // Swap the send fd for a full pipe, so the first finished task blocks while
+  // it writes the wakeup and the others queue behind it.  The original fd is
+  // kept open, so the IO thread still waits on it.
+  signal(SIGPIPE, SIG_IGN);
+  int pipeFDs[2];
+  BOOST_REQUIRE_EQUAL(pipe(pipeFDs), 0);
+  BOOST_REQUIRE_EQUAL(fcntl(pipeFDs[1], F_SETFL, O_NONBLOCK), 0);
+  char fill[4096] = {0};
+  while (write(pipeFDs[1], fill, sizeof(fill)) > 0) {
+  }
+  BOOST_REQUIRE_EQUAL(fcntl(pipeFDs[1], F_SETFL, 0), 0);
+  int savedFD = dup(sendFD);
+  BOOST_REQUIRE_GE(savedFD, 0);
+  BOOST_REQUIRE_EQUAL(dup2(pipeFDs[1], sendFD), sendFD);
+
+  std::atomic<int> closed(0);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < numClients; ++i) {
+    clients.emplace_back([&] {
+      shared_ptr<transport::TSocket> socket(
+          new transport::TSocket("localhost", server->getListenPort()));
+      socket->setRecvTimeout(10000);
+      socket->open();
+      test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+          make_shared<transport::TFramedTransport>(socket)));
+      try {
+        client.incrementGeneration();
+      } catch (const transport::TTransportException& tte) {
+        if (tte.getType() != transport::TTransportException::TIMED_OUT) {
+          ++closed;
+        }
+      }
+    });
+  }
+
+  // wait for the calls, and a little more for their tasks to notify
+  while (handler->generation_ < numClients) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // fail the blocked write: every queued connection has to be closed
+  ::close(pipeFDs[0]);
+  for (auto& client : clients) {
+    client.join();
+  }
+  BOOST_CHECK_EQUAL(closed, numClients);
+
+  BOOST_REQUIRE_EQUAL(dup2(savedFD, sendFD), sendFD);
+  ::close(savedFD);
+  ::close(pipeFDs[1]);
+  signal(SIGPIPE, SIG_DFL);
+  server->stop();
+}
+#endif
+
+#ifdef SO_REUSEPORT
+BOOST_FIXTURE_TEST_CASE(reuse_port_acceptors, Fixture) {
+  setReusePortAcceptors(4);
+  startServer(0);
+  int assigned_port = server->getListenPort();
+  BOOST_REQUIRE_NE(assigned_port, 0);
+
+  // each connection lands on whichever IO thread's socket the kernel picks
+  for (size_t i = 1; i <= 16; ++i) {
+    shared_ptr<transport::TSocket> socket(new transport::TSocket("localhost", assigned_port));
+    socket->open();
+    test::ParentServiceClient client(make_shared<protocol::TBinaryProtocol>(
+        make_shared<transport::TFramedTransport>(socket)));
+    client.addString("foo");
+    std::vector<std::string> strings;
+    client.getStrings(strings);
+    BOOST_CHECK_EQUAL(strings.size(), i);
+  }
+
+  server->stop();
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
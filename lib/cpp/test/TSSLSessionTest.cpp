@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TSSLSessionTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/transport/TSSLSocket.h>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SSLTestHelpers.h"
+
+using apache::thrift::transport::TSSLException;
+using apache::thrift::transport::TSSLSocket;
+using apache::thrift::transport::TSSLSocketFactory;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+struct TSSLSessionFixture {
+  TSSLSessionFixture() {
+    // OpenSSL writes without MSG_NOSIGNAL
+    signal(SIGPIPE, SIG_IGN);
+    makeTestCertificate(certificate, privateKey);
+  }
+
+  shared_ptr<TSSLSocketFactory> createServerFactory() {
+    auto factory = make_shared<TSSLSocketFactory>();
+    factory->server(true);
+    factory->loadCertificateFromBuffer(certificate.c_str());
+    factory->loadPrivateKeyFromBuffer(privateKey.c_str());
+    // authenticated clients need a session id context to resume sessions
+    factory->authenticate(true);
+    factory->loadTrustedCertificatesFromBuffer(certificate.c_str());
+    return factory;
+  }
+
+  shared_ptr<TSSLSocketFactory> createClientFactory() {
+    auto factory = make_shared<TSSLSocketFactory>();
+    factory->loadCertificateFromBuffer(certificate.c_str());
+    factory->loadPrivateKeyFromBuffer(privateKey.c_str());
+    factory->loadTrustedCertificatesFromBuffer(certificate.c_str());
+    return factory;
+  }
+
+  // Sends a message and checks the checksum the server answers with
+  void roundTrip(TSSLSocket& socket, const std::vector<uint8_t>& message) {
+    uint32_t size = static_cast<uint32_t>(message.size());
+    socket.write(reinterpret_cast<uint8_t*>(&size), sizeof(size));
+    socket.write(message.data(), size);
+    uint32_t sum;
+    socket.readAll(reinterpret_cast<uint8_t*>(&sum), sizeof(sum));
+    BOOST_CHECK_EQUAL(sum, checksum(message.data(), message.size()));
+  }
+
+  // Connects, sends a message and tells whether the session was resumed
+  bool connect(TSSLSocketFactory& factory, int port) {
+    shared_ptr<TSSLSocket> socket = factory.createSocket("localhost", port);
+    socket->open();
+    roundTrip(*socket, std::vector<uint8_t>(100, 'x'));
+    bool reused = socket->isSessionReused();
+    socket->close();
+    return reused;
+  }
+
+  std::string certificate;
+  std::string privateKey;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(TSSLSessionTest, TSSLSessionFixture)
+
+BOOST_AUTO_TEST_CASE(sessions_are_resumed) {
+  shared_ptr<TSSLSocketFactory> serverFactory = createServerFactory();
+  serverFactory->enableSessionCache(true);
+  TestSSLServer server(serverFactory);
+  shared_ptr<TSSLSocketFactory> clientFactory = createClientFactory();
+  clientFactory->enableSessionCache(true);
+
+  BOOST_CHECK(!connect(*clientFactory, server.getPort()));
+  BOOST_CHECK(connect(*clientFactory, server.getPort()));
+  BOOST_CHECK(connect(*clientFactory, server.getPort()));
+  BOOST_CHECK_EQUAL(server.connections_, 3);
+  BOOST_CHECK_EQUAL(server.resumedConnections_, 2);
+}
+
+BOOST_AUTO_TEST_CASE(sessions_are_not_resumed_without_cache) {
+  shared_ptr<TSSLSocketFactory> serverFactory = createServerFactory();
+  serverFactory->enableSessionCache(true);
+  TestSSLServer server(serverFactory);
+  shared_ptr<TSSLSocketFactory> clientFactory = createClientFactory();
+
+  BOOST_CHECK(!connect(*clientFactory, server.getPort()));
+  BOOST_CHECK(!connect(*clientFactory, server.getPort()));
+
+  // nor when the server does not cache them
+  serverFactory->enableSessionCache(false);
+  clientFactory->enableSessionCache(true);
+  BOOST_CHECK(!connect(*clientFactory, server.getPort()));
+  BOOST_CHECK(!connect(*clientFactory, server.getPort()));
+  BOOST_CHECK_EQUAL(server.resumedConnections_, 0);
+}
+
+BOOST_AUTO_TEST_CASE(sends_files) {
+  shared_ptr<TSSLSocketFactory> serverFactory = createServerFactory();
+  shared_ptr<TSSLSocketFactory> clientFactory = createClientFactory();
+  try {
+    serverFactory->enableKernelTLS(true);
+    clientFactory->enableKernelTLS(true);
+  } catch (const TSSLException& e) {
+    BOOST_TEST_MESSAGE(e.what());
+  }
+  TestSSLServer server(serverFactory);
+
+  std::vector<uint8_t> contents(1024 * 1024 + 17);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<uint8_t>(i * 7);
+  }
+  char path[] = "/tmp/thrift.TSSLSessionTest.XXXXXX";
+  int fd = mkstemp(path);
+  BOOST_REQUIRE(fd != -1);
+  BOOST_REQUIRE_EQUAL(::write(fd, contents.data(), contents.size()),
+                      static_cast<ssize_t>(contents.size()));
+
+  shared_ptr<TSSLSocket> socket = clientFactory->createSocket("localhost", server.getPort());
+  socket->open();
+  roundTrip(*socket, contents);
+  BOOST_TEST_MESSAGE("kernel TLS send: " << socket->isKernelTLSSend()
+                     << ", receive: " << server.kernelTLSConnections_);
+
+  // the whole file, and a part of it that does not start at the beginning
+  for (off_t offset : {static_cast<off_t>(0), static_cast<off_t>(1000)}) {
+    uint32_t size = static_cast<uint32_t>(contents.size() - offset);
+    socket->write(reinterpret_cast<uint8_t*>(&size), sizeof(size));
+    socket->sendFile(fd, offset, size);
+    uint32_t sum;
+    socket->readAll(reinterpret_cast<uint8_t*>(&sum), sizeof(sum));
+    BOOST_CHECK_EQUAL(sum, checksum(contents.data() + offset, size));
+  }
+  socket->close();
+  close(fd);
+  unlink(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TSocketPoolTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocketPool.h>
+
+#include <memory>
+#include <vector>
+
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocketPool;
+using apache::thrift::transport::TSocketPoolServer;
+using apache::thrift::transport::TTransport;
+using apache::thrift::transport::TTransportException;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+// Two servers that only differ in what the pool knows about them
+struct TSocketPoolFixture {
+  TSocketPoolFixture() {
+    for (int i = 0; i < 2; ++i) {
+      auto serverSocket = make_shared<TServerSocket>("localhost", 0);
+      serverSocket->setAcceptTimeout(1000);
+      serverSocket->listen();
+      serverSockets.push_back(serverSocket);
+      servers.push_back(make_shared<TSocketPoolServer>("localhost", serverSocket->getPort()));
+    }
+  }
+
+  ~TSocketPoolFixture() {
+    for (auto& serverSocket : serverSockets) {
+      serverSocket->close();
+    }
+  }
+
+  std::vector<shared_ptr<TServerSocket> > serverSockets;
+  std::vector<shared_ptr<TSocketPoolServer> > servers;
+};
+
+void sendRequest(TSocketPool& pool) {
+  const uint8_t request[] = "ping";
+  pool.write(request, sizeof(request));
+  pool.flush();
+}
+
+void answerRequest(const shared_ptr<TTransport>& connection) {
+  uint8_t request[5];
+  connection->readAll(request, sizeof(request));
+  connection->write(request, sizeof(request));
+  connection->flush();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(TSocketPoolTest, TSocketPoolFixture)
+
+BOOST_AUTO_TEST_CASE(prefers_the_faster_server) {
+  servers[0]->addLatencySample(100000);
+  servers[1]->addLatencySample(100);
+  // with two servers, both are compared on every open
+  for (int i = 0; i < 20; ++i) {
+    TSocketPool pool(servers);
+    pool.open();
+    BOOST_CHECK_EQUAL(pool.getPort(), servers[1]->port_);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(avoids_busy_servers) {
+  servers[0]->addLatencySample(300);
+  servers[1]->addLatencySample(100);
+  servers[1]->outstanding_ = 5;
+  TSocketPool pool(servers);
+  pool.open();
+  BOOST_CHECK_EQUAL(pool.getPort(), servers[0]->port_);
+  servers[1]->outstanding_ = 0;
+}
+
+BOOST_AUTO_TEST_CASE(tracks_requests) {
+  TSocketPool pool(servers[0]->host_, servers[0]->port_);
+  pool.open();
+  shared_ptr<TSocketPoolServer> server;
+  {
+    std::vector<shared_ptr<TSocketPoolServer> > poolServers;
+    pool.getServers(poolServers);
+    server = poolServers[0];
+  }
+  double connectLatency = server->getLatencyUs();
+  BOOST_CHECK_GT(connectLatency, 0);
+
+  sendRequest(pool);
+  BOOST_CHECK_EQUAL(server->outstanding_, 1);
+  // the server socket only accepts connections that sent something
+  shared_ptr<TTransport> connection = serverSockets[0]->accept();
+  answerRequest(connection);
+  uint8_t response[5];
+  pool.readAll(response, sizeof(response));
+  BOOST_CHECK_EQUAL(server->outstanding_, 0);
+  BOOST_CHECK_NE(server->getLatencyUs(), connectLatency);
+
+  // closing the pool forgets the unanswered request
+  sendRequest(pool);
+  BOOST_CHECK_EQUAL(server->outstanding_, 1);
+  pool.close();
+  BOOST_CHECK_EQUAL(server->outstanding_, 0);
+}
+
+BOOST_AUTO_TEST_CASE(reuses_idle_connections) {
+  TSocketPool pool(servers[0]->host_, servers[0]->port_);
+  pool.setMaxIdleConnections(1);
+  pool.open();
+  sendRequest(pool);
+  shared_ptr<TTransport> connection = serverSockets[0]->accept();
+  answerRequest(connection);
+  uint8_t response[5];
+  pool.readAll(response, sizeof(response));
+  THRIFT_SOCKET socket = pool.getSocketFD();
+  pool.close();
+  BOOST_CHECK(!pool.isOpen());
+
+  pool.open();
+  BOOST_CHECK_EQUAL(pool.getSocketFD(), socket);
+  sendRequest(pool);
+  answerRequest(connection);
+  pool.readAll(response, sizeof(response));
+  pool.close();
+
+  // a connection the server closed in the meantime is not reused
+  connection->close();
+  pool.open();
+  sendRequest(pool);
+  BOOST_CHECK_NO_THROW(connection = serverSockets[0]->accept());
+  answerRequest(connection);
+  pool.readAll(response, sizeof(response));
+}
+
+BOOST_AUTO_TEST_CASE(fails_when_all_servers_are_down) {
+  std::vector<shared_ptr<TSocketPoolServer> > downServers;
+  for (auto& serverSocket : serverSockets) {
+    downServers.push_back(make_shared<TSocketPoolServer>("localhost", serverSocket->getPort()));
+    serverSocket->close();
+  }
+  TSocketPool pool(downServers);
+  BOOST_CHECK_THROW(pool.open(), TTransportException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,356 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#define BOOST_TEST_MODULE TWebSocketServerTest
+#include <boost/test/unit_test.hpp>
+
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TVirtualTransport.h>
+#include <thrift/transport/TWebSocketDeflate.h>
+#include <thrift/transport/TWebSocketServer.h>
+
+#include <zlib.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TVirtualTransport;
+using apache::thrift::transport::TWebSocketCompression;
+using apache::thrift::transport::TWebSocketDeflate;
+using apache::thrift::transport::TWebSocketServer;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+// Hands the server what the client sent, a few bytes at a time, and keeps
+// what the server answers
+class Connection : public TVirtualTransport<Connection> {
+public:
+  Connection() : open_(true) {}
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    return input.read(buf, (std::min)(len, static_cast<uint32_t>(1000)));
+  }
+
+  void write(const uint8_t* buf, uint32_t len) { output.write(buf, len); }
+
+  bool isOpen() const override { return open_; }
+
+  void close() override { open_ = false; }
+
+  TMemoryBuffer input;
+  TMemoryBuffer output;
+
+private:
+  bool open_;
+};
+
+struct Frame {
+  uint8_t opcode;
+  bool compressed;
+  std::string payload;
+};
+
+std::string makeMessage(uint32_t size) {
+  std::string message(size, '\0');
+  for (uint32_t i = 0; i < size; ++i) {
+    message[i] = static_cast<char>(i * 31 + i / 7);
+  }
+  return message;
+}
+
+std::string deflateMessage(z_stream& stream, const std::string& message) {
+  std::string out(message.size() + 64, '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.data()));
+  stream.avail_in = static_cast<uInt>(message.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  BOOST_REQUIRE_EQUAL(deflate(&stream, Z_SYNC_FLUSH), Z_OK);
+  out.resize(out.size() - stream.avail_out);
+  BOOST_REQUIRE_EQUAL(out.substr(out.size() - 4), std::string("\0\0\xff\xff", 4));
+  return out.substr(0, out.size() - 4);
+}
+
+std::string inflateMessage(z_stream& stream, std::string payload) {
+  payload.append("\0\0\xff\xff", 4);
+  std::string out(1024 * 1024, '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(&payload[0]);
+  stream.avail_in = static_cast<uInt>(payload.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  BOOST_REQUIRE_EQUAL(inflate(&stream, Z_SYNC_FLUSH), Z_OK);
+  out.resize(out.size() - stream.avail_out);
+  return out;
+}
+
+struct TWebSocketServerFixture {
+  TWebSocketServerFixture()
+    : connection(make_shared<Connection>()),
+      server(make_shared<TWebSocketServer<true> >(connection)) {}
+
+  // Returns the headers of the answer
+  std::string handshake(const std::string& extensions = "") {
+    std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+                          "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n";
+    if (!extensions.empty()) {
+      request += "Sec-WebSocket-Extensions: " + extensions + "\r\n";
+    }
+    request += "\r\n";
+    connection->input.write(reinterpret_cast<const uint8_t*>(request.data()),
+                            static_cast<uint32_t>(request.size()));
+    // there are no frames yet
+    uint8_t buf[1];
+    BOOST_CHECK_EQUAL(server->read(buf, 1), 0u);
+    std::string answer = connection->output.getBufferAsString();
+    connection->output.resetBuffer();
+    BOOST_REQUIRE_EQUAL(answer.substr(0, 12), "HTTP/1.1 101");
+    return answer;
+  }
+
+  void sendFrame(uint8_t opcode, const std::string& payload, bool fin = true, bool compressed = false) {
+    std::string frame;
+    frame += static_cast<char>((fin ? 0x80 : 0) | (compressed ? 0x40 : 0) | opcode);
+    uint64_t length = payload.size();
+    if (length < 126) {
+      frame += static_cast<char>(0x80 | length);
+    } else if (length < 65536) {
+      frame += static_cast<char>(0x80 | 126);
+      frame += static_cast<char>(length >> 8);
+      frame += static_cast<char>(length);
+    } else {
+      frame += static_cast<char>(0x80 | 127);
+      for (int shift = 56; shift >= 0; shift -= 8) {
+        frame += static_cast<char>(length >> shift);
+      }
+    }
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    frame.append(mask, 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+      frame += static_cast<char>(payload[i] ^ mask[i % 4]);
+    }
+    connection->input.write(reinterpret_cast<const uint8_t*>(frame.data()),
+                            static_cast<uint32_t>(frame.size()));
+  }
+
+  std::string receive(uint32_t size, uint32_t piece) {
+    std::string message(size, '\0');
+    for (uint32_t have = 0; have < size; have += piece) {
+      uint32_t len = (std::min)(piece, size - have);
+      BOOST_REQUIRE_EQUAL(server->readAll(reinterpret_cast<uint8_t*>(&message[have]), len), len);
+    }
+    return message;
+  }
+
+  // The frames the server sent
+  std::vector<Frame> sentFrames() {
+    std::string output = connection->output.getBufferAsString();
+    connection->output.resetBuffer();
+    std::vector<Frame> frames;
+    size_t pos = 0;
+    while (pos < output.size()) {
+      Frame frame;
+      uint8_t first = static_cast<uint8_t>(output[pos]);
+      BOOST_REQUIRE(first & 0x80);
+      frame.opcode = first & 0x0F;
+      frame.compressed = (first & 0x40) != 0;
+      uint8_t second = static_cast<uint8_t>(output[pos + 1]);
+      BOOST_REQUIRE_EQUAL(second & 0x80, 0);
+      uint64_t length = second;
+      pos += 2;
+      int extended = length == 126 ? 2 : length == 127 ? 8 : 0;
+      if (extended > 0) {
+        length = 0;
+        for (int i = 0; i < extended; ++i) {
+          length = (length << 8) | static_cast<uint8_t>(output[pos++]);
+        }
+        // the shortest encoding
+        BOOST_CHECK_GE(length, extended == 2 ? 126u : 65536u);
+      }
+      BOOST_REQUIRE_LE(pos + length, output.size());
+      frame.payload = output.substr(pos, length);
+      pos += length;
+      frames.push_back(frame);
+    }
+    return frames;
+  }
+
+  void send(const std::string& message) {
+    server->write(reinterpret_cast<const uint8_t*>(message.data()),
+                  static_cast<uint32_t>(message.size()));
+    server->flush();
+  }
+
+  shared_ptr<Connection> connection;
+  shared_ptr<TWebSocketServer<true> > server;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(TWebSocketServerTest, TWebSocketServerFixture)
+
+BOOST_AUTO_TEST_CASE(handshake_is_answered) {
+  std::string answer = handshake();
+  BOOST_CHECK(answer.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n")
+              != std::string::npos);
+  BOOST_CHECK(answer.find("Sec-WebSocket-Extensions") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(reads_frames_in_pieces) {
+  handshake();
+  std::string message = makeMessage(100000);
+  // a message in three frames, with a ping in the middle
+  sendFrame(0x2, message.substr(0, 3), false);
+  sendFrame(0x0, message.substr(3, 70000), false);
+  sendFrame(0x9, "ping");
+  sendFrame(0x0, message.substr(70003), true);
+  // an empty frame is skipped
+  sendFrame(0x2, "");
+  sendFrame(0x2, message.substr(0, 200));
+
+  // pieces that don't line up with the frames nor the mask
+  BOOST_CHECK(receive(100000, 13) == message);
+  BOOST_CHECK(receive(200, 200) == message.substr(0, 200));
+
+  std::vector<Frame> frames = sentFrames();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1u);
+  BOOST_CHECK_EQUAL(frames[0].opcode, 0xA);
+  BOOST_CHECK_EQUAL(frames[0].payload, "ping");
+
+  // a partial read stops at the end of the data that arrived
+  sendFrame(0x2, "abc");
+  uint8_t buf[10];
+  BOOST_CHECK_EQUAL(server->read(buf, sizeof(buf)), 3u);
+  BOOST_CHECK_EQUAL(server->read(buf, sizeof(buf)), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(writes_frames) {
+  handshake();
+  for (uint32_t size : {0u, 5u, 125u, 126u, 65535u, 65536u, 100000u}) {
+    std::string message = makeMessage(size);
+    // in two writes
+    server->write(reinterpret_cast<const uint8_t*>(message.data()), size / 2);
+    send(message.substr(size / 2));
+    std::vector<Frame> frames = sentFrames();
+    BOOST_REQUIRE_EQUAL(frames.size(), 1u);
+    BOOST_CHECK_EQUAL(frames[0].opcode, 0x2);
+    BOOST_CHECK(!frames[0].compressed);
+    BOOST_CHECK(frames[0].payload == message);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(closes_on_protocol_errors) {
+  handshake();
+  // compressed, but the extension was not negotiated
+  sendFrame(0x2, "abc", true, true);
+  uint8_t buf[3];
+  BOOST_CHECK_THROW(server->readAll(buf, sizeof(buf)), TTransportException);
+  std::vector<Frame> frames = sentFrames();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1u);
+  BOOST_CHECK_EQUAL(frames[0].opcode, 0x8);
+  BOOST_CHECK_EQUAL(frames[0].payload, std::string("\x03\xea", 2));
+  BOOST_CHECK(!connection->isOpen());
+}
+
+BOOST_AUTO_TEST_CASE(negotiates_deflate) {
+  TWebSocketDeflate deflate;
+  std::string response;
+  BOOST_CHECK(deflate.accept("permessage-deflate; client_max_window_bits", response));
+  BOOST_CHECK_EQUAL(response, "permessage-deflate");
+  BOOST_CHECK(deflate.accept("x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=\"10\";"
+                             " server_no_context_takeover",
+                             response));
+  BOOST_CHECK_EQUAL(response,
+                    "permessage-deflate; server_no_context_takeover; server_max_window_bits=10");
+
+  // the first acceptable offer
+  BOOST_CHECK(deflate.accept("permessage-deflate; unknown, permessage-deflate; server_max_window_bits=8,"
+                             " permessage-deflate; client_max_window_bits=9",
+                             response));
+  BOOST_CHECK_EQUAL(response, "permessage-deflate");
+
+  BOOST_CHECK(!deflate.accept("permessage-deflate; server_no_context_takeover; server_no_context_takeover",
+                              response));
+  BOOST_CHECK(!deflate.accept("permessage-deflate; server_max_window_bits", response));
+  BOOST_CHECK(!deflate.accept("x-webkit-deflate-frame", response));
+}
+
+BOOST_AUTO_TEST_CASE(compresses_messages) {
+  server->setCompression(make_shared<TWebSocketDeflate>());
+  std::string answer = handshake("permessage-deflate; client_max_window_bits");
+  BOOST_CHECK(answer.find("Sec-WebSocket-Extensions: permessage-deflate\r\n") != std::string::npos);
+
+  z_stream clientDeflate;
+  memset(&clientDeflate, 0, sizeof(clientDeflate));
+  BOOST_REQUIRE_EQUAL(deflateInit2(&clientDeflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                                   Z_DEFAULT_STRATEGY),
+                      Z_OK);
+  z_stream clientInflate;
+  memset(&clientInflate, 0, sizeof(clientInflate));
+  BOOST_REQUIRE_EQUAL(inflateInit2(&clientInflate, -15), Z_OK);
+
+  for (int i = 0; i < 3; ++i) {
+    std::string message = makeMessage(50000 + i);
+    // a compressed message in two frames, then an uncompressed one
+    std::string payload = deflateMessage(clientDeflate, message);
+    sendFrame(0x2, payload.substr(0, 100), false, true);
+    sendFrame(0x0, payload.substr(100), true);
+    sendFrame(0x2, "plain");
+    BOOST_CHECK(receive(50000 + i, 1000) == message);
+    BOOST_CHECK_EQUAL(receive(5, 5), "plain");
+
+    // short messages are not compressed
+    send(message);
+    send("short");
+    std::vector<Frame> frames = sentFrames();
+    BOOST_REQUIRE_EQUAL(frames.size(), 2u);
+    BOOST_CHECK(frames[0].compressed);
+    BOOST_CHECK_LT(frames[0].payload.size(), message.size());
+    BOOST_CHECK(inflateMessage(clientInflate, frames[0].payload) == message);
+    BOOST_CHECK(!frames[1].compressed);
+    BOOST_CHECK_EQUAL(frames[1].payload, "short");
+  }
+  deflateEnd(&clientDeflate);
+  inflateEnd(&clientInflate);
+}
+
+BOOST_AUTO_TEST_CASE(limits_decompressed_messages) {
+  server->setConfiguration(make_shared<apache::thrift::TConfiguration>(10000));
+  server->setCompression(make_shared<TWebSocketDeflate>());
+  handshake("permessage-deflate");
+
+  z_stream clientDeflate;
+  memset(&clientDeflate, 0, sizeof(clientDeflate));
+  BOOST_REQUIRE_EQUAL(deflateInit2(&clientDeflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                                   Z_DEFAULT_STRATEGY),
+                      Z_OK);
+  sendFrame(0x2, deflateMessage(clientDeflate, std::string(100000, 'x')), true, true);
+  deflateEnd(&clientDeflate);
+  uint8_t buf[10];
+  BOOST_CHECK_THROW(server->readAll(buf, sizeof(buf)), TTransportException);
+  std::vector<Frame> frames = sentFrames();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1u);
+  BOOST_CHECK_EQUAL(frames[0].payload, std::string("\x03\xf1", 2));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Printing benchmarks, for a struct like a logged request:
+ *
+ *   numbers/to_string, numbers/appendTo  a list of numbers, with an
+ *                                        ostringstream per number or
+ *                                        appended to a reused buffer
+ *   struct/to_string, struct/appendTo    the whole struct, with operator<<
+ *                                        or appended to a reused buffer
+ *   struct/appendTo_limited              the first 200 bytes of it
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <thrift/TToString.h>
+
+#include "gen-cpp/ThriftTest_types.h"
+
+using apache::thrift::TToStringLimit;
+using apache::thrift::appendTo;
+using apache::thrift::to_string;
+using namespace thrift::test;
+
+namespace {
+
+Insanity makeRequest() {
+  Insanity request;
+  for (int i = 1; i <= 8; ++i) {
+    request.userMap[static_cast<Numberz::type>(i)] = 1000000007LL * i;
+  }
+  for (int i = 0; i < 20; ++i) {
+    Xtruct xtruct;
+    xtruct.__set_string_thing("user-" + to_string(i));
+    xtruct.__set_byte_thing('x');
+    xtruct.__set_i32_thing(-i * 1234);
+    xtruct.__set_i64_thing(static_cast<int64_t>(i) << 40);
+    request.xtructs.push_back(xtruct);
+  }
+  return request;
+}
+
+std::vector<int64_t> makeNumbers() {
+  std::vector<int64_t> numbers;
+  for (int64_t i = 0; i < 100; ++i) {
+    numbers.push_back(i * i * i * 7919);
+  }
+  return numbers;
+}
+
+void numbersToString(benchmark::State& state) {
+  std::vector<int64_t> numbers = makeNumbers();
+  for (auto _ : state) {
+    std::string out = to_string(numbers);
+    benchmark::DoNotOptimize(out);
+  }
+  state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+
+void numbersAppendTo(benchmark::State& state) {
+  std::vector<int64_t> numbers = makeNumbers();
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    appendTo(out, numbers);
+    benchmark::DoNotOptimize(out);
+  }
+  state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+
+void structToString(benchmark::State& state) {
+  Insanity request = makeRequest();
+  for (auto _ : state) {
+    std::string out = to_string(request);
+    benchmark::DoNotOptimize(out);
+  }
+}
+
+void structAppendTo(benchmark::State& state) {
+  Insanity request = makeRequest();
+  TToStringLimit limit(state.range(0) != 0 ? state.range(0) : std::string::npos);
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    request.appendTo(out, limit);
+    benchmark::DoNotOptimize(out);
+  }
+  state.counters["bytes"] = static_cast<double>(out.size());
+}
+}
+
+BENCHMARK(numbersToString)->Name("numbers/to_string");
+BENCHMARK(numbersAppendTo)->Name("numbers/appendTo");
+BENCHMARK(structToString)->Name("struct/to_string");
+BENCHMARK(structAppendTo)->Name("struct/appendTo")->Arg(0);
+BENCHMARK(structAppendTo)->Name("struct/appendTo_limited")->Arg(200);
+
+BENCHMARK_MAIN();
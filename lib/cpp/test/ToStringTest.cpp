@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <map>
 #include <locale>
@@ -29,6 +31,8 @@
 #include "gen-cpp/OptionalRequiredTest_types.h"
 #include "gen-cpp/DebugProtoTest_types.h"
 
+using apache::thrift::TToStringLimit;
+using apache::thrift::appendTo;
 using apache::thrift::to_string;
 
 BOOST_AUTO_TEST_SUITE(ToStringTest)
@@ -160,4 +164,95 @@ BOOST_AUTO_TEST_CASE(generated_nested_list_object_to_string) {
                     "ListBonks(bonk=[Bonk(message=a, type=0), Bonk(message=b, type=0)])");
 }
 
+BOOST_AUTO_TEST_CASE(base_types_append_to) {
+  std::string out;
+  appendTo(out, 10);
+  appendTo(out, -7);
+  appendTo(out, std::numeric_limits<int64_t>::min());
+  appendTo(out, std::numeric_limits<uint64_t>::max());
+  BOOST_CHECK_EQUAL(out, "10-7-922337203685477580818446744073709551615");
+
+  out.clear();
+  appendTo(out, true);
+  appendTo(out, 'a');
+  appendTo(out, "bc");
+  appendTo(out, std::string("de"));
+  BOOST_CHECK_EQUAL(out, "1abcde");
+
+  for (double value : {1.2, -0.1, 1e300, 1.0 / 3, 0.0}) {
+    out.clear();
+    appendTo(out, value);
+    BOOST_CHECK_EQUAL(out, to_string(value));
+  }
+  out.clear();
+  appendTo(out, 1.1f);
+  BOOST_CHECK_EQUAL(out, to_string(1.1f));
+}
+
+BOOST_AUTO_TEST_CASE(containers_append_to) {
+  std::map<int, std::vector<std::string> > m;
+  m[1].push_back("a");
+  m[1].push_back("b");
+  m[2];
+  std::set<short> s;
+  s.insert(3);
+  s.insert(-4);
+
+  std::string out;
+  appendTo(out, m);
+  BOOST_CHECK_EQUAL(out, to_string(m));
+  out.clear();
+  appendTo(out, s);
+  BOOST_CHECK_EQUAL(out, to_string(s));
+}
+
+BOOST_AUTO_TEST_CASE(generated_object_append_to) {
+  thrift::test::Insanity insanity;
+  insanity.userMap[thrift::test::Numberz::FIVE] = 5;
+  insanity.userMap[static_cast<thrift::test::Numberz::type>(42)] = 42;
+  insanity.xtructs.resize(1);
+  insanity.xtructs[0].__set_string_thing("x");
+  insanity.xtructs[0].__set_byte_thing('b');
+  insanity.xtructs[0].__set_i64_thing(-1);
+
+  // appends to what is in the buffer already
+  std::string out = "request: ";
+  insanity.appendTo(out);
+  BOOST_CHECK_EQUAL(out,
+                    "request: Insanity(userMap={FIVE: 5, 42: 42}, xtructs=[Xtruct(string_thing=x, "
+                    "byte_thing=b, i32_thing=0, i64_thing=-1)])");
+  BOOST_CHECK_EQUAL(out, "request: " + to_string(insanity));
+
+  thrift::test::Tricky2 tricky;
+  out.clear();
+  appendTo(out, tricky);
+  BOOST_CHECK_EQUAL(out, "Tricky2(im_optional=<null>)");
+}
+
+BOOST_AUTO_TEST_CASE(append_to_with_limits) {
+  std::string out;
+  appendTo(out, std::string("abcdef"), TToStringLimit(4));
+  BOOST_CHECK_EQUAL(out, "abcd...");
+
+  std::vector<int> l(10, 7);
+  out.clear();
+  appendTo(out, l, TToStringLimit(std::string::npos, 3));
+  BOOST_CHECK_EQUAL(out, "[7, 7, 7, ...]");
+  out.clear();
+  appendTo(out, l, TToStringLimit(8));
+  BOOST_CHECK_EQUAL(out, "[7, 7, 7, ...]");
+
+  thrift::test::ListBonks bonks;
+  bonks.bonk.assign(100, thrift::test::Bonk());
+  out.clear();
+  bonks.appendTo(out, TToStringLimit(45));
+  BOOST_CHECK_EQUAL(out, "ListBonks(bonk=[Bonk(message=, type=0), Bonk(...), ...])");
+
+  thrift::test::Bonk bonk;
+  bonk.__set_message(std::string(1000, 'x'));
+  out.clear();
+  bonk.appendTo(out, TToStringLimit(20));
+  BOOST_CHECK_EQUAL(out, "Bonk(message=xxxxxxx..., ...)");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
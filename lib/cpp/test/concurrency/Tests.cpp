@@ -151,6 +151,48 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (runAll || args[0].compare("timing-wheel-timer-manager") == 0) {
+
+    std::cout << "TimingWheelTimerManager tests..." << std::endl;
+
+    TimingWheelTimerManagerTests timingWheelTests;
+
+    std::cout << "\t\tTimingWheelTimerManager test00" << std::endl;
+
+    if (!timingWheelTests.test00()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test01" << std::endl;
+
+    if (!timingWheelTests.test01()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test02" << std::endl;
+
+    if (!timingWheelTests.test02()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test03" << std::endl;
+
+    if (!timingWheelTests.test03()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager test04" << std::endl;
+
+    if (!timingWheelTests.test04()) {
+      std::cerr << "\t\tTimingWheelTimerManager tests FAILED" << std::endl;
+      return 1;
+    }
+  }
+
   if (runAll || args[0].compare("thread-manager") == 0) {
 
     std::cout << "ThreadManager tests..." << std::endl;
@@ -187,6 +229,49 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (runAll || args[0].compare("work-stealing-thread-manager") == 0) {
+
+    std::cout << "WorkStealingThreadManager tests..." << std::endl;
+
+    {
+      size_t workerCount = 10 * WEIGHT;
+      size_t taskCount = 500 * WEIGHT;
+      int64_t delay = 10LL;
+
+      ThreadManagerTests threadManagerTests(&ThreadManager::newWorkStealingThreadManager);
+
+      std::cout << "\t\tWorkStealingThreadManager api test:" << std::endl;
+
+      if (!threadManagerTests.apiTest()) {
+        std::cerr << "\t\tWorkStealingThreadManager apiTest FAILED" << std::endl;
+        return 1;
+      }
+
+      std::cout << "\t\tWorkStealingThreadManager load test: worker count: " << workerCount
+                << " task count: " << taskCount << " delay: " << delay << std::endl;
+
+      if (!threadManagerTests.loadTest(taskCount, delay, workerCount)) {
+        std::cerr << "\t\tWorkStealingThreadManager loadTest FAILED" << std::endl;
+        return 1;
+      }
+
+      std::cout << "\t\tWorkStealingThreadManager block test: worker count: " << workerCount
+                << " delay: " << delay << std::endl;
+
+      if (!threadManagerTests.blockTest(delay, workerCount)) {
+        std::cerr << "\t\tWorkStealingThreadManager blockTest FAILED" << std::endl;
+        return 1;
+      }
+
+      std::cout << "\t\tWorkStealingThreadManager stop test" << std::endl;
+
+      if (!threadManagerTests.stopTest(100 * WEIGHT)) {
+        std::cerr << "\t\tWorkStealingThreadManager stopTest FAILED" << std::endl;
+        return 1;
+      }
+    }
+  }
+
   if (runAll || args[0].compare("thread-manager-benchmark") == 0) {
 
     std::cout << "ThreadManager benchmark tests..." << std::endl;
@@ -215,10 +300,46 @@ int main(int argc, char** argv) {
           std::cerr << "\t\tThreadManager loadTest FAILED" << std::endl;
           return 1;
         }
+
+        std::cout << "\t\tWorkStealingThreadManager load test: worker count: " << workerCount
+                  << " task count: " << taskCount << " delay: " << delay << std::endl;
+
+        ThreadManagerTests workStealingTests(&ThreadManager::newWorkStealingThreadManager);
+
+        if (!workStealingTests.loadTest(taskCount, delay, workerCount))
+        {
+          std::cerr << "\t\tWorkStealingThreadManager loadTest FAILED" << std::endl;
+          return 1;
+        }
       }
     }
   }
 
+  if (runAll || args[0].compare("timer-manager-benchmark") == 0) {
+
+    std::cout << "TimerManager benchmark tests..." << std::endl;
+
+    size_t timerCount = 10000 * WEIGHT;
+
+    std::cout << "\t\tTimerManager add/remove: timer count: " << timerCount << std::endl;
+
+    TimerManagerTests timerManagerTests;
+
+    if (!timerManagerTests.benchmark(timerCount)) {
+      std::cerr << "\t\tTimerManager benchmark FAILED" << std::endl;
+      return 1;
+    }
+
+    std::cout << "\t\tTimingWheelTimerManager add/remove: timer count: " << timerCount << std::endl;
+
+    TimingWheelTimerManagerTests timingWheelTests;
+
+    if (!timingWheelTests.benchmark(timerCount)) {
+      std::cerr << "\t\tTimingWheelTimerManager benchmark FAILED" << std::endl;
+      return 1;
+    }
+  }
+
   std::cout << "ALL TESTS PASSED" << std::endl;
   return 0;
 }
@@ -23,10 +23,12 @@
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
+#include <atomic>
 #include <deque>
 #include <set>
 #include <iostream>
 #include <stdint.h>
+#include <thread>
 
 namespace apache {
 namespace thrift {
@@ -57,6 +59,11 @@ static void sleep_(int64_t millisec) {
 class ThreadManagerTests {
 
 public:
+  typedef shared_ptr<ThreadManager> (*Factory)(size_t count, size_t pendingTaskCountMax);
+
+  ThreadManagerTests(Factory factory = &ThreadManager::newSimpleThreadManager)
+    : _factory(factory) {}
+
   class Task : public Runnable {
 
   public:
@@ -105,7 +112,7 @@ public:
 
     size_t activeCount = count;
 
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount);
+    shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
 
     shared_ptr<ThreadFactory> threadFactory
         = shared_ptr<ThreadFactory>(new ThreadFactory(false));
@@ -251,7 +258,7 @@ public:
       size_t activeCounts[] = {workerCount, pendingTaskMaxCount, 1};
 
       shared_ptr<ThreadManager> threadManager
-          = ThreadManager::newSimpleThreadManager(workerCount, pendingTaskMaxCount);
+          = _factory(workerCount, pendingTaskMaxCount);
 
       shared_ptr<ThreadFactory> threadFactory
           = shared_ptr<ThreadFactory>(new ThreadFactory());
@@ -383,6 +390,69 @@ public:
   }
 
 
+  class CountingTask : public Runnable {
+
+  public:
+    CountingTask(std::atomic<size_t>& count) : _count(count) {}
+
+    void run() override {
+      ++_count;
+      // lets the other workers run while this one holds the task
+      std::this_thread::yield();
+    }
+
+    std::atomic<size_t>& _count;
+  };
+
+  /**
+   * Stop a thread manager while the tasks added just before are still being
+   * taken by its workers, so that idle workers wait for the last pending one
+   * while busy ones run it.  Verify that stop() returns every time, after
+   * all tasks ran.
+   */
+  bool stopTest(size_t iterations = 1000, size_t workerCount = 16) {
+
+    bool success = true;
+
+    for (size_t ix = 0; ix < iterations && success; ix++) {
+      std::atomic<size_t> count(0);
+      size_t taskCount = workerCount + 1;
+      shared_ptr<ThreadManager> threadManager = _factory(workerCount, 0);
+      threadManager->threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory(false)));
+      threadManager->start();
+
+      for (size_t task = 0; task < taskCount; task++) {
+        threadManager->add(shared_ptr<Runnable>(new CountingTask(count)));
+      }
+
+      // stop() on another thread, so that a hang is reported
+      auto stopped = std::make_shared<std::atomic<bool> >(false);
+      std::thread stopper([threadManager, stopped] {
+        threadManager->stop();
+        *stopped = true;
+      });
+      for (int wait = 0; wait < 10000 && !*stopped; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      if (!*stopped) {
+        std::cerr << "\t\t\tstop() did not return in iteration " << ix << std::endl;
+        stopper.detach();
+        return false;
+      }
+      stopper.join();
+
+      if (count != taskCount) {
+        std::cerr << "\t\t\texpected " << taskCount << " tasks to run, but " << count
+                  << " did" << std::endl;
+        success = false;
+      }
+    }
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << std::endl;
+    return success;
+  }
+
   bool apiTest() {
 
     // prove currentTime has milliseconds granularity since many other things depend on it
@@ -400,7 +470,7 @@ public:
 
   bool apiTestWithThreadFactory(shared_ptr<ThreadFactory> threadFactory)
   {
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(1);
+    shared_ptr<ThreadManager> threadManager = _factory(1, 0);
     threadManager->threadFactory(threadFactory);
 
     std::cout << "\t\t\t\tstarting.. " << std::endl;
@@ -629,6 +699,9 @@ public:
     threadManager.reset();
     return true;
   }
+
+private:
+  Factory _factory;
 };
 
 }
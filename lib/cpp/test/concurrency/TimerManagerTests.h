@@ -18,12 +18,14 @@
  */
 
 #include <thrift/concurrency/TimerManager.h>
+#include <thrift/concurrency/TimingWheelTimerManager.h>
 #include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/Monitor.h>
 
 #include <assert.h>
 #include <chrono>
 #include <thread>
+#include <vector>
 #include <iostream>
 
 namespace apache {
@@ -33,7 +35,8 @@ namespace test {
 
 using namespace apache::thrift::concurrency;
 
-class TimerManagerTests {
+template <class Manager>
+class TimerManagerTestsT {
 
 public:
   class Task : public Runnable {
@@ -76,21 +79,21 @@ public:
    */
   bool test00(uint64_t timeout = 1000LL) {
 
-    shared_ptr<TimerManagerTests::Task> orphanTask
-        = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, 10 * timeout));
+    shared_ptr<Task> orphanTask
+        = shared_ptr<Task>(new Task(_monitor, 10 * timeout));
 
     {
-      TimerManager timerManager;
+      Manager timerManager;
       timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
       timerManager.start();
-      if (timerManager.state() != TimerManager::STARTED) {
+      if (timerManager.state() != Manager::STARTED) {
         std::cerr << "timerManager is not in the STARTED state, but should be" << std::endl;
         return false;
       }
 
       // Don't create task yet, because its constructor sets the expected completion time, and we
       // need to delay between inserting the two tasks into the run queue.
-      shared_ptr<TimerManagerTests::Task> task;
+      shared_ptr<Task> task;
 
       {
         Synchronized s(_monitor);
@@ -98,7 +101,7 @@ public:
 
         std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
 
-        task.reset(new TimerManagerTests::Task(_monitor, timeout));
+        task.reset(new Task(_monitor, timeout));
         timerManager.add(task, timeout);
         _monitor.wait();
       }
@@ -125,20 +128,20 @@ public:
    * task when the manager goes out of scope and its destructor is called.
    */
   bool test01(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the two tasks
-    shared_ptr<TimerManagerTests::Task> taskToRemove
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 2));
+    shared_ptr<Task> taskToRemove
+      = shared_ptr<Task>(new Task(_monitor, timeout / 2));
     timerManager.add(taskToRemove, taskToRemove->_timeout);
 
-    shared_ptr<TimerManagerTests::Task> task
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout));
+    shared_ptr<Task> task
+      = shared_ptr<Task>(new Task(_monitor, timeout));
     timerManager.add(task, task->_timeout);
 
     // Remove one task and wait until the other has completed
@@ -158,21 +161,21 @@ public:
    * and its destructor is called.
    */
   bool test02(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the one tasks and add it twice
-    shared_ptr<TimerManagerTests::Task> taskToRemove
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 3));
+    shared_ptr<Task> taskToRemove
+      = shared_ptr<Task>(new Task(_monitor, timeout / 3));
     timerManager.add(taskToRemove, taskToRemove->_timeout);
     timerManager.add(taskToRemove, taskToRemove->_timeout * 2);
 
-    shared_ptr<TimerManagerTests::Task> task
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout));
+    shared_ptr<Task> task
+      = shared_ptr<Task>(new Task(_monitor, timeout));
     timerManager.add(task, task->_timeout);
 
     // Remove the first task (e.g. two timers) and wait until the other has completed
@@ -191,20 +194,20 @@ public:
    * task when the manager goes out of scope and its destructor is called.
    */
   bool test03(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the two tasks
-    shared_ptr<TimerManagerTests::Task> taskToRemove
-        = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 2));
-    TimerManager::Timer timer = timerManager.add(taskToRemove, taskToRemove->_timeout);
+    shared_ptr<Task> taskToRemove
+        = shared_ptr<Task>(new Task(_monitor, timeout / 2));
+    typename Manager::Timer timer = timerManager.add(taskToRemove, taskToRemove->_timeout);
 
-    shared_ptr<TimerManagerTests::Task> task
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout));
+    shared_ptr<Task> task
+      = shared_ptr<Task>(new Task(_monitor, timeout));
     timerManager.add(task, task->_timeout);
 
     // Remove one task and wait until the other has completed
@@ -228,17 +231,17 @@ public:
    * This test creates one task, and tries to remove it after it has expired.
    */
   bool test04(uint64_t timeout = 1000LL) {
-    TimerManager timerManager;
+    Manager timerManager;
     timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
     timerManager.start();
-    assert(timerManager.state() == TimerManager::STARTED);
+    assert(timerManager.state() == Manager::STARTED);
 
     Synchronized s(_monitor);
 
     // Setup the task
-    shared_ptr<TimerManagerTests::Task> task
-      = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, timeout / 10));
-    TimerManager::Timer timer = timerManager.add(task, task->_timeout);
+    shared_ptr<Task> task
+      = shared_ptr<Task>(new Task(_monitor, timeout / 10));
+    typename Manager::Timer timer = timerManager.add(task, task->_timeout);
     task.reset();
 
     // Wait until the task has completed
@@ -262,11 +265,60 @@ public:
     return true;
   }
 
+  /**
+   * Adds timerCount timers with deadlines spread over one to ten seconds and
+   * cancels all but every tenth of them again, the typical life of
+   * per-request deadlines.  Reports the time spent adding and cancelling.
+   */
+  bool benchmark(size_t timerCount) {
+    Manager timerManager;
+    timerManager.threadFactory(shared_ptr<ThreadFactory>(new ThreadFactory()));
+    timerManager.start();
+    assert(timerManager.state() == Manager::STARTED);
+
+    shared_ptr<Runnable> task(new NoopTask());
+    std::vector<typename Manager::Timer> timers;
+    timers.reserve(timerCount);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t ix = 0; ix < timerCount; ix++) {
+      timers.push_back(timerManager.add(task, std::chrono::milliseconds(1000 + (ix * 7919) % 9000)));
+    }
+    auto added = std::chrono::steady_clock::now();
+    for (size_t ix = 0; ix < timerCount; ix++) {
+      if (ix % 10 != 0) {
+        timerManager.remove(timers[ix]);
+      }
+    }
+    auto removed = std::chrono::steady_clock::now();
+
+    if (timerManager.taskCount() != (timerCount + 9) / 10) {
+      return false;
+    }
+
+    std::cout << "\t\t\tadd: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(added - start).count()
+              << "ms remove: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(removed - added).count()
+              << "ms" << std::endl;
+
+    timerManager.stop();
+    return true;
+  }
+
+  class NoopTask : public Runnable {
+  public:
+    void run() override {}
+  };
+
   friend class TestTask;
 
   Monitor _monitor;
 };
 
+typedef TimerManagerTestsT<TimerManager> TimerManagerTests;
+typedef TimerManagerTestsT<TimingWheelTimerManager> TimingWheelTimerManagerTests;
+
 }
 }
 }